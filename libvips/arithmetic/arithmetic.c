@@ -771,6 +771,7 @@ vips_arithmetic_operation_init(void)
 	extern GType vips_abs_get_type(void);
 	extern GType vips_sign_get_type(void);
 	extern GType vips_stats_get_type(void);
+	extern GType vips_multistats_get_type(void);
 	extern GType vips_hist_find_get_type(void);
 	extern GType vips_hist_find_ndim_get_type(void);
 	extern GType vips_hist_find_indexed_get_type(void);
@@ -780,6 +781,7 @@ vips_arithmetic_operation_init(void)
 	extern GType vips_profile_get_type(void);
 	extern GType vips_measure_get_type(void);
 	extern GType vips_getpoint_get_type(void);
+	extern GType vips_getpoints_get_type(void);
 	extern GType vips_round_get_type(void);
 	extern GType vips_relational_get_type(void);
 	extern GType vips_relational_const_get_type(void);
@@ -810,6 +812,7 @@ vips_arithmetic_operation_init(void)
 	vips_abs_get_type();
 	vips_sign_get_type();
 	vips_stats_get_type();
+	vips_multistats_get_type();
 	vips_hist_find_get_type();
 	vips_hist_find_ndim_get_type();
 	vips_hist_find_indexed_get_type();
@@ -819,6 +822,7 @@ vips_arithmetic_operation_init(void)
 	vips_profile_get_type();
 	vips_measure_get_type();
 	vips_getpoint_get_type();
+	vips_getpoints_get_type();
 	vips_round_get_type();
 	vips_relational_get_type();
 	vips_relational_const_get_type();
@@ -0,0 +1,444 @@
+/* read many points from an image
+ *
+ * 19/10/26
+ * 	- from getpoint.c
+ */
+
+/*
+
+	This file is part of VIPS.
+
+	VIPS is free software; you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+	02110-1301  USA
+
+ */
+
+/*
+
+	These files are distributed with VIPS - http://www.vips.ecs.soton.ac.uk
+
+ */
+
+/*
+#define VIPS_DEBUG
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif /*HAVE_CONFIG_H*/
+#include <glib/gi18n-lib.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <vips/vips.h>
+#include <vips/debug.h>
+#include <vips/internal.h>
+
+/* Group points into tiles of this size. Each tile is prepared once.
+ */
+#define GETPOINTS_TILE_SIZE (128)
+
+/* A point to read, plus the tile it falls in.
+ */
+typedef struct _VipsGetpointsPoint {
+	gint64 tile;
+	int index;
+} VipsGetpointsPoint;
+
+typedef struct _VipsGetpoints {
+	VipsOperation parent_instance;
+
+	VipsImage *in;
+	VipsArrayDouble *coords;
+	VipsInterpolate *interpolate;
+	VipsArrayDouble *out_array;
+
+	/* The image we read from: decoded, cast to double, and embedded for
+	 * the interpolator if necessary.
+	 */
+	VipsImage *ready;
+
+	/* Interpolator window, if any, and the margin we added.
+	 */
+	int window_size;
+	int window_offset;
+	int margin;
+	VipsInterpolateMethod interpolate_fn;
+
+	/* All the points, sorted by tile.
+	 */
+	int n_points;
+	VipsGetpointsPoint *points;
+
+	/* Start of each run of points which share a tile, plus a sentinel.
+	 */
+	int n_groups;
+	int *groups;
+
+	/* The next group to hand out.
+	 */
+	int next_group;
+
+	/* Write results here, n_points * bands doubles.
+	 */
+	double *values;
+
+} VipsGetpoints;
+
+typedef VipsOperationClass VipsGetpointsClass;
+
+G_DEFINE_TYPE(VipsGetpoints, vips_getpoints, VIPS_TYPE_OPERATION);
+
+static int
+vips_getpoints_point_compare(const void *a, const void *b)
+{
+	const VipsGetpointsPoint *p1 = (const VipsGetpointsPoint *) a;
+	const VipsGetpointsPoint *p2 = (const VipsGetpointsPoint *) b;
+
+	if (p1->tile < p2->tile)
+		return -1;
+	else if (p1->tile > p2->tile)
+		return 1;
+	else
+		return p1->index - p2->index;
+}
+
+/* Hand out the next tile. This runs single-threaded.
+ */
+static int
+vips_getpoints_allocate(VipsThreadState *state, void *a, gboolean *stop)
+{
+	VipsGetpoints *getpoints = (VipsGetpoints *) a;
+	double *coords = VIPS_AREA(getpoints->coords)->data;
+
+	VipsRect image;
+	VipsGetpointsPoint *point;
+	int tx, ty;
+
+	if (getpoints->next_group >= getpoints->n_groups) {
+		*stop = TRUE;
+		return 0;
+	}
+
+	/* All points in a group share a tile, so we can find it from the
+	 * first.
+	 */
+	point = &getpoints->points[getpoints->groups[getpoints->next_group]];
+	tx = (int) coords[point->index * 2] / GETPOINTS_TILE_SIZE;
+	ty = (int) coords[point->index * 2 + 1] / GETPOINTS_TILE_SIZE;
+
+	/* The tile, in ready coordinates, plus the interpolator window.
+	 */
+	state->pos.left = tx * GETPOINTS_TILE_SIZE +
+		getpoints->margin - getpoints->window_offset;
+	state->pos.top = ty * GETPOINTS_TILE_SIZE +
+		getpoints->margin - getpoints->window_offset;
+	state->pos.width = GETPOINTS_TILE_SIZE + getpoints->window_size;
+	state->pos.height = GETPOINTS_TILE_SIZE + getpoints->window_size;
+
+	image.left = 0;
+	image.top = 0;
+	image.width = getpoints->ready->Xsize;
+	image.height = getpoints->ready->Ysize;
+	vips_rect_intersectrect(&state->pos, &image, &state->pos);
+
+	state->x = getpoints->next_group;
+	getpoints->next_group += 1;
+
+	return 0;
+}
+
+/* Read all the points in a tile.
+ */
+static int
+vips_getpoints_work(VipsThreadState *state, void *a)
+{
+	VipsGetpoints *getpoints = (VipsGetpoints *) a;
+	double *coords = VIPS_AREA(getpoints->coords)->data;
+	int bands = getpoints->ready->Bands;
+	int start = getpoints->groups[state->x];
+	int end = getpoints->groups[state->x + 1];
+
+	int i, b;
+
+	if (vips_region_prepare(state->reg, &state->pos))
+		return -1;
+
+	for (i = start; i < end; i++) {
+		int index = getpoints->points[i].index;
+		double x = coords[index * 2];
+		double y = coords[index * 2 + 1];
+		double *q = getpoints->values + (gint64) index * bands;
+
+		if (getpoints->interpolate_fn)
+			getpoints->interpolate_fn(getpoints->interpolate,
+				q, state->reg,
+				x + getpoints->margin, y + getpoints->margin);
+		else {
+			double *p = (double *)
+				VIPS_REGION_ADDR(state->reg, (int) x, (int) y);
+
+			for (b = 0; b < bands; b++)
+				q[b] = p[b];
+		}
+	}
+
+	return 0;
+}
+
+static int
+vips_getpoints_build(VipsObject *object)
+{
+	VipsObjectClass *class = VIPS_OBJECT_GET_CLASS(object);
+	VipsGetpoints *getpoints = (VipsGetpoints *) object;
+	VipsImage **t = (VipsImage **) vips_object_local_array(object, 3);
+
+	double *coords;
+	int n_coords;
+	int tiles_across;
+	VipsArrayDouble *out_array;
+	int i;
+
+	if (VIPS_OBJECT_CLASS(vips_getpoints_parent_class)->build(object))
+		return -1;
+
+	coords = VIPS_AREA(getpoints->coords)->data;
+	n_coords = VIPS_AREA(getpoints->coords)->n;
+	if (n_coords % 2 != 0) {
+		vips_error(class->nickname,
+			"%s", _("coords must be a list of x, y pairs"));
+		return -1;
+	}
+	getpoints->n_points = n_coords / 2;
+
+	for (i = 0; i < getpoints->n_points; i++) {
+		double x = coords[i * 2];
+		double y = coords[i * 2 + 1];
+
+		/* !(x >= 0) also catches NaN.
+		 */
+		if (!(x >= 0) ||
+			!(y >= 0) ||
+			x >= getpoints->in->Xsize ||
+			y >= getpoints->in->Ysize) {
+			vips_error(class->nickname,
+				_("point %d out of range"), i);
+			return -1;
+		}
+	}
+
+	/* Decode and unpack to double.
+	 */
+	if (vips_image_decode(getpoints->in, &t[0]) ||
+		vips_cast(t[0], &t[1], VIPS_FORMAT_DOUBLE, NULL))
+		return -1;
+	getpoints->ready = t[1];
+
+	if (getpoints->interpolate) {
+		getpoints->window_size =
+			vips_interpolate_get_window_size(getpoints->interpolate);
+		getpoints->window_offset =
+			vips_interpolate_get_window_offset(getpoints->interpolate);
+		getpoints->interpolate_fn =
+			vips_interpolate_get_method(getpoints->interpolate);
+
+		/* Add new pixels around the input so we can interpolate at
+		 * the edges, as vips_mapim() does.
+		 */
+		getpoints->margin = getpoints->window_offset + 1;
+		if (vips_embed(getpoints->ready, &t[2],
+				getpoints->margin, getpoints->margin,
+				getpoints->ready->Xsize + getpoints->window_size - 1 + 2,
+				getpoints->ready->Ysize + getpoints->window_size - 1 + 2,
+				"extend", VIPS_EXTEND_COPY,
+				NULL))
+			return -1;
+		getpoints->ready = t[2];
+	}
+	else {
+		getpoints->window_size = 0;
+		getpoints->window_offset = 0;
+		getpoints->margin = 0;
+	}
+
+	/* Sort the points by tile, keeping the original order within each
+	 * tile.
+	 */
+	tiles_across = VIPS_ROUND_UP(getpoints->in->Xsize, GETPOINTS_TILE_SIZE) /
+		GETPOINTS_TILE_SIZE;
+	if (!(getpoints->points = VIPS_ARRAY(object,
+			  VIPS_MAX(1, getpoints->n_points), VipsGetpointsPoint)) ||
+		!(getpoints->groups = VIPS_ARRAY(object,
+			  getpoints->n_points + 1, int)) ||
+		!(getpoints->values = VIPS_ARRAY(NULL,
+			  VIPS_MAX(1, getpoints->n_points * getpoints->ready->Bands),
+			  double)))
+		return -1;
+
+	for (i = 0; i < getpoints->n_points; i++) {
+		int tx = (int) coords[i * 2] / GETPOINTS_TILE_SIZE;
+		int ty = (int) coords[i * 2 + 1] / GETPOINTS_TILE_SIZE;
+
+		getpoints->points[i].tile = (gint64) ty * tiles_across + tx;
+		getpoints->points[i].index = i;
+	}
+	qsort(getpoints->points, getpoints->n_points,
+		sizeof(VipsGetpointsPoint), vips_getpoints_point_compare);
+
+	getpoints->n_groups = 0;
+	for (i = 0; i < getpoints->n_points; i++)
+		if (i == 0 ||
+			getpoints->points[i].tile != getpoints->points[i - 1].tile)
+			getpoints->groups[getpoints->n_groups++] = i;
+	getpoints->groups[getpoints->n_groups] = getpoints->n_points;
+
+	/* Read the tiles in parallel. Each tile writes a disjoint set of
+	 * values, so no locking is necessary.
+	 */
+	getpoints->next_group = 0;
+	if (getpoints->n_groups > 0 &&
+		vips_threadpool_run(getpoints->ready,
+			vips_thread_state_new,
+			vips_getpoints_allocate,
+			vips_getpoints_work,
+			NULL,
+			getpoints)) {
+		VIPS_FREE(getpoints->values);
+		return -1;
+	}
+
+	out_array = vips_array_double_new(getpoints->values,
+		getpoints->n_points * getpoints->ready->Bands);
+	VIPS_FREE(getpoints->values);
+	g_object_set(object,
+		"out_array", out_array,
+		NULL);
+	vips_area_unref(VIPS_AREA(out_array));
+
+	return 0;
+}
+
+static void
+vips_getpoints_class_init(VipsGetpointsClass *class)
+{
+	GObjectClass *gobject_class = (GObjectClass *) class;
+	VipsObjectClass *object_class = (VipsObjectClass *) class;
+
+	gobject_class->set_property = vips_object_set_property;
+	gobject_class->get_property = vips_object_get_property;
+
+	object_class->nickname = "getpoints";
+	object_class->description = _("read many points from an image");
+	object_class->build = vips_getpoints_build;
+
+	VIPS_ARG_IMAGE(class, "in", 1,
+		_("Input"),
+		_("Input image"),
+		VIPS_ARGUMENT_REQUIRED_INPUT,
+		G_STRUCT_OFFSET(VipsGetpoints, in));
+
+	VIPS_ARG_BOXED(class, "out_array", 2,
+		_("Output array"),
+		_("Array of output values"),
+		VIPS_ARGUMENT_REQUIRED_OUTPUT,
+		G_STRUCT_OFFSET(VipsGetpoints, out_array),
+		VIPS_TYPE_ARRAY_DOUBLE);
+
+	VIPS_ARG_BOXED(class, "coords", 5,
+		_("Coordinates"),
+		_("Array of x, y pairs to read"),
+		VIPS_ARGUMENT_REQUIRED_INPUT,
+		G_STRUCT_OFFSET(VipsGetpoints, coords),
+		VIPS_TYPE_ARRAY_DOUBLE);
+
+	VIPS_ARG_INTERPOLATE(class, "interpolate", 6,
+		_("Interpolate"),
+		_("Interpolate pixels with this"),
+		VIPS_ARGUMENT_OPTIONAL_INPUT,
+		G_STRUCT_OFFSET(VipsGetpoints, interpolate));
+}
+
+static void
+vips_getpoints_init(VipsGetpoints *getpoints)
+{
+}
+
+/**
+ * vips_getpoints: (method)
+ * @in: image to read from
+ * @vector: (out)(array length=n): output pixel values here
+ * @n: length of output vector
+ * @coords: (array length=n_coords): x, y pairs to read
+ * @n_coords: length of @coords
+ * @...: %NULL-terminated list of optional named arguments
+ *
+ * Optional arguments:
+ *
+ * * @interpolate: interpolate pixels with this
+ *
+ * Reads many pixels from an image. @coords is an array of x, y pairs, and
+ * the values of each pixel are returned, one after the other, in @vector.
+ * @vector will have (@n_coords / 2) * bands elements. You must free the
+ * array with g_free() when you are done with it.
+ *
+ * This is much faster than calling vips_getpoint() repeatedly: the points
+ * are grouped by tile and each tile is computed just once, with tiles
+ * read in parallel.
+ *
+ * Coordinates are truncated to integers, unless you set @interpolate, in
+ * which case sub-pixel positions are interpolated. Pixels beyond the image
+ * edge are made by copying the nearest edge pixel. All points must lie
+ * within the image.
+ *
+ * See also: vips_getpoint().
+ *
+ * Returns: 0 on success, or -1 on error.
+ */
+int
+vips_getpoints(VipsImage *in, double **vector, int *n,
+	const double *coords, int n_coords, ...)
+{
+	va_list ap;
+	VipsArea *area_coords;
+	VipsArrayDouble *out_array;
+	VipsArea *area;
+	int result;
+
+	area_coords = VIPS_AREA(vips_array_double_new(coords, n_coords));
+
+	va_start(ap, n_coords);
+	result = vips_call_split("getpoints", ap, in, &out_array, area_coords);
+	va_end(ap);
+
+	vips_area_unref(area_coords);
+
+	if (result)
+		return -1;
+
+	area = VIPS_AREA(out_array);
+	*vector = VIPS_ARRAY(NULL, VIPS_MAX(1, area->n), double);
+	if (!*vector) {
+		vips_area_unref(area);
+		return -1;
+	}
+	memcpy(*vector, area->data, area->n * area->sizeof_type);
+	*n = area->n;
+	vips_area_unref(area);
+
+	return 0;
+}
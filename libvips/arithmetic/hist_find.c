@@ -28,6 +28,9 @@
  * 	- unroll common cases
  * 1/2/21 erdmann
  * 	- use double for very large histograms
+ * 19/10/26
+ * 	- interleave uchar sub-histograms to break store-to-load dependencies
+ * 	- run-length accumulate ushort histograms, if lines have runs
  */
 
 /*
@@ -74,10 +77,17 @@ typedef struct {
 	int n_bands;	/* Number of bands in output */
 	int band;		/* If one band in out, which band of input */
 	int size;		/* Number of bins for each band */
+	int n_sub;		/* Number of interleaved copies of each band */
 	int mx;			/* Maximum value we have seen */
 	VipsPel **bins; /* double or uint bins */
 } Histogram;
 
+/* Interleave this many sub-histograms for uchar images. Successive pixels
+ * go to different copies, so runs of equal values don't stall on the
+ * previous increment.
+ */
+#define N_SUB_UCHAR (4)
+
 typedef struct _VipsHistFind {
 	VipsStatistic parent_instance;
 
@@ -107,11 +117,12 @@ G_DEFINE_TYPE(VipsHistFind, vips_hist_find, VIPS_TYPE_STATISTIC);
 /* Build a Histogram.
  */
 static Histogram *
-histogram_new(VipsHistFind *hist_find, int n_bands, int band, int size)
+histogram_new(VipsHistFind *hist_find,
+	int n_bands, int band, int size, int n_sub)
 {
 	/* We won't use all of this for uint accumulators.
 	 */
-	int n_bytes = size * sizeof(double);
+	int n_bytes = n_sub * size * sizeof(double);
 
 	Histogram *hist;
 	int i;
@@ -130,6 +141,7 @@ histogram_new(VipsHistFind *hist_find, int n_bands, int band, int size)
 	hist->n_bands = n_bands;
 	hist->band = band;
 	hist->size = size;
+	hist->n_sub = n_sub;
 	hist->mx = 0;
 
 	return hist;
@@ -223,15 +235,23 @@ vips_hist_find_start(VipsStatistic *statistic)
 			hist_find->band,
 			statistic->ready->BandFmt == VIPS_FORMAT_UCHAR
 				? 256
-				: 65536);
+				: 65536,
+			1);
 
+	/* uchar sub-hists are small, so we can interleave several copies
+	 * and still stay in L1.
+	 */
 	return (void *) histogram_new(hist_find,
 		hist_find->hist->n_bands,
 		hist_find->hist->band,
-		hist_find->hist->size);
+		hist_find->hist->size,
+		statistic->ready->BandFmt == VIPS_FORMAT_UCHAR
+			? N_SUB_UCHAR
+			: 1);
 }
 
-/* Join a sub-hist onto the main hist.
+/* Join a sub-hist onto the main hist, folding the interleaved copies
+ * together.
  */
 static int
 vips_hist_find_stop(VipsStatistic *statistic, void *seq)
@@ -240,15 +260,44 @@ vips_hist_find_stop(VipsStatistic *statistic, void *seq)
 	VipsHistFind *hist_find = (VipsHistFind *) statistic;
 	Histogram *hist = hist_find->hist;
 
-	int i, j;
+	int i, j, k;
 
 	g_assert(sub_hist->n_bands == hist->n_bands &&
-		sub_hist->size == hist->size);
+		sub_hist->size == hist->size &&
+		hist->n_sub == 1);
 
 	/* Add on sub-data.
 	 */
 	hist->mx = VIPS_MAX(hist->mx, sub_hist->mx);
 
+	/* Find the max of a single band of a uchar image from the highest
+	 * non-zero bin.
+	 */
+#define MAX_BIN(TYPE) \
+	G_STMT_START \
+	{ \
+		TYPE **sub_bins = (TYPE **) sub_hist->bins; \
+\
+		for (j = sub_hist->size - 1; j > hist->mx; j--) { \
+			for (k = 0; k < sub_hist->n_sub; k++) \
+				if (sub_bins[0][k * sub_hist->size + j]) \
+					break; \
+			if (k < sub_hist->n_sub) \
+				break; \
+		} \
+\
+		hist->mx = j; \
+	} \
+	G_STMT_END
+
+	if (hist_find->band >= 0 &&
+		statistic->ready->BandFmt == VIPS_FORMAT_UCHAR) {
+		if (hist_find->large)
+			MAX_BIN(double);
+		else
+			MAX_BIN(unsigned int);
+	}
+
 #define SUM(TYPE) \
 	G_STMT_START \
 	{ \
@@ -256,8 +305,13 @@ vips_hist_find_stop(VipsStatistic *statistic, void *seq)
 		TYPE **sub_bins = (TYPE **) sub_hist->bins; \
 \
 		for (i = 0; i < hist->n_bands; i++) \
-			for (j = 0; j < hist->size; j++) \
-				main_bins[i][j] += sub_bins[i][j]; \
+			for (k = 0; k < sub_hist->n_sub; k++) { \
+				TYPE *restrict p = sub_bins[i] + k * hist->size; \
+				TYPE *restrict q = main_bins[i]; \
+\
+				for (j = 0; j < hist->size; j++) \
+					q[j] += p[j]; \
+			} \
 	} \
 	G_STMT_END
 
@@ -275,67 +329,102 @@ vips_hist_find_stop(VipsStatistic *statistic, void *seq)
 	return 0;
 }
 
-#define SCANOP \
+/* Histogram a uchar band, sending successive pixels to successive
+ * interleaved copies.
+ */
+#define UCSCAN(HIST_TYPE, FIRST, N_BANDS) \
 	G_STMT_START \
 	{ \
-		for (z = 0; z < nb; z++) { \
-			int v = p[z]; \
+		HIST_TYPE **bins = (HIST_TYPE **) hist->bins; \
+		int size = hist->size; \
 \
-			if (v > mx) \
-				mx = v; \
+		int z; \
 \
-			bins[z][v] += 1; \
-		} \
+		for (z = 0; z < (N_BANDS); z++) { \
+			HIST_TYPE *restrict b0 = bins[z]; \
+			HIST_TYPE *restrict b1 = b0 + size; \
+			HIST_TYPE *restrict b2 = b1 + size; \
+			HIST_TYPE *restrict b3 = b2 + size; \
+			unsigned char *restrict p = \
+				(unsigned char *) in + (FIRST) + z; \
 \
-		p += nb; \
-	} \
-	G_STMT_END
-
-/* No need to track max for uchar images (it's always 255).
- */
-#define UCSCANOP \
-	G_STMT_START \
-	{ \
-		for (z = 0; z < nb; z++) { \
-			int v = p[z]; \
+			for (i = 0; i + 4 <= n; i += 4) { \
+				b0[p[0]] += 1; \
+				b1[p[nb]] += 1; \
+				b2[p[2 * nb]] += 1; \
+				b3[p[3 * nb]] += 1; \
 \
-			bins[z][v] += 1; \
+				p += 4 * nb; \
+			} \
+			for (; i < n; i++) { \
+				b0[p[0]] += 1; \
+				p += nb; \
+			} \
 		} \
-\
-		p += nb; \
 	} \
 	G_STMT_END
 
-/* Hist of all bands. This one is just about worth unrolling.
+/* Look at this many pixels at the start of a line to decide if it has runs.
+ */
+#define USSCAN_PROBE (32)
+
+/* The ushort fast path. 65536 bins won't fit in L1, so rather than
+ * interleave, we count runs of equal values and add each run once. Flat
+ * areas then need a single increment per run, and we only need to check the
+ * max when a run ends.
+ *
+ * On noisy images the test costs more than it saves, so we sample the start
+ * of each line and only count runs if values mostly repeat.
  */
-#define SCAN(IMAGE_TYPE, HIST_TYPE, OP) \
+#define USSCAN(HIST_TYPE, FIRST, N_BANDS) \
 	G_STMT_START \
 	{ \
 		HIST_TYPE **bins = (HIST_TYPE **) hist->bins; \
-		IMAGE_TYPE *p = (IMAGE_TYPE *) in; \
 \
 		int z; \
 \
-		VIPS_UNROLL(n, OP); \
-	} \
-	G_STMT_END
-
-/* Hist of selected band.
- */
-#define SCAN1(IMAGE_TYPE, HIST_TYPE) \
-	G_STMT_START \
-	{ \
-		HIST_TYPE *bins = (HIST_TYPE *) hist->bins[0]; \
-		IMAGE_TYPE *p = (IMAGE_TYPE *) in; \
-		int max = nb * n; \
+		for (z = 0; z < (N_BANDS); z++) { \
+			HIST_TYPE *restrict b = bins[z]; \
+			unsigned short *restrict p = \
+				(unsigned short *) in + (FIRST) + z; \
+			int probe = VIPS_MIN(n, USSCAN_PROBE); \
+			int last = p[0]; \
+			unsigned int run = 0; \
+			int changes; \
 \
-		for (i = hist->band; i < max; i += nb) { \
-			int v = p[i]; \
+			changes = 0; \
+			for (i = 1; i < probe; i++) \
+				changes += p[i * nb] != p[(i - 1) * nb]; \
 \
-			if (v > mx) \
-				mx = v; \
+			if (changes > probe / 4) { \
+				for (i = 0; i < n; i++) { \
+					int v = p[0]; \
 \
-			bins[v] += 1; \
+					b[v] += 1; \
+					mx = VIPS_MAX(mx, v); \
+\
+					p += nb; \
+				} \
+\
+				continue; \
+			} \
+\
+			for (i = 0; i < n; i++) { \
+				int v = p[0]; \
+\
+				if (v != last) { \
+					b[last] += run; \
+					mx = VIPS_MAX(mx, last); \
+					last = v; \
+					run = 0; \
+				} \
+				run += 1; \
+\
+				p += nb; \
+			} \
+\
+			b[last] += run; \
+			mx = VIPS_MAX(mx, last); \
 		} \
 	} \
 	G_STMT_END
@@ -347,49 +436,38 @@ vips_hist_find_scan(VipsStatistic *statistic, void *seq,
 	VipsHistFind *hist_find = (VipsHistFind *) statistic;
 	Histogram *hist = (Histogram *) seq;
 	int nb = statistic->ready->Bands;
+	int first = hist_find->band < 0 ? 0 : hist_find->band;
+	int n_bands = hist_find->band < 0 ? nb : 1;
 	int mx = hist->mx;
 
 	int i;
 
-	if (hist_find->band < 0)
-		switch (statistic->ready->BandFmt) {
-		case VIPS_FORMAT_UCHAR:
-			if (hist_find->large)
-				SCAN(unsigned char, double, UCSCANOP);
-			else
-				SCAN(unsigned char, unsigned int, UCSCANOP);
+	switch (statistic->ready->BandFmt) {
+	case VIPS_FORMAT_UCHAR:
+		g_assert(hist->n_sub == N_SUB_UCHAR);
+
+		if (hist_find->large)
+			UCSCAN(double, first, n_bands);
+		else
+			UCSCAN(unsigned int, first, n_bands);
+
+		/* No need to track max for all bands of uchar images (it's
+		 * always 255). For a single band, we find the max in stop.
+		 */
+		if (hist_find->band < 0)
 			mx = 255;
-			break;
-
-		case VIPS_FORMAT_USHORT:
-			if (hist_find->large)
-				SCAN(unsigned short, double, SCANOP);
-			else
-				SCAN(unsigned short, unsigned int, SCANOP);
-			break;
-
-		default:
-			g_assert_not_reached();
-		}
-	else
-		switch (statistic->ready->BandFmt) {
-		case VIPS_FORMAT_UCHAR:
-			if (hist_find->large)
-				SCAN1(unsigned char, double);
-			else
-				SCAN1(unsigned char, unsigned int);
-			break;
-
-		case VIPS_FORMAT_USHORT:
-			if (hist_find->large)
-				SCAN1(unsigned short, double);
-			else
-				SCAN1(unsigned short, unsigned int);
-			break;
-
-		default:
-			g_assert_not_reached();
-		}
+		break;
+
+	case VIPS_FORMAT_USHORT:
+		if (hist_find->large)
+			USSCAN(double, first, n_bands);
+		else
+			USSCAN(unsigned int, first, n_bands);
+		break;
+
+	default:
+		g_assert_not_reached();
+	}
 
 	hist->mx = mx;
 
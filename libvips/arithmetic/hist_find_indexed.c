@@ -8,6 +8,8 @@
  * 	- redo as a class
  * 2/11/17
  * 	- add @combine ... pick a bin combine mode
+ * 19/10/26
+ * 	- use a sparse histogram per thread for ushort index images
  */
 
 /*
@@ -49,20 +51,29 @@
 #include <vips/vips.h>
 
 #include "statistic.h"
+#include "sparsehist.h"
+
+/* Switch a sparse per-thread histogram to dense once it has this many
+ * bins in use.
+ */
+#define SPARSE_MAX (4096)
 
 struct _VipsHistFindIndexed;
 
-/* Accumulate a histogram in one of these.
+/* Accumulate a histogram in one of these. ushort index images start with
+ * a sparse histogram, since label images often use only a few of the 65536
+ * possible bins.
  */
 typedef struct {
 	struct _VipsHistFindIndexed *indexed;
 
 	VipsRegion *reg; /* Get index pixels with this */
 
-	int size;	  /* Length of bins */
-	int mx;		  /* Maximum value we have seen */
-	double *bins; /* All the bins! */
-	int *init;	  /* TRUE for bin has been initialised */
+	int size;				/* Length of bins */
+	int mx;					/* Maximum value we have seen */
+	double *bins;			/* All the bins! */
+	int *init;				/* TRUE for bin has been initialised */
+	VipsSparseHist *sparse; /* Or sparse bins */
 } Histogram;
 
 typedef struct _VipsHistFindIndexed {
@@ -93,8 +104,26 @@ typedef VipsStatisticClass VipsHistFindIndexedClass;
 G_DEFINE_TYPE(VipsHistFindIndexed,
 	vips_hist_find_indexed, VIPS_TYPE_STATISTIC);
 
+/* Allocate the dense bins.
+ */
+static int
+histogram_dense(Histogram *hist)
+{
+	VipsHistFindIndexed *indexed = hist->indexed;
+	int bands = VIPS_STATISTIC(indexed)->ready->Bands;
+
+	if (!(hist->bins = VIPS_ARRAY(indexed, bands * hist->size, double)) ||
+		!(hist->init = VIPS_ARRAY(indexed, hist->size, int)))
+		return -1;
+
+	memset(hist->bins, 0, bands * hist->size * sizeof(double));
+	memset(hist->init, 0, hist->size * sizeof(int));
+
+	return 0;
+}
+
 static Histogram *
-histogram_new(VipsHistFindIndexed *indexed)
+histogram_new(VipsHistFindIndexed *indexed, gboolean sparse)
 {
 	VipsStatistic *statistic = VIPS_STATISTIC(indexed);
 	int bands = statistic->ready->Bands;
@@ -111,14 +140,15 @@ histogram_new(VipsHistFindIndexed *indexed)
 	hist->mx = 0;
 	hist->bins = NULL;
 	hist->init = NULL;
+	hist->sparse = NULL;
 
-	if (!(hist->bins = VIPS_ARRAY(indexed, bands * hist->size, double)) ||
-		!(hist->init = VIPS_ARRAY(indexed, hist->size, int)) ||
-		!(hist->reg = vips_region_new(indexed->index_ready)))
+	if (sparse)
+		hist->sparse = vips__sparsehist_new(bands);
+	else if (histogram_dense(hist))
 		return NULL;
 
-	memset(hist->bins, 0, bands * hist->size * sizeof(double));
-	memset(hist->init, 0, hist->size * sizeof(int));
+	if (!(hist->reg = vips_region_new(indexed->index_ready)))
+		return NULL;
 
 	return hist;
 }
@@ -201,9 +231,10 @@ vips_hist_find_indexed_start(VipsStatistic *statistic)
 	/* Make the main hist, if necessary.
 	 */
 	if (!indexed->hist)
-		indexed->hist = histogram_new(indexed);
+		indexed->hist = histogram_new(indexed, FALSE);
 
-	return (void *) histogram_new(indexed);
+	return (void *) histogram_new(indexed,
+		indexed->index_ready->BandFmt == VIPS_FORMAT_USHORT);
 }
 
 /* Combine B with A according to mode.
@@ -248,6 +279,31 @@ vips_hist_find_indexed_stop(VipsStatistic *statistic, void *seq)
 
 	hist->mx = VIPS_MAX(hist->mx, sub_hist->mx);
 
+	if (sub_hist->sparse) {
+		VipsSparseHist *sparse = sub_hist->sparse;
+
+		for (i = 0; i < sparse->n; i++) {
+			int ix = VIPS_SPARSEHIST_KEY(sparse, i);
+
+			bins = hist->bins + ix * bands;
+			sub_bins = VIPS_SPARSEHIST_VALUE(sparse, i);
+			if (hist->init[ix])
+				for (j = 0; j < bands; j++)
+					COMBINE(indexed->combine,
+						bins[j], sub_bins[j]);
+			else {
+				for (j = 0; j < bands; j++)
+					bins[j] = sub_bins[j];
+				hist->init[ix] = TRUE;
+			}
+		}
+
+		VIPS_FREEF(vips__sparsehist_free, sub_hist->sparse);
+		VIPS_UNREF(sub_hist->reg);
+
+		return 0;
+	}
+
 	bins = hist->bins;
 	sub_bins = sub_hist->bins;
 	init = hist->init;
@@ -370,6 +426,60 @@ vips_hist_find_indexed_uchar_scan(VipsHistFindIndexed *indexed,
 		} \
 	}
 
+/* Accumulate a buffer of pels into a sparse histogram, ushort index.
+ */
+#define ACCUMULATE_SPARSE(TYPE) \
+	{ \
+		int x, z; \
+		TYPE *tv = (TYPE *) in; \
+\
+		for (x = 0; x < n; x++) { \
+			int ix = i[x]; \
+			gboolean is_new; \
+			double *bin = vips__sparsehist_get(hist->sparse, \
+				ix, &is_new); \
+\
+			if (ix > mx) \
+				mx = ix; \
+\
+			if (!is_new) \
+				for (z = 0; z < bands; z++) \
+					COMBINE(indexed->combine, bin[z], tv[z]); \
+			else \
+				for (z = 0; z < bands; z++) \
+					bin[z] = tv[z]; \
+\
+			tv += bands; \
+		} \
+	}
+
+/* Too many bins in use: move a sparse histogram to dense bins.
+ */
+static int
+vips_hist_find_indexed_densify(Histogram *hist)
+{
+	VipsSparseHist *sparse = hist->sparse;
+	int bands = VIPS_STATISTIC(hist->indexed)->ready->Bands;
+
+	int i;
+
+	if (histogram_dense(hist))
+		return -1;
+
+	for (i = 0; i < sparse->n; i++) {
+		int ix = VIPS_SPARSEHIST_KEY(sparse, i);
+
+		memcpy(hist->bins + ix * bands,
+			VIPS_SPARSEHIST_VALUE(sparse, i),
+			bands * sizeof(double));
+		hist->init[ix] = TRUE;
+	}
+
+	VIPS_FREEF(vips__sparsehist_free, hist->sparse);
+
+	return 0;
+}
+
 /* A ushort index image.
  */
 static void
@@ -384,6 +494,42 @@ vips_hist_find_indexed_ushort_scan(VipsHistFindIndexed *indexed,
 
 	mx = hist->mx;
 
+	if (hist->sparse) {
+		switch (statistic->ready->BandFmt) {
+		case VIPS_FORMAT_UCHAR:
+			ACCUMULATE_SPARSE(unsigned char);
+			break;
+		case VIPS_FORMAT_CHAR:
+			ACCUMULATE_SPARSE(signed char);
+			break;
+		case VIPS_FORMAT_USHORT:
+			ACCUMULATE_SPARSE(unsigned short);
+			break;
+		case VIPS_FORMAT_SHORT:
+			ACCUMULATE_SPARSE(signed short);
+			break;
+		case VIPS_FORMAT_UINT:
+			ACCUMULATE_SPARSE(unsigned int);
+			break;
+		case VIPS_FORMAT_INT:
+			ACCUMULATE_SPARSE(signed int);
+			break;
+		case VIPS_FORMAT_FLOAT:
+			ACCUMULATE_SPARSE(float);
+			break;
+		case VIPS_FORMAT_DOUBLE:
+			ACCUMULATE_SPARSE(double);
+			break;
+
+		default:
+			g_assert_not_reached();
+		}
+
+		hist->mx = mx;
+
+		return;
+	}
+
 	switch (statistic->ready->BandFmt) {
 	case VIPS_FORMAT_UCHAR:
 		ACCUMULATE_USHORT(unsigned char);
@@ -444,6 +590,11 @@ vips_hist_find_indexed_scan(VipsStatistic *statistic, void *seq,
 
 	scan(indexed, hist, in, VIPS_REGION_ADDR(hist->reg, x, y), n);
 
+	if (hist->sparse &&
+		hist->sparse->n > SPARSE_MAX &&
+		vips_hist_find_indexed_densify(hist))
+		return -1;
+
 	return 0;
 }
 
@@ -10,6 +10,8 @@
  * 	- redo as a class
  * 28/1/22 travisbell
  * 	- better arg checking
+ * 19/10/26
+ * 	- use a sparse histogram per thread for large bin counts
  */
 
 /*
@@ -47,19 +49,26 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <math.h>
 
 #include <vips/vips.h>
 
 #include "statistic.h"
+#include "sparsehist.h"
+
+/* Per-thread histograms with more than this many cells are sparse.
+ */
+#define SPARSE_CELLS (65536)
 
 struct _VipsHistFindNDim;
 
-/* Accumulate a histogram in one of these.
+/* Accumulate a histogram in one of these. Either dense in @data, or sparse.
  */
 typedef struct {
 	struct _VipsHistFindNDim *ndim;
 
 	unsigned int ***data;
+	VipsSparseHist *sparse;
 } Histogram;
 
 typedef struct _VipsHistFindNDim {
@@ -73,6 +82,10 @@ typedef struct _VipsHistFindNDim {
 	 */
 	int max_val;
 
+	/* TRUE to use sparse per-thread histograms.
+	 */
+	gboolean sparse;
+
 	/* Main image histogram. Subhists accumulate to this.
 	 */
 	Histogram *hist;
@@ -107,6 +120,8 @@ histogram_new(VipsHistFindNDim *ndim)
 		return NULL;
 
 	hist->ndim = ndim;
+	hist->data = NULL;
+	hist->sparse = NULL;
 
 	if (!(hist->data = VIPS_ARRAY(ndim, bins, unsigned int **)))
 		return NULL;
@@ -159,6 +174,12 @@ vips_hist_find_ndim_build(VipsObject *object)
 				_("bins out of range [1,%d]"), ndim->max_val);
 			return -1;
 		}
+
+		/* A 2D or 3D histogram with a lot of bins is mostly empty,
+		 * and a dense copy per thread would be huge.
+		 */
+		ndim->sparse =
+			pow(ndim->bins, statistic->in->Bands) > SPARSE_CELLS;
 	}
 
 	/* main hist made on first thread start.
@@ -198,12 +219,24 @@ vips_hist_find_ndim_start(VipsStatistic *statistic)
 {
 	VipsHistFindNDim *ndim = (VipsHistFindNDim *) statistic;
 
-	/* Make the main hist, if necessary.
+	Histogram *hist;
+
+	/* Make the main hist, if necessary. This is always dense, since we
+	 * need every cell for the output.
 	 */
 	if (!ndim->hist)
 		ndim->hist = histogram_new(ndim);
 
-	return (void *) histogram_new(ndim);
+	if (!ndim->sparse)
+		return (void *) histogram_new(ndim);
+
+	if (!(hist = VIPS_NEW(ndim, Histogram)))
+		return NULL;
+	hist->ndim = ndim;
+	hist->data = NULL;
+	hist->sparse = vips__sparsehist_new(1);
+
+	return (void *) hist;
 }
 
 /* Join a sub-hist onto the main hist.
@@ -214,21 +247,39 @@ vips_hist_find_ndim_stop(VipsStatistic *statistic, void *seq)
 	Histogram *sub_hist = (Histogram *) seq;
 	VipsHistFindNDim *ndim = (VipsHistFindNDim *) statistic;
 	Histogram *hist = ndim->hist;
+	VipsImage *in = statistic->ready;
+	int ilimit = in->Bands > 2 ? ndim->bins : 1;
+	int jlimit = in->Bands > 1 ? ndim->bins : 1;
 
 	int i, j, k;
 
-	for (i = 0; i < ndim->bins; i++)
-		for (j = 0; j < ndim->bins; j++)
-			for (k = 0; k < ndim->bins; k++)
-				if (hist->data[i] && hist->data[i][j]) {
-					hist->data[i][j][k] +=
-						sub_hist->data[i][j][k];
+	if (sub_hist->sparse) {
+		VipsSparseHist *sparse = sub_hist->sparse;
+
+		for (i = 0; i < sparse->n; i++) {
+			guint64 key = VIPS_SPARSEHIST_KEY(sparse, i);
 
-					/* Zap sub-hist to make sure we
-					 * can't add it again.
-					 */
-					sub_hist->data[i][j][k] = 0;
-				}
+			hist->data[key / ndim->bins / ndim->bins]
+					  [(key / ndim->bins) % ndim->bins]
+					  [key % ndim->bins] +=
+				*VIPS_SPARSEHIST_VALUE(sparse, i);
+		}
+
+		VIPS_FREEF(vips__sparsehist_free, sub_hist->sparse);
+
+		return 0;
+	}
+
+	for (i = 0; i < ilimit; i++)
+		for (j = 0; j < jlimit; j++)
+			for (k = 0; k < ndim->bins; k++) {
+				hist->data[i][j][k] += sub_hist->data[i][j][k];
+
+				/* Zap sub-hist to make sure we
+				 * can't add it again.
+				 */
+				sub_hist->data[i][j][k] = 0;
+			}
 
 	return 0;
 }
@@ -245,6 +296,23 @@ vips_hist_find_ndim_stop(VipsStatistic *statistic, void *seq)
 		} \
 	}
 
+#define LOOP_SPARSE(TYPE) \
+	{ \
+		TYPE *p = (TYPE *) in; \
+\
+		for (i = 0, j = 0; j < n; j++) { \
+			guint64 key; \
+\
+			for (k = 0; k < nb; k++, i++) \
+				index[k] = p[i] / scale; \
+\
+			key = ((guint64) index[2] * ndim->bins + index[1]) * \
+					ndim->bins + \
+				index[0]; \
+			*vips__sparsehist_get(hist->sparse, key, NULL) += 1; \
+		} \
+	}
+
 static int
 vips_hist_find_ndim_scan(VipsStatistic *statistic, void *seq,
 	int x, int y, void *in, int n)
@@ -261,18 +329,32 @@ vips_hist_find_ndim_scan(VipsStatistic *statistic, void *seq,
 	 */
 	index[0] = index[1] = index[2] = 0;
 
-	switch (im->BandFmt) {
-	case VIPS_FORMAT_UCHAR:
-		LOOP(unsigned char);
-		break;
+	if (hist->sparse)
+		switch (im->BandFmt) {
+		case VIPS_FORMAT_UCHAR:
+			LOOP_SPARSE(unsigned char);
+			break;
 
-	case VIPS_FORMAT_USHORT:
-		LOOP(unsigned short);
-		break;
+		case VIPS_FORMAT_USHORT:
+			LOOP_SPARSE(unsigned short);
+			break;
 
-	default:
-		g_assert_not_reached();
-	}
+		default:
+			g_assert_not_reached();
+		}
+	else
+		switch (im->BandFmt) {
+		case VIPS_FORMAT_UCHAR:
+			LOOP(unsigned char);
+			break;
+
+		case VIPS_FORMAT_USHORT:
+			LOOP(unsigned short);
+			break;
+
+		default:
+			g_assert_not_reached();
+		}
 
 	return 0;
 }
@@ -2,6 +2,8 @@
  *
  * 7/3/14
  * 	- from hist_find.c
+ * 19/10/26
+ * 	- sum thread accumulators directly
  */
 
 /*
@@ -109,20 +111,27 @@ vips_hough_start(VipsStatistic *statistic)
 	return (void *) accumulator;
 }
 
-/* Add our finished accumulator to the main area.
+/* Add our finished accumulator to the main area. Accumulators are always
+ * uint memory images of the same size, so we can just add the buffers.
+ * Stop is single-threaded, so no locking is necessary.
  */
 static int
 vips_hough_stop(VipsStatistic *statistic, void *seq)
 {
 	VipsImage *accumulator = (VipsImage *) seq;
 	VipsHough *hough = (VipsHough *) statistic;
+	size_t n = VIPS_IMAGE_N_PELS(accumulator) * accumulator->Bands;
+	guint *restrict p = (guint *) VIPS_IMAGE_ADDR(accumulator, 0, 0);
+	guint *restrict q = (guint *) VIPS_IMAGE_ADDR(hough->out, 0, 0);
 
-	if (vips_draw_image(hough->out, accumulator, 0, 0,
-			"mode", VIPS_COMBINE_MODE_ADD,
-			NULL)) {
-		g_object_unref(accumulator);
-		return -1;
-	}
+	size_t i;
+
+	g_assert(VIPS_IMAGE_N_PELS(accumulator) ==
+		VIPS_IMAGE_N_PELS(hough->out));
+	g_assert(accumulator->BandFmt == VIPS_FORMAT_UINT);
+
+	for (i = 0; i < n; i++)
+		q[i] += p[i];
 
 	g_object_unref(accumulator);
 
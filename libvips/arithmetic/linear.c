@@ -45,6 +45,10 @@
  * 30/9/17
  * 	- squash constants with all elements equal so we use 1ary path more
  * 	  often
+ * 19/10/26
+ * 	- use a lookup table for 8 and 16-bit input with uchar output
+ * 	- repeat per-band constants over a block of pixels so the n-ary path
+ * 	  vectorises
  */
 
 /*
@@ -109,12 +113,96 @@ typedef struct _VipsLinear {
 	double *a_ready;
 	double *b_ready;
 
+	/* The ready constants repeated across LINEAR_BLOCK pixels, so the
+	 * n-ary loops can run as a simple flat loop.
+	 */
+	int n_block;
+	double *a_block;
+	double *b_block;
+
+	/* For uchar and ushort input with uchar output, a table per band
+	 * mapping input to output, or a single table for 1ary constants.
+	 */
+	int n_lut;
+	int lut_size;
+	VipsPel *lut;
+
 } VipsLinear;
 
 typedef VipsUnaryClass VipsLinearClass;
 
 G_DEFINE_TYPE(VipsLinear, vips_linear, VIPS_TYPE_UNARY);
 
+/* Expand per-band constants over this many pixels.
+ */
+#define LINEAR_BLOCK (64)
+
+/* Don't make tables larger than this.
+ */
+#define LINEAR_LUT_MAX (4 * 65536)
+
+/* Make the lookup tables. We compute each entry in the same way as the
+ * uchar output loops below, so the result is identical.
+ */
+static int
+vips_linear_build_lut(VipsLinear *linear, VipsImage *ready)
+{
+	int i, k;
+
+	switch (ready->BandFmt) {
+	case VIPS_FORMAT_UCHAR:
+		linear->lut_size = 256;
+		break;
+
+	case VIPS_FORMAT_USHORT:
+		linear->lut_size = 65536;
+		break;
+
+	default:
+		return 0;
+	}
+
+	if (linear->a->n == 1 &&
+		linear->b->n == 1)
+		linear->n_lut = 1;
+	else
+		linear->n_lut = ready->Bands;
+
+	/* Small images are quicker to just compute.
+	 */
+	if ((guint64) linear->n_lut * linear->lut_size > LINEAR_LUT_MAX ||
+		(guint64) ready->Xsize * ready->Ysize < linear->lut_size)
+		return 0;
+
+	if (!(linear->lut = VIPS_ARRAY(linear,
+			  linear->n_lut * linear->lut_size, VipsPel)))
+		return -1;
+
+	if (linear->n_lut == 1) {
+		float a1 = linear->a_ready[0];
+		float b1 = linear->b_ready[0];
+
+		for (i = 0; i < linear->lut_size; i++) {
+			float t = a1 * i + b1;
+
+			linear->lut[i] = VIPS_FCLIP(0, t, 255);
+		}
+	}
+	else
+		for (k = 0; k < linear->n_lut; k++) {
+			VipsPel *lut = linear->lut + k * linear->lut_size;
+
+			for (i = 0; i < linear->lut_size; i++) {
+				double t = linear->a_ready[k] * i +
+					linear->b_ready[k];
+
+				lut[i] = VIPS_FCLIP(0, t, 255);
+			}
+		}
+
+	return 0;
+}
+
 static int
 vips_linear_build(VipsObject *object)
 {
@@ -123,6 +211,7 @@ vips_linear_build(VipsObject *object)
 	VipsUnary *unary = (VipsUnary *) object;
 	VipsLinear *linear = (VipsLinear *) object;
 
+	VipsImage *ready;
 	int i;
 
 	/* If we have a three-element vector, we need to bandup the image to
@@ -210,6 +299,24 @@ vips_linear_build(VipsObject *object)
 	if (VIPS_OBJECT_CLASS(vips_linear_parent_class)->build(object))
 		return -1;
 
+	/* We know the ready image now, so we can size our blocks and tables.
+	 * Pixels aren't computed until after build, so it's safe to do this
+	 * here.
+	 */
+	ready = arithmetic->ready[0];
+	linear->n_block = ready->Bands * LINEAR_BLOCK;
+	if (!(linear->a_block = VIPS_ARRAY(linear, linear->n_block, double)) ||
+		!(linear->b_block = VIPS_ARRAY(linear, linear->n_block, double)))
+		return -1;
+	for (i = 0; i < linear->n_block; i++) {
+		linear->a_block[i] = linear->a_ready[i % ready->Bands];
+		linear->b_block[i] = linear->b_ready[i % ready->Bands];
+	}
+
+	if (linear->uchar &&
+		vips_linear_build_lut(linear, ready))
+		return -1;
+
 	return 0;
 }
 
@@ -227,16 +334,22 @@ vips_linear_build(VipsObject *object)
 			q[x] = a1 * (OUT) p[x] + b1; \
 	}
 
-/* Non-complex input, any output.
+/* Non-complex input, any output. Walk the line in blocks of whole pixels
+ * with the constants expanded to match, so the inner loop vectorises.
  */
 #define LOOPN(IN, OUT) \
 	{ \
 		IN *restrict p = (IN *) in[0]; \
 		OUT *restrict q = (OUT *) out; \
+		int sz = width * nb; \
 \
-		for (i = 0, x = 0; x < width; x++) \
-			for (k = 0; k < nb; k++, i++) \
-				q[i] = a[k] * (OUT) p[i] + b[k]; \
+		for (i = 0; i < sz; i += n_block) { \
+			int n = VIPS_MIN(n_block, sz - i); \
+\
+			for (x = 0; x < n; x++) \
+				q[i + x] = a_block[x] * (OUT) p[i + x] + \
+					b_block[x]; \
+		} \
 	}
 
 #define LOOP(IN, OUT) \
@@ -289,13 +402,36 @@ vips_linear_build(VipsObject *object)
 	{ \
 		IN *restrict p = (IN *) in[0]; \
 		VipsPel *restrict q = (VipsPel *) out; \
+		int sz = width * nb; \
 \
-		for (i = 0, x = 0; x < width; x++) \
-			for (k = 0; k < nb; k++, i++) { \
-				double t = a[k] * p[i] + b[k]; \
+		for (i = 0; i < sz; i += n_block) { \
+			int n = VIPS_MIN(n_block, sz - i); \
 \
-				q[i] = VIPS_FCLIP(0, t, 255); \
+			for (x = 0; x < n; x++) { \
+				double t = a_block[x] * p[i + x] + b_block[x]; \
+\
+				q[i + x] = VIPS_FCLIP(0, t, 255); \
 			} \
+		} \
+	}
+
+/* uchar or ushort input, uchar output, via the lookup table.
+ */
+#define LOOPlut(IN) \
+	{ \
+		IN *restrict p = (IN *) in[0]; \
+		VipsPel *restrict q = (VipsPel *) out; \
+		VipsPel *restrict lut = linear->lut; \
+		int lut_size = linear->lut_size; \
+		int sz = width * nb; \
+\
+		if (linear->n_lut == 1) \
+			for (x = 0; x < sz; x++) \
+				q[x] = lut[p[x]]; \
+		else \
+			for (i = 0, x = 0; x < width; x++) \
+				for (k = 0; k < nb; k++, i++) \
+					q[i] = lut[k * lut_size + p[i]]; \
 	}
 
 #define LOOPuc(IN) \
@@ -334,11 +470,26 @@ vips_linear_buffer(VipsArithmetic *arithmetic,
 	VipsLinear *linear = (VipsLinear *) arithmetic;
 	double *restrict a = linear->a_ready;
 	double *restrict b = linear->b_ready;
+	double *restrict a_block = linear->a_block;
+	double *restrict b_block = linear->b_block;
+	int n_block = linear->n_block;
 	int nb = im->Bands;
 
 	int i, x, k;
 
-	if (linear->uchar)
+	if (linear->lut)
+		switch (vips_image_get_format(im)) {
+		case VIPS_FORMAT_UCHAR:
+			LOOPlut(unsigned char);
+			break;
+		case VIPS_FORMAT_USHORT:
+			LOOPlut(unsigned short);
+			break;
+
+		default:
+			g_assert_not_reached();
+		}
+	else if (linear->uchar)
 		switch (vips_image_get_format(im)) {
 		case VIPS_FORMAT_UCHAR:
 			LOOPuc(unsigned char);
@@ -514,6 +665,9 @@ vips_linearv(VipsImage *in, VipsImage **out,
  * complex input and double complex for double complex input. Set @uchar to
  * output uchar pixels.
  *
+ * With @uchar set, uchar and ushort images are processed with a lookup
+ * table, which is much faster than computing each pixel.
+ *
  * If the arrays of constants have just one element, that constant is used for
  * all image bands. If the arrays have more than one element and they have
  * the same number of elements as there are bands in the image, then
@@ -0,0 +1,1070 @@
+/* multistats.c ... many stats, histogram and percentiles in a single pass
+ *
+ * 19/10/26
+ * 	- from stats.c and hist_find.c
+ */
+
+/*
+
+	This file is part of VIPS.
+
+	VIPS is free software; you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+	02110-1301  USA
+
+ */
+
+/*
+
+	These files are distributed with VIPS - http://www.vips.ecs.soton.ac.uk
+
+ */
+
+/*
+#define VIPS_DEBUG
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif /*HAVE_CONFIG_H*/
+#include <glib/gi18n-lib.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <vips/vips.h>
+#include <vips/debug.h>
+#include <vips/internal.h>
+
+/* Names for our columns, the same as vips_stats().
+ */
+enum {
+	COL_MIN = 0,
+	COL_MAX = 1,
+	COL_SUM = 2,
+	COL_SUM2 = 3,
+	COL_AVG = 4,
+	COL_SD = 5,
+	COL_XMIN = 6,
+	COL_YMIN = 7,
+	COL_XMAX = 8,
+	COL_YMAX = 9,
+	COL_LAST = 10
+};
+
+typedef struct _VipsMultistats {
+	VipsOperation parent_instance;
+
+	VipsImage *in;
+	VipsImage *out;
+	gboolean find_hist;
+	VipsArrayDouble *percent;
+	VipsImage *hist;
+	VipsImage *percentiles;
+
+	/* The decoded input we scan.
+	 */
+	VipsImage *ready;
+
+	/* TRUE if we need to build a histogram, and the number of bins per
+	 * band.
+	 */
+	gboolean histogram;
+	int hist_size;
+
+	/* The tile grid we scan in. Each tile sums into a private slot in
+	 * @partial, then we add the slots up in tile order at the end. This
+	 * makes sum and sum of squares independent of thread scheduling.
+	 */
+	int tile_width;
+	int tile_height;
+	int tiles_across;
+	int n_tiles;
+	double *partial;
+
+	/* Min, max and histogram, merged from the per-thread sequences in
+	 * stop.
+	 */
+	gboolean set;
+	double *min;
+	double *max;
+	int *xmin;
+	int *ymin;
+	int *xmax;
+	int *ymax;
+	guint64 **bins;
+	int mx;
+
+} VipsMultistats;
+
+typedef VipsOperationClass VipsMultistatsClass;
+
+G_DEFINE_TYPE(VipsMultistats, vips_multistats, VIPS_TYPE_OPERATION);
+
+/* Per-thread accumulators.
+ */
+typedef struct _VipsMultistatsSeq {
+	VipsMultistats *multistats;
+
+	gboolean set;
+	double *min;
+	double *max;
+	int *xmin;
+	int *ymin;
+	int *xmax;
+	int *ymax;
+	guint64 **bins;
+	int mx;
+} VipsMultistatsSeq;
+
+/* Add a value with Kahan compensation.
+ */
+#define KAHAN_ADD(SUM, C, V) \
+	G_STMT_START \
+	{ \
+		double y_ = (V) - (C); \
+		double t_ = (SUM) + y_; \
+\
+		(C) = (t_ - (SUM)) - y_; \
+		(SUM) = t_; \
+	} \
+	G_STMT_END
+
+/* TRUE if position (x1, y1) comes before (x2, y2) in scan order. We use this
+ * to break ties in min and max, so we always report the first occurrence.
+ */
+#define BEFORE(X1, Y1, X2, Y2) \
+	((Y1) < (Y2) || ((Y1) == (Y2) && (X1) < (X2)))
+
+static void
+vips_multistats_seq_free(VipsMultistatsSeq *seq)
+{
+	int b;
+
+	if (seq->bins) {
+		for (b = 0; b < seq->multistats->ready->Bands; b++)
+			VIPS_FREE(seq->bins[b]);
+		VIPS_FREE(seq->bins);
+	}
+	VIPS_FREE(seq->min);
+	VIPS_FREE(seq->max);
+	VIPS_FREE(seq->xmin);
+	VIPS_FREE(seq->ymin);
+	VIPS_FREE(seq->xmax);
+	VIPS_FREE(seq->ymax);
+	VIPS_FREE(seq);
+}
+
+static void *
+vips_multistats_start(VipsImage *out, void *a, void *b)
+{
+	VipsMultistats *multistats = (VipsMultistats *) a;
+	int bands = multistats->ready->Bands;
+
+	VipsMultistatsSeq *seq;
+	int i;
+
+	if (!(seq = VIPS_NEW(NULL, VipsMultistatsSeq)))
+		return NULL;
+	seq->multistats = multistats;
+	seq->set = FALSE;
+	seq->bins = NULL;
+	seq->mx = 0;
+
+	seq->min = VIPS_ARRAY(NULL, bands, double);
+	seq->max = VIPS_ARRAY(NULL, bands, double);
+	seq->xmin = VIPS_ARRAY(NULL, bands, int);
+	seq->ymin = VIPS_ARRAY(NULL, bands, int);
+	seq->xmax = VIPS_ARRAY(NULL, bands, int);
+	seq->ymax = VIPS_ARRAY(NULL, bands, int);
+	if (!seq->min ||
+		!seq->max ||
+		!seq->xmin ||
+		!seq->ymin ||
+		!seq->xmax ||
+		!seq->ymax) {
+		vips_multistats_seq_free(seq);
+		return NULL;
+	}
+
+	if (multistats->histogram) {
+		if (!(seq->bins = VIPS_ARRAY(NULL, bands, guint64 *))) {
+			vips_multistats_seq_free(seq);
+			return NULL;
+		}
+		memset(seq->bins, 0, bands * sizeof(guint64 *));
+
+		for (i = 0; i < bands; i++)
+			if (!(seq->bins[i] = VIPS_ARRAY(NULL,
+					  multistats->hist_size, guint64))) {
+				vips_multistats_seq_free(seq);
+				return NULL;
+			}
+			else
+				memset(seq->bins[i], 0,
+					multistats->hist_size * sizeof(guint64));
+	}
+
+	return (void *) seq;
+}
+
+/* Merge a thread's min, max and histogram into the main set. Stop functions
+ * are single-threaded, so no locking is necessary.
+ */
+static int
+vips_multistats_stop(void *vseq, void *a, void *b)
+{
+	VipsMultistatsSeq *seq = (VipsMultistatsSeq *) vseq;
+	VipsMultistats *multistats = (VipsMultistats *) a;
+	int bands = multistats->ready->Bands;
+
+	int i, j;
+
+	if (seq->set) {
+		for (i = 0; i < bands; i++) {
+			if (!multistats->set ||
+				seq->min[i] < multistats->min[i] ||
+				(seq->min[i] == multistats->min[i] &&
+					BEFORE(seq->xmin[i], seq->ymin[i],
+						multistats->xmin[i], multistats->ymin[i]))) {
+				multistats->min[i] = seq->min[i];
+				multistats->xmin[i] = seq->xmin[i];
+				multistats->ymin[i] = seq->ymin[i];
+			}
+
+			if (!multistats->set ||
+				seq->max[i] > multistats->max[i] ||
+				(seq->max[i] == multistats->max[i] &&
+					BEFORE(seq->xmax[i], seq->ymax[i],
+						multistats->xmax[i], multistats->ymax[i]))) {
+				multistats->max[i] = seq->max[i];
+				multistats->xmax[i] = seq->xmax[i];
+				multistats->ymax[i] = seq->ymax[i];
+			}
+		}
+
+		multistats->set = TRUE;
+	}
+
+	if (multistats->histogram) {
+		for (i = 0; i < bands; i++) {
+			guint64 *restrict p = seq->bins[i];
+			guint64 *restrict q = multistats->bins[i];
+
+			for (j = 0; j < multistats->hist_size; j++)
+				q[j] += p[j];
+		}
+
+		multistats->mx = VIPS_MAX(multistats->mx, seq->mx);
+	}
+
+	vips_multistats_seq_free(seq);
+
+	return 0;
+}
+
+/* Sum, sum of squares, min and max for one band of one line. Four
+ * independent accumulators break the dependency chain on the adds, and min
+ * and max are branchless, so the compiler can vectorise this.
+ */
+#define LINE(TYPE) \
+	G_STMT_START \
+	{ \
+		TYPE *restrict p = ((TYPE *) in) + band; \
+		double s0 = 0.0, s1 = 0.0, s2 = 0.0, s3 = 0.0; \
+		double q0 = 0.0, q1 = 0.0, q2 = 0.0, q3 = 0.0; \
+		TYPE small = p[0]; \
+		TYPE big = p[0]; \
+\
+		for (i = 0; i + 4 <= n; i += 4) { \
+			double v0 = p[0]; \
+			double v1 = p[bands]; \
+			double v2 = p[2 * bands]; \
+			double v3 = p[3 * bands]; \
+\
+			s0 += v0; \
+			s1 += v1; \
+			s2 += v2; \
+			s3 += v3; \
+			q0 += v0 * v0; \
+			q1 += v1 * v1; \
+			q2 += v2 * v2; \
+			q3 += v3 * v3; \
+\
+			small = VIPS_MIN(small, p[0]); \
+			small = VIPS_MIN(small, p[bands]); \
+			small = VIPS_MIN(small, p[2 * bands]); \
+			small = VIPS_MIN(small, p[3 * bands]); \
+			big = VIPS_MAX(big, p[0]); \
+			big = VIPS_MAX(big, p[bands]); \
+			big = VIPS_MAX(big, p[2 * bands]); \
+			big = VIPS_MAX(big, p[3 * bands]); \
+\
+			p += 4 * bands; \
+		} \
+		for (; i < n; i++) { \
+			double v = p[0]; \
+\
+			s0 += v; \
+			q0 += v * v; \
+			small = VIPS_MIN(small, p[0]); \
+			big = VIPS_MAX(big, p[0]); \
+\
+			p += bands; \
+		} \
+\
+		sum = (s0 + s1) + (s2 + s3); \
+		sum2 = (q0 + q1) + (q2 + q3); \
+		line_min = small; \
+		line_max = big; \
+	} \
+	G_STMT_END
+
+/* Find the first occurrence of value in one band of one line.
+ */
+#define FIND(TYPE, VALUE) \
+	G_STMT_START \
+	{ \
+		TYPE *restrict p = ((TYPE *) in) + band; \
+\
+		for (i = 0; i < n; i++) \
+			if (p[i * bands] == (VALUE)) \
+				break; \
+	} \
+	G_STMT_END
+
+/* Histogram all bands of a line. Types are mapped to bins with the same
+ * rules as vips_cast(), so the result matches vips_hist_find().
+ */
+#define HIST(TYPE, MAX) \
+	G_STMT_START \
+	{ \
+		TYPE *restrict p = (TYPE *) in; \
+\
+		for (i = 0; i < n; i++) { \
+			for (band = 0; band < bands; band++) { \
+				int v = VIPS_CLIP(0, (double) p[band], MAX); \
+\
+				bins[band][v] += 1; \
+				mx = VIPS_MAX(mx, v); \
+			} \
+\
+			p += bands; \
+		} \
+	} \
+	G_STMT_END
+
+/* As HIST, but NaN has no bin, so we skip it. The clip would let it through
+ * and the int conversion is undefined.
+ */
+#define HIST_FLOAT(TYPE, MAX) \
+	G_STMT_START \
+	{ \
+		TYPE *restrict p = (TYPE *) in; \
+\
+		for (i = 0; i < n; i++) { \
+			for (band = 0; band < bands; band++) { \
+				int v; \
+\
+				if (VIPS_ISNAN(p[band])) \
+					continue; \
+\
+				v = VIPS_CLIP(0, (double) p[band], MAX); \
+				bins[band][v] += 1; \
+				mx = VIPS_MAX(mx, v); \
+			} \
+\
+			p += bands; \
+		} \
+	} \
+	G_STMT_END
+
+#define HIST_UCHAR() \
+	G_STMT_START \
+	{ \
+		unsigned char *restrict p = (unsigned char *) in; \
+\
+		for (i = 0; i < n; i++) { \
+			for (band = 0; band < bands; band++) \
+				bins[band][p[band]] += 1; \
+\
+			p += bands; \
+		} \
+\
+		mx = 255; \
+	} \
+	G_STMT_END
+
+#define HIST_USHORT() \
+	G_STMT_START \
+	{ \
+		unsigned short *restrict p = (unsigned short *) in; \
+\
+		for (i = 0; i < n; i++) { \
+			for (band = 0; band < bands; band++) { \
+				int v = p[band]; \
+\
+				bins[band][v] += 1; \
+				mx = VIPS_MAX(mx, v); \
+			} \
+\
+			p += bands; \
+		} \
+	} \
+	G_STMT_END
+
+static void
+vips_multistats_line(VipsMultistats *multistats, VipsMultistatsSeq *seq,
+	double *partial, int x, int y, VipsPel *in, int n)
+{
+	const int bands = multistats->ready->Bands;
+	const gboolean first = !seq->set;
+
+	int band, i;
+
+	for (band = 0; band < bands; band++) {
+		double sum, sum2;
+		double line_min, line_max;
+
+		switch (multistats->ready->BandFmt) {
+		case VIPS_FORMAT_UCHAR:
+			LINE(unsigned char);
+			break;
+		case VIPS_FORMAT_CHAR:
+			LINE(signed char);
+			break;
+		case VIPS_FORMAT_USHORT:
+			LINE(unsigned short);
+			break;
+		case VIPS_FORMAT_SHORT:
+			LINE(signed short);
+			break;
+		case VIPS_FORMAT_UINT:
+			LINE(unsigned int);
+			break;
+		case VIPS_FORMAT_INT:
+			LINE(signed int);
+			break;
+		case VIPS_FORMAT_FLOAT:
+			LINE(float);
+			break;
+		case VIPS_FORMAT_DOUBLE:
+			LINE(double);
+			break;
+
+		default:
+			g_assert_not_reached();
+
+			/* Stop compiler warnings.
+			 */
+			sum = 0;
+			sum2 = 0;
+			line_min = 0;
+			line_max = 0;
+		}
+
+		/* partial holds sum, compensation, sum2, compensation for each
+		 * band.
+		 */
+		KAHAN_ADD(partial[band * 4 + 0], partial[band * 4 + 1], sum);
+		KAHAN_ADD(partial[band * 4 + 2], partial[band * 4 + 3], sum2);
+
+		/* Start from the line start, in case NaN stops us finding a
+		 * position below.
+		 */
+		if (first) {
+			seq->min[band] = line_min;
+			seq->xmin[band] = x;
+			seq->ymin[band] = y;
+			seq->max[band] = line_max;
+			seq->xmax[band] = x;
+			seq->ymax[band] = y;
+		}
+
+		/* Only search for the position when this line could replace the
+		 * current min or max. This is rare after the first few lines.
+		 */
+		if (first ||
+			line_min < seq->min[band] ||
+			(line_min == seq->min[band] &&
+				BEFORE(x, y, seq->xmin[band], seq->ymin[band]))) {
+			switch (multistats->ready->BandFmt) {
+			case VIPS_FORMAT_UCHAR:
+				FIND(unsigned char, line_min);
+				break;
+			case VIPS_FORMAT_CHAR:
+				FIND(signed char, line_min);
+				break;
+			case VIPS_FORMAT_USHORT:
+				FIND(unsigned short, line_min);
+				break;
+			case VIPS_FORMAT_SHORT:
+				FIND(signed short, line_min);
+				break;
+			case VIPS_FORMAT_UINT:
+				FIND(unsigned int, line_min);
+				break;
+			case VIPS_FORMAT_INT:
+				FIND(signed int, line_min);
+				break;
+			case VIPS_FORMAT_FLOAT:
+				FIND(float, line_min);
+				break;
+			case VIPS_FORMAT_DOUBLE:
+				FIND(double, line_min);
+				break;
+
+			default:
+				g_assert_not_reached();
+				i = 0;
+			}
+
+			/* NaN never compares equal, so we can fall off the end.
+			 */
+			if (i < n &&
+				(first ||
+					line_min < seq->min[band] ||
+					BEFORE(x + i, y,
+						seq->xmin[band], seq->ymin[band]))) {
+				seq->min[band] = line_min;
+				seq->xmin[band] = x + i;
+				seq->ymin[band] = y;
+			}
+		}
+
+		if (first ||
+			line_max > seq->max[band] ||
+			(line_max == seq->max[band] &&
+				BEFORE(x, y, seq->xmax[band], seq->ymax[band]))) {
+			switch (multistats->ready->BandFmt) {
+			case VIPS_FORMAT_UCHAR:
+				FIND(unsigned char, line_max);
+				break;
+			case VIPS_FORMAT_CHAR:
+				FIND(signed char, line_max);
+				break;
+			case VIPS_FORMAT_USHORT:
+				FIND(unsigned short, line_max);
+				break;
+			case VIPS_FORMAT_SHORT:
+				FIND(signed short, line_max);
+				break;
+			case VIPS_FORMAT_UINT:
+				FIND(unsigned int, line_max);
+				break;
+			case VIPS_FORMAT_INT:
+				FIND(signed int, line_max);
+				break;
+			case VIPS_FORMAT_FLOAT:
+				FIND(float, line_max);
+				break;
+			case VIPS_FORMAT_DOUBLE:
+				FIND(double, line_max);
+				break;
+
+			default:
+				g_assert_not_reached();
+				i = 0;
+			}
+
+			if (i < n &&
+				(first ||
+					line_max > seq->max[band] ||
+					BEFORE(x + i, y,
+						seq->xmax[band], seq->ymax[band]))) {
+				seq->max[band] = line_max;
+				seq->xmax[band] = x + i;
+				seq->ymax[band] = y;
+			}
+		}
+	}
+
+	seq->set = TRUE;
+
+	if (multistats->histogram) {
+		guint64 **bins = seq->bins;
+		int mx = seq->mx;
+
+		switch (multistats->ready->BandFmt) {
+		case VIPS_FORMAT_UCHAR:
+			HIST_UCHAR();
+			break;
+		case VIPS_FORMAT_CHAR:
+			HIST(signed char, UCHAR_MAX);
+
+			/* vips_hist_find() casts char to uchar, so it's always
+			 * 256 bins.
+			 */
+			mx = 255;
+			break;
+		case VIPS_FORMAT_USHORT:
+			HIST_USHORT();
+			break;
+		case VIPS_FORMAT_SHORT:
+			HIST(signed short, USHRT_MAX);
+			break;
+		case VIPS_FORMAT_UINT:
+			HIST(unsigned int, USHRT_MAX);
+			break;
+		case VIPS_FORMAT_INT:
+			HIST(signed int, USHRT_MAX);
+			break;
+		case VIPS_FORMAT_FLOAT:
+			HIST_FLOAT(float, USHRT_MAX);
+			break;
+		case VIPS_FORMAT_DOUBLE:
+			HIST_FLOAT(double, USHRT_MAX);
+			break;
+
+		default:
+			g_assert_not_reached();
+		}
+
+		seq->mx = mx;
+	}
+}
+
+static int
+vips_multistats_scan(VipsRegion *region,
+	void *vseq, void *a, void *b, gboolean *stop)
+{
+	VipsMultistatsSeq *seq = (VipsMultistatsSeq *) vseq;
+	VipsMultistats *multistats = (VipsMultistats *) a;
+	VipsRect *r = &region->valid;
+	int lsk = VIPS_REGION_LSKIP(region);
+	int tile = (r->top / multistats->tile_height) *
+			multistats->tiles_across +
+		r->left / multistats->tile_width;
+	double *partial = multistats->partial +
+		(gint64) tile * multistats->ready->Bands * 4;
+
+	VipsPel *p;
+	int y;
+
+	VIPS_DEBUG_MSG("vips_multistats_scan: %d x %d @ %d x %d\n",
+		r->width, r->height, r->left, r->top);
+
+	g_assert(tile >= 0 && tile < multistats->n_tiles);
+
+	p = VIPS_REGION_ADDR(region, r->left, r->top);
+	for (y = 0; y < r->height; y++) {
+		vips_multistats_line(multistats, seq, partial,
+			r->left, r->top + y, p, r->width);
+		p += lsk;
+	}
+
+	return 0;
+}
+
+static int
+vips_multistats_write_hist(VipsMultistats *multistats, gboolean large)
+{
+	int bands = multistats->ready->Bands;
+	int width = multistats->mx + 1;
+
+	VipsPel *obuffer;
+	int i, j;
+
+	if (vips_image_pipelinev(multistats->hist,
+			VIPS_DEMAND_STYLE_ANY, multistats->ready, NULL))
+		return -1;
+	vips_image_init_fields(multistats->hist,
+		width, 1, bands,
+		large ? VIPS_FORMAT_DOUBLE : VIPS_FORMAT_UINT,
+		VIPS_CODING_NONE, VIPS_INTERPRETATION_HISTOGRAM, 1.0, 1.0);
+
+	if (!(obuffer = VIPS_ARRAY(multistats,
+			  VIPS_IMAGE_SIZEOF_LINE(multistats->hist), VipsPel)))
+		return -1;
+
+	if (large) {
+		double *q = (double *) obuffer;
+
+		for (j = 0; j < width; j++)
+			for (i = 0; i < bands; i++)
+				*q++ = multistats->bins[i][j];
+	}
+	else {
+		unsigned int *q = (unsigned int *) obuffer;
+
+		for (j = 0; j < width; j++)
+			for (i = 0; i < bands; i++)
+				*q++ = multistats->bins[i][j];
+	}
+
+	if (vips_image_write_line(multistats->hist, 0, obuffer))
+		return -1;
+
+	return 0;
+}
+
+/* The smallest bin v for which at least percent% of values are <= v.
+ */
+static int
+vips_multistats_percentile(guint64 *cumulative, int size, double percent)
+{
+	double target = cumulative[size - 1] * percent / 100.0;
+
+	int i;
+
+	for (i = 0; i < size - 1; i++)
+		if (cumulative[i] >= target)
+			break;
+
+	return i;
+}
+
+static int
+vips_multistats_write_percentiles(VipsMultistats *multistats)
+{
+	int bands = multistats->ready->Bands;
+	int size = multistats->mx + 1;
+	double *percent = VIPS_AREA(multistats->percent)->data;
+	int n = VIPS_AREA(multistats->percent)->n;
+
+	guint64 *cumulative;
+	guint64 *all;
+	int b, i, j;
+
+	if (!(cumulative = VIPS_ARRAY(multistats, size, guint64)) ||
+		!(all = VIPS_ARRAY(multistats, size, guint64)))
+		return -1;
+	memset(all, 0, size * sizeof(guint64));
+
+	for (b = 0; b < bands; b++) {
+		guint64 total;
+
+		total = 0;
+		for (j = 0; j < size; j++) {
+			total += multistats->bins[b][j];
+			cumulative[j] = total;
+			all[j] += total;
+		}
+
+		for (i = 0; i < n; i++)
+			*VIPS_MATRIX(multistats->percentiles, i, b + 1) =
+				vips_multistats_percentile(cumulative, size,
+					percent[i]);
+	}
+
+	for (i = 0; i < n; i++)
+		*VIPS_MATRIX(multistats->percentiles, i, 0) =
+			vips_multistats_percentile(all, size, percent[i]);
+
+	return 0;
+}
+
+static int
+vips_multistats_build(VipsObject *object)
+{
+	VipsObjectClass *class = VIPS_OBJECT_GET_CLASS(object);
+	VipsMultistats *multistats = (VipsMultistats *) object;
+	VipsImage **t = (VipsImage **) vips_object_local_array(object, 1);
+
+	int bands;
+	int n_lines;
+	gint64 vals, pels;
+	double *row0;
+	int b, i, y;
+
+	if (VIPS_OBJECT_CLASS(vips_multistats_parent_class)->build(object))
+		return -1;
+
+	if (vips_image_decode(multistats->in, &t[0]) ||
+		vips_check_noncomplex(class->nickname, t[0]))
+		return -1;
+	multistats->ready = t[0];
+	bands = multistats->ready->Bands;
+
+	if (vips_object_argument_isset(object, "percent")) {
+		double *percent = VIPS_AREA(multistats->percent)->data;
+		int n = VIPS_AREA(multistats->percent)->n;
+
+		for (i = 0; i < n; i++)
+			if (percent[i] < 0 ||
+				percent[i] > 100) {
+				vips_error(class->nickname,
+					"%s", _("percent out of range"));
+				return -1;
+			}
+	}
+
+	multistats->histogram = multistats->find_hist ||
+		vips_object_argument_isset(object, "percent");
+	multistats->hist_size =
+		multistats->ready->BandFmt == VIPS_FORMAT_UCHAR ||
+			multistats->ready->BandFmt == VIPS_FORMAT_CHAR
+		? 256
+		: 65536;
+
+	/* Fix the tile geometry so we know which slot each region will land
+	 * in.
+	 */
+	vips_get_tile_size(multistats->ready,
+		&multistats->tile_width, &multistats->tile_height, &n_lines);
+	multistats->tiles_across =
+		VIPS_ROUND_UP(multistats->ready->Xsize, multistats->tile_width) /
+		multistats->tile_width;
+	multistats->n_tiles = multistats->tiles_across *
+		(VIPS_ROUND_UP(multistats->ready->Ysize,
+			 multistats->tile_height) /
+			multistats->tile_height);
+	if (!(multistats->partial = VIPS_ARRAY(object,
+			  (gint64) multistats->n_tiles * bands * 4, double)))
+		return -1;
+	memset(multistats->partial, 0,
+		(gint64) multistats->n_tiles * bands * 4 * sizeof(double));
+
+	if (!(multistats->min = VIPS_ARRAY(object, bands, double)) ||
+		!(multistats->max = VIPS_ARRAY(object, bands, double)) ||
+		!(multistats->xmin = VIPS_ARRAY(object, bands, int)) ||
+		!(multistats->ymin = VIPS_ARRAY(object, bands, int)) ||
+		!(multistats->xmax = VIPS_ARRAY(object, bands, int)) ||
+		!(multistats->ymax = VIPS_ARRAY(object, bands, int)))
+		return -1;
+
+	if (multistats->histogram) {
+		if (!(multistats->bins = VIPS_ARRAY(object, bands, guint64 *)))
+			return -1;
+		for (b = 0; b < bands; b++) {
+			if (!(multistats->bins[b] = VIPS_ARRAY(object,
+					  multistats->hist_size, guint64)))
+				return -1;
+			memset(multistats->bins[b], 0,
+				multistats->hist_size * sizeof(guint64));
+		}
+	}
+
+	if (vips_sink_tile(multistats->ready,
+			multistats->tile_width, multistats->tile_height,
+			vips_multistats_start,
+			vips_multistats_scan,
+			vips_multistats_stop,
+			multistats, NULL))
+		return -1;
+
+	g_object_set(object,
+		"out", vips_image_new_matrix(COL_LAST, bands + 1),
+		NULL);
+
+	pels = (gint64) multistats->ready->Xsize * multistats->ready->Ysize;
+	vals = pels * bands;
+
+	/* Sum the tiles in a fixed order.
+	 */
+	row0 = VIPS_MATRIX(multistats->out, 0, 0);
+	for (b = 0; b < bands; b++) {
+		double *row = VIPS_MATRIX(multistats->out, 0, b + 1);
+
+		double sum, c_sum, sum2, c_sum2;
+
+		sum = 0.0;
+		c_sum = 0.0;
+		sum2 = 0.0;
+		c_sum2 = 0.0;
+		for (i = 0; i < multistats->n_tiles; i++) {
+			double *partial = multistats->partial +
+				((gint64) i * bands + b) * 4;
+
+			/* Each partial is sum - compensation.
+			 */
+			KAHAN_ADD(sum, c_sum, partial[0]);
+			KAHAN_ADD(sum, c_sum, -partial[1]);
+			KAHAN_ADD(sum2, c_sum2, partial[2]);
+			KAHAN_ADD(sum2, c_sum2, -partial[3]);
+		}
+
+		row[COL_MIN] = multistats->min[b];
+		row[COL_MAX] = multistats->max[b];
+		row[COL_SUM] = sum;
+		row[COL_SUM2] = sum2;
+		row[COL_XMIN] = multistats->xmin[b];
+		row[COL_YMIN] = multistats->ymin[b];
+		row[COL_XMAX] = multistats->xmax[b];
+		row[COL_YMAX] = multistats->ymax[b];
+
+		if (b == 0)
+			for (i = 0; i < COL_LAST; i++)
+				row0[i] = row[i];
+		else {
+			if (row[COL_MIN] < row0[COL_MIN]) {
+				row0[COL_MIN] = row[COL_MIN];
+				row0[COL_XMIN] = row[COL_XMIN];
+				row0[COL_YMIN] = row[COL_YMIN];
+			}
+
+			if (row[COL_MAX] > row0[COL_MAX]) {
+				row0[COL_MAX] = row[COL_MAX];
+				row0[COL_XMAX] = row[COL_XMAX];
+				row0[COL_YMAX] = row[COL_YMAX];
+			}
+
+			row0[COL_SUM] += row[COL_SUM];
+			row0[COL_SUM2] += row[COL_SUM2];
+		}
+	}
+
+	for (y = 1; y < bands + 1; y++) {
+		double *row = VIPS_MATRIX(multistats->out, 0, y);
+
+		row[COL_AVG] = row[COL_SUM] / pels;
+		row[COL_SD] = sqrt(
+			VIPS_FABS(row[COL_SUM2] -
+				(row[COL_SUM] * row[COL_SUM] / pels)) /
+			(pels - 1));
+	}
+
+	row0[COL_AVG] = row0[COL_SUM] / vals;
+	row0[COL_SD] = sqrt(
+		VIPS_FABS(row0[COL_SUM2] -
+			(row0[COL_SUM] * row0[COL_SUM] / vals)) /
+		(vals - 1));
+
+	if (multistats->find_hist) {
+		g_object_set(object,
+			"hist", vips_image_new(),
+			NULL);
+
+		if (vips_multistats_write_hist(multistats,
+				pels >= ((gint64) 1 << 32)))
+			return -1;
+	}
+
+	if (vips_object_argument_isset(object, "percent")) {
+		int n = VIPS_AREA(multistats->percent)->n;
+
+		g_object_set(object,
+			"percentiles", vips_image_new_matrix(n, bands + 1),
+			NULL);
+
+		if (vips_multistats_write_percentiles(multistats))
+			return -1;
+	}
+
+	return 0;
+}
+
+static void
+vips_multistats_class_init(VipsMultistatsClass *class)
+{
+	GObjectClass *gobject_class = G_OBJECT_CLASS(class);
+	VipsObjectClass *object_class = (VipsObjectClass *) class;
+	VipsOperationClass *operation_class = VIPS_OPERATION_CLASS(class);
+
+	gobject_class->set_property = vips_object_set_property;
+	gobject_class->get_property = vips_object_get_property;
+
+	object_class->nickname = "multistats";
+	object_class->description =
+		_("find many image stats, histogram and percentiles in one pass");
+	object_class->build = vips_multistats_build;
+
+	operation_class->flags = VIPS_OPERATION_SEQUENTIAL;
+
+	VIPS_ARG_IMAGE(class, "in", 1,
+		_("Input"),
+		_("Input image"),
+		VIPS_ARGUMENT_REQUIRED_INPUT,
+		G_STRUCT_OFFSET(VipsMultistats, in));
+
+	VIPS_ARG_IMAGE(class, "out", 2,
+		_("Output"),
+		_("Output array of statistics"),
+		VIPS_ARGUMENT_REQUIRED_OUTPUT,
+		G_STRUCT_OFFSET(VipsMultistats, out));
+
+	VIPS_ARG_BOOL(class, "find_hist", 3,
+		_("Find histogram"),
+		_("Also find the image histogram"),
+		VIPS_ARGUMENT_OPTIONAL_INPUT,
+		G_STRUCT_OFFSET(VipsMultistats, find_hist),
+		FALSE);
+
+	VIPS_ARG_BOXED(class, "percent", 4,
+		_("Percent"),
+		_("Find thresholds for these percentages of pixels"),
+		VIPS_ARGUMENT_OPTIONAL_INPUT,
+		G_STRUCT_OFFSET(VipsMultistats, percent),
+		VIPS_TYPE_ARRAY_DOUBLE);
+
+	VIPS_ARG_IMAGE(class, "hist", 5,
+		_("Histogram"),
+		_("Output histogram"),
+		VIPS_ARGUMENT_OPTIONAL_OUTPUT,
+		G_STRUCT_OFFSET(VipsMultistats, hist));
+
+	VIPS_ARG_IMAGE(class, "percentiles", 6,
+		_("Percentiles"),
+		_("Output array of percentiles"),
+		VIPS_ARGUMENT_OPTIONAL_OUTPUT,
+		G_STRUCT_OFFSET(VipsMultistats, percentiles));
+}
+
+static void
+vips_multistats_init(VipsMultistats *multistats)
+{
+}
+
+/**
+ * vips_multistats: (method)
+ * @in: image to scan
+ * @out: (out): image of statistics
+ * @...: %NULL-terminated list of optional named arguments
+ *
+ * Optional arguments:
+ *
+ * * @find_hist: %gboolean, also find the histogram
+ * * @percent: #VipsArrayDouble, find thresholds for these percentages
+ * * @hist: (out): output histogram
+ * * @percentiles: (out): output percentiles
+ *
+ * Find statistics, a histogram and a set of percentiles in a single pass
+ * through @in. Pipelines which would otherwise call vips_stats(),
+ * vips_hist_find() and vips_percent() on the same image only need to
+ * decode it once.
+ *
+ * @out is a matrix laid out exactly as for vips_stats(). Sums are
+ * accumulated per tile with Kahan summation and the tiles are then added in
+ * a fixed order, so the result does not depend on the number of threads.
+ * If there is more than one minimum or maximum, the first in scan order is
+ * reported.
+ *
+ * Set @find_hist to also output the histogram of @in in @hist. This
+ * matches the output of vips_hist_find(): char and uchar images are
+ * histogrammed as uchar, all other types as ushort. NaN is not counted.
+ *
+ * Set @percent to an array of percentages and @percentiles will be a
+ * matrix with one column per percentage and one row per band, plus an
+ * initial row for all bands together, as for @out. Each value is
+ * the smallest histogram bin below or at which lie that percentage of
+ * pixels.
+ *
+ * See also: vips_stats(), vips_hist_find(), vips_percent().
+ *
+ * Returns: 0 on success, -1 on error
+ */
+int
+vips_multistats(VipsImage *in, VipsImage **out, ...)
+{
+	va_list ap;
+	int result;
+
+	va_start(ap, out);
+	result = vips_call_split("multistats", ap, in, out);
+	va_end(ap);
+
+	return result;
+}
@@ -100,6 +100,12 @@ GType vips_arithmetic_get_type(void);
 void vips_arithmetic_set_format_table(VipsArithmeticClass *klass,
 	const VipsBandFormat *format_table);
 
+/* Highway path for vips_relational(). It returns the number of elements
+ * done, and the constant version is in internal.h.
+ */
+int vips_relational_hwy(VipsPel *q, const VipsPel *left, const VipsPel *right,
+	VipsOperationRelational op, VipsBandFormat format, int sz);
+
 #ifdef __cplusplus
 }
 #endif /*__cplusplus*/
@@ -32,6 +32,8 @@
  * 	- im1 > im2, im1 >= im2 were broken
  * 17/9/14
  * 	- im1 > im2, im1 >= im2 were still broken, but in a more subtle way
+ * 19/10/26
+ * 	- add Highway paths
  */
 
 /*
@@ -74,6 +76,8 @@
 #include <stdlib.h>
 
 #include <vips/vips.h>
+#include <vips/vector.h>
+#include <vips/internal.h>
 
 #include "binary.h"
 #include "unaryconst.h"
@@ -95,7 +99,7 @@ G_DEFINE_TYPE(VipsRelational, vips_relational, VIPS_TYPE_BINARY);
 		TYPE *restrict right = (TYPE *) in1; \
 		VipsPel *restrict q = (VipsPel *) out; \
 \
-		for (x = 0; x < sz; x++) \
+		for (x = x0; x < sz; x++) \
 			q[x] = (left[x] ROP right[x]) ? 255 : 0; \
 	}
 
@@ -168,7 +172,7 @@ vips_relational_buffer(VipsArithmetic *arithmetic,
 	VipsOperationRelational op;
 	VipsPel *in0;
 	VipsPel *in1;
-	int x;
+	int x, x0;
 
 	in0 = in[0];
 	in1 = in[1];
@@ -184,6 +188,14 @@ vips_relational_buffer(VipsArithmetic *arithmetic,
 		VIPS_SWAP(VipsPel *, in0, in1);
 	}
 
+	x0 = 0;
+
+#ifdef HAVE_HWY
+	if (vips_vector_isenabled())
+		x0 = vips_relational_hwy(out, in0, in1,
+			op, vips_image_get_format(im), sz);
+#endif /*HAVE_HWY*/
+
 	switch (op) {
 	case VIPS_OPERATION_RELATIONAL_EQUAL:
 		SWITCH(RLOOP, CLOOP, ==, CEQUAL);
@@ -484,7 +496,7 @@ G_DEFINE_TYPE(VipsRelationalConst,
 		TYPE *restrict p = (TYPE *) in[0]; \
 		int *restrict c = uconst->c_int; \
 \
-		for (i = 0, x = 0; x < width; x++) \
+		for (i = x0 * bands, x = x0; x < width; x++) \
 			for (b = 0; b < bands; b++, i++) \
 				out[i] = (p[i] OP c[b]) ? 255 : 0; \
 	}
@@ -494,7 +506,7 @@ G_DEFINE_TYPE(VipsRelationalConst,
 		TYPE *restrict p = (TYPE *) in[0]; \
 		double *restrict c = uconst->c_double; \
 \
-		for (i = 0, x = 0; x < width; x++) \
+		for (i = x0 * bands, x = x0; x < width; x++) \
 			for (b = 0; b < bands; b++, i++) \
 				out[i] = (p[i] OP c[b]) ? 255 : 0; \
 	}
@@ -526,7 +538,27 @@ vips_relational_const_buffer(VipsArithmetic *arithmetic,
 	gboolean is_int = uconst->is_int &&
 		vips_band_format_isint(im->BandFmt);
 
-	int i, x, b;
+	int i, x, b, x0;
+
+	x0 = 0;
+
+#ifdef HAVE_HWY
+	/* The vector path needs the same constant for every band.
+	 */
+	if (vips_vector_isenabled() &&
+		!vips_band_format_iscomplex(im->BandFmt)) {
+		for (b = 1; b < bands; b++)
+			if (uconst->c_double[b] != uconst->c_double[0])
+				break;
+
+		if (b == bands) {
+			x0 = vips__relational_const_hwy(out, in[0],
+				rconst->relational, im->BandFmt,
+				uconst->c_double[0], width * bands);
+			x0 /= bands;
+		}
+	}
+#endif /*HAVE_HWY*/
 
 	switch (rconst->relational) {
 	case VIPS_OPERATION_RELATIONAL_EQUAL:
@@ -0,0 +1,278 @@
+/* Highway kernels for vips_relational() and vips_relational_const()
+ *
+ * 19/10/26
+ * 	- from relational.c
+ */
+
+/*
+
+	This file is part of VIPS.
+
+	VIPS is free software; you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+	02110-1301  USA
+
+ */
+
+/*
+
+	These files are distributed with VIPS - http://www.vips.ecs.soton.ac.uk
+
+ */
+
+/* These do all the non-complex formats except double, comparing in the
+ * pixel type and narrowing the mask to 0 / 255 bytes.
+ *
+ * The C compares against a constant as int or double, so we can only
+ * compare in the pixel type if the constant is exactly representable in
+ * it. Otherwise (x < 12.5, or a uchar image against 300) we return 0 and
+ * the C does the whole line.
+ *
+ * NaN compares the same way as in the C: false for everything except !=.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif /*HAVE_CONFIG_H*/
+#include <glib/gi18n-lib.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <vips/vips.h>
+#include <vips/vector.h>
+#include <vips/debug.h>
+#include <vips/internal.h>
+
+#include "parithmetic.h"
+
+#ifdef HAVE_HWY
+
+#undef HWY_TARGET_INCLUDE
+#define HWY_TARGET_INCLUDE "libvips/arithmetic/relational_hwy.cpp"
+#include <hwy/foreach_target.h>
+#include <hwy/highway.h>
+
+namespace HWY_NAMESPACE {
+
+using namespace hwy::HWY_NAMESPACE;
+
+template <class D>
+HWY_ATTR HWY_INLINE Mask<D>
+vips_relational_compare_hwy(D d, VipsOperationRelational op,
+	Vec<D> a, Vec<D> b)
+{
+	switch (op) {
+	case VIPS_OPERATION_RELATIONAL_NOTEQ:
+		return Not(Eq(a, b));
+
+	case VIPS_OPERATION_RELATIONAL_LESS:
+		return Lt(a, b);
+
+	case VIPS_OPERATION_RELATIONAL_LESSEQ:
+		return Or(Lt(a, b), Eq(a, b));
+
+	case VIPS_OPERATION_RELATIONAL_MORE:
+		return Lt(b, a);
+
+	case VIPS_OPERATION_RELATIONAL_MOREEQ:
+		return Or(Lt(b, a), Eq(a, b));
+
+	default:
+		return Eq(a, b);
+	}
+}
+
+/* Write a mask as 0 / 255 bytes. Set lanes are all ones, ie. -1 as a
+ * signed int, and the signed demote keeps that.
+ */
+template <class D>
+HWY_ATTR HWY_INLINE void
+vips_relational_store_hwy(D d, Mask<D> m, uint8_t *HWY_RESTRICT q,
+	hwy::SizeTag<1>)
+{
+	const Rebind<uint8_t, D> du8;
+
+	StoreU(BitCast(du8, VecFromMask(d, m)), du8, q);
+}
+
+template <class D, size_t kSize>
+HWY_ATTR HWY_INLINE void
+vips_relational_store_hwy(D d, Mask<D> m, uint8_t *HWY_RESTRICT q,
+	hwy::SizeTag<kSize>)
+{
+	const RebindToSigned<D> di;
+	const Rebind<int8_t, D> di8;
+	const Rebind<uint8_t, D> du8;
+
+	StoreU(BitCast(du8, DemoteTo(di8, BitCast(di, VecFromMask(d, m)))),
+		du8, q);
+}
+
+template <typename T>
+HWY_ATTR int
+vips_relational_line_hwy(uint8_t *HWY_RESTRICT q,
+	const T *HWY_RESTRICT left, const T *HWY_RESTRICT right,
+	VipsOperationRelational op, int sz)
+{
+	const ScalableTag<T> d;
+	const int N = Lanes(d);
+
+	int x;
+
+	for (x = 0; x + N <= sz; x += N) {
+		const auto m = vips_relational_compare_hwy(d, op,
+			LoadU(d, left + x), LoadU(d, right + x));
+
+		vips_relational_store_hwy(d, m, q + x, hwy::SizeTag<sizeof(T)>());
+	}
+
+	return x;
+}
+
+template <typename T>
+HWY_ATTR int
+vips_relational_const_line_hwy(uint8_t *HWY_RESTRICT q,
+	const T *HWY_RESTRICT p, VipsOperationRelational op, double c, int sz)
+{
+	const ScalableTag<T> d;
+	const int N = Lanes(d);
+
+	int x;
+
+	/* Written so that NaN fails as well.
+	 */
+	if (!(c >= (double) hwy::LowestValue<T>() &&
+			c <= (double) hwy::HighestValue<T>()) ||
+		(double) (T) c != c)
+		return 0;
+
+	const auto constant = Set(d, (T) c);
+
+	for (x = 0; x + N <= sz; x += N) {
+		const auto m = vips_relational_compare_hwy(d, op,
+			LoadU(d, p + x), constant);
+
+		vips_relational_store_hwy(d, m, q + x, hwy::SizeTag<sizeof(T)>());
+	}
+
+	return x;
+}
+
+HWY_ATTR int
+vips_relational_hwy(VipsPel *HWY_RESTRICT q,
+	const VipsPel *HWY_RESTRICT left, const VipsPel *HWY_RESTRICT right,
+	VipsOperationRelational op, VipsBandFormat format, int sz)
+{
+	switch (format) {
+	case VIPS_FORMAT_UCHAR:
+		return vips_relational_line_hwy(q, (const uint8_t *) left,
+			(const uint8_t *) right, op, sz);
+
+	case VIPS_FORMAT_CHAR:
+		return vips_relational_line_hwy(q, (const int8_t *) left,
+			(const int8_t *) right, op, sz);
+
+	case VIPS_FORMAT_USHORT:
+		return vips_relational_line_hwy(q, (const uint16_t *) left,
+			(const uint16_t *) right, op, sz);
+
+	case VIPS_FORMAT_SHORT:
+		return vips_relational_line_hwy(q, (const int16_t *) left,
+			(const int16_t *) right, op, sz);
+
+	case VIPS_FORMAT_UINT:
+		return vips_relational_line_hwy(q, (const uint32_t *) left,
+			(const uint32_t *) right, op, sz);
+
+	case VIPS_FORMAT_INT:
+		return vips_relational_line_hwy(q, (const int32_t *) left,
+			(const int32_t *) right, op, sz);
+
+	case VIPS_FORMAT_FLOAT:
+		return vips_relational_line_hwy(q, (const float *) left,
+			(const float *) right, op, sz);
+
+	default:
+		return 0;
+	}
+}
+
+HWY_ATTR int
+vips__relational_const_hwy(VipsPel *HWY_RESTRICT q,
+	const VipsPel *HWY_RESTRICT p,
+	VipsOperationRelational op, VipsBandFormat format, double c, int sz)
+{
+	switch (format) {
+	case VIPS_FORMAT_UCHAR:
+		return vips_relational_const_line_hwy(q, (const uint8_t *) p,
+			op, c, sz);
+
+	case VIPS_FORMAT_CHAR:
+		return vips_relational_const_line_hwy(q, (const int8_t *) p,
+			op, c, sz);
+
+	case VIPS_FORMAT_USHORT:
+		return vips_relational_const_line_hwy(q, (const uint16_t *) p,
+			op, c, sz);
+
+	case VIPS_FORMAT_SHORT:
+		return vips_relational_const_line_hwy(q, (const int16_t *) p,
+			op, c, sz);
+
+	case VIPS_FORMAT_UINT:
+		return vips_relational_const_line_hwy(q, (const uint32_t *) p,
+			op, c, sz);
+
+	case VIPS_FORMAT_INT:
+		return vips_relational_const_line_hwy(q, (const int32_t *) p,
+			op, c, sz);
+
+	case VIPS_FORMAT_FLOAT:
+		return vips_relational_const_line_hwy(q, (const float *) p,
+			op, c, sz);
+
+	default:
+		return 0;
+	}
+}
+
+} /*namespace HWY_NAMESPACE*/
+
+#if HWY_ONCE
+HWY_EXPORT(vips_relational_hwy);
+HWY_EXPORT(vips__relational_const_hwy);
+
+int
+vips_relational_hwy(VipsPel *q, const VipsPel *left, const VipsPel *right,
+	VipsOperationRelational op, VipsBandFormat format, int sz)
+{
+	/* clang-format off */
+	return HWY_DYNAMIC_DISPATCH(vips_relational_hwy)(q, left, right,
+		op, format, sz);
+	/* clang-format on */
+}
+
+int
+vips__relational_const_hwy(VipsPel *q, const VipsPel *p,
+	VipsOperationRelational op, VipsBandFormat format, double c, int sz)
+{
+	/* clang-format off */
+	return HWY_DYNAMIC_DISPATCH(vips__relational_const_hwy)(q, p,
+		op, format, c, sz);
+	/* clang-format on */
+}
+#endif /*HWY_ONCE*/
+
+#endif /*HAVE_HWY*/
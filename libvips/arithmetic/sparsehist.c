@@ -0,0 +1,158 @@
+/* a sparse histogram, for when there are many bins but few are used
+ *
+ * 19/10/26
+ * 	- from hist_find_ndim.c
+ */
+
+/*
+
+	This file is part of VIPS.
+
+	VIPS is free software; you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+	02110-1301  USA
+
+ */
+
+/*
+
+	These files are distributed with VIPS - http://www.vips.ecs.soton.ac.uk
+
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif /*HAVE_CONFIG_H*/
+#include <glib/gi18n-lib.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vips/vips.h>
+
+#include "sparsehist.h"
+
+/* Start with 2 ** this many hash slots.
+ */
+#define SPARSEHIST_START_BITS (8)
+
+/* Fibonacci hashing: multiply by 2^64 / phi and take the top bits.
+ */
+static int
+vips_sparsehist_hash(VipsSparseHist *hist, guint64 key)
+{
+	return (int) ((key * G_GUINT64_CONSTANT(0x9E3779B97F4A7C15)) >>
+		(64 - hist->slot_bits));
+}
+
+/* Rebuild the hash with twice as many slots.
+ */
+static void
+vips_sparsehist_grow(VipsSparseHist *hist)
+{
+	int i;
+
+	hist->n_slots *= 2;
+	hist->slot_bits += 1;
+	g_free(hist->slots);
+	hist->slots = g_new0(int, hist->n_slots);
+
+	for (i = 0; i < hist->n; i++) {
+		int slot = vips_sparsehist_hash(hist, hist->keys[i]);
+
+		while (hist->slots[slot])
+			slot = (slot + 1) & (hist->n_slots - 1);
+		hist->slots[slot] = i + 1;
+	}
+}
+
+VipsSparseHist *
+vips__sparsehist_new(int value_size)
+{
+	VipsSparseHist *hist;
+
+	hist = g_new0(VipsSparseHist, 1);
+	hist->value_size = value_size;
+	hist->n_slots = 1 << SPARSEHIST_START_BITS;
+	hist->slot_bits = SPARSEHIST_START_BITS;
+	hist->slots = g_new0(int, hist->n_slots);
+	hist->last = -1;
+
+	return hist;
+}
+
+void
+vips__sparsehist_free(VipsSparseHist *hist)
+{
+	VIPS_FREE(hist->keys);
+	VIPS_FREE(hist->values);
+	VIPS_FREE(hist->slots);
+	g_free(hist);
+}
+
+/* Get the values for a bin, making a new zeroed entry if necessary. The
+ * pointer is only valid until the next call.
+ */
+double *
+vips__sparsehist_get(VipsSparseHist *hist, guint64 key, gboolean *is_new)
+{
+	int slot;
+	int i;
+
+	if (hist->last >= 0 &&
+		hist->keys[hist->last] == key) {
+		if (is_new)
+			*is_new = FALSE;
+		return VIPS_SPARSEHIST_VALUE(hist, hist->last);
+	}
+
+	slot = vips_sparsehist_hash(hist, key);
+	while ((i = hist->slots[slot])) {
+		if (hist->keys[i - 1] == key) {
+			hist->last = i - 1;
+			if (is_new)
+				*is_new = FALSE;
+			return VIPS_SPARSEHIST_VALUE(hist, i - 1);
+		}
+
+		slot = (slot + 1) & (hist->n_slots - 1);
+	}
+
+	/* Not found: add a new entry.
+	 */
+	if (hist->n >= hist->n_allocated) {
+		hist->n_allocated = VIPS_MAX(64, hist->n_allocated * 2);
+		hist->keys = g_renew(guint64, hist->keys, hist->n_allocated);
+		hist->values = g_renew(double, hist->values,
+			(gsize) hist->n_allocated * hist->value_size);
+	}
+
+	i = hist->n++;
+	hist->keys[i] = key;
+	memset(VIPS_SPARSEHIST_VALUE(hist, i),
+		0, hist->value_size * sizeof(double));
+	hist->slots[slot] = i + 1;
+	hist->last = i;
+
+	/* Keep the load factor under a half.
+	 */
+	if (hist->n * 2 > hist->n_slots)
+		vips_sparsehist_grow(hist);
+
+	if (is_new)
+		*is_new = TRUE;
+
+	return VIPS_SPARSEHIST_VALUE(hist, i);
+}
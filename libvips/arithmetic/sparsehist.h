@@ -0,0 +1,82 @@
+/* a sparse histogram, for when there are many bins but few are used
+ *
+ * 19/10/26
+ * 	- from hist_find_ndim.c
+ */
+
+/*
+
+	This file is part of VIPS.
+
+	VIPS is free software; you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+	02110-1301  USA
+
+ */
+
+/*
+
+	These files are distributed with VIPS - http://www.vips.ecs.soton.ac.uk
+
+ */
+
+#ifndef VIPS_SPARSEHIST_H
+#define VIPS_SPARSEHIST_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif /*__cplusplus*/
+
+/* An open-addressed hash from a bin number to a set of doubles. Entries are
+ * kept in insertion order in @keys and @values, so callers can walk them
+ * directly when merging.
+ */
+typedef struct _VipsSparseHist {
+	/* Number of doubles we hold for each bin.
+	 */
+	int value_size;
+
+	/* Entries in use, and allocated.
+	 */
+	int n;
+	int n_allocated;
+	guint64 *keys;
+	double *values;
+
+	/* The hash table: entry number plus one, or zero for an empty slot.
+	 * Always a power of two in size.
+	 */
+	int n_slots;
+	int slot_bits;
+	int *slots;
+
+	/* The last entry we looked up. Histograms often see runs of the same
+	 * bin.
+	 */
+	int last;
+} VipsSparseHist;
+
+VipsSparseHist *vips__sparsehist_new(int value_size);
+void vips__sparsehist_free(VipsSparseHist *hist);
+double *vips__sparsehist_get(VipsSparseHist *hist,
+	guint64 key, gboolean *is_new);
+
+#define VIPS_SPARSEHIST_KEY(H, I) ((H)->keys[I])
+#define VIPS_SPARSEHIST_VALUE(H, I) ((H)->values + (I) * (H)->value_size)
+
+#ifdef __cplusplus
+}
+#endif /*__cplusplus*/
+
+#endif /*VIPS_SPARSEHIST_H*/
@@ -5,6 +5,8 @@
  *      - from scRGB2XYZ.c
  * 7/5/23 kleisauke
  *      - use embedded ICC profile, if available
+ * 19/10/26
+ *      - restrict and target clones for the non-lcms path
  */
 
 /*
@@ -141,11 +143,12 @@ typedef VipsColourCodeClass VipsCMYK2XYZClass;
 
 G_DEFINE_TYPE(VipsCMYK2XYZ, vips_CMYK2XYZ, VIPS_TYPE_COLOUR_CODE);
 
+VIPS_TARGET_CLONES("default,avx")
 static void
 vips_CMYK2XYZ_line(VipsColour *colour, VipsPel *out, VipsPel **in, int width)
 {
-	unsigned char *p = (unsigned char *) in[0];
-	float *q = (float *) out;
+	unsigned char *restrict p = (unsigned char *) in[0];
+	float *restrict q = (float *) out;
 
 	int i;
 
@@ -11,6 +11,8 @@
  * 	- gtkdoc
  * 19/9/12
  * 	- redone as a class
+ * 19/10/26
+ * 	- add a Highway path
  */
 
 /*
@@ -49,6 +51,7 @@
 #include <math.h>
 
 #include <vips/vips.h>
+#include <vips/vector.h>
 
 #include "pcolour.h"
 
@@ -83,6 +86,13 @@ vips_LCh2Lab_line(VipsColour *colour, VipsPel *out, VipsPel **in, int width)
 
 	int x;
 
+#ifdef HAVE_HWY
+	if (vips_vector_isenabled()) {
+		vips_LCh2Lab_hwy(q, p, width);
+		return;
+	}
+#endif /*HAVE_HWY*/
+
 	for (x = 0; x < width; x++) {
 		float L = p[0];
 		float C = p[1];
@@ -5,6 +5,8 @@
  * 	- cleanups
  * 18/9/12
  * 	- redone as a class
+ * 19/10/26
+ * 	- add a Highway path
  */
 
 /*
@@ -43,6 +45,7 @@
 #include <math.h>
 
 #include <vips/vips.h>
+#include <vips/vector.h>
 
 #include "pcolour.h"
 
@@ -108,6 +111,13 @@ vips_Lab2LCh_line(VipsColour *colour, VipsPel *out, VipsPel **in, int width)
 
 	int x;
 
+#ifdef HAVE_HWY
+	if (vips_vector_isenabled()) {
+		vips_Lab2LCh_hwy(q, p, width);
+		return;
+	}
+#endif /*HAVE_HWY*/
+
 	for (x = 0; x < width; x++) {
 		float L = p[0];
 		float a = p[1];
@@ -31,6 +31,8 @@
  *	- cleanups
  * 20/9/12
  * 	- redo as a class
+ * 19/10/26
+ * 	- a and b in float, so the loop vectorises
  */
 
 /*
@@ -81,7 +83,11 @@ G_DEFINE_TYPE(VipsLab2LabQ, vips_Lab2LabQ, VIPS_TYPE_COLOUR_CODE);
  * works only on buffers, not IMAGEs
  * Copyright 1993 K.Martinez
  * Modified: 3/5/93, 16/6/93
+ *
+ * L needs the double multiply to give the same result as before, but a and
+ * b are scaled by a power of two, so float is exact.
  */
+VIPS_TARGET_CLONES("default,avx")
 static void
 vips_Lab2LabQ_line(VipsColour *colour, VipsPel *out, VipsPel **in, int width)
 {
@@ -91,30 +97,27 @@ vips_Lab2LabQ_line(VipsColour *colour, VipsPel *out, VipsPel **in, int width)
 	int i;
 
 	for (i = 0; i < width; i++) {
-		float fval;
-		int lsbs;
-		int intv;
+		int l, a, b;
 
 		/* Scale L up to 10 bits.
 		 */
-		intv = VIPS_ROUND_UINT(10.23 * p[0]);
-		intv = VIPS_CLIP(0, intv, 1023);
-		lsbs = (intv & 0x3) << 6; /* 00000011 -> 11000000 */
-		q[0] = intv >> 2;		  /* drop bot 2 bits and store */
-
-		fval = 8.0 * p[1]; /* do a */
-		intv = VIPS_RINT(fval);
-		intv = VIPS_CLIP(-1024, intv, 1023);
-		lsbs |= (intv & 0x7) << 3; /* 00000111 -> 00111000 */
-		q[1] = intv >> 3;		   /* drop bot 3 bits & store */
-
-		fval = 8.0 * p[2]; /* do b */
-		intv = VIPS_RINT(fval);
-		intv = VIPS_CLIP(-1024, intv, 1023);
-		lsbs |= (intv & 0x7);
-		q[2] = intv >> 3;
-
-		q[3] = lsbs; /* store lsb band */
+		l = VIPS_ROUND_UINT(10.23 * p[0]);
+		l = VIPS_CLIP(0, l, 1023);
+
+		/* a and b to 11 bits.
+		 */
+		a = VIPS_RINT(8.0F * p[1]);
+		a = VIPS_CLIP(-1024, a, 1023);
+		b = VIPS_RINT(8.0F * p[2]);
+		b = VIPS_CLIP(-1024, b, 1023);
+
+		/* Drop the bottom bits and store, then pack the bottom bits
+		 * into the lsb band as LLaaabbb.
+		 */
+		q[0] = l >> 2;
+		q[1] = a >> 3;
+		q[2] = b >> 3;
+		q[3] = ((l & 0x3) << 6) | ((a & 0x7) << 3) | (b & 0x7);
 
 		p += 3;
 		q += 4;
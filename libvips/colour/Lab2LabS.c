@@ -7,6 +7,8 @@
  *	- cleanups
  * 20/9/12
  * 	- redo as a class
+ * 19/10/26
+ * 	- a and b in float, so the loop vectorises
  */
 
 /*
@@ -53,6 +55,10 @@ typedef VipsColourCodeClass VipsLab2LabSClass;
 
 G_DEFINE_TYPE(VipsLab2LabS, vips_Lab2LabS, VIPS_TYPE_COLOUR_CODE);
 
+/* L needs the double multiply to give the same result as before, but a and
+ * b are scaled by a power of two, so float is exact.
+ */
+VIPS_TARGET_CLONES("default,avx")
 static void
 vips_Lab2LabS_line(VipsColour *colour, VipsPel *out, VipsPel **in, int width)
 {
@@ -62,8 +68,8 @@ vips_Lab2LabS_line(VipsColour *colour, VipsPel *out, VipsPel **in, int width)
 
 	for (i = 0; i < width; i++) {
 		q[0] = p[0] * (32767.0 / 100.0);
-		q[1] = p[1] * (32768.0 / 128.0);
-		q[2] = p[2] * (32768.0 / 128.0);
+		q[1] = p[1] * (32768.0F / 128.0F);
+		q[2] = p[2] * (32768.0F / 128.0F);
 
 		q += 3;
 		p += 3;
@@ -0,0 +1,561 @@
+/* Turn Lab into sRGB in a single pass.
+ *
+ * 19/10/26
+ * 	- from Lab2XYZ.c, XYZ2scRGB.c and scRGB2sRGB.c
+ * 	- add Lab2BW
+ */
+
+/*
+
+	This file is part of VIPS.
+
+	VIPS is free software; you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+	02110-1301  USA
+
+ */
+
+/*
+
+	These files are distributed with VIPS - http://www.vips.ecs.soton.ac.uk
+
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif /*HAVE_CONFIG_H*/
+#include <glib/gi18n-lib.h>
+
+#include <stdio.h>
+#include <math.h>
+#include <limits.h>
+
+#include <vips/vips.h>
+#include <vips/vector.h>
+#include <vips/internal.h>
+
+#include "pcolour.h"
+
+/* This is used by vips_colourspace() to do Lab -> XYZ -> scRGB -> sRGB (or
+ * B_W) in one step. The arithmetic is exactly the same as the separate
+ * operations, so the result is identical, we just avoid the intermediate
+ * float images.
+ * When the separate operations would use their vector paths, we run the same
+ * kernels on a chunk of pixels at a time.
+ */
+
+typedef struct _VipsLab2sRGB {
+	VipsOperation parent_instance;
+
+	VipsImage *in;
+	VipsImage *out;
+	int depth;
+
+	/* Make B_W or GREY16 rather than sRGB or RGB16.
+	 */
+	gboolean bw;
+} VipsLab2sRGB;
+
+typedef VipsOperationClass VipsLab2sRGBClass;
+
+G_DEFINE_TYPE(VipsLab2sRGB, vips_Lab2sRGB, VIPS_TYPE_OPERATION);
+
+/* D65 Lab to XYZ, as vips_col_Lab2XYZ_helper().
+ */
+static inline void
+vips_Lab2sRGB_XYZ(float L, float a, float b, float *X, float *Y, float *Z)
+{
+	double cby, tmp;
+
+	if (L < 8.0) {
+		*Y = (L * VIPS_D65_Y0) / 903.3;
+		cby = 7.787 * (*Y / VIPS_D65_Y0) + 16.0 / 116.0;
+	}
+	else {
+		cby = (L + 16.0) / 116.0;
+		*Y = VIPS_D65_Y0 * cby * cby * cby;
+	}
+
+	tmp = a / 500.0 + cby;
+	if (tmp < 0.2069)
+		*X = VIPS_D65_X0 * (tmp - 0.13793) / 7.787;
+	else
+		*X = VIPS_D65_X0 * tmp * tmp * tmp;
+
+	tmp = cby - b / 200.0;
+	if (tmp < 0.2069)
+		*Z = VIPS_D65_Z0 * (tmp - 0.13793) / 7.787;
+	else
+		*Z = VIPS_D65_Z0 * tmp * tmp * tmp;
+}
+
+/* Linear to gamma with an interpolated lookup, as vips_col_scRGB2sRGB().
+ */
+static inline int
+vips_Lab2sRGB_gamma(const int *lut, int maxval, float V)
+{
+	float Yf;
+	int Yi;
+	float v;
+
+	Yf = V * maxval;
+	Yf = VIPS_FCLIP(0, Yf, maxval);
+	Yi = (int) Yf;
+	v = lut[Yi] + (lut[Yi + 1] - lut[Yi]) * (Yf - Yi);
+
+	return VIPS_RINT(v);
+}
+
+/* Lab to scRGB, as vips_Lab2XYZ() then vips_XYZ2scRGB().
+ */
+static inline void
+vips_Lab2sRGB_scRGB(float L, float a, float b, float *R, float *G, float *B)
+{
+	float X, Y, Z;
+
+	vips_Lab2sRGB_XYZ(L, a, b, &X, &Y, &Z);
+
+	X /= VIPS_D65_Y0;
+	Y /= VIPS_D65_Y0;
+	Z /= VIPS_D65_Y0;
+
+	*R = 3.240625 * X +
+		-1.537208 * Y +
+		-0.498629 * Z;
+	*G = -0.968931 * X +
+		1.875756 * Y +
+		0.041518 * Z;
+	*B = 0.055710 * X +
+		-0.204021 * Y +
+		1.056996 * Z;
+}
+
+/* Write one scRGB pixel as sRGB, as vips_scRGB2sRGB().
+ */
+#define sRGB_PIXEL(LUT, MAX) \
+	{ \
+		if (VIPS_ISNAN(R) || \
+			VIPS_ISNAN(G) || \
+			VIPS_ISNAN(B)) { \
+			q[0] = 0; \
+			q[1] = 0; \
+			q[2] = 0; \
+		} \
+		else { \
+			q[0] = vips_Lab2sRGB_gamma(LUT, MAX, R); \
+			q[1] = vips_Lab2sRGB_gamma(LUT, MAX, G); \
+			q[2] = vips_Lab2sRGB_gamma(LUT, MAX, B); \
+		} \
+		q += 3; \
+	}
+
+/* Write one scRGB pixel as greyscale, as vips_scRGB2BW().
+ */
+#define BW_PIXEL(SCRGB2BW) \
+	{ \
+		int g; \
+\
+		SCRGB2BW(R, G, B, &g, NULL); \
+		q[0] = g; \
+		q += 1; \
+	}
+
+/* Extra bands go through XYZ2scRGB and then scale to the output range.
+ */
+#define EXTRA_BANDS(MAX) \
+	{ \
+		for (j = 0; j < extra_bands; j++) { \
+			const float a = VIPS_CLIP(0, p[j] / 255.0, 1.0); \
+\
+			q[j] = VIPS_CLIP(0, (int) (a * (double) MAX), MAX); \
+		} \
+		p += extra_bands; \
+		q += extra_bands; \
+	}
+
+#define Lab2sRGB_LINE(TYPE, MAX, PIXEL) \
+	{ \
+		TYPE *restrict q = (TYPE *) out; \
+\
+		for (i = 0; i < width; i++) { \
+			float R, G, B; \
+\
+			vips_Lab2sRGB_scRGB(p[0], p[1], p[2], &R, &G, &B); \
+			p += 3; \
+\
+			PIXEL; \
+			EXTRA_BANDS(MAX); \
+		} \
+	}
+
+VIPS_TARGET_CLONES("default,avx")
+static void
+vips_Lab2sRGB_line_8(VipsPel *restrict out, float *restrict p,
+	int extra_bands, int width)
+{
+	int i, j;
+
+	Lab2sRGB_LINE(VipsPel, UCHAR_MAX,
+		sRGB_PIXEL(vips_Y2v_8, UCHAR_MAX));
+}
+
+VIPS_TARGET_CLONES("default,avx")
+static void
+vips_Lab2sRGB_line_16(VipsPel *restrict out, float *restrict p,
+	int extra_bands, int width)
+{
+	int i, j;
+
+	Lab2sRGB_LINE(unsigned short, USHRT_MAX,
+		sRGB_PIXEL(vips_Y2v_16, USHRT_MAX));
+}
+
+static void
+vips_Lab2BW_line_8(VipsPel *restrict out, float *restrict p,
+	int extra_bands, int width)
+{
+	int i, j;
+
+	Lab2sRGB_LINE(VipsPel, UCHAR_MAX,
+		BW_PIXEL(vips_col_scRGB2BW_8));
+}
+
+static void
+vips_Lab2BW_line_16(VipsPel *restrict out, float *restrict p,
+	int extra_bands, int width)
+{
+	int i, j;
+
+	Lab2sRGB_LINE(unsigned short, USHRT_MAX,
+		BW_PIXEL(vips_col_scRGB2BW_16));
+}
+
+#ifdef HAVE_HWY
+/* Chunk size for the vector path.
+ */
+#define CHUNK (256)
+
+/* As the scalar path, but XYZ and scRGB come from the Lab2XYZ and XYZ2scRGB
+ * kernels.
+ */
+#define Lab2sRGB_LINE_HWY(TYPE, MAX, PIXEL) \
+	{ \
+		TYPE *restrict q = (TYPE *) out; \
+		const int bands = 3 + extra_bands; \
+\
+		float lab[3 * CHUNK]; \
+		float xyz[3 * CHUNK]; \
+\
+		for (x = 0; x < width; x += CHUNK) { \
+			int n = VIPS_MIN(CHUNK, width - x); \
+\
+			for (i = 0; i < n; i++) { \
+				lab[3 * i] = p[i * bands]; \
+				lab[3 * i + 1] = p[i * bands + 1]; \
+				lab[3 * i + 2] = p[i * bands + 2]; \
+			} \
+\
+			vips_Lab2XYZ_hwy(xyz, lab, n, \
+				VIPS_D65_X0, VIPS_D65_Y0, VIPS_D65_Z0); \
+			vips_XYZ2scRGB_hwy(lab, xyz, 0, n); \
+\
+			for (i = 0; i < n; i++) { \
+				const float R = lab[3 * i]; \
+				const float G = lab[3 * i + 1]; \
+				const float B = lab[3 * i + 2]; \
+\
+				p += 3; \
+\
+				PIXEL; \
+				EXTRA_BANDS(MAX); \
+			} \
+		} \
+	}
+
+static void
+vips_Lab2sRGB_line_8_hwy(VipsPel *restrict out, float *restrict p,
+	int extra_bands, int width)
+{
+	int x, i, j;
+
+	Lab2sRGB_LINE_HWY(VipsPel, UCHAR_MAX,
+		sRGB_PIXEL(vips_Y2v_8, UCHAR_MAX));
+}
+
+static void
+vips_Lab2sRGB_line_16_hwy(VipsPel *restrict out, float *restrict p,
+	int extra_bands, int width)
+{
+	int x, i, j;
+
+	Lab2sRGB_LINE_HWY(unsigned short, USHRT_MAX,
+		sRGB_PIXEL(vips_Y2v_16, USHRT_MAX));
+}
+
+static void
+vips_Lab2BW_line_8_hwy(VipsPel *restrict out, float *restrict p,
+	int extra_bands, int width)
+{
+	int x, i, j;
+
+	Lab2sRGB_LINE_HWY(VipsPel, UCHAR_MAX,
+		BW_PIXEL(vips_col_scRGB2BW_8));
+}
+
+static void
+vips_Lab2BW_line_16_hwy(VipsPel *restrict out, float *restrict p,
+	int extra_bands, int width)
+{
+	int x, i, j;
+
+	Lab2sRGB_LINE_HWY(unsigned short, USHRT_MAX,
+		BW_PIXEL(vips_col_scRGB2BW_16));
+}
+#endif /*HAVE_HWY*/
+
+typedef void (*VipsLab2sRGBLineFn)(VipsPel *restrict out,
+	float *restrict p, int extra_bands, int width);
+
+static VipsLab2sRGBLineFn
+vips_Lab2sRGB_get_line(VipsLab2sRGB *Lab2sRGB)
+{
+#ifdef HAVE_HWY
+	if (vips_vector_isenabled()) {
+		if (Lab2sRGB->bw)
+			return Lab2sRGB->depth == 16
+				? vips_Lab2BW_line_16_hwy
+				: vips_Lab2BW_line_8_hwy;
+		else
+			return Lab2sRGB->depth == 16
+				? vips_Lab2sRGB_line_16_hwy
+				: vips_Lab2sRGB_line_8_hwy;
+	}
+#endif /*HAVE_HWY*/
+
+	if (Lab2sRGB->bw)
+		return Lab2sRGB->depth == 16
+			? vips_Lab2BW_line_16
+			: vips_Lab2BW_line_8;
+	else
+		return Lab2sRGB->depth == 16
+			? vips_Lab2sRGB_line_16
+			: vips_Lab2sRGB_line_8;
+}
+
+static int
+vips_Lab2sRGB_gen(VipsRegion *out_region,
+	void *seq, void *a, void *b, gboolean *stop)
+{
+	VipsRegion *ir = (VipsRegion *) seq;
+	VipsLab2sRGB *Lab2sRGB = (VipsLab2sRGB *) b;
+	VipsRect *r = &out_region->valid;
+	VipsImage *in = ir->im;
+	VipsLab2sRGBLineFn line = vips_Lab2sRGB_get_line(Lab2sRGB);
+
+	int y;
+
+	if (vips_region_prepare(ir, r))
+		return -1;
+
+	VIPS_GATE_START("vips_Lab2sRGB_gen: work");
+
+	if (Lab2sRGB->depth == 16)
+		vips_col_make_tables_RGB_16();
+	else
+		vips_col_make_tables_RGB_8();
+
+	for (y = 0; y < r->height; y++) {
+		float *p = (float *)
+			VIPS_REGION_ADDR(ir, r->left, r->top + y);
+		VipsPel *q = (VipsPel *)
+			VIPS_REGION_ADDR(out_region, r->left, r->top + y);
+
+		line(q, p, in->Bands - 3, r->width);
+	}
+
+	VIPS_GATE_STOP("vips_Lab2sRGB_gen: work");
+
+	return 0;
+}
+
+static int
+vips_Lab2sRGB_build(VipsObject *object)
+{
+	VipsObjectClass *class = VIPS_OBJECT_GET_CLASS(object);
+	VipsLab2sRGB *Lab2sRGB = (VipsLab2sRGB *) object;
+
+	VipsImage **t = (VipsImage **) vips_object_local_array(object, 2);
+
+	VipsImage *in;
+	VipsBandFormat format;
+	VipsInterpretation interpretation;
+	VipsImage *out;
+
+	if (VIPS_OBJECT_CLASS(vips_Lab2sRGB_parent_class)->build(object))
+		return -1;
+
+	in = Lab2sRGB->in;
+	if (vips_check_bands_atleast(class->nickname, in, 3))
+		return -1;
+
+	// as scRGB2sRGB, any profile can no longer be correct
+	if (vips_copy(in, &t[0], NULL))
+		return -1;
+	in = t[0];
+	vips_image_remove(in, VIPS_META_ICC_NAME);
+
+	switch (Lab2sRGB->depth) {
+	case 16:
+		interpretation = Lab2sRGB->bw
+			? VIPS_INTERPRETATION_GREY16
+			: VIPS_INTERPRETATION_RGB16;
+		format = VIPS_FORMAT_USHORT;
+		break;
+
+	case 8:
+		interpretation = Lab2sRGB->bw
+			? VIPS_INTERPRETATION_B_W
+			: VIPS_INTERPRETATION_sRGB;
+		format = VIPS_FORMAT_UCHAR;
+		break;
+
+	default:
+		vips_error(class->nickname, "%s", _("depth must be 8 or 16"));
+		return -1;
+	}
+
+	if (vips_cast_float(in, &t[1], NULL))
+		return -1;
+	in = t[1];
+
+	out = vips_image_new();
+	if (vips_image_pipelinev(out,
+			VIPS_DEMAND_STYLE_THINSTRIP, in, NULL)) {
+		g_object_unref(out);
+		return -1;
+	}
+	out->Type = interpretation;
+	out->BandFmt = format;
+	if (Lab2sRGB->bw)
+		out->Bands = in->Bands - 2;
+
+	if (vips_image_generate(out,
+			vips_start_one, vips_Lab2sRGB_gen, vips_stop_one,
+			in, Lab2sRGB)) {
+		g_object_unref(out);
+		return -1;
+	}
+
+	g_object_set(object, "out", out, NULL);
+
+	return 0;
+}
+
+static void
+vips_Lab2sRGB_class_init(VipsLab2sRGBClass *class)
+{
+	GObjectClass *gobject_class = G_OBJECT_CLASS(class);
+	VipsObjectClass *object_class = (VipsObjectClass *) class;
+	VipsOperationClass *operation_class = VIPS_OPERATION_CLASS(class);
+
+	gobject_class->set_property = vips_object_set_property;
+	gobject_class->get_property = vips_object_get_property;
+
+	object_class->nickname = "Lab2sRGB";
+	object_class->description = _("convert a Lab image to sRGB");
+	object_class->build = vips_Lab2sRGB_build;
+
+	/* Only for vips_colourspace(), so keep it out of the docs and the
+	 * operation list.
+	 */
+	operation_class->flags = VIPS_OPERATION_SEQUENTIAL |
+		VIPS_OPERATION_DEPRECATED;
+
+	VIPS_ARG_IMAGE(class, "in", 1,
+		_("Input"),
+		_("Input image"),
+		VIPS_ARGUMENT_REQUIRED_INPUT,
+		G_STRUCT_OFFSET(VipsLab2sRGB, in));
+
+	VIPS_ARG_IMAGE(class, "out", 100,
+		_("Output"),
+		_("Output image"),
+		VIPS_ARGUMENT_REQUIRED_OUTPUT,
+		G_STRUCT_OFFSET(VipsLab2sRGB, out));
+
+	VIPS_ARG_INT(class, "depth", 130,
+		_("Depth"),
+		_("Output device space depth in bits"),
+		VIPS_ARGUMENT_OPTIONAL_INPUT,
+		G_STRUCT_OFFSET(VipsLab2sRGB, depth),
+		8, 16, 8);
+}
+
+static void
+vips_Lab2sRGB_init(VipsLab2sRGB *Lab2sRGB)
+{
+	Lab2sRGB->depth = 8;
+}
+
+/* Convert a D65 Lab image to 8 or 16-bit sRGB. Same as vips_Lab2XYZ(),
+ * vips_XYZ2scRGB() and vips_scRGB2sRGB(), but in one pass.
+ */
+int
+vips_Lab2sRGB(VipsImage *in, VipsImage **out, ...)
+{
+	va_list ap;
+	int result;
+
+	va_start(ap, out);
+	result = vips_call_split("Lab2sRGB", ap, in, out);
+	va_end(ap);
+
+	return result;
+}
+
+typedef VipsLab2sRGB VipsLab2BW;
+typedef VipsLab2sRGBClass VipsLab2BWClass;
+
+G_DEFINE_TYPE(VipsLab2BW, vips_Lab2BW, vips_Lab2sRGB_get_type());
+
+static void
+vips_Lab2BW_class_init(VipsLab2BWClass *class)
+{
+	VipsObjectClass *object_class = (VipsObjectClass *) class;
+
+	object_class->nickname = "Lab2BW";
+	object_class->description = _("convert a Lab image to BW");
+}
+
+static void
+vips_Lab2BW_init(VipsLab2BW *Lab2BW)
+{
+	Lab2BW->bw = TRUE;
+}
+
+/* Convert a D65 Lab image to 8 or 16-bit greyscale. Same as vips_Lab2XYZ(),
+ * vips_XYZ2scRGB() and vips_scRGB2BW(), but in one pass.
+ */
+int
+vips_Lab2BW(VipsImage *in, VipsImage **out, ...)
+{
+	va_list ap;
+	int result;
+
+	va_start(ap, out);
+	result = vips_call_split("Lab2BW", ap, in, out);
+	va_end(ap);
+
+	return result;
+}
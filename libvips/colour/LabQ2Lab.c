@@ -18,6 +18,8 @@
  * 	- gtkdoc
  * 20/9/12
  * 	- redo as a class
+ * 19/10/26
+ * 	- look up L, make a and b with float arithmetic, so the loop vectorises
  */
 
 /*
@@ -64,6 +66,22 @@ typedef VipsColourCodeClass VipsLabQ2LabClass;
 
 G_DEFINE_TYPE(VipsLabQ2Lab, vips_LabQ2Lab, VIPS_TYPE_COLOUR_CODE);
 
+/* L is only 10 bits, so we can look it up. The table is made with exactly
+ * the same double arithmetic we used to do for every pixel.
+ */
+static float vips_LabQ2Lab_L[1024];
+
+static void *
+vips_LabQ2Lab_table_init(void *client)
+{
+	int l;
+
+	for (l = 0; l < 1024; l++)
+		vips_LabQ2Lab_L[l] = (float) l * (100.0 / 1023.0);
+
+	return NULL;
+}
+
 /* imb_LabQ2Lab: CONVERT n pels from packed 32bit Lab to float values
  * in a buffer
  * ARGS:   VipsPel *inp       pointer to first byte of Lab32 buffer
@@ -71,38 +89,36 @@ G_DEFINE_TYPE(VipsLabQ2Lab, vips_LabQ2Lab, VIPS_TYPE_COLOUR_CODE);
  *	int n           number of pels to process
  * (C) K.Martinez 2/5/93
  */
+VIPS_TARGET_CLONES("default,avx")
 static void
 vips_LabQ2Lab_line(VipsColour *colour, VipsPel *out, VipsPel **in, int width)
 {
+	static GOnce once = G_ONCE_INIT;
+
 	signed char *restrict p = (signed char *) in[0];
 	float *restrict q = (float *) out;
 
-	int l;
-	int lsbs; /* for lsbs byte */
-	int i;	  /* counter      */
+	int i;
+
+	VIPS_ONCE(&once, vips_LabQ2Lab_table_init, NULL);
 
 	/* Read input with a signed pointer to get signed ab easily.
 	 */
 	for (i = 0; i < width; i++) {
 		/* Get extra bits.
 		 */
-		lsbs = ((unsigned char *) p)[3];
+		const int lsbs = ((unsigned char *) p)[3];
 
 		/* Build L.
 		 */
-		l = ((unsigned char *) p)[0];
-		l = (l << 2) | (lsbs >> 6);
-		q[0] = (float) l * (100.0 / 1023.0);
-
-		/* Build a.
-		 */
-		l = VIPS_LSHIFT_INT(p[1], 3) | ((lsbs >> 3) & 0x7);
-		q[1] = (float) l * 0.125;
+		q[0] = vips_LabQ2Lab_L[(((unsigned char *) p)[0] << 2) |
+			(lsbs >> 6)];
 
-		/* And b.
+		/* Build a and b. These are 11 bit ints scaled by a power of
+		 * two, so float is exact.
 		 */
-		l = VIPS_LSHIFT_INT(p[2], 3) | (lsbs & 0x7);
-		q[2] = (float) l * 0.125;
+		q[1] = (VIPS_LSHIFT_INT(p[1], 3) | ((lsbs >> 3) & 0x7)) * 0.125F;
+		q[2] = (VIPS_LSHIFT_INT(p[2], 3) | (lsbs & 0x7)) * 0.125F;
 
 		p += 4;
 		q += 3;
@@ -4,6 +4,8 @@
  * 	- adapted from im_LabS2LabQ()
  * 2/11/09
  * 	- gtkdoc, cleanup
+ * 19/10/26
+ * 	- a and b in float, restrict, so the loop vectorises
  */
 
 /*
@@ -50,18 +52,22 @@ typedef VipsColourCodeClass VipsLabS2LabClass;
 G_DEFINE_TYPE(VipsLabS2Lab, vips_LabS2Lab, VIPS_TYPE_COLOUR_CODE);
 
 /* Convert n pels from signed short to Lab.
+ *
+ * L needs the double divide to give the same result as before, but a and b
+ * are scaled by a power of two, so float is exact.
  */
+VIPS_TARGET_CLONES("default,avx")
 static void
 vips_LabS2Lab_line(VipsColour *colour, VipsPel *out, VipsPel **in, int width)
 {
-	signed short *p = (signed short *) in[0];
-	float *q = (float *) out;
+	signed short *restrict p = (signed short *) in[0];
+	float *restrict q = (float *) out;
 	int i;
 
 	for (i = 0; i < width; i++) {
 		q[0] = p[0] / (32767.0 / 100.0);
-		q[1] = p[1] / (32768.0 / 128.0);
-		q[2] = p[2] / (32768.0 / 128.0);
+		q[1] = p[1] * (128.0F / 32768.0F);
+		q[2] = p[2] * (128.0F / 32768.0F);
 
 		p += 3;
 		q += 3;
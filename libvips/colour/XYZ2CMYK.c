@@ -5,6 +5,8 @@
  *      - from CMYK2XYZ.c
  * 09/01/2019
  *  	- add CMYK <-> XYZ conversions if no lcms2 has been found
+ * 19/10/26
+ *      - restrict and target clones for the non-lcms path
  */
 
 /*
@@ -140,11 +142,12 @@ typedef VipsColourCodeClass VipsXYZ2CMYKClass;
 
 G_DEFINE_TYPE(VipsXYZ2CMYK, vips_XYZ2CMYK, VIPS_TYPE_COLOUR_CODE);
 
+VIPS_TARGET_CLONES("default,avx")
 static void
 vips_XYZ2CMYK_line(VipsColour *colour, VipsPel *out, VipsPel **in, int width)
 {
-	float *p = (float *) in[0];
-	unsigned char *q = (unsigned char *) out;
+	float *restrict p = (float *) in[0];
+	unsigned char *restrict q = (unsigned char *) out;
 
 	const float epsilon = 0.00001;
 
@@ -19,6 +19,8 @@
  * 	- fix a race in the table build
  * 19/9/12
  * 	- redone as a class
+ * 19/10/26
+ * 	- add a Highway path
  */
 
 /*
@@ -57,6 +59,7 @@
 #include <math.h>
 
 #include <vips/vips.h>
+#include <vips/vector.h>
 #include <vips/internal.h>
 
 #include "pcolour.h"
@@ -67,9 +70,11 @@
 
 /* Lookup table size.
  */
-#define QUANT_ELEMENTS (100000)
+#define QUANT_ELEMENTS (VIPS_XYZ2LAB_QUANT)
 
-static float cbrt_table[QUANT_ELEMENTS];
+/* Also used by the fused sRGB2Lab.
+ */
+float vips_cbrt_table[QUANT_ELEMENTS];
 
 typedef struct _VipsXYZ2Lab {
 	VipsColourTransform parent_instance;
@@ -101,14 +106,20 @@ table_init(void *client)
 		float Y = (double) i / QUANT_ELEMENTS;
 
 		if (Y < 0.008856)
-			cbrt_table[i] = 7.787 * Y + (16.0 / 116.0);
+			vips_cbrt_table[i] = 7.787 * Y + (16.0 / 116.0);
 		else
-			cbrt_table[i] = cbrt(Y);
+			vips_cbrt_table[i] = cbrt(Y);
 	}
 
 	return NULL;
 }
 
+void
+vips_col_make_tables_XYZ2Lab(void)
+{
+	VIPS_ONCE(&table_init_once, table_init, NULL);
+}
+
 static void
 vips_col_XYZ2Lab_helper(VipsXYZ2Lab *XYZ2Lab,
 	float X, float Y, float Z, float *L, float *a, float *b)
@@ -126,15 +137,15 @@ vips_col_XYZ2Lab_helper(VipsXYZ2Lab *XYZ2Lab,
 	 */
 	i = VIPS_CLIP(0, (int) nX, QUANT_ELEMENTS - 2);
 	f = nX - i;
-	cbx = cbrt_table[i] + f * (cbrt_table[i + 1] - cbrt_table[i]);
+	cbx = vips_cbrt_table[i] + f * (vips_cbrt_table[i + 1] - vips_cbrt_table[i]);
 
 	i = VIPS_CLIP(0, (int) nY, QUANT_ELEMENTS - 2);
 	f = nY - i;
-	cby = cbrt_table[i] + f * (cbrt_table[i + 1] - cbrt_table[i]);
+	cby = vips_cbrt_table[i] + f * (vips_cbrt_table[i + 1] - vips_cbrt_table[i]);
 
 	i = VIPS_CLIP(0, (int) nZ, QUANT_ELEMENTS - 2);
 	f = nZ - i;
-	cbz = cbrt_table[i] + f * (cbrt_table[i + 1] - cbrt_table[i]);
+	cbz = vips_cbrt_table[i] + f * (vips_cbrt_table[i + 1] - vips_cbrt_table[i]);
 
 	*L = 116.0 * cby - 16.0;
 	*a = 500.0 * (cbx - cby);
@@ -153,7 +164,15 @@ vips_XYZ2Lab_line(VipsColour *colour, VipsPel *out, VipsPel **in, int width)
 
 	int x;
 
-	VIPS_ONCE(&table_init_once, table_init, NULL);
+	vips_col_make_tables_XYZ2Lab();
+
+#ifdef HAVE_HWY
+	if (vips_vector_isenabled()) {
+		vips_XYZ2Lab_hwy(q, p, width,
+			XYZ2Lab->X0, XYZ2Lab->Y0, XYZ2Lab->Z0);
+		return;
+	}
+#endif /*HAVE_HWY*/
 
 	for (x = 0; x < width; x++) {
 		float X, Y, Z;
@@ -191,7 +210,7 @@ vips_col_XYZ2Lab(float X, float Y, float Z, float *L, float *a, float *b)
 {
 	VipsXYZ2Lab XYZ2Lab;
 
-	VIPS_ONCE(&table_init_once, table_init, NULL);
+	vips_col_make_tables_XYZ2Lab();
 
 	XYZ2Lab.X0 = VIPS_D65_X0;
 	XYZ2Lab.Y0 = VIPS_D65_Y0;
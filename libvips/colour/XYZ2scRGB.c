@@ -6,6 +6,8 @@
  * 	- remove any ICC profile
  * 25/11/14
  * 	- oh argh, revert the above
+ * 19/10/26
+ * 	- add a Highway path
  */
 
 /*
@@ -44,6 +46,7 @@
 #include <math.h>
 
 #include <vips/vips.h>
+#include <vips/vector.h>
 
 #include "pcolour.h"
 
@@ -84,6 +87,27 @@ vips_XYZ2scRGB_line(float *restrict q, float *restrict p,
 {
 	int i, j;
 
+#ifdef HAVE_HWY
+	if (vips_vector_isenabled()) {
+		/* That does the colour bands, we do any extra bands.
+		 */
+		vips_XYZ2scRGB_hwy(q, p, extra_bands, width);
+
+		if (extra_bands > 0)
+			for (i = 0; i < width; i++) {
+				p += 3;
+				q += 3;
+
+				for (j = 0; j < extra_bands; j++)
+					q[j] = VIPS_CLIP(0, p[j] / 255.0, 1.0);
+				p += extra_bands;
+				q += extra_bands;
+			}
+
+		return;
+	}
+#endif /*HAVE_HWY*/
+
 	for (i = 0; i < width; i++) {
 		const float X = p[0];
 		const float Y = p[1];
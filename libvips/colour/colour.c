@@ -735,6 +735,10 @@ vips_colour_operation_init(void)
 	extern GType vips_scRGB2BW_get_type(void);
 	extern GType vips_XYZ2scRGB_get_type(void);
 	extern GType vips_scRGB2sRGB_get_type(void);
+	extern GType vips_sRGB2Lab_get_type(void);
+	extern GType vips_Lab2sRGB_get_type(void);
+	extern GType vips_Lab2BW_get_type(void);
+	extern GType vips_sRGB2BW_get_type(void);
 	extern GType vips_CMYK2XYZ_get_type(void);
 	extern GType vips_XYZ2CMYK_get_type(void);
 	extern GType vips_profile_load_get_type(void);
@@ -746,6 +750,7 @@ vips_colour_operation_init(void)
 	extern GType vips_dE76_get_type(void);
 	extern GType vips_dE00_get_type(void);
 	extern GType vips_dECMC_get_type(void);
+	extern GType vips_dEstats_get_type(void);
 
 	vips_colourspace_get_type();
 	vips_Lab2XYZ_get_type();
@@ -772,6 +777,10 @@ vips_colour_operation_init(void)
 	vips_HSV2sRGB_get_type();
 	vips_XYZ2scRGB_get_type();
 	vips_scRGB2sRGB_get_type();
+	vips_sRGB2Lab_get_type();
+	vips_Lab2sRGB_get_type();
+	vips_Lab2BW_get_type();
+	vips_sRGB2BW_get_type();
 	vips_CMYK2XYZ_get_type();
 	vips_XYZ2CMYK_get_type();
 	vips_profile_load_get_type();
@@ -783,4 +792,5 @@ vips_colour_operation_init(void)
 	vips_dE76_get_type();
 	vips_dE00_get_type();
 	vips_dECMC_get_type();
+	vips_dEstats_get_type();
 }
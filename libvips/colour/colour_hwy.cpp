@@ -0,0 +1,680 @@
+/* Highway kernels for the core float colour transforms
+ *
+ * 19/10/26
+ * 	- from scRGB2XYZ.c, XYZ2scRGB.c, XYZ2Lab.c, Lab2XYZ.c, Lab2LCh.c and
+ * 	  LCh2Lab.c
+ * 	- add dE00 and pythagoras, from dE00.c and dE76.c
+ */
+
+/*
+
+	This file is part of VIPS.
+
+	VIPS is free software; you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+	02110-1301  USA
+
+ */
+
+/*
+
+	These files are distributed with VIPS - http://www.vips.ecs.soton.ac.uk
+
+ */
+
+/* The core transforms do the whole line, see below, so a pixel's value
+ * doesn't depend on where it is in the line. scRGB2XYZ and XYZ2scRGB only
+ * write the three colour bands, the caller does any extra bands. dE00 and
+ * pythagoras do as many whole vectors as they can and return the number of
+ * pixels they did, the caller finishes the line with the scalar code.
+ *
+ * Accuracy, measured against the scalar paths over the usual ranges:
+ *
+ * 	scRGB2XYZ, XYZ2scRGB: float rather than double arithmetic, relative
+ * 	error below 1e-6.
+ *
+ * 	XYZ2Lab: the same interpolated cbrt() table as the scalar path,
+ * 	gathered, in float rather than double arithmetic. Within 1e-4 of the
+ * 	scalar path.
+ *
+ * 	Lab2XYZ: float rather than double arithmetic, relative error below 1e-6.
+ *
+ * 	Lab2LCh: atan2() is built from Highway's Atan() (3 ULP) with octant
+ * 	reduction, h is within 1e-4 degrees of the scalar path.
+ *
+ * 	LCh2Lab: Highway Sin() and Cos() (3 ULP for |x| < 39000 radians), a and
+ * 	b within 1e-5 of the scalar path.
+ *
+ * 	dE00: float rather than double arithmetic, with the hue from Atan() as
+ * 	for Lab2LCh. Within 1e-3 dE of the scalar path.
+ *
+ * 	pythagoras (dE76 and dECMC): relative error below 1e-6.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif /*HAVE_CONFIG_H*/
+#include <glib/gi18n-lib.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include <vips/vips.h>
+#include <vips/vector.h>
+#include <vips/debug.h>
+#include <vips/internal.h>
+
+#include "pcolour.h"
+
+#ifdef HAVE_HWY
+
+#undef HWY_TARGET_INCLUDE
+#define HWY_TARGET_INCLUDE "libvips/colour/colour_hwy.cpp"
+#include <hwy/foreach_target.h>
+#include <hwy/highway.h>
+#include <hwy/contrib/math/math-inl.h>
+
+namespace HWY_NAMESPACE {
+
+using namespace hwy::HWY_NAMESPACE;
+
+using DF32 = ScalableTag<float>;
+constexpr DF32 df32;
+using VF32 = Vec<DF32>;
+
+/* Each kernel below works on one vector of pixels, for any D. The line
+ * functions run them on whole vectors, then finish the line one pixel at a
+ * time on single-lane vectors. The arithmetic is the same for every pixel,
+ * so results don't depend on x.
+ */
+
+/* Interpolate vips_cbrt_table[], as vips_col_XYZ2Lab_helper().
+ */
+template <class D>
+HWY_ATTR HWY_INLINE Vec<D>
+vips_colour_cbrt_hwy(D d, Vec<D> n)
+{
+	const RebindToSigned<D> di;
+
+	auto i = ConvertTo(di, n);
+	i = Min(Max(i, Zero(di)), Set(di, VIPS_XYZ2LAB_QUANT - 2));
+	const auto f = Sub(n, ConvertTo(d, i));
+	const auto t0 = GatherIndex(d, vips_cbrt_table, i);
+	const auto t1 = GatherIndex(d, vips_cbrt_table, Add(i, Set(di, 1)));
+
+	return Add(t0, Mul(f, Sub(t1, t0)));
+}
+
+/* Load and store the three colour bands of pixels @bands floats apart.
+ * Any extra bands are left for the caller.
+ */
+template <class D>
+HWY_ATTR HWY_INLINE void
+vips_colour_load3_hwy(D d, const float *HWY_RESTRICT p, int32_t bands,
+	Vec<D> &v0, Vec<D> &v1, Vec<D> &v2)
+{
+	if (bands == 3)
+		LoadInterleaved3(d, p, v0, v1, v2);
+	else {
+		const RebindToSigned<D> di;
+		const auto index = Mul(Iota(di, 0), Set(di, bands));
+
+		v0 = GatherIndex(d, p, index);
+		v1 = GatherIndex(d, p + 1, index);
+		v2 = GatherIndex(d, p + 2, index);
+	}
+}
+
+template <class D>
+HWY_ATTR HWY_INLINE void
+vips_colour_store3_hwy(D d, Vec<D> v0, Vec<D> v1, Vec<D> v2,
+	float *HWY_RESTRICT q, int32_t bands)
+{
+	if (bands == 3)
+		StoreInterleaved3(v0, v1, v2, d, q);
+	else {
+		const RebindToSigned<D> di;
+		const auto index = Mul(Iota(di, 0), Set(di, bands));
+
+		ScatterIndex(v0, d, q, index);
+		ScatterIndex(v1, d, q + 1, index);
+		ScatterIndex(v2, d, q + 2, index);
+	}
+}
+
+template <class D>
+HWY_ATTR HWY_INLINE void
+vips_scRGB2XYZ_pixels_hwy(D d, float *HWY_RESTRICT q,
+	const float *HWY_RESTRICT p, int32_t bands)
+{
+	const auto scale = Set(d, VIPS_D65_Y0);
+
+	Vec<D> R, G, B;
+
+	vips_colour_load3_hwy(d, p, bands, R, G, B);
+
+	R = Mul(R, scale);
+	G = Mul(G, scale);
+	B = Mul(B, scale);
+
+	const auto X = MulAdd(Set(d, 0.4124f), R,
+		MulAdd(Set(d, 0.3576f), G,
+			Mul(Set(d, 0.1805f), B)));
+	const auto Y = MulAdd(Set(d, 0.2126f), R,
+		MulAdd(Set(d, 0.7152f), G,
+			Mul(Set(d, 0.0722f), B)));
+	const auto Z = MulAdd(Set(d, 0.0193f), R,
+		MulAdd(Set(d, 0.1192f), G,
+			Mul(Set(d, 0.9505f), B)));
+
+	vips_colour_store3_hwy(d, X, Y, Z, q, bands);
+}
+
+HWY_ATTR void
+vips_scRGB2XYZ_hwy(float *HWY_RESTRICT q, const float *HWY_RESTRICT p,
+	int32_t extra_bands, int32_t width)
+{
+	const CappedTag<float, 1> d1;
+	const int32_t N = Lanes(df32);
+	const int32_t bands = 3 + extra_bands;
+
+	int32_t x;
+
+	for (x = 0; x + N <= width; x += N)
+		vips_scRGB2XYZ_pixels_hwy(df32,
+			q + bands * x, p + bands * x, bands);
+	for (; x < width; x++)
+		vips_scRGB2XYZ_pixels_hwy(d1,
+			q + bands * x, p + bands * x, bands);
+}
+
+template <class D>
+HWY_ATTR HWY_INLINE void
+vips_XYZ2scRGB_pixels_hwy(D d, float *HWY_RESTRICT q,
+	const float *HWY_RESTRICT p, int32_t bands)
+{
+	const auto scale = Set(d, 1.0f / VIPS_D65_Y0);
+
+	Vec<D> X, Y, Z;
+
+	vips_colour_load3_hwy(d, p, bands, X, Y, Z);
+
+	X = Mul(X, scale);
+	Y = Mul(Y, scale);
+	Z = Mul(Z, scale);
+
+	const auto R = MulAdd(Set(d, 3.240625f), X,
+		MulAdd(Set(d, -1.537208f), Y,
+			Mul(Set(d, -0.498629f), Z)));
+	const auto G = MulAdd(Set(d, -0.968931f), X,
+		MulAdd(Set(d, 1.875756f), Y,
+			Mul(Set(d, 0.041518f), Z)));
+	const auto B = MulAdd(Set(d, 0.055710f), X,
+		MulAdd(Set(d, -0.204021f), Y,
+			Mul(Set(d, 1.056996f), Z)));
+
+	vips_colour_store3_hwy(d, R, G, B, q, bands);
+}
+
+HWY_ATTR void
+vips_XYZ2scRGB_hwy(float *HWY_RESTRICT q, const float *HWY_RESTRICT p,
+	int32_t extra_bands, int32_t width)
+{
+	const CappedTag<float, 1> d1;
+	const int32_t N = Lanes(df32);
+	const int32_t bands = 3 + extra_bands;
+
+	int32_t x;
+
+	for (x = 0; x + N <= width; x += N)
+		vips_XYZ2scRGB_pixels_hwy(df32,
+			q + bands * x, p + bands * x, bands);
+	for (; x < width; x++)
+		vips_XYZ2scRGB_pixels_hwy(d1,
+			q + bands * x, p + bands * x, bands);
+}
+
+template <class D>
+HWY_ATTR HWY_INLINE void
+vips_XYZ2Lab_pixels_hwy(D d, float *HWY_RESTRICT q,
+	const float *HWY_RESTRICT p, float X0, float Y0, float Z0)
+{
+	const auto quant = Set(d, (float) VIPS_XYZ2LAB_QUANT);
+
+	Vec<D> X, Y, Z;
+
+	LoadInterleaved3(d, p, X, Y, Z);
+
+	const auto cbx = vips_colour_cbrt_hwy(d,
+		Div(Mul(quant, X), Set(d, X0)));
+	const auto cby = vips_colour_cbrt_hwy(d,
+		Div(Mul(quant, Y), Set(d, Y0)));
+	const auto cbz = vips_colour_cbrt_hwy(d,
+		Div(Mul(quant, Z), Set(d, Z0)));
+
+	const auto L = Sub(Mul(Set(d, 116.0f), cby), Set(d, 16.0f));
+	const auto a = Mul(Set(d, 500.0f), Sub(cbx, cby));
+	const auto b = Mul(Set(d, 200.0f), Sub(cby, cbz));
+
+	StoreInterleaved3(L, a, b, d, q);
+}
+
+HWY_ATTR void
+vips_XYZ2Lab_hwy(float *HWY_RESTRICT q, const float *HWY_RESTRICT p,
+	int32_t width, float X0, float Y0, float Z0)
+{
+	const CappedTag<float, 1> d1;
+	const int32_t N = Lanes(df32);
+
+	int32_t x;
+
+	for (x = 0; x + N <= width; x += N)
+		vips_XYZ2Lab_pixels_hwy(df32, q + 3 * x, p + 3 * x, X0, Y0, Z0);
+	for (; x < width; x++)
+		vips_XYZ2Lab_pixels_hwy(d1, q + 3 * x, p + 3 * x, X0, Y0, Z0);
+}
+
+template <class D>
+HWY_ATTR HWY_INLINE void
+vips_Lab2XYZ_pixels_hwy(D d, float *HWY_RESTRICT q,
+	const float *HWY_RESTRICT p, float X0, float Y0, float Z0)
+{
+	const auto knee = Set(d, 0.2069f);
+	const auto offset = Set(d, 16.0f / 116.0f);
+	const auto r7787 = Set(d, 1.0f / 7.787f);
+
+	Vec<D> L, a, b;
+
+	LoadInterleaved3(d, p, L, a, b);
+
+	/* Below L 8 we're on the linear part of the curve.
+	 */
+	const auto Ylin = Mul(L, Set(d, Y0 / 903.3f));
+	const auto cbylin = MulAdd(Set(d, 7.787f / Y0), Ylin, offset);
+	const auto cbycube = Mul(Add(L, Set(d, 16.0f)),
+		Set(d, 1.0f / 116.0f));
+	const auto Ycube = Mul(Set(d, Y0), Mul(cbycube, Mul(cbycube, cbycube)));
+	const auto low = Lt(L, Set(d, 8.0f));
+	const auto Y = IfThenElse(low, Ylin, Ycube);
+	const auto cby = IfThenElse(low, cbylin, cbycube);
+
+	auto tmp = MulAdd(a, Set(d, 1.0f / 500.0f), cby);
+	const auto X = IfThenElse(Lt(tmp, knee),
+		Mul(Set(d, X0), Mul(Sub(tmp, Set(d, 0.13793f)), r7787)),
+		Mul(Set(d, X0), Mul(tmp, Mul(tmp, tmp))));
+
+	tmp = NegMulAdd(b, Set(d, 1.0f / 200.0f), cby);
+	const auto Z = IfThenElse(Lt(tmp, knee),
+		Mul(Set(d, Z0), Mul(Sub(tmp, Set(d, 0.13793f)), r7787)),
+		Mul(Set(d, Z0), Mul(tmp, Mul(tmp, tmp))));
+
+	StoreInterleaved3(X, Y, Z, d, q);
+}
+
+HWY_ATTR void
+vips_Lab2XYZ_hwy(float *HWY_RESTRICT q, const float *HWY_RESTRICT p,
+	int32_t width, float X0, float Y0, float Z0)
+{
+	const CappedTag<float, 1> d1;
+	const int32_t N = Lanes(df32);
+
+	int32_t x;
+
+	for (x = 0; x + N <= width; x += N)
+		vips_Lab2XYZ_pixels_hwy(df32, q + 3 * x, p + 3 * x, X0, Y0, Z0);
+	for (; x < width; x++)
+		vips_Lab2XYZ_pixels_hwy(d1, q + 3 * x, p + 3 * x, X0, Y0, Z0);
+}
+
+/* Hue in degrees, 0 - 360, as vips_col_ab2h(). This is atan2(b, a),
+ * reduced to atan() of [0, 1]. a == b == 0 gives 0.
+ */
+template <class D>
+HWY_ATTR HWY_INLINE Vec<D>
+vips_colour_ab2h_hwy(D d, Vec<D> a, Vec<D> b)
+{
+	const auto zero = Zero(d);
+
+	const auto aa = Abs(a);
+	const auto ab = Abs(b);
+	const auto mx = Max(aa, ab);
+	const auto mn = Min(aa, ab);
+	const auto r = IfThenElse(Eq(mx, zero), zero, Div(mn, mx));
+
+	auto t = Atan(d, r);
+	t = IfThenElse(Gt(ab, aa), Sub(Set(d, VIPS_PI / 2.0), t), t);
+	t = IfThenElse(Lt(a, zero), Sub(Set(d, VIPS_PI), t), t);
+	t = IfThenElse(Lt(b, zero), Neg(t), t);
+
+	auto h = Mul(t, Set(d, 180.0 / VIPS_PI));
+
+	return IfThenElse(Lt(h, zero), Add(h, Set(d, 360.0f)), h);
+}
+
+template <class D>
+HWY_ATTR HWY_INLINE void
+vips_Lab2LCh_pixels_hwy(D d, float *HWY_RESTRICT q,
+	const float *HWY_RESTRICT p)
+{
+	Vec<D> L, a, b;
+
+	LoadInterleaved3(d, p, L, a, b);
+
+	const auto C = Sqrt(MulAdd(a, a, Mul(b, b)));
+	const auto h = vips_colour_ab2h_hwy(d, a, b);
+
+	StoreInterleaved3(L, C, h, d, q);
+}
+
+HWY_ATTR void
+vips_Lab2LCh_hwy(float *HWY_RESTRICT q, const float *HWY_RESTRICT p,
+	int32_t width)
+{
+	const CappedTag<float, 1> d1;
+	const int32_t N = Lanes(df32);
+
+	int32_t x;
+
+	for (x = 0; x + N <= width; x += N)
+		vips_Lab2LCh_pixels_hwy(df32, q + 3 * x, p + 3 * x);
+	for (; x < width; x++)
+		vips_Lab2LCh_pixels_hwy(d1, q + 3 * x, p + 3 * x);
+}
+
+template <class D>
+HWY_ATTR HWY_INLINE void
+vips_LCh2Lab_pixels_hwy(D d, float *HWY_RESTRICT q,
+	const float *HWY_RESTRICT p)
+{
+	Vec<D> L, C, h;
+
+	LoadInterleaved3(d, p, L, C, h);
+
+	const auto rad = Mul(h, Set(d, VIPS_PI / 180.0));
+	const auto a = Mul(C, Cos(d, rad));
+	const auto b = Mul(C, Sin(d, rad));
+
+	StoreInterleaved3(L, a, b, d, q);
+}
+
+HWY_ATTR void
+vips_LCh2Lab_hwy(float *HWY_RESTRICT q, const float *HWY_RESTRICT p,
+	int32_t width)
+{
+	const CappedTag<float, 1> d1;
+	const int32_t N = Lanes(df32);
+
+	int32_t x;
+
+	for (x = 0; x + N <= width; x += N)
+		vips_LCh2Lab_pixels_hwy(df32, q + 3 * x, p + 3 * x);
+	for (; x < width; x++)
+		vips_LCh2Lab_pixels_hwy(d1, q + 3 * x, p + 3 * x);
+}
+
+/* Cb ** 7 / (Cb ** 7 + 25 ** 7), the chroma weight in dE00.
+ */
+HWY_ATTR HWY_INLINE VF32
+vips_colour_dE00_c7_hwy(VF32 Cb)
+{
+	const auto Cb2 = Mul(Cb, Cb);
+	const auto Cb4 = Mul(Cb2, Cb2);
+	const auto Cb7 = Mul(Mul(Cb4, Cb2), Cb);
+
+	return Div(Cb7, Add(Cb7, Set(df32, 6103515625.0f)));
+}
+
+/* cos() of an angle in degrees.
+ */
+HWY_ATTR HWY_INLINE VF32
+vips_colour_cosd_hwy(VF32 d)
+{
+	return Cos(df32, Mul(d, Set(df32, VIPS_PI / 180.0)));
+}
+
+HWY_ATTR HWY_INLINE VF32
+vips_colour_sind_hwy(VF32 d)
+{
+	return Sin(df32, Mul(d, Set(df32, VIPS_PI / 180.0)));
+}
+
+/* As vips_col_dE00(), see there for notes.
+ */
+HWY_ATTR int32_t
+vips_dE00_hwy(float *HWY_RESTRICT q,
+	const float *HWY_RESTRICT p1, const float *HWY_RESTRICT p2,
+	int32_t width)
+{
+	const int32_t N = Lanes(df32);
+	const auto one = Set(df32, 1.0f);
+	const auto half = Set(df32, 0.5f);
+	const auto d180 = Set(df32, 180.0f);
+	const auto d360 = Set(df32, 360.0f);
+
+	int32_t x;
+
+	for (x = 0; x + N <= width; x += N) {
+		VF32 L1, a1, b1;
+		VF32 L2, a2, b2;
+
+		LoadInterleaved3(df32, p1 + 3 * x, L1, a1, b1);
+		LoadInterleaved3(df32, p2 + 3 * x, L2, a2, b2);
+
+		/* Chroma and mean chroma, then G.
+		 */
+		const auto C1 = Sqrt(MulAdd(a1, a1, Mul(b1, b1)));
+		const auto C2 = Sqrt(MulAdd(a2, a2, Mul(b2, b2)));
+		const auto Cb = Mul(Add(C1, C2), half);
+		const auto G = Mul(half,
+			Sub(one, Sqrt(vips_colour_dE00_c7_hwy(Cb))));
+
+		/* a', C', h'. L' and b' are unchanged.
+		 */
+		const auto a1d = Mul(Add(one, G), a1);
+		const auto a2d = Mul(Add(one, G), a2);
+		const auto C1d = Sqrt(MulAdd(a1d, a1d, Mul(b1, b1)));
+		const auto C2d = Sqrt(MulAdd(a2d, a2d, Mul(b2, b2)));
+		const auto h1d = vips_colour_ab2h_hwy(df32, a1d, b1);
+		const auto h2d = vips_colour_ab2h_hwy(df32, a2d, b2);
+
+		/* L' bar, C' bar, h' bar.
+		 */
+		const auto Ldb = Mul(Add(L1, L2), half);
+		const auto Cdb = Mul(Add(C1d, C2d), half);
+		const auto dh = Sub(h1d, h2d);
+		const auto small_dh = Lt(Abs(dh), d180);
+		const auto hdb = IfThenElse(small_dh,
+			Mul(Add(h1d, h2d), half),
+			Mul(Abs(Sub(Add(h1d, h2d), d360)), half));
+
+		/* dtheta, RC, RT.
+		 */
+		const auto hdbd = Div(Sub(hdb, Set(df32, 275.0f)),
+			Set(df32, 25.0f));
+		/* exp() underflows to 0 long before -80.
+		 */
+		const auto dtheta = Mul(Set(df32, 30.0f),
+			Exp(df32, Max(Neg(Mul(hdbd, hdbd)), Set(df32, -80.0f))));
+		const auto RC = Mul(Set(df32, 2.0f),
+			Sqrt(vips_colour_dE00_c7_hwy(Cdb)));
+		const auto RT = Neg(Mul(
+			vips_colour_sind_hwy(Add(dtheta, dtheta)), RC));
+
+		/* T.
+		 */
+		auto T = NegMulAdd(Set(df32, 0.17f),
+			vips_colour_cosd_hwy(Sub(hdb, Set(df32, 30.0f))), one);
+		T = MulAdd(Set(df32, 0.24f),
+			vips_colour_cosd_hwy(Add(hdb, hdb)), T);
+		T = MulAdd(Set(df32, 0.32f),
+			vips_colour_cosd_hwy(MulAdd(Set(df32, 3.0f), hdb,
+				Set(df32, 6.0f))),
+			T);
+		T = NegMulAdd(Set(df32, 0.20f),
+			vips_colour_cosd_hwy(MulAdd(Set(df32, 4.0f), hdb,
+				Set(df32, -63.0f))),
+			T);
+
+		/* SL, SC, SH.
+		 */
+		const auto Ldb50 = Sub(Ldb, Set(df32, 50.0f));
+		const auto Ldb502 = Mul(Ldb50, Ldb50);
+		const auto SL = Add(one,
+			Div(Mul(Set(df32, 0.015f), Ldb502),
+				Sqrt(Add(Set(df32, 20.0f), Ldb502))));
+		const auto SC = MulAdd(Set(df32, 0.045f), Cdb, one);
+		const auto SH = MulAdd(Mul(Set(df32, 0.015f), Cdb), T, one);
+
+		/* Hue difference.
+		 */
+		const auto dhd = IfThenElse(small_dh, dh, Sub(d360, dh));
+
+		const auto dLd = Sub(L1, L2);
+		const auto dCd = Sub(C1d, C2d);
+		const auto dHd = Mul(Mul(Set(df32, 2.0f), Sqrt(Mul(C1d, C2d))),
+			vips_colour_sind_hwy(Mul(dhd, half)));
+
+		/* Normalised terms, with kL == kC == kH == 1.
+		 */
+		const auto nL = Div(dLd, SL);
+		const auto nC = Div(dCd, SC);
+		const auto nH = Div(dHd, SH);
+
+		auto sum = Mul(nL, nL);
+		sum = MulAdd(nC, nC, sum);
+		sum = MulAdd(nH, nH, sum);
+		sum = MulAdd(Mul(RT, nC), nH, sum);
+
+		Store(Sqrt(sum), df32, q + x);
+	}
+
+	return x;
+}
+
+HWY_ATTR int32_t
+vips_pythagoras_hwy(float *HWY_RESTRICT q,
+	const float *HWY_RESTRICT p1, const float *HWY_RESTRICT p2,
+	int32_t width)
+{
+	const int32_t N = Lanes(df32);
+
+	int32_t x;
+
+	for (x = 0; x + N <= width; x += N) {
+		VF32 L1, a1, b1;
+		VF32 L2, a2, b2;
+
+		LoadInterleaved3(df32, p1 + 3 * x, L1, a1, b1);
+		LoadInterleaved3(df32, p2 + 3 * x, L2, a2, b2);
+
+		const auto dL = Sub(L1, L2);
+		const auto da = Sub(a1, a2);
+		const auto db = Sub(b1, b2);
+
+		Store(Sqrt(MulAdd(dL, dL, MulAdd(da, da, Mul(db, db)))),
+			df32, q + x);
+	}
+
+	return x;
+}
+
+} /*namespace HWY_NAMESPACE*/
+
+#if HWY_ONCE
+HWY_EXPORT(vips_scRGB2XYZ_hwy);
+HWY_EXPORT(vips_XYZ2scRGB_hwy);
+HWY_EXPORT(vips_XYZ2Lab_hwy);
+HWY_EXPORT(vips_Lab2XYZ_hwy);
+HWY_EXPORT(vips_Lab2LCh_hwy);
+HWY_EXPORT(vips_LCh2Lab_hwy);
+HWY_EXPORT(vips_dE00_hwy);
+HWY_EXPORT(vips_pythagoras_hwy);
+
+void
+vips_scRGB2XYZ_hwy(float *restrict q, const float *restrict p,
+	int extra_bands, int width)
+{
+	/* clang-format off */
+	HWY_DYNAMIC_DISPATCH(vips_scRGB2XYZ_hwy)(q, p,
+		extra_bands, width);
+	/* clang-format on */
+}
+
+void
+vips_XYZ2scRGB_hwy(float *restrict q, const float *restrict p,
+	int extra_bands, int width)
+{
+	/* clang-format off */
+	HWY_DYNAMIC_DISPATCH(vips_XYZ2scRGB_hwy)(q, p,
+		extra_bands, width);
+	/* clang-format on */
+}
+
+void
+vips_XYZ2Lab_hwy(float *restrict q, const float *restrict p, int width,
+	float X0, float Y0, float Z0)
+{
+	/* clang-format off */
+	HWY_DYNAMIC_DISPATCH(vips_XYZ2Lab_hwy)(q, p, width,
+		X0, Y0, Z0);
+	/* clang-format on */
+}
+
+void
+vips_Lab2XYZ_hwy(float *restrict q, const float *restrict p, int width,
+	float X0, float Y0, float Z0)
+{
+	/* clang-format off */
+	HWY_DYNAMIC_DISPATCH(vips_Lab2XYZ_hwy)(q, p, width,
+		X0, Y0, Z0);
+	/* clang-format on */
+}
+
+void
+vips_Lab2LCh_hwy(float *restrict q, const float *restrict p, int width)
+{
+	/* clang-format off */
+	HWY_DYNAMIC_DISPATCH(vips_Lab2LCh_hwy)(q, p, width);
+	/* clang-format on */
+}
+
+void
+vips_LCh2Lab_hwy(float *restrict q, const float *restrict p, int width)
+{
+	/* clang-format off */
+	HWY_DYNAMIC_DISPATCH(vips_LCh2Lab_hwy)(q, p, width);
+	/* clang-format on */
+}
+
+int
+vips_dE00_hwy(float *restrict q,
+	const float *restrict p1, const float *restrict p2, int width)
+{
+	/* clang-format off */
+	return HWY_DYNAMIC_DISPATCH(vips_dE00_hwy)(q, p1, p2, width);
+	/* clang-format on */
+}
+
+int
+vips_pythagoras_hwy(float *restrict q,
+	const float *restrict p1, const float *restrict p2, int width)
+{
+	/* clang-format off */
+	return HWY_DYNAMIC_DISPATCH(vips_pythagoras_hwy)(q, p1, p2, width);
+	/* clang-format on */
+}
+#endif /*HWY_ONCE*/
+
+#endif /*HAVE_HWY*/
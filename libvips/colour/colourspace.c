@@ -21,6 +21,10 @@
  * 	  https://github.com/lovell/sharp/issues/193
  * 27/12/18
  * 	- add CMYK conversions
+ * 19/10/26
+ * 	- use fused sRGB -> Lab, Lab -> sRGB and sRGB -> BW steps, so the common
+ * 	  routes make one pass over the image rather than three or four
+ * 	- also fuse Lab -> B_W and Lab -> GREY16
  */
 
 /*
@@ -80,6 +84,24 @@ vips_scRGB2BW16(VipsImage *in, VipsImage **out, ...)
 	return vips_scRGB2BW(in, out, "depth", 16, NULL);
 }
 
+static int
+vips_Lab2RGB16(VipsImage *in, VipsImage **out, ...)
+{
+	return vips_Lab2sRGB(in, out, "depth", 16, NULL);
+}
+
+static int
+vips_Lab2GREY16(VipsImage *in, VipsImage **out, ...)
+{
+	return vips_Lab2BW(in, out, "depth", 16, NULL);
+}
+
+static int
+vips_sRGB2BW16(VipsImage *in, VipsImage **out, ...)
+{
+	return vips_sRGB2BW(in, out, "depth", 16, NULL);
+}
+
 /* Do these two with a simple cast ... since we're just cast shifting, we can
  * short-circuit the extra band processing.
  */
@@ -240,11 +262,11 @@ static VipsColourRoute vips_colour_routes[] = {
 	{ LAB, LABS, { vips_Lab2LabS, NULL } },
 	{ LAB, CMYK, { vips_Lab2XYZ, vips_XYZ2CMYK, NULL } },
 	{ LAB, scRGB, { vips_Lab2XYZ, vips_XYZ2scRGB, NULL } },
-	{ LAB, sRGB, { vips_Lab2XYZ, vips_XYZ2scRGB, vips_scRGB2sRGB, NULL } },
-	{ LAB, HSV, { vips_Lab2XYZ, vips_XYZ2scRGB, vips_scRGB2sRGB, vips_sRGB2HSV, NULL } },
-	{ LAB, BW, { vips_Lab2XYZ, vips_XYZ2scRGB, vips_scRGB2BW, NULL } },
-	{ LAB, RGB16, { vips_Lab2XYZ, vips_XYZ2scRGB, vips_scRGB2RGB16, NULL } },
-	{ LAB, GREY16, { vips_Lab2XYZ, vips_XYZ2scRGB, vips_scRGB2BW16, NULL } },
+	{ LAB, sRGB, { vips_Lab2sRGB, NULL } },
+	{ LAB, HSV, { vips_Lab2sRGB, vips_sRGB2HSV, NULL } },
+	{ LAB, BW, { vips_Lab2BW, NULL } },
+	{ LAB, RGB16, { vips_Lab2RGB16, NULL } },
+	{ LAB, GREY16, { vips_Lab2GREY16, NULL } },
 	{ LAB, YXY, { vips_Lab2XYZ, vips_XYZ2Yxy, NULL } },
 
 	{ LABQ, XYZ, { vips_LabQ2Lab, vips_Lab2XYZ, NULL } },
@@ -256,9 +278,9 @@ static VipsColourRoute vips_colour_routes[] = {
 	{ LABQ, scRGB, { vips_LabQ2Lab, vips_Lab2XYZ, vips_XYZ2scRGB, NULL } },
 	{ LABQ, sRGB, { vips_LabQ2sRGB, NULL } },
 	{ LABQ, HSV, { vips_LabQ2sRGB, vips_sRGB2HSV, NULL } },
-	{ LABQ, BW, { vips_LabQ2Lab, vips_Lab2XYZ, vips_XYZ2scRGB, vips_scRGB2BW, NULL } },
-	{ LABQ, RGB16, { vips_LabQ2Lab, vips_Lab2XYZ, vips_XYZ2scRGB, vips_scRGB2RGB16, NULL } },
-	{ LABQ, GREY16, { vips_LabQ2Lab, vips_Lab2XYZ, vips_XYZ2scRGB, vips_scRGB2BW16, NULL } },
+	{ LABQ, BW, { vips_LabQ2Lab, vips_Lab2BW, NULL } },
+	{ LABQ, RGB16, { vips_LabQ2Lab, vips_Lab2RGB16, NULL } },
+	{ LABQ, GREY16, { vips_LabQ2Lab, vips_Lab2GREY16, NULL } },
 	{ LABQ, YXY, { vips_LabQ2Lab, vips_Lab2XYZ, vips_XYZ2Yxy, NULL } },
 
 	{ LCH, XYZ, { vips_LCh2Lab, vips_Lab2XYZ, NULL } },
@@ -268,11 +290,11 @@ static VipsColourRoute vips_colour_routes[] = {
 	{ LCH, LABS, { vips_LCh2Lab, vips_Lab2LabS, NULL } },
 	{ LCH, CMYK, { vips_LCh2Lab, vips_Lab2XYZ, vips_XYZ2CMYK, NULL } },
 	{ LCH, scRGB, { vips_LCh2Lab, vips_Lab2XYZ, vips_XYZ2scRGB, NULL } },
-	{ LCH, sRGB, { vips_LCh2Lab, vips_Lab2XYZ, vips_XYZ2scRGB, vips_scRGB2sRGB, NULL } },
-	{ LCH, HSV, { vips_LCh2Lab, vips_Lab2XYZ, vips_XYZ2scRGB, vips_scRGB2sRGB, vips_sRGB2HSV, NULL } },
-	{ LCH, BW, { vips_LCh2Lab, vips_Lab2XYZ, vips_XYZ2scRGB, vips_scRGB2BW, NULL } },
-	{ LCH, RGB16, { vips_LCh2Lab, vips_Lab2XYZ, vips_XYZ2scRGB, vips_scRGB2RGB16, NULL } },
-	{ LCH, GREY16, { vips_LCh2Lab, vips_Lab2XYZ, vips_XYZ2scRGB, vips_scRGB2BW16, NULL } },
+	{ LCH, sRGB, { vips_LCh2Lab, vips_Lab2sRGB, NULL } },
+	{ LCH, HSV, { vips_LCh2Lab, vips_Lab2sRGB, vips_sRGB2HSV, NULL } },
+	{ LCH, BW, { vips_LCh2Lab, vips_Lab2BW, NULL } },
+	{ LCH, RGB16, { vips_LCh2Lab, vips_Lab2RGB16, NULL } },
+	{ LCH, GREY16, { vips_LCh2Lab, vips_Lab2GREY16, NULL } },
 	{ LCH, YXY, { vips_LCh2Lab, vips_Lab2XYZ, vips_XYZ2Yxy, NULL } },
 
 	{ CMC, XYZ, { vips_CMC2LCh, vips_LCh2Lab, vips_Lab2XYZ, NULL } },
@@ -282,11 +304,11 @@ static VipsColourRoute vips_colour_routes[] = {
 	{ CMC, LABS, { vips_CMC2LCh, vips_LCh2Lab, vips_Lab2LabS, NULL } },
 	{ CMC, CMYK, { vips_CMC2LCh, vips_LCh2Lab, vips_Lab2XYZ, vips_XYZ2CMYK, NULL } },
 	{ CMC, scRGB, { vips_CMC2LCh, vips_LCh2Lab, vips_Lab2XYZ, vips_XYZ2scRGB, NULL } },
-	{ CMC, sRGB, { vips_CMC2LCh, vips_LCh2Lab, vips_Lab2XYZ, vips_XYZ2scRGB, vips_scRGB2sRGB, NULL } },
-	{ CMC, HSV, { vips_CMC2LCh, vips_LCh2Lab, vips_Lab2XYZ, vips_XYZ2scRGB, vips_scRGB2sRGB, vips_sRGB2HSV, NULL } },
-	{ CMC, BW, { vips_CMC2LCh, vips_LCh2Lab, vips_Lab2XYZ, vips_XYZ2scRGB, vips_scRGB2BW, NULL } },
-	{ CMC, RGB16, { vips_CMC2LCh, vips_LCh2Lab, vips_Lab2XYZ, vips_XYZ2scRGB, vips_scRGB2RGB16, NULL } },
-	{ CMC, GREY16, { vips_CMC2LCh, vips_LCh2Lab, vips_Lab2XYZ, vips_XYZ2scRGB, vips_scRGB2BW16, NULL } },
+	{ CMC, sRGB, { vips_CMC2LCh, vips_LCh2Lab, vips_Lab2sRGB, NULL } },
+	{ CMC, HSV, { vips_CMC2LCh, vips_LCh2Lab, vips_Lab2sRGB, vips_sRGB2HSV, NULL } },
+	{ CMC, BW, { vips_CMC2LCh, vips_LCh2Lab, vips_Lab2BW, NULL } },
+	{ CMC, RGB16, { vips_CMC2LCh, vips_LCh2Lab, vips_Lab2RGB16, NULL } },
+	{ CMC, GREY16, { vips_CMC2LCh, vips_LCh2Lab, vips_Lab2GREY16, NULL } },
 	{ CMC, YXY, { vips_CMC2LCh, vips_LCh2Lab, vips_Lab2XYZ, vips_XYZ2Yxy, NULL } },
 
 	{ LABS, XYZ, { vips_LabS2Lab, vips_Lab2XYZ, NULL } },
@@ -296,11 +318,11 @@ static VipsColourRoute vips_colour_routes[] = {
 	{ LABS, CMC, { vips_LabS2Lab, vips_Lab2LCh, vips_LCh2CMC, NULL } },
 	{ LABS, CMYK, { vips_LabS2Lab, vips_Lab2XYZ, vips_XYZ2CMYK, NULL } },
 	{ LABS, scRGB, { vips_LabS2Lab, vips_Lab2XYZ, vips_XYZ2scRGB, NULL } },
-	{ LABS, sRGB, { vips_LabS2Lab, vips_Lab2XYZ, vips_XYZ2scRGB, vips_scRGB2sRGB, NULL } },
-	{ LABS, HSV, { vips_LabS2Lab, vips_Lab2XYZ, vips_XYZ2scRGB, vips_scRGB2sRGB, vips_sRGB2HSV, NULL } },
-	{ LABS, BW, { vips_LabS2Lab, vips_Lab2XYZ, vips_XYZ2scRGB, vips_scRGB2BW, NULL } },
-	{ LABS, RGB16, { vips_LabS2Lab, vips_Lab2XYZ, vips_XYZ2scRGB, vips_scRGB2RGB16, NULL } },
-	{ LABS, GREY16, { vips_LabS2Lab, vips_Lab2XYZ, vips_XYZ2scRGB, vips_scRGB2BW16, NULL } },
+	{ LABS, sRGB, { vips_LabS2Lab, vips_Lab2sRGB, NULL } },
+	{ LABS, HSV, { vips_LabS2Lab, vips_Lab2sRGB, vips_sRGB2HSV, NULL } },
+	{ LABS, BW, { vips_LabS2Lab, vips_Lab2BW, NULL } },
+	{ LABS, RGB16, { vips_LabS2Lab, vips_Lab2RGB16, NULL } },
+	{ LABS, GREY16, { vips_LabS2Lab, vips_Lab2GREY16, NULL } },
 	{ LABS, YXY, { vips_LabS2Lab, vips_Lab2XYZ, vips_XYZ2Yxy, NULL } },
 
 	{ scRGB, XYZ, { vips_scRGB2XYZ, NULL } },
@@ -332,73 +354,73 @@ static VipsColourRoute vips_colour_routes[] = {
 	{ CMYK, YXY, { vips_CMYK2XYZ, vips_XYZ2Yxy, NULL } },
 
 	{ sRGB, XYZ, { vips_sRGB2scRGB, vips_scRGB2XYZ, NULL } },
-	{ sRGB, LAB, { vips_sRGB2scRGB, vips_scRGB2XYZ, vips_XYZ2Lab, NULL } },
-	{ sRGB, LABQ, { vips_sRGB2scRGB, vips_scRGB2XYZ, vips_XYZ2Lab, vips_Lab2LabQ, NULL } },
-	{ sRGB, LCH, { vips_sRGB2scRGB, vips_scRGB2XYZ, vips_XYZ2Lab, vips_Lab2LCh, NULL } },
-	{ sRGB, CMC, { vips_sRGB2scRGB, vips_scRGB2XYZ, vips_XYZ2Lab, vips_Lab2LCh, vips_LCh2CMC, NULL } },
+	{ sRGB, LAB, { vips_sRGB2Lab, NULL } },
+	{ sRGB, LABQ, { vips_sRGB2Lab, vips_Lab2LabQ, NULL } },
+	{ sRGB, LCH, { vips_sRGB2Lab, vips_Lab2LCh, NULL } },
+	{ sRGB, CMC, { vips_sRGB2Lab, vips_Lab2LCh, vips_LCh2CMC, NULL } },
 	{ sRGB, CMYK, { vips_sRGB2scRGB, vips_scRGB2XYZ, vips_XYZ2CMYK, NULL } },
 	{ sRGB, scRGB, { vips_sRGB2scRGB, NULL } },
 	{ sRGB, HSV, { vips_sRGB2HSV, NULL } },
-	{ sRGB, BW, { vips_sRGB2scRGB, vips_scRGB2BW, NULL } },
-	{ sRGB, LABS, { vips_sRGB2scRGB, vips_scRGB2XYZ, vips_XYZ2Lab, vips_Lab2LabS, NULL } },
+	{ sRGB, BW, { vips_sRGB2BW, NULL } },
+	{ sRGB, LABS, { vips_sRGB2Lab, vips_Lab2LabS, NULL } },
 	{ sRGB, RGB16, { vips_sRGB2RGB16, NULL } },
-	{ sRGB, GREY16, { vips_sRGB2scRGB, vips_scRGB2BW16, NULL } },
+	{ sRGB, GREY16, { vips_sRGB2BW16, NULL } },
 	{ sRGB, YXY, { vips_sRGB2scRGB, vips_scRGB2XYZ, vips_XYZ2Yxy, NULL } },
 
 	{ HSV, XYZ, { vips_HSV2sRGB, vips_sRGB2scRGB, vips_scRGB2XYZ, NULL } },
-	{ HSV, LAB, { vips_HSV2sRGB, vips_sRGB2scRGB, vips_scRGB2XYZ, vips_XYZ2Lab, NULL } },
-	{ HSV, LABQ, { vips_HSV2sRGB, vips_sRGB2scRGB, vips_scRGB2XYZ, vips_XYZ2Lab, vips_Lab2LabQ, NULL } },
-	{ HSV, LCH, { vips_HSV2sRGB, vips_sRGB2scRGB, vips_scRGB2XYZ, vips_XYZ2Lab, vips_Lab2LCh, NULL } },
-	{ HSV, CMC, { vips_HSV2sRGB, vips_sRGB2scRGB, vips_scRGB2XYZ, vips_XYZ2Lab, vips_Lab2LCh, vips_LCh2CMC, NULL } },
+	{ HSV, LAB, { vips_HSV2sRGB, vips_sRGB2Lab, NULL } },
+	{ HSV, LABQ, { vips_HSV2sRGB, vips_sRGB2Lab, vips_Lab2LabQ, NULL } },
+	{ HSV, LCH, { vips_HSV2sRGB, vips_sRGB2Lab, vips_Lab2LCh, NULL } },
+	{ HSV, CMC, { vips_HSV2sRGB, vips_sRGB2Lab, vips_Lab2LCh, vips_LCh2CMC, NULL } },
 	{ HSV, CMYK, { vips_HSV2sRGB, vips_sRGB2scRGB, vips_scRGB2XYZ, vips_XYZ2CMYK, NULL } },
 	{ HSV, scRGB, { vips_HSV2sRGB, vips_sRGB2scRGB, NULL } },
 	{ HSV, sRGB, { vips_HSV2sRGB, NULL } },
-	{ HSV, BW, { vips_HSV2sRGB, vips_sRGB2scRGB, vips_scRGB2BW, NULL } },
-	{ HSV, LABS, { vips_HSV2sRGB, vips_sRGB2scRGB, vips_scRGB2XYZ, vips_XYZ2Lab, vips_Lab2LabS, NULL } },
+	{ HSV, BW, { vips_HSV2sRGB, vips_sRGB2BW, NULL } },
+	{ HSV, LABS, { vips_HSV2sRGB, vips_sRGB2Lab, vips_Lab2LabS, NULL } },
 	{ HSV, RGB16, { vips_HSV2sRGB, vips_sRGB2RGB16, NULL } },
-	{ HSV, GREY16, { vips_HSV2sRGB, vips_sRGB2scRGB, vips_scRGB2BW16, NULL } },
+	{ HSV, GREY16, { vips_HSV2sRGB, vips_sRGB2BW16, NULL } },
 	{ HSV, YXY, { vips_HSV2sRGB, vips_sRGB2scRGB, vips_scRGB2XYZ, vips_XYZ2Yxy, NULL } },
 
 	{ RGB16, XYZ, { vips_sRGB2scRGB, vips_scRGB2XYZ, NULL } },
-	{ RGB16, LAB, { vips_sRGB2scRGB, vips_scRGB2XYZ, vips_XYZ2Lab, NULL } },
-	{ RGB16, LABQ, { vips_sRGB2scRGB, vips_scRGB2XYZ, vips_XYZ2Lab, vips_Lab2LabQ, NULL } },
-	{ RGB16, LCH, { vips_sRGB2scRGB, vips_scRGB2XYZ, vips_XYZ2Lab, vips_Lab2LCh, NULL } },
-	{ RGB16, CMC, { vips_sRGB2scRGB, vips_scRGB2XYZ, vips_XYZ2Lab, vips_Lab2LCh, vips_LCh2CMC, NULL } },
+	{ RGB16, LAB, { vips_sRGB2Lab, NULL } },
+	{ RGB16, LABQ, { vips_sRGB2Lab, vips_Lab2LabQ, NULL } },
+	{ RGB16, LCH, { vips_sRGB2Lab, vips_Lab2LCh, NULL } },
+	{ RGB16, CMC, { vips_sRGB2Lab, vips_Lab2LCh, vips_LCh2CMC, NULL } },
 	{ RGB16, CMYK, { vips_sRGB2scRGB, vips_scRGB2XYZ, vips_XYZ2CMYK, NULL } },
 	{ RGB16, scRGB, { vips_sRGB2scRGB, NULL } },
 	{ RGB16, sRGB, { vips_RGB162sRGB, NULL } },
 	{ RGB16, HSV, { vips_RGB162sRGB, vips_sRGB2HSV, NULL } },
-	{ RGB16, BW, { vips_sRGB2scRGB, vips_scRGB2BW, NULL } },
-	{ RGB16, LABS, { vips_sRGB2scRGB, vips_scRGB2XYZ, vips_XYZ2Lab, vips_Lab2LabS, NULL } },
-	{ RGB16, GREY16, { vips_sRGB2scRGB, vips_scRGB2BW16, NULL } },
+	{ RGB16, BW, { vips_sRGB2BW, NULL } },
+	{ RGB16, LABS, { vips_sRGB2Lab, vips_Lab2LabS, NULL } },
+	{ RGB16, GREY16, { vips_sRGB2BW16, NULL } },
 	{ RGB16, YXY, { vips_sRGB2scRGB, vips_scRGB2XYZ, vips_XYZ2Yxy, NULL } },
 
 	{ GREY16, XYZ, { vips_GREY162RGB16, vips_sRGB2scRGB, vips_scRGB2XYZ, NULL } },
-	{ GREY16, LAB, { vips_GREY162RGB16, vips_sRGB2scRGB, vips_scRGB2XYZ, vips_XYZ2Lab, NULL } },
-	{ GREY16, LABQ, { vips_GREY162RGB16, vips_sRGB2scRGB, vips_scRGB2XYZ, vips_XYZ2Lab, vips_Lab2LabQ, NULL } },
-	{ GREY16, LCH, { vips_GREY162RGB16, vips_sRGB2scRGB, vips_scRGB2XYZ, vips_XYZ2Lab, vips_Lab2LCh, NULL } },
-	{ GREY16, CMC, { vips_GREY162RGB16, vips_sRGB2scRGB, vips_scRGB2XYZ, vips_XYZ2Lab, vips_Lab2LCh, vips_LCh2CMC, NULL } },
+	{ GREY16, LAB, { vips_GREY162RGB16, vips_sRGB2Lab, NULL } },
+	{ GREY16, LABQ, { vips_GREY162RGB16, vips_sRGB2Lab, vips_Lab2LabQ, NULL } },
+	{ GREY16, LCH, { vips_GREY162RGB16, vips_sRGB2Lab, vips_Lab2LCh, NULL } },
+	{ GREY16, CMC, { vips_GREY162RGB16, vips_sRGB2Lab, vips_Lab2LCh, vips_LCh2CMC, NULL } },
 	{ GREY16, CMYK, { vips_GREY162RGB16, vips_sRGB2scRGB, vips_scRGB2XYZ, vips_XYZ2CMYK, NULL } },
 	{ GREY16, scRGB, { vips_GREY162RGB16, vips_sRGB2scRGB, NULL } },
 	{ GREY16, sRGB, { vips_GREY162RGB16, vips_RGB162sRGB, NULL } },
 	{ GREY16, HSV, { vips_GREY162RGB16, vips_RGB162sRGB, vips_sRGB2HSV, NULL } },
-	{ GREY16, BW, { vips_GREY162RGB16, vips_sRGB2scRGB, vips_scRGB2BW, NULL } },
-	{ GREY16, LABS, { vips_GREY162RGB16, vips_sRGB2scRGB, vips_scRGB2XYZ, vips_XYZ2Lab, vips_Lab2LabS, NULL } },
+	{ GREY16, BW, { vips_GREY162RGB16, vips_sRGB2BW, NULL } },
+	{ GREY16, LABS, { vips_GREY162RGB16, vips_sRGB2Lab, vips_Lab2LabS, NULL } },
 	{ GREY16, RGB16, { vips_GREY162RGB16, NULL } },
 	{ GREY16, YXY, { vips_GREY162RGB16, vips_sRGB2scRGB, vips_scRGB2XYZ, vips_XYZ2Yxy, NULL } },
 
 	{ BW, XYZ, { vips_BW2sRGB, vips_sRGB2scRGB, vips_scRGB2XYZ, NULL } },
-	{ BW, LAB, { vips_BW2sRGB, vips_sRGB2scRGB, vips_scRGB2XYZ, vips_XYZ2Lab, NULL } },
-	{ BW, LABQ, { vips_BW2sRGB, vips_sRGB2scRGB, vips_scRGB2XYZ, vips_XYZ2Lab, vips_Lab2LabQ, NULL } },
-	{ BW, LCH, { vips_BW2sRGB, vips_sRGB2scRGB, vips_scRGB2XYZ, vips_XYZ2Lab, vips_Lab2LCh, NULL } },
-	{ BW, CMC, { vips_BW2sRGB, vips_sRGB2scRGB, vips_scRGB2XYZ, vips_XYZ2Lab, vips_Lab2LCh, vips_LCh2CMC, NULL } },
+	{ BW, LAB, { vips_BW2sRGB, vips_sRGB2Lab, NULL } },
+	{ BW, LABQ, { vips_BW2sRGB, vips_sRGB2Lab, vips_Lab2LabQ, NULL } },
+	{ BW, LCH, { vips_BW2sRGB, vips_sRGB2Lab, vips_Lab2LCh, NULL } },
+	{ BW, CMC, { vips_BW2sRGB, vips_sRGB2Lab, vips_Lab2LCh, vips_LCh2CMC, NULL } },
 	{ BW, CMYK, { vips_BW2sRGB, vips_sRGB2scRGB, vips_scRGB2XYZ, vips_XYZ2CMYK, NULL } },
 	{ BW, scRGB, { vips_BW2sRGB, vips_sRGB2scRGB, NULL } },
 	{ BW, sRGB, { vips_BW2sRGB, NULL } },
 	{ BW, HSV, { vips_BW2sRGB, vips_sRGB2HSV, NULL } },
-	{ BW, LABS, { vips_BW2sRGB, vips_sRGB2scRGB, vips_scRGB2XYZ, vips_XYZ2Lab, vips_Lab2LabS, NULL } },
+	{ BW, LABS, { vips_BW2sRGB, vips_sRGB2Lab, vips_Lab2LabS, NULL } },
 	{ BW, RGB16, { vips_BW2sRGB, vips_sRGB2RGB16, NULL } },
-	{ BW, GREY16, { vips_BW2sRGB, vips_sRGB2scRGB, vips_scRGB2BW16, NULL } },
+	{ BW, GREY16, { vips_BW2sRGB, vips_sRGB2BW16, NULL } },
 	{ BW, YXY, { vips_BW2sRGB, vips_sRGB2scRGB, vips_scRGB2XYZ, vips_XYZ2Yxy, NULL } },
 
 	{ YXY, XYZ, { vips_Yxy2XYZ, NULL } },
@@ -3,6 +3,8 @@
  * Modified:
  * 31/10/12
  * 	- from dE76.c
+ * 19/10/26
+ * 	- add a Highway path
  */
 
 /*
@@ -40,6 +42,7 @@
 #include <math.h>
 
 #include <vips/vips.h>
+#include <vips/vector.h>
 #include <vips/debug.h>
 
 #include "pcolour.h"
@@ -217,7 +220,16 @@ vips_dE00_line(VipsColour *colour,
 
 	int x;
 
-	for (x = 0; x < width; x++) {
+	x = 0;
+#ifdef HAVE_HWY
+	if (vips_vector_isenabled()) {
+		x = vips_dE00_hwy(q, p1, p2, width);
+		p1 += x * 3;
+		p2 += x * 3;
+	}
+#endif /*HAVE_HWY*/
+
+	for (; x < width; x++) {
 		q[x] = vips_col_dE00(p1[0], p1[1], p1[2],
 			p2[0], p2[1], p2[2]);
 
@@ -8,6 +8,8 @@
  * 	- gtkdoc comment
  * 25/10/12
  * 	- redone as a class
+ * 19/10/26
+ * 	- add a Highway path
  */
 
 /*
@@ -45,6 +47,7 @@
 #include <math.h>
 
 #include <vips/vips.h>
+#include <vips/vector.h>
 #include <vips/debug.h>
 
 #include "pcolour.h"
@@ -91,7 +94,16 @@ vips__pythagoras_line(VipsColour *colour,
 
 	int x;
 
-	for (x = 0; x < width; x++) {
+	x = 0;
+#ifdef HAVE_HWY
+	if (vips_vector_isenabled()) {
+		x = vips_pythagoras_hwy(q, p1, p2, width);
+		p1 += x * 3;
+		p2 += x * 3;
+	}
+#endif /*HAVE_HWY*/
+
+	for (; x < width; x++) {
 		float dL = p1[0] - p2[0];
 		float da = p1[1] - p2[1];
 		float db = p1[2] - p2[2];
@@ -0,0 +1,319 @@
+/* dEstats.c
+ *
+ * 19/10/26
+ * 	- from dE00.c and avg.c
+ */
+
+/*
+
+	This file is part of VIPS.
+
+	VIPS is free software; you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+	02110-1301  USA
+
+ */
+
+/*
+
+	These files are distributed with VIPS - http://www.vips.ecs.soton.ac.uk
+
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif /*HAVE_CONFIG_H*/
+#include <glib/gi18n-lib.h>
+
+#include <stdio.h>
+#include <math.h>
+#include <limits.h>
+
+#include <vips/vips.h>
+#include <vips/debug.h>
+
+#include "pcolour.h"
+
+/**
+ * VipsDEType:
+ * @VIPS_DE_TYPE_DE76: CIE dE76, see vips_dE76()
+ * @VIPS_DE_TYPE_DE00: CIE dE2000, see vips_dE00()
+ * @VIPS_DE_TYPE_DECMC: dE CMC(1:1), see vips_dECMC()
+ *
+ * A colour difference formula.
+ */
+
+typedef struct _VipsdEstats {
+	VipsOperation parent_instance;
+
+	VipsImage *left;
+	VipsImage *right;
+	VipsDEType metric;
+	double threshold;
+
+	double mean;
+	double max;
+	int count;
+
+	/* Accumulate here from each thread.
+	 */
+	double sum;
+	double max_seen;
+	gint64 count_seen;
+} VipsdEstats;
+
+typedef VipsOperationClass VipsdEstatsClass;
+
+G_DEFINE_TYPE(VipsdEstats, vips_dEstats, VIPS_TYPE_OPERATION);
+
+/* Per-thread totals.
+ */
+typedef struct _VipsdEstatsSeq {
+	double sum;
+	double max;
+	gint64 count;
+} VipsdEstatsSeq;
+
+static void *
+vips_dEstats_start(VipsImage *in, void *a, void *b)
+{
+	VipsdEstatsSeq *seq = g_new0(VipsdEstatsSeq, 1);
+
+	return (void *) seq;
+}
+
+static int
+vips_dEstats_scan(VipsRegion *region,
+	void *vseq, void *a, void *b, gboolean *stop)
+{
+	VipsdEstatsSeq *seq = (VipsdEstatsSeq *) vseq;
+	VipsdEstats *dEstats = (VipsdEstats *) a;
+	VipsRect *r = &region->valid;
+	const float threshold = dEstats->threshold;
+
+	int x, y;
+
+	for (y = 0; y < r->height; y++) {
+		float *p = (float *)
+			VIPS_REGION_ADDR(region, r->left, r->top + y);
+
+		/* Accumulate the line in float so this vectorises, then add
+		 * to the double total.
+		 */
+		float sum;
+		float max;
+		int count;
+
+		sum = 0.0;
+		max = seq->max;
+		count = 0;
+		for (x = 0; x < r->width; x++) {
+			sum += p[x];
+			max = VIPS_MAX(max, p[x]);
+			count += p[x] > threshold;
+		}
+
+		seq->sum += sum;
+		seq->max = max;
+		seq->count += count;
+	}
+
+	return 0;
+}
+
+/* Called under a lock by vips_sink(), so we can just add.
+ */
+static int
+vips_dEstats_stop(void *vseq, void *a, void *b)
+{
+	VipsdEstatsSeq *seq = (VipsdEstatsSeq *) vseq;
+	VipsdEstats *dEstats = (VipsdEstats *) a;
+
+	dEstats->sum += seq->sum;
+	dEstats->max_seen = VIPS_MAX(dEstats->max_seen, seq->max);
+	dEstats->count_seen += seq->count;
+
+	g_free(seq);
+
+	return 0;
+}
+
+static int
+vips_dEstats_build(VipsObject *object)
+{
+	VipsdEstats *dEstats = (VipsdEstats *) object;
+	VipsImage **t = (VipsImage **) vips_object_local_array(object, 2);
+
+	gint64 n;
+
+	if (VIPS_OBJECT_CLASS(vips_dEstats_parent_class)->build(object))
+		return -1;
+
+	/* The difference image is only ever made a region at a time, and we
+	 * get all three stats in a single pass.
+	 */
+	switch (dEstats->metric) {
+	case VIPS_DE_TYPE_DE76:
+		if (vips_dE76(dEstats->left, dEstats->right, &t[0], NULL))
+			return -1;
+		break;
+
+	case VIPS_DE_TYPE_DE00:
+		if (vips_dE00(dEstats->left, dEstats->right, &t[0], NULL))
+			return -1;
+		break;
+
+	case VIPS_DE_TYPE_DECMC:
+		if (vips_dECMC(dEstats->left, dEstats->right, &t[0], NULL))
+			return -1;
+		break;
+
+	default:
+		g_assert_not_reached();
+		return -1;
+	}
+
+	/* Drop any extra bands.
+	 */
+	if (vips_extract_band(t[0], &t[1], 0, NULL))
+		return -1;
+
+	dEstats->sum = 0.0;
+	dEstats->max_seen = 0.0;
+	dEstats->count_seen = 0;
+	if (vips_sink(t[1],
+			vips_dEstats_start, vips_dEstats_scan, vips_dEstats_stop,
+			dEstats, NULL))
+		return -1;
+
+	n = (gint64) t[1]->Xsize * t[1]->Ysize;
+	g_object_set(object,
+		"mean", dEstats->sum / n,
+		"max", dEstats->max_seen,
+		"count", (int) VIPS_MIN(dEstats->count_seen, INT_MAX),
+		NULL);
+
+	return 0;
+}
+
+static void
+vips_dEstats_class_init(VipsdEstatsClass *class)
+{
+	GObjectClass *gobject_class = G_OBJECT_CLASS(class);
+	VipsObjectClass *object_class = (VipsObjectClass *) class;
+	VipsOperationClass *operation_class = VIPS_OPERATION_CLASS(class);
+
+	gobject_class->set_property = vips_object_set_property;
+	gobject_class->get_property = vips_object_get_property;
+
+	object_class->nickname = "dEstats";
+	object_class->description = _("find colour difference statistics");
+	object_class->build = vips_dEstats_build;
+
+	operation_class->flags = VIPS_OPERATION_SEQUENTIAL;
+
+	VIPS_ARG_IMAGE(class, "left", 1,
+		_("Left"),
+		_("Left-hand input image"),
+		VIPS_ARGUMENT_REQUIRED_INPUT,
+		G_STRUCT_OFFSET(VipsdEstats, left));
+
+	VIPS_ARG_IMAGE(class, "right", 2,
+		_("Right"),
+		_("Right-hand input image"),
+		VIPS_ARGUMENT_REQUIRED_INPUT,
+		G_STRUCT_OFFSET(VipsdEstats, right));
+
+	VIPS_ARG_DOUBLE(class, "mean", 3,
+		_("Mean"),
+		_("Mean colour difference"),
+		VIPS_ARGUMENT_REQUIRED_OUTPUT,
+		G_STRUCT_OFFSET(VipsdEstats, mean),
+		-INFINITY, INFINITY, 0.0);
+
+	VIPS_ARG_ENUM(class, "metric", 4,
+		_("Metric"),
+		_("Colour difference formula"),
+		VIPS_ARGUMENT_OPTIONAL_INPUT,
+		G_STRUCT_OFFSET(VipsdEstats, metric),
+		VIPS_TYPE_DE_TYPE, VIPS_DE_TYPE_DE00);
+
+	VIPS_ARG_DOUBLE(class, "threshold", 5,
+		_("Threshold"),
+		_("Count pixels with a difference above this"),
+		VIPS_ARGUMENT_OPTIONAL_INPUT,
+		G_STRUCT_OFFSET(VipsdEstats, threshold),
+		0.0, INFINITY, 1.0);
+
+	VIPS_ARG_DOUBLE(class, "max", 6,
+		_("Max"),
+		_("Maximum colour difference"),
+		VIPS_ARGUMENT_OPTIONAL_OUTPUT,
+		G_STRUCT_OFFSET(VipsdEstats, max),
+		-INFINITY, INFINITY, 0.0);
+
+	VIPS_ARG_INT(class, "count", 7,
+		_("Count"),
+		_("Number of pixels with a difference above threshold"),
+		VIPS_ARGUMENT_OPTIONAL_OUTPUT,
+		G_STRUCT_OFFSET(VipsdEstats, count),
+		0, INT_MAX, 0);
+}
+
+static void
+vips_dEstats_init(VipsdEstats *dEstats)
+{
+	dEstats->metric = VIPS_DE_TYPE_DE00;
+	dEstats->threshold = 1.0;
+}
+
+/**
+ * vips_dEstats:
+ * @left: first input image
+ * @right: second input image
+ * @mean: (out): mean colour difference
+ * @...: %NULL-terminated list of optional named arguments
+ *
+ * Optional arguments:
+ *
+ * * @metric: #VipsDEType, colour difference formula
+ * * @threshold: %gdouble, count pixels with a difference above this
+ * * @max: (out): %gdouble, maximum colour difference
+ * * @count: (out): %gint, number of pixels above @threshold
+ *
+ * Find the mean and maximum colour difference between two images, and the
+ * number of pixels where the difference is greater than @threshold. This is
+ * much faster than making a difference image with vips_dE00() and then
+ * finding each statistic separately, since the difference is only
+ * calculated once.
+ *
+ * @metric defaults to #VIPS_DE_TYPE_DE00, @threshold to 1.0. Any extra bands
+ * are ignored.
+ *
+ * See also: vips_dE00(), vips_dE76(), vips_dECMC(), vips_stats().
+ *
+ * Returns: 0 on success, -1 on error
+ */
+int
+vips_dEstats(VipsImage *left, VipsImage *right, double *mean, ...)
+{
+	va_list ap;
+	int result;
+
+	va_start(ap, mean);
+	result = vips_call_split("dEstats", ap, left, right, mean);
+	va_end(ap);
+
+	return result;
+}
@@ -214,6 +214,20 @@ extern float vips_v2Y_16[65536];
 void vips_col_make_tables_RGB_8(void);
 void vips_col_make_tables_RGB_16(void);
 
+/* And for linear -> sRGB. These have an extra element at the end for
+ * interpolation.
+ */
+extern int vips_Y2v_8[256 + 1];
+extern int vips_Y2v_16[65536 + 1];
+
+/* The cbrt() table for XYZ -> Lab. Call vips_col_make_tables_XYZ2Lab()
+ * before use.
+ */
+#define VIPS_XYZ2LAB_QUANT (100000)
+extern float vips_cbrt_table[VIPS_XYZ2LAB_QUANT];
+
+void vips_col_make_tables_XYZ2Lab(void);
+
 /* A colour-transforming function.
  */
 typedef int (*VipsColourTransformFn)(VipsImage *in, VipsImage **out, ...);
@@ -221,6 +235,40 @@ typedef int (*VipsColourTransformFn)(VipsImage *in, VipsImage **out, ...);
 int vips__colourspace_process_n(const char *domain,
 	VipsImage *in, VipsImage **out, int n, VipsColourTransformFn fn);
 
+/* Highway paths for the float transforms. These do the whole line, and
+ * give the same result for a pixel wherever it is. scRGB2XYZ and XYZ2scRGB
+ * only write the colour bands.
+ */
+void vips_scRGB2XYZ_hwy(float *restrict q, const float *restrict p,
+	int extra_bands, int width);
+void vips_XYZ2scRGB_hwy(float *restrict q, const float *restrict p,
+	int extra_bands, int width);
+void vips_XYZ2Lab_hwy(float *restrict q, const float *restrict p, int width,
+	float X0, float Y0, float Z0);
+void vips_Lab2XYZ_hwy(float *restrict q, const float *restrict p, int width,
+	float X0, float Y0, float Z0);
+void vips_Lab2LCh_hwy(float *restrict q, const float *restrict p, int width);
+void vips_LCh2Lab_hwy(float *restrict q, const float *restrict p, int width);
+
+/* These do as many whole vectors of pixels as they can and return the
+ * number processed.
+ */
+int vips_dE00_hwy(float *restrict q,
+	const float *restrict p1, const float *restrict p2, int width);
+int vips_pythagoras_hwy(float *restrict q,
+	const float *restrict p1, const float *restrict p2, int width);
+
+/* Fused routes for vips_colourspace(): several steps in one pass.
+ */
+int vips_sRGB2Lab(VipsImage *in, VipsImage **out, ...)
+	G_GNUC_NULL_TERMINATED;
+int vips_Lab2sRGB(VipsImage *in, VipsImage **out, ...)
+	G_GNUC_NULL_TERMINATED;
+int vips_Lab2BW(VipsImage *in, VipsImage **out, ...)
+	G_GNUC_NULL_TERMINATED;
+int vips_sRGB2BW(VipsImage *in, VipsImage **out, ...)
+	G_GNUC_NULL_TERMINATED;
+
 #ifdef __cplusplus
 }
 #endif /*__cplusplus*/
@@ -0,0 +1,303 @@
+/* Turn sRGB into greyscale in a single pass.
+ *
+ * 19/10/26
+ * 	- from sRGB2scRGB.c and scRGB2BW.c
+ */
+
+/*
+
+	This file is part of VIPS.
+
+	VIPS is free software; you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+	02110-1301  USA
+
+ */
+
+/*
+
+	These files are distributed with VIPS - http://www.vips.ecs.soton.ac.uk
+
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif /*HAVE_CONFIG_H*/
+#include <glib/gi18n-lib.h>
+
+#include <stdio.h>
+#include <math.h>
+#include <limits.h>
+
+#include <vips/vips.h>
+#include <vips/internal.h>
+
+#include "pcolour.h"
+
+/* This is used by vips_colourspace() to do sRGB -> scRGB -> B_W in one step.
+ * The arithmetic is exactly the same as the separate operations, so the
+ * result is identical, we just avoid the intermediate float image.
+ */
+
+typedef struct _VipssRGB2BW {
+	VipsOperation parent_instance;
+
+	VipsImage *in;
+	VipsImage *out;
+	int depth;
+} VipssRGB2BW;
+
+typedef VipsOperationClass VipssRGB2BWClass;
+
+G_DEFINE_TYPE(VipssRGB2BW, vips_sRGB2BW, VIPS_TYPE_OPERATION);
+
+/* IN_MAX is the range of the sRGB input, OUT_MAX of the greyscale output.
+ */
+#define sRGB2BW_LINE(IN, V2Y, IN_MAX, OUT, Y2V, OUT_MAX) \
+	{ \
+		IN *restrict p = (IN *) in; \
+		OUT *restrict q = (OUT *) out; \
+\
+		for (i = 0; i < width; i++) { \
+			const float R = V2Y[p[0]]; \
+			const float G = V2Y[p[1]]; \
+			const float B = V2Y[p[2]]; \
+\
+			float Y; \
+			float Yf; \
+			int Yi; \
+			float v; \
+\
+			/* As vips_col_scRGB2BW(). The LUT input can't be \
+			 * NaN, so we don't need to test for that. \
+			 */ \
+			Y = 0.2 * R + 0.7 * G + 0.1 * B; \
+			Yf = Y * OUT_MAX; \
+			Yf = VIPS_FCLIP(0, Yf, OUT_MAX); \
+			Yi = (int) Yf; \
+			v = Y2V[Yi] + (Y2V[Yi + 1] - Y2V[Yi]) * (Yf - Yi); \
+			q[0] = VIPS_RINT(v); \
+\
+			p += 3; \
+			q += 1; \
+\
+			for (j = 0; j < extra_bands; j++) { \
+				const float a = p[j] / (double) IN_MAX; \
+\
+				q[j] = VIPS_CLIP(0, \
+					(int) (a * (double) OUT_MAX), OUT_MAX); \
+			} \
+			p += extra_bands; \
+			q += extra_bands; \
+		} \
+	}
+
+VIPS_TARGET_CLONES("default,avx")
+static void
+vips_sRGB2BW_line(VipsPel *restrict out, VipsPel *restrict in,
+	int in_depth, int out_depth, int extra_bands, int width)
+{
+	int i, j;
+
+	if (in_depth == 8) {
+		if (out_depth == 8)
+			sRGB2BW_LINE(VipsPel, vips_v2Y_8, UCHAR_MAX,
+				VipsPel, vips_Y2v_8, UCHAR_MAX)
+		else
+			sRGB2BW_LINE(VipsPel, vips_v2Y_8, UCHAR_MAX,
+				unsigned short, vips_Y2v_16, USHRT_MAX)
+	}
+	else {
+		if (out_depth == 8)
+			sRGB2BW_LINE(unsigned short, vips_v2Y_16, USHRT_MAX,
+				VipsPel, vips_Y2v_8, UCHAR_MAX)
+		else
+			sRGB2BW_LINE(unsigned short, vips_v2Y_16, USHRT_MAX,
+				unsigned short, vips_Y2v_16, USHRT_MAX)
+	}
+}
+
+static int
+vips_sRGB2BW_gen(VipsRegion *out_region,
+	void *seq, void *a, void *b, gboolean *stop)
+{
+	VipsRegion *ir = (VipsRegion *) seq;
+	VipssRGB2BW *sRGB2BW = (VipssRGB2BW *) b;
+	VipsRect *r = &out_region->valid;
+	VipsImage *in = ir->im;
+	int in_depth = in->BandFmt == VIPS_FORMAT_UCHAR ? 8 : 16;
+
+	int y;
+
+	if (vips_region_prepare(ir, r))
+		return -1;
+
+	VIPS_GATE_START("vips_sRGB2BW_gen: work");
+
+	if (in_depth == 8 ||
+		sRGB2BW->depth == 8)
+		vips_col_make_tables_RGB_8();
+	if (in_depth == 16 ||
+		sRGB2BW->depth == 16)
+		vips_col_make_tables_RGB_16();
+
+	for (y = 0; y < r->height; y++) {
+		VipsPel *p = VIPS_REGION_ADDR(ir, r->left, r->top + y);
+		VipsPel *q = VIPS_REGION_ADDR(out_region, r->left, r->top + y);
+
+		vips_sRGB2BW_line(q, p,
+			in_depth, sRGB2BW->depth, in->Bands - 3, r->width);
+	}
+
+	VIPS_GATE_STOP("vips_sRGB2BW_gen: work");
+
+	return 0;
+}
+
+static int
+vips_sRGB2BW_build(VipsObject *object)
+{
+	VipsObjectClass *class = VIPS_OBJECT_GET_CLASS(object);
+	VipssRGB2BW *sRGB2BW = (VipssRGB2BW *) object;
+
+	VipsImage **t = (VipsImage **) vips_object_local_array(object, 2);
+
+	VipsImage *in;
+	VipsBandFormat in_format;
+	VipsBandFormat format;
+	VipsInterpretation interpretation;
+	VipsImage *out;
+
+	if (VIPS_OBJECT_CLASS(vips_sRGB2BW_parent_class)->build(object))
+		return -1;
+
+	in = sRGB2BW->in;
+	if (vips_check_bands_atleast(class->nickname, in, 3))
+		return -1;
+
+	// as sRGB2scRGB, any profile can no longer be correct
+	if (vips_copy(in, &t[0], NULL))
+		return -1;
+	in = t[0];
+	vips_image_remove(in, VIPS_META_ICC_NAME);
+
+	in_format = in->Type == VIPS_INTERPRETATION_RGB16
+		? VIPS_FORMAT_USHORT
+		: VIPS_FORMAT_UCHAR;
+	if (in->BandFmt != in_format) {
+		if (vips_cast(in, &t[1], in_format, NULL))
+			return -1;
+		in = t[1];
+	}
+
+	switch (sRGB2BW->depth) {
+	case 16:
+		interpretation = VIPS_INTERPRETATION_GREY16;
+		format = VIPS_FORMAT_USHORT;
+		break;
+
+	case 8:
+		interpretation = VIPS_INTERPRETATION_B_W;
+		format = VIPS_FORMAT_UCHAR;
+		break;
+
+	default:
+		vips_error(class->nickname,
+			"%s", _("depth must be 8 or 16"));
+		return -1;
+	}
+
+	out = vips_image_new();
+	if (vips_image_pipelinev(out,
+			VIPS_DEMAND_STYLE_THINSTRIP, in, NULL)) {
+		g_object_unref(out);
+		return -1;
+	}
+	out->Type = interpretation;
+	out->BandFmt = format;
+	out->Bands = in->Bands - 2;
+
+	if (vips_image_generate(out,
+			vips_start_one, vips_sRGB2BW_gen, vips_stop_one,
+			in, sRGB2BW)) {
+		g_object_unref(out);
+		return -1;
+	}
+
+	g_object_set(object, "out", out, NULL);
+
+	return 0;
+}
+
+static void
+vips_sRGB2BW_class_init(VipssRGB2BWClass *class)
+{
+	GObjectClass *gobject_class = G_OBJECT_CLASS(class);
+	VipsObjectClass *object_class = (VipsObjectClass *) class;
+	VipsOperationClass *operation_class = VIPS_OPERATION_CLASS(class);
+
+	gobject_class->set_property = vips_object_set_property;
+	gobject_class->get_property = vips_object_get_property;
+
+	object_class->nickname = "sRGB2BW";
+	object_class->description = _("convert an sRGB image to BW");
+	object_class->build = vips_sRGB2BW_build;
+
+	/* Only for vips_colourspace(), so keep it out of the docs and the
+	 * operation list.
+	 */
+	operation_class->flags = VIPS_OPERATION_SEQUENTIAL |
+		VIPS_OPERATION_DEPRECATED;
+
+	VIPS_ARG_IMAGE(class, "in", 1,
+		_("Input"),
+		_("Input image"),
+		VIPS_ARGUMENT_REQUIRED_INPUT,
+		G_STRUCT_OFFSET(VipssRGB2BW, in));
+
+	VIPS_ARG_IMAGE(class, "out", 100,
+		_("Output"),
+		_("Output image"),
+		VIPS_ARGUMENT_REQUIRED_OUTPUT,
+		G_STRUCT_OFFSET(VipssRGB2BW, out));
+
+	VIPS_ARG_INT(class, "depth", 130,
+		_("Depth"),
+		_("Output device space depth in bits"),
+		VIPS_ARGUMENT_OPTIONAL_INPUT,
+		G_STRUCT_OFFSET(VipssRGB2BW, depth),
+		8, 16, 8);
+}
+
+static void
+vips_sRGB2BW_init(VipssRGB2BW *sRGB2BW)
+{
+	sRGB2BW->depth = 8;
+}
+
+/* Convert an 8 or 16-bit sRGB image to 8 or 16-bit greyscale. Same as
+ * vips_sRGB2scRGB() and vips_scRGB2BW(), but in one pass.
+ */
+int
+vips_sRGB2BW(VipsImage *in, VipsImage **out, ...)
+{
+	va_list ap;
+	int result;
+
+	va_start(ap, out);
+	result = vips_call_split("sRGB2BW", ap, in, out);
+	va_end(ap);
+
+	return result;
+}
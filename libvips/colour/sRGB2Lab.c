@@ -0,0 +1,367 @@
+/* Turn sRGB into Lab in a single pass.
+ *
+ * 19/10/26
+ * 	- from sRGB2scRGB.c, scRGB2XYZ.c and XYZ2Lab.c
+ */
+
+/*
+
+	This file is part of VIPS.
+
+	VIPS is free software; you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+	02110-1301  USA
+
+ */
+
+/*
+
+	These files are distributed with VIPS - http://www.vips.ecs.soton.ac.uk
+
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif /*HAVE_CONFIG_H*/
+#include <glib/gi18n-lib.h>
+
+#include <stdio.h>
+#include <math.h>
+
+#include <vips/vips.h>
+#include <vips/vector.h>
+#include <vips/internal.h>
+
+#include "pcolour.h"
+
+/* This is used by vips_colourspace() to do sRGB -> scRGB -> XYZ -> Lab in
+ * one step. The arithmetic is exactly the same as the separate operations,
+ * so the result is identical, we just avoid the intermediate float images.
+ * When the separate operations would use their vector paths, we run the same
+ * kernels on a chunk of pixels at a time.
+ */
+
+typedef struct _VipssRGB2Lab {
+	VipsOperation parent_instance;
+
+	VipsImage *in;
+	VipsImage *out;
+} VipssRGB2Lab;
+
+typedef VipsOperationClass VipssRGB2LabClass;
+
+G_DEFINE_TYPE(VipssRGB2Lab, vips_sRGB2Lab, VIPS_TYPE_OPERATION);
+
+/* Interpolated cbrt() lookup, as vips_col_XYZ2Lab_helper().
+ */
+static inline float
+vips_sRGB2Lab_cbrt(float n)
+{
+	int i = VIPS_CLIP(0, (int) n, VIPS_XYZ2LAB_QUANT - 2);
+	float f = n - i;
+
+	return vips_cbrt_table[i] +
+		f * (vips_cbrt_table[i + 1] - vips_cbrt_table[i]);
+}
+
+/* Extra bands become 0 - 255 float, as scRGB2XYZ does.
+ */
+#define sRGB2Lab_LINE(TYPE, LUT, MAX) \
+	{ \
+		TYPE *restrict p = (TYPE *) in; \
+\
+		for (i = 0; i < width; i++) { \
+			const float R = LUT[p[0]] * VIPS_D65_Y0; \
+			const float G = LUT[p[1]] * VIPS_D65_Y0; \
+			const float B = LUT[p[2]] * VIPS_D65_Y0; \
+\
+			const float X = 0.4124 * R + \
+				0.3576 * G + \
+				0.1805 * B; \
+			const float Y = 0.2126 * R + \
+				0.7152 * G + \
+				0.0722 * B; \
+			const float Z = 0.0193 * R + \
+				0.1192 * G + \
+				0.9505 * B; \
+\
+			const float nX = VIPS_XYZ2LAB_QUANT * X / VIPS_D65_X0; \
+			const float nY = VIPS_XYZ2LAB_QUANT * Y / VIPS_D65_Y0; \
+			const float nZ = VIPS_XYZ2LAB_QUANT * Z / VIPS_D65_Z0; \
+\
+			const float cbx = vips_sRGB2Lab_cbrt(nX); \
+			const float cby = vips_sRGB2Lab_cbrt(nY); \
+			const float cbz = vips_sRGB2Lab_cbrt(nZ); \
+\
+			q[0] = 116.0 * cby - 16.0; \
+			q[1] = 500.0 * (cbx - cby); \
+			q[2] = 200.0 * (cby - cbz); \
+\
+			p += 3; \
+			q += 3; \
+\
+			for (j = 0; j < extra_bands; j++) { \
+				const float a = p[j] / MAX; \
+\
+				q[j] = VIPS_CLIP(0, a * 255.0, 255.0); \
+			} \
+			p += extra_bands; \
+			q += extra_bands; \
+		} \
+	}
+
+VIPS_TARGET_CLONES("default,avx")
+static void
+vips_sRGB2Lab_line_8(float *restrict q, VipsPel *restrict in,
+	int extra_bands, int width)
+{
+	int i, j;
+
+	sRGB2Lab_LINE(VipsPel, vips_v2Y_8, 255.0);
+}
+
+VIPS_TARGET_CLONES("default,avx")
+static void
+vips_sRGB2Lab_line_16(float *restrict q, VipsPel *restrict in,
+	int extra_bands, int width)
+{
+	int i, j;
+
+	sRGB2Lab_LINE(unsigned short, vips_v2Y_16, 65535.0);
+}
+
+#ifdef HAVE_HWY
+/* Chunk size for the vector path.
+ */
+#define CHUNK (256)
+
+/* As the scalar path, but XYZ and Lab come from the scRGB2XYZ and XYZ2Lab
+ * kernels.
+ */
+#define sRGB2Lab_LINE_HWY(TYPE, LUT, MAX) \
+	{ \
+		TYPE *restrict p = (TYPE *) in; \
+		const int bands = 3 + extra_bands; \
+\
+		float rgb[3 * CHUNK]; \
+		float xyz[3 * CHUNK]; \
+\
+		for (x = 0; x < width; x += CHUNK) { \
+			int n = VIPS_MIN(CHUNK, width - x); \
+\
+			for (i = 0; i < n; i++) { \
+				rgb[3 * i] = LUT[p[i * bands]]; \
+				rgb[3 * i + 1] = LUT[p[i * bands + 1]]; \
+				rgb[3 * i + 2] = LUT[p[i * bands + 2]]; \
+			} \
+\
+			vips_scRGB2XYZ_hwy(xyz, rgb, 0, n); \
+			vips_XYZ2Lab_hwy(rgb, xyz, n, \
+				VIPS_D65_X0, VIPS_D65_Y0, VIPS_D65_Z0); \
+\
+			for (i = 0; i < n; i++) { \
+				q[0] = rgb[3 * i]; \
+				q[1] = rgb[3 * i + 1]; \
+				q[2] = rgb[3 * i + 2]; \
+\
+				p += 3; \
+				q += 3; \
+\
+				for (j = 0; j < extra_bands; j++) { \
+					const float a = p[j] / MAX; \
+\
+					q[j] = VIPS_CLIP(0, a * 255.0, 255.0); \
+				} \
+				p += extra_bands; \
+				q += extra_bands; \
+			} \
+		} \
+	}
+
+static void
+vips_sRGB2Lab_line_8_hwy(float *restrict q, VipsPel *restrict in,
+	int extra_bands, int width)
+{
+	int x, i, j;
+
+	sRGB2Lab_LINE_HWY(VipsPel, vips_v2Y_8, 255.0);
+}
+
+static void
+vips_sRGB2Lab_line_16_hwy(float *restrict q, VipsPel *restrict in,
+	int extra_bands, int width)
+{
+	int x, i, j;
+
+	sRGB2Lab_LINE_HWY(unsigned short, vips_v2Y_16, 65535.0);
+}
+#endif /*HAVE_HWY*/
+
+static int
+vips_sRGB2Lab_gen(VipsRegion *out_region,
+	void *seq, void *a, void *b, gboolean *stop)
+{
+	VipsRegion *ir = (VipsRegion *) seq;
+	VipsRect *r = &out_region->valid;
+	VipsImage *in = ir->im;
+
+	int y;
+
+	if (vips_region_prepare(ir, r))
+		return -1;
+
+	VIPS_GATE_START("vips_sRGB2Lab_gen: work");
+
+	vips_col_make_tables_XYZ2Lab();
+	if (in->BandFmt == VIPS_FORMAT_UCHAR)
+		vips_col_make_tables_RGB_8();
+	else
+		vips_col_make_tables_RGB_16();
+
+	for (y = 0; y < r->height; y++) {
+		VipsPel *p = VIPS_REGION_ADDR(ir, r->left, r->top + y);
+		float *q = (float *)
+			VIPS_REGION_ADDR(out_region, r->left, r->top + y);
+
+#ifdef HAVE_HWY
+		if (vips_vector_isenabled()) {
+			if (in->BandFmt == VIPS_FORMAT_UCHAR)
+				vips_sRGB2Lab_line_8_hwy(q, p,
+					in->Bands - 3, r->width);
+			else
+				vips_sRGB2Lab_line_16_hwy(q, p,
+					in->Bands - 3, r->width);
+			continue;
+		}
+#endif /*HAVE_HWY*/
+
+		if (in->BandFmt == VIPS_FORMAT_UCHAR)
+			vips_sRGB2Lab_line_8(q, p, in->Bands - 3, r->width);
+		else
+			vips_sRGB2Lab_line_16(q, p, in->Bands - 3, r->width);
+	}
+
+	VIPS_GATE_STOP("vips_sRGB2Lab_gen: work");
+
+	return 0;
+}
+
+static int
+vips_sRGB2Lab_build(VipsObject *object)
+{
+	VipsObjectClass *class = VIPS_OBJECT_GET_CLASS(object);
+	VipssRGB2Lab *sRGB2Lab = (VipssRGB2Lab *) object;
+
+	VipsImage **t = (VipsImage **) vips_object_local_array(object, 2);
+
+	VipsImage *in;
+	VipsImage *out;
+	VipsBandFormat format;
+
+	if (VIPS_OBJECT_CLASS(vips_sRGB2Lab_parent_class)->build(object))
+		return -1;
+
+	in = sRGB2Lab->in;
+	if (vips_check_bands_atleast(class->nickname, in, 3))
+		return -1;
+
+	// as sRGB2scRGB, any profile can no longer be correct
+	if (vips_copy(in, &t[0], NULL))
+		return -1;
+	in = t[0];
+	vips_image_remove(in, VIPS_META_ICC_NAME);
+
+	format = in->Type == VIPS_INTERPRETATION_RGB16
+		? VIPS_FORMAT_USHORT
+		: VIPS_FORMAT_UCHAR;
+	if (in->BandFmt != format) {
+		if (vips_cast(in, &t[1], format, NULL))
+			return -1;
+		in = t[1];
+	}
+
+	out = vips_image_new();
+	if (vips_image_pipelinev(out,
+			VIPS_DEMAND_STYLE_THINSTRIP, in, NULL)) {
+		g_object_unref(out);
+		return -1;
+	}
+	out->Type = VIPS_INTERPRETATION_LAB;
+	out->BandFmt = VIPS_FORMAT_FLOAT;
+
+	if (vips_image_generate(out,
+			vips_start_one, vips_sRGB2Lab_gen, vips_stop_one,
+			in, sRGB2Lab)) {
+		g_object_unref(out);
+		return -1;
+	}
+
+	g_object_set(object, "out", out, NULL);
+
+	return 0;
+}
+
+static void
+vips_sRGB2Lab_class_init(VipssRGB2LabClass *class)
+{
+	GObjectClass *gobject_class = G_OBJECT_CLASS(class);
+	VipsObjectClass *object_class = (VipsObjectClass *) class;
+	VipsOperationClass *operation_class = VIPS_OPERATION_CLASS(class);
+
+	gobject_class->set_property = vips_object_set_property;
+	gobject_class->get_property = vips_object_get_property;
+
+	object_class->nickname = "sRGB2Lab";
+	object_class->description = _("convert an sRGB image to Lab");
+	object_class->build = vips_sRGB2Lab_build;
+
+	/* Only for vips_colourspace(), so keep it out of the docs and the
+	 * operation list.
+	 */
+	operation_class->flags = VIPS_OPERATION_SEQUENTIAL |
+		VIPS_OPERATION_DEPRECATED;
+
+	VIPS_ARG_IMAGE(class, "in", 1,
+		_("Input"),
+		_("Input image"),
+		VIPS_ARGUMENT_REQUIRED_INPUT,
+		G_STRUCT_OFFSET(VipssRGB2Lab, in));
+
+	VIPS_ARG_IMAGE(class, "out", 100,
+		_("Output"),
+		_("Output image"),
+		VIPS_ARGUMENT_REQUIRED_OUTPUT,
+		G_STRUCT_OFFSET(VipssRGB2Lab, out));
+}
+
+static void
+vips_sRGB2Lab_init(VipssRGB2Lab *sRGB2Lab)
+{
+}
+
+/* Convert an 8 or 16-bit sRGB image to D65 Lab. Same as vips_sRGB2scRGB(),
+ * vips_scRGB2XYZ() and vips_XYZ2Lab(), but in one pass.
+ */
+int
+vips_sRGB2Lab(VipsImage *in, VipsImage **out, ...)
+{
+	va_list ap;
+	int result;
+
+	va_start(ap, out);
+	result = vips_call_split("sRGB2Lab", ap, in, out);
+	va_end(ap);
+
+	return result;
+}
@@ -8,6 +8,8 @@
  * 	- cleanups
  * 20/9/12
  * 	redo as a class
+ * 19/10/26
+ * 	- add a Highway path
  */
 
 /*
@@ -46,6 +48,7 @@
 #include <math.h>
 
 #include <vips/vips.h>
+#include <vips/vector.h>
 
 #include "pcolour.h"
 
@@ -70,6 +73,27 @@ vips_scRGB2XYZ_line(float *restrict q, float *restrict p,
 {
 	int i, j;
 
+#ifdef HAVE_HWY
+	if (vips_vector_isenabled()) {
+		/* That does the colour bands, we do any extra bands.
+		 */
+		vips_scRGB2XYZ_hwy(q, p, extra_bands, width);
+
+		if (extra_bands > 0)
+			for (i = 0; i < width; i++) {
+				p += 3;
+				q += 3;
+
+				for (j = 0; j < extra_bands; j++)
+					q[j] = VIPS_CLIP(0, p[j] * 255.0, 255.0);
+				p += extra_bands;
+				q += extra_bands;
+			}
+
+		return;
+	}
+#endif /*HAVE_HWY*/
+
 	for (i = 0; i < width; i++) {
 		const float R = p[0] * VIPS_D65_Y0;
 		const float G = p[1] * VIPS_D65_Y0;
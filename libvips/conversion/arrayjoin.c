@@ -8,6 +8,9 @@
  *	- much faster with large arrays
  * 29/1/24
  *	- render and don't forward pixels for complete subregions
+ * 19/10/26
+ *	- add vips_arrayjoin_lazy()
+ *	- minimise in order, not with a scan of every input
  */
 
 /*
@@ -56,12 +59,15 @@
 
 #include "pconversion.h"
 
-typedef struct _VipsArrayjoin {
+/* Layout and pixel pasting are shared between vips_arrayjoin(), where all the
+ * inputs are open up front, and vips_arrayjoin_lazy(), where tiles are opened
+ * on demand.
+ */
+typedef struct _VipsArrayjoinBase {
 	VipsConversion parent_instance;
 
 	/* Params.
 	 */
-	VipsArrayImage *in;
 	int across;
 	int shim;
 	VipsArea *background;
@@ -70,25 +76,49 @@ typedef struct _VipsArrayjoin {
 	int hspacing;
 	int vspacing;
 
+	/* The number of inputs, and the grid they make.
+	 */
+	int n;
 	int down;
 	VipsRect *rects;
-	gboolean *minimised;
 
-} VipsArrayjoin;
+	/* Inputs below this have been minimised. Rects are in order of
+	 * bottom edge, so this can only go up.
+	 */
+	int n_minimised;
+
+} VipsArrayjoinBase;
+
+typedef struct _VipsArrayjoinBaseClass {
+	VipsConversionClass parent_class;
+
+	/* Get input i, aligned and embedded in its rect. Return a new ref,
+	 * or NULL on error.
+	 */
+	VipsImage *(*get)(VipsArrayjoinBase *join, int i);
+
+	/* Sequential mode has finished with input i.
+	 */
+	void (*minimise)(VipsArrayjoinBase *join, int i);
 
-typedef VipsConversionClass VipsArrayjoinClass;
+} VipsArrayjoinBaseClass;
 
-G_DEFINE_TYPE(VipsArrayjoin, vips_arrayjoin, VIPS_TYPE_CONVERSION);
+G_DEFINE_ABSTRACT_TYPE(VipsArrayjoinBase, vips_arrayjoin_base,
+	VIPS_TYPE_CONVERSION);
+
+#define VIPS_ARRAYJOIN_BASE_GET_CLASS(obj) \
+	(G_TYPE_INSTANCE_GET_CLASS((obj), \
+		vips_arrayjoin_base_get_type(), VipsArrayjoinBaseClass))
 
 static int
-vips_arrayjoin_gen(VipsRegion *out_region,
+vips_arrayjoin_base_gen(VipsRegion *out_region,
 	void *seq, void *a, void *b, gboolean *stop)
 {
-	VipsImage **in = (VipsImage **) a;
-	VipsArrayjoin *join = (VipsArrayjoin *) b;
+	VipsArrayjoinBase *join = (VipsArrayjoinBase *) b;
+	VipsArrayjoinBaseClass *class = VIPS_ARRAYJOIN_BASE_GET_CLASS(join);
 	VipsConversion *conversion = VIPS_CONVERSION(join);
 	VipsRect *r = &out_region->valid;
-	int n;
+	int n = join->n;
 
 	/* Find the left/top/width/height of the cells this region touches.
 	 */
@@ -104,12 +134,9 @@ vips_arrayjoin_gen(VipsRegion *out_region,
 		cell_height;
 
 	int i;
+	VipsImage *in;
 	VipsRegion *reg;
 
-	/* Size of image array.
-	 */
-	vips_array_image_get(join->in, &n);
-
 	/* Does this rect fit completely within one of our inputs? We can just
 	 * forward the request.
 	 */
@@ -127,7 +154,10 @@ vips_arrayjoin_gen(VipsRegion *out_region,
 		/* And render into out_region. We can't just forward a pointer since
 		 * we are about to unref reg.
 		 */
-		reg = vips_region_new(in[i]);
+		if (!(in = class->get(join, i)))
+			return -1;
+		reg = vips_region_new(in);
+		g_object_unref(in);
 		if (vips_region_prepare_to(reg, out_region, &need, r->left, r->top)) {
 			g_object_unref(reg);
 			return -1;
@@ -144,7 +174,10 @@ vips_arrayjoin_gen(VipsRegion *out_region,
 			for (x = 0; x < width; x++) {
 				i = VIPS_MIN(n - 1, x + left + (y + top) * join->across);
 
-				reg = vips_region_new(in[i]);
+				if (!(in = class->get(join, i)))
+					return -1;
+				reg = vips_region_new(in);
+				g_object_unref(in);
 
 				if (vips__insert_paste_region(out_region, reg,
 						&join->rects[i])) {
@@ -161,84 +194,35 @@ vips_arrayjoin_gen(VipsRegion *out_region,
 	 * descriptors on large image arrays.
 	 *
 	 * minimise_all is quite expensive, so only trigger once for each input.
-	 *
-	 * We don't lock for minimised[], but it's harmless.
+	 * Threads race to claim each input with a compare and swap.
 	 */
 	if (vips_image_is_sequential(conversion->out))
-		for (i = 0; i < n; i++) {
-			int bottom_edge = VIPS_RECT_BOTTOM(&join->rects[i]);
-
-			if (!join->minimised[i] &&
-				r->top > bottom_edge + 1024) {
-				join->minimised[i] = TRUE;
-				vips_image_minimise_all(in[i]);
-			}
+		for (;;) {
+			i = g_atomic_int_get(&join->n_minimised);
+			if (i >= n ||
+				r->top <= VIPS_RECT_BOTTOM(&join->rects[i]) + 1024)
+				break;
+
+			if (g_atomic_int_compare_and_exchange(&join->n_minimised,
+					i, i + 1))
+				class->minimise(join, i);
 		}
 
 	return 0;
 }
 
-static int
-vips_arrayjoin_build(VipsObject *object)
+/* Set the spacing, the grid size and the rect for each input.
+ */
+static void
+vips_arrayjoin_base_layout(VipsArrayjoinBase *join,
+	int hspacing, int vspacing)
 {
-	VipsObjectClass *class = VIPS_OBJECT_GET_CLASS(object);
-	VipsConversion *conversion = VIPS_CONVERSION(object);
-	VipsArrayjoin *join = (VipsArrayjoin *) object;
+	VipsObject *object = VIPS_OBJECT(join);
+	int n = join->n;
 
-	VipsImage **in;
-	int n;
-
-	VipsImage **format;
-	VipsImage **band;
-	VipsImage **size;
-
-	int hspacing;
-	int vspacing;
 	int output_width;
-	int output_height;
 	int i;
 
-	if (VIPS_OBJECT_CLASS(vips_arrayjoin_parent_class)->build(object))
-		return -1;
-
-	in = vips_array_image_get(join->in, &n);
-	/* Array length zero means error.
-	 */
-	if (n == 0)
-		return -1;
-
-	for (i = 0; i < n; i++)
-		if (vips_image_pio_input(in[i]) ||
-			vips_check_coding_known(class->nickname, in[i]))
-			return -1;
-
-	/* Move all input images to a common format and number of bands.
-	 */
-	format = (VipsImage **) vips_object_local_array(object, n);
-	if (vips__formatalike_vec(in, format, n))
-		return -1;
-	in = format;
-
-	/* We have to include the number of bands in @background in our
-	 * calculation.
-	 */
-	band = (VipsImage **) vips_object_local_array(object, n);
-	if (vips__bandalike_vec(class->nickname,
-			in, band, n, join->background->n))
-		return -1;
-	in = band;
-
-	/* Now sizealike: search for the largest image.
-	 */
-	hspacing = in[0]->Xsize;
-	vspacing = in[0]->Ysize;
-	for (i = 1; i < n; i++) {
-		if (in[i]->Xsize > hspacing)
-			hspacing = in[i]->Xsize;
-		if (in[i]->Ysize > vspacing)
-			vspacing = in[i]->Ysize;
-	}
-
 	if (!vips_object_argument_isset(object, "hspacing"))
 		join->hspacing = hspacing;
 	if (!vips_object_argument_isset(object, "vspacing"))
@@ -254,12 +238,8 @@ vips_arrayjoin_build(VipsObject *object)
 	 */
 	join->down = VIPS_ROUND_UP(n, join->across) / join->across;
 
-	/* The output size.
-	 */
 	output_width = hspacing * join->across +
 		join->shim * (join->across - 1);
-	output_height = vspacing * join->down +
-		join->shim * (join->down - 1);
 
 	/* Make a rect for the position of each input.
 	 */
@@ -288,167 +268,164 @@ vips_arrayjoin_build(VipsObject *object)
 			join->rects[i].width =
 				output_width - join->rects[i].left;
 	}
+}
 
-	/* A thing to track which inputs we've signalled minimise on.
-	 */
-	join->minimised = VIPS_ARRAY(join, n, gboolean);
-	for (i = 0; i < n; i++)
-		join->minimised[i] = FALSE;
+/* Each image must be cropped and aligned within an @hspacing by
+ * @vspacing box.
+ */
+static int
+vips_arrayjoin_base_embed(VipsArrayjoinBase *join,
+	VipsImage *in, int i, VipsImage **out)
+{
+	int left, top;
 
-	/* Each image must be cropped and aligned within an @hspacing by
-	 * @vspacing box.
+	/* Compiler warnings.
 	 */
-	size = (VipsImage **) vips_object_local_array(object, n);
-	for (i = 0; i < n; i++) {
-		int left, top;
-		int width, height;
+	left = 0;
+	top = 0;
 
-		/* Compiler warnings.
-		 */
+	switch (join->halign) {
+	case VIPS_ALIGN_LOW:
 		left = 0;
-		top = 0;
+		break;
 
-		switch (join->halign) {
-		case VIPS_ALIGN_LOW:
-			left = 0;
-			break;
+	case VIPS_ALIGN_CENTRE:
+		left = (join->hspacing - in->Xsize) / 2;
+		break;
 
-		case VIPS_ALIGN_CENTRE:
-			left = (hspacing - in[i]->Xsize) / 2;
-			break;
+	case VIPS_ALIGN_HIGH:
+		left = join->hspacing - in->Xsize;
+		break;
 
-		case VIPS_ALIGN_HIGH:
-			left = hspacing - in[i]->Xsize;
-			break;
+	default:
+		g_assert_not_reached();
+		break;
+	}
 
-		default:
-			g_assert_not_reached();
-			break;
-		}
+	switch (join->valign) {
+	case VIPS_ALIGN_LOW:
+		top = 0;
+		break;
 
-		switch (join->valign) {
-		case VIPS_ALIGN_LOW:
-			top = 0;
-			break;
+	case VIPS_ALIGN_CENTRE:
+		top = (join->vspacing - in->Ysize) / 2;
+		break;
 
-		case VIPS_ALIGN_CENTRE:
-			top = (vspacing - in[i]->Ysize) / 2;
-			break;
+	case VIPS_ALIGN_HIGH:
+		top = join->vspacing - in->Ysize;
+		break;
 
-		case VIPS_ALIGN_HIGH:
-			top = vspacing - in[i]->Ysize;
-			break;
+	default:
+		g_assert_not_reached();
+		break;
+	}
 
-		default:
-			g_assert_not_reached();
-			break;
-		}
+	if (vips_embed(in, out, left, top,
+			join->rects[i].width, join->rects[i].height,
+			"extend", VIPS_EXTEND_BACKGROUND,
+			"background", join->background,
+			NULL))
+		return -1;
 
-		width = join->rects[i].width;
-		height = join->rects[i].height;
+	return 0;
+}
 
-		if (vips_embed(in[i], &size[i], left, top, width, height,
-				"extend", VIPS_EXTEND_BACKGROUND,
-				"background", join->background,
-				NULL))
-			return -1;
-	}
+/* Attach the output to the NULL-terminated array of embedded inputs.
+ */
+static int
+vips_arrayjoin_base_generate(VipsArrayjoinBase *join, VipsImage **in)
+{
+	VipsConversion *conversion = VIPS_CONVERSION(join);
 
 	if (vips_image_pipeline_array(conversion->out,
-			VIPS_DEMAND_STYLE_THINSTRIP, size))
+			VIPS_DEMAND_STYLE_THINSTRIP, in))
 		return -1;
 
-	conversion->out->Xsize = output_width;
-	conversion->out->Ysize = output_height;
+	conversion->out->Xsize = join->hspacing * join->across +
+		join->shim * (join->across - 1);
+	conversion->out->Ysize = join->vspacing * join->down +
+		join->shim * (join->down - 1);
 
 	/* Don't use start_many -- the set of input images can be huge (many
 	 * 10s of 1000s) and we don't want to have 20,000 regions active. It's
 	 * much quicker to make them on demand.
 	 */
 	if (vips_image_generate(conversion->out,
-			NULL, vips_arrayjoin_gen, NULL, size, join))
+			NULL, vips_arrayjoin_base_gen, NULL, NULL, join))
 		return -1;
 
 	return 0;
 }
 
 static void
-vips_arrayjoin_class_init(VipsArrayjoinClass *class)
+vips_arrayjoin_base_class_init(VipsArrayjoinBaseClass *class)
 {
 	GObjectClass *gobject_class = G_OBJECT_CLASS(class);
 	VipsObjectClass *vobject_class = VIPS_OBJECT_CLASS(class);
 	VipsOperationClass *operation_class = VIPS_OPERATION_CLASS(class);
 
-	VIPS_DEBUG_MSG("vips_arrayjoin_class_init\n");
+	VIPS_DEBUG_MSG("vips_arrayjoin_base_class_init\n");
 
 	gobject_class->set_property = vips_object_set_property;
 	gobject_class->get_property = vips_object_get_property;
 
-	vobject_class->nickname = "arrayjoin";
+	vobject_class->nickname = "arrayjoin_base";
 	vobject_class->description = _("join an array of images");
-	vobject_class->build = vips_arrayjoin_build;
 
 	operation_class->flags = VIPS_OPERATION_SEQUENTIAL;
 
-	VIPS_ARG_BOXED(class, "in", -1,
-		_("Input"),
-		_("Array of input images"),
-		VIPS_ARGUMENT_REQUIRED_INPUT,
-		G_STRUCT_OFFSET(VipsArrayjoin, in),
-		VIPS_TYPE_ARRAY_IMAGE);
-
 	VIPS_ARG_INT(class, "across", 4,
 		_("Across"),
 		_("Number of images across grid"),
 		VIPS_ARGUMENT_OPTIONAL_INPUT,
-		G_STRUCT_OFFSET(VipsArrayjoin, across),
+		G_STRUCT_OFFSET(VipsArrayjoinBase, across),
 		1, 1000000, 1);
 
 	VIPS_ARG_INT(class, "shim", 5,
 		_("Shim"),
 		_("Pixels between images"),
 		VIPS_ARGUMENT_OPTIONAL_INPUT,
-		G_STRUCT_OFFSET(VipsArrayjoin, shim),
+		G_STRUCT_OFFSET(VipsArrayjoinBase, shim),
 		0, 1000000, 0);
 
 	VIPS_ARG_BOXED(class, "background", 6,
 		_("Background"),
 		_("Colour for new pixels"),
 		VIPS_ARGUMENT_OPTIONAL_INPUT,
-		G_STRUCT_OFFSET(VipsArrayjoin, background),
+		G_STRUCT_OFFSET(VipsArrayjoinBase, background),
 		VIPS_TYPE_ARRAY_DOUBLE);
 
 	VIPS_ARG_ENUM(class, "halign", 7,
 		_("Horizontal align"),
 		_("Align on the left, centre or right"),
 		VIPS_ARGUMENT_OPTIONAL_INPUT,
-		G_STRUCT_OFFSET(VipsArrayjoin, halign),
+		G_STRUCT_OFFSET(VipsArrayjoinBase, halign),
 		VIPS_TYPE_ALIGN, VIPS_ALIGN_LOW);
 
 	VIPS_ARG_ENUM(class, "valign", 8,
 		_("Vertical align"),
 		_("Align on the top, centre or bottom"),
 		VIPS_ARGUMENT_OPTIONAL_INPUT,
-		G_STRUCT_OFFSET(VipsArrayjoin, valign),
+		G_STRUCT_OFFSET(VipsArrayjoinBase, valign),
 		VIPS_TYPE_ALIGN, VIPS_ALIGN_LOW);
 
 	VIPS_ARG_INT(class, "hspacing", 9,
 		_("Horizontal spacing"),
 		_("Horizontal spacing between images"),
 		VIPS_ARGUMENT_OPTIONAL_INPUT,
-		G_STRUCT_OFFSET(VipsArrayjoin, hspacing),
+		G_STRUCT_OFFSET(VipsArrayjoinBase, hspacing),
 		1, 1000000, 1);
 
 	VIPS_ARG_INT(class, "vspacing", 10,
 		_("Vertical spacing"),
 		_("Vertical spacing between images"),
 		VIPS_ARGUMENT_OPTIONAL_INPUT,
-		G_STRUCT_OFFSET(VipsArrayjoin, vspacing),
+		G_STRUCT_OFFSET(VipsArrayjoinBase, vspacing),
 		1, 1000000, 1);
 }
 
 static void
-vips_arrayjoin_init(VipsArrayjoin *join)
+vips_arrayjoin_base_init(VipsArrayjoinBase *join)
 {
 	/* Init our instance fields.
 	 */
@@ -457,6 +434,475 @@ vips_arrayjoin_init(VipsArrayjoin *join)
 	((double *) (join->background->data))[0] = 0.0;
 }
 
+typedef struct _VipsArrayjoin {
+	VipsArrayjoinBase parent_instance;
+
+	/* Params.
+	 */
+	VipsArrayImage *in;
+
+	/* The inputs, aligned and embedded in their boxes.
+	 */
+	VipsImage **size;
+
+} VipsArrayjoin;
+
+typedef VipsArrayjoinBaseClass VipsArrayjoinClass;
+
+G_DEFINE_TYPE(VipsArrayjoin, vips_arrayjoin, vips_arrayjoin_base_get_type());
+
+static VipsImage *
+vips_arrayjoin_get(VipsArrayjoinBase *join, int i)
+{
+	VipsArrayjoin *arrayjoin = (VipsArrayjoin *) join;
+
+	return VIPS_IMAGE(g_object_ref(arrayjoin->size[i]));
+}
+
+static void
+vips_arrayjoin_minimise(VipsArrayjoinBase *join, int i)
+{
+	VipsArrayjoin *arrayjoin = (VipsArrayjoin *) join;
+
+	vips_image_minimise_all(arrayjoin->size[i]);
+}
+
+static int
+vips_arrayjoin_build(VipsObject *object)
+{
+	VipsObjectClass *class = VIPS_OBJECT_GET_CLASS(object);
+	VipsArrayjoinBase *base = (VipsArrayjoinBase *) object;
+	VipsArrayjoin *join = (VipsArrayjoin *) object;
+
+	VipsImage **in;
+	int n;
+
+	VipsImage **format;
+	VipsImage **band;
+
+	int hspacing;
+	int vspacing;
+	int i;
+
+	if (VIPS_OBJECT_CLASS(vips_arrayjoin_parent_class)->build(object))
+		return -1;
+
+	in = vips_array_image_get(join->in, &n);
+	/* Array length zero means error.
+	 */
+	if (n == 0)
+		return -1;
+
+	for (i = 0; i < n; i++)
+		if (vips_image_pio_input(in[i]) ||
+			vips_check_coding_known(class->nickname, in[i]))
+			return -1;
+
+	/* Move all input images to a common format and number of bands.
+	 */
+	format = (VipsImage **) vips_object_local_array(object, n);
+	if (vips__formatalike_vec(in, format, n))
+		return -1;
+	in = format;
+
+	/* We have to include the number of bands in @background in our
+	 * calculation.
+	 */
+	band = (VipsImage **) vips_object_local_array(object, n);
+	if (vips__bandalike_vec(class->nickname,
+			in, band, n, base->background->n))
+		return -1;
+	in = band;
+
+	/* Now sizealike: search for the largest image.
+	 */
+	hspacing = in[0]->Xsize;
+	vspacing = in[0]->Ysize;
+	for (i = 1; i < n; i++) {
+		if (in[i]->Xsize > hspacing)
+			hspacing = in[i]->Xsize;
+		if (in[i]->Ysize > vspacing)
+			vspacing = in[i]->Ysize;
+	}
+
+	base->n = n;
+	vips_arrayjoin_base_layout(base, hspacing, vspacing);
+
+	join->size = (VipsImage **) vips_object_local_array(object, n);
+	for (i = 0; i < n; i++)
+		if (vips_arrayjoin_base_embed(base, in[i], i, &join->size[i]))
+			return -1;
+
+	if (vips_arrayjoin_base_generate(base, join->size))
+		return -1;
+
+	return 0;
+}
+
+static void
+vips_arrayjoin_class_init(VipsArrayjoinClass *class)
+{
+	GObjectClass *gobject_class = G_OBJECT_CLASS(class);
+	VipsObjectClass *vobject_class = VIPS_OBJECT_CLASS(class);
+
+	VIPS_DEBUG_MSG("vips_arrayjoin_class_init\n");
+
+	gobject_class->set_property = vips_object_set_property;
+	gobject_class->get_property = vips_object_get_property;
+
+	vobject_class->nickname = "arrayjoin";
+	vobject_class->description = _("join an array of images");
+	vobject_class->build = vips_arrayjoin_build;
+
+	class->get = vips_arrayjoin_get;
+	class->minimise = vips_arrayjoin_minimise;
+
+	VIPS_ARG_BOXED(class, "in", -1,
+		_("Input"),
+		_("Array of input images"),
+		VIPS_ARGUMENT_REQUIRED_INPUT,
+		G_STRUCT_OFFSET(VipsArrayjoin, in),
+		VIPS_TYPE_ARRAY_IMAGE);
+}
+
+static void
+vips_arrayjoin_init(VipsArrayjoin *join)
+{
+}
+
+typedef struct _VipsArrayjoinLazy {
+	VipsArrayjoinBase parent_instance;
+
+	/* Params.
+	 */
+	char *filename;
+	VipsArrayjoinOpenFn open_fn;
+	void *client;
+	int max_open;
+
+	/* Tiles are cast to this format and number of bands.
+	 */
+	VipsBandFormat format;
+	int bands;
+
+	/* Open tiles, ready to paste, indexed by tile number. The LRU queue
+	 * holds the numbers of the open tiles, most recently used first, and
+	 * link[] is each tile's node in the queue.
+	 */
+	GMutex *lock;
+	VipsImage **tile;
+	GList **link;
+	GQueue *lru;
+
+} VipsArrayjoinLazy;
+
+typedef VipsArrayjoinBaseClass VipsArrayjoinLazyClass;
+
+G_DEFINE_TYPE(VipsArrayjoinLazy, vips_arrayjoin_lazy,
+	vips_arrayjoin_base_get_type());
+
+static void
+vips_arrayjoin_lazy_dispose(GObject *gobject)
+{
+	VipsArrayjoinLazy *lazy = (VipsArrayjoinLazy *) gobject;
+	VipsArrayjoinBase *join = (VipsArrayjoinBase *) gobject;
+
+	if (lazy->tile) {
+		int i;
+
+		for (i = 0; i < join->n; i++)
+			VIPS_UNREF(lazy->tile[i]);
+	}
+	VIPS_FREE(lazy->tile);
+	VIPS_FREE(lazy->link);
+	VIPS_FREEF(g_queue_free, lazy->lru);
+	VIPS_FREEF(vips_g_mutex_free, lazy->lock);
+
+	G_OBJECT_CLASS(vips_arrayjoin_lazy_parent_class)->dispose(gobject);
+}
+
+/* Open tile i, no processing.
+ */
+static VipsImage *
+vips_arrayjoin_lazy_load(VipsArrayjoinLazy *lazy, int i)
+{
+	VipsObjectClass *class = VIPS_OBJECT_GET_CLASS(lazy);
+
+	VipsImage *image;
+
+	if (lazy->open_fn)
+		image = lazy->open_fn(i, lazy->client);
+	else {
+		char filename[VIPS_PATH_MAX];
+
+		vips_snprintf(filename, VIPS_PATH_MAX, lazy->filename, i);
+		image = vips_image_new_from_file(filename, NULL);
+	}
+
+	if (!image)
+		vips_error(class->nickname, _("unable to open tile %d"), i);
+
+	return image;
+}
+
+/* Open tile i and get it ready to paste.
+ */
+static VipsImage *
+vips_arrayjoin_lazy_open(VipsArrayjoinLazy *lazy, int i)
+{
+	VipsObjectClass *class = VIPS_OBJECT_GET_CLASS(lazy);
+	VipsArrayjoinBase *join = (VipsArrayjoinBase *) lazy;
+
+	/* Run our pipeline relative to this.
+	 */
+	VipsImage *context = vips_image_new();
+
+	VipsImage **t = (VipsImage **)
+		vips_object_local_array(VIPS_OBJECT(context), 5);
+
+	VipsImage *tile;
+
+	if (!(t[0] = vips_arrayjoin_lazy_load(lazy, i)) ||
+		vips_image_decode(t[0], &t[1]) ||
+		vips_cast(t[1], &t[2], lazy->format, NULL) ||
+		vips__bandup(class->nickname, t[2], &t[3], lazy->bands) ||
+		vips_arrayjoin_base_embed(join, t[3], i, &t[4])) {
+		g_object_unref(context);
+		return NULL;
+	}
+
+	tile = t[4];
+	g_object_ref(tile);
+	g_object_unref(context);
+
+	return tile;
+}
+
+/* Call with the lock held.
+ */
+static void
+vips_arrayjoin_lazy_close(VipsArrayjoinLazy *lazy, int i)
+{
+	if (lazy->tile[i]) {
+		g_queue_delete_link(lazy->lru, lazy->link[i]);
+		lazy->link[i] = NULL;
+		VIPS_UNREF(lazy->tile[i]);
+	}
+}
+
+/* Tiles are opened outside the lock, so a slow open_fn doesn't hold up
+ * threads working on other tiles. If two threads open the same tile, the
+ * first to get back wins and the other copy is dropped.
+ */
+static VipsImage *
+vips_arrayjoin_lazy_get(VipsArrayjoinBase *join, int i)
+{
+	VipsArrayjoinLazy *lazy = (VipsArrayjoinLazy *) join;
+
+	VipsImage *tile;
+
+	g_mutex_lock(lazy->lock);
+
+	if (!lazy->tile[i]) {
+		g_mutex_unlock(lazy->lock);
+
+		if (!(tile = vips_arrayjoin_lazy_open(lazy, i)))
+			return NULL;
+
+		g_mutex_lock(lazy->lock);
+
+		if (lazy->tile[i])
+			VIPS_UNREF(tile);
+		else {
+			lazy->tile[i] = tile;
+			g_queue_push_head(lazy->lru, GINT_TO_POINTER(i));
+			lazy->link[i] = g_queue_peek_head_link(lazy->lru);
+		}
+	}
+
+	if (lazy->link[i] != g_queue_peek_head_link(lazy->lru)) {
+		g_queue_unlink(lazy->lru, lazy->link[i]);
+		g_queue_push_head_link(lazy->lru, lazy->link[i]);
+	}
+
+	tile = VIPS_IMAGE(g_object_ref(lazy->tile[i]));
+
+	/* Close least recently used tiles. Regions on them keep them alive
+	 * until they are done. max_open is at least 1, so we never close the
+	 * tile we just got.
+	 */
+	while ((int) g_queue_get_length(lazy->lru) > lazy->max_open)
+		vips_arrayjoin_lazy_close(lazy,
+			GPOINTER_TO_INT(g_queue_peek_tail(lazy->lru)));
+
+	g_mutex_unlock(lazy->lock);
+
+	return tile;
+}
+
+static void
+vips_arrayjoin_lazy_minimise(VipsArrayjoinBase *join, int i)
+{
+	VipsArrayjoinLazy *lazy = (VipsArrayjoinLazy *) join;
+
+	g_mutex_lock(lazy->lock);
+	vips_arrayjoin_lazy_close(lazy, i);
+	g_mutex_unlock(lazy->lock);
+}
+
+/* The filename must have a single %d and no other conversions. The %d can
+ * have flags, a width and a precision, eg. "tile_%05d.png".
+ */
+static gboolean
+vips_arrayjoin_lazy_template_ok(const char *filename)
+{
+	const char *p;
+	int n_d;
+
+	n_d = 0;
+	for (p = filename; *p; p++)
+		if (p[0] == '%') {
+			p += 1;
+			if (p[0] == '%')
+				continue;
+
+			p += strspn(p, "-+ #0");
+			p += strspn(p, "0123456789");
+			if (p[0] == '.') {
+				p += 1;
+				p += strspn(p, "0123456789");
+			}
+
+			if (p[0] != 'd')
+				return FALSE;
+			n_d += 1;
+		}
+
+	return n_d == 1;
+}
+
+static int
+vips_arrayjoin_lazy_build(VipsObject *object)
+{
+	VipsObjectClass *class = VIPS_OBJECT_GET_CLASS(object);
+	VipsArrayjoinBase *join = (VipsArrayjoinBase *) object;
+	VipsArrayjoinLazy *lazy = (VipsArrayjoinLazy *) object;
+	VipsImage **t = (VipsImage **) vips_object_local_array(object, 3);
+
+	VipsImage *in[2];
+
+	if (VIPS_OBJECT_CLASS(vips_arrayjoin_lazy_parent_class)->build(object))
+		return -1;
+
+	if (!lazy->open_fn) {
+		if (!lazy->filename) {
+			vips_error(class->nickname,
+				"%s", _("set one of filename or open_fn"));
+			return -1;
+		}
+
+		if (!vips_arrayjoin_lazy_template_ok(lazy->filename)) {
+			vips_error(class->nickname,
+				"%s", _("filename must contain a single %d"));
+			return -1;
+		}
+	}
+
+	/* The first tile sets the format, the number of bands and the
+	 * default spacing. We can't look at all of them.
+	 */
+	if (!(t[0] = vips_arrayjoin_lazy_load(lazy, 0)) ||
+		vips_image_decode(t[0], &t[1]))
+		return -1;
+
+	lazy->format = t[1]->BandFmt;
+	lazy->bands = VIPS_MAX(t[1]->Bands, join->background->n);
+
+	vips_arrayjoin_base_layout(join, t[1]->Xsize, t[1]->Ysize);
+
+	lazy->tile = VIPS_ARRAY(NULL, join->n, VipsImage *);
+	lazy->link = VIPS_ARRAY(NULL, join->n, GList *);
+	lazy->lru = g_queue_new();
+
+	/* Tile 0 stays in the cache for now, and the output is
+	 * pipelined to it.
+	 */
+	if (!(t[2] = vips_arrayjoin_lazy_get(join, 0)))
+		return -1;
+	in[0] = t[2];
+	in[1] = NULL;
+
+	if (vips_arrayjoin_base_generate(join, in))
+		return -1;
+
+	return 0;
+}
+
+static void
+vips_arrayjoin_lazy_class_init(VipsArrayjoinLazyClass *class)
+{
+	GObjectClass *gobject_class = G_OBJECT_CLASS(class);
+	VipsObjectClass *vobject_class = VIPS_OBJECT_CLASS(class);
+	VipsOperationClass *operation_class = VIPS_OPERATION_CLASS(class);
+
+	VIPS_DEBUG_MSG("vips_arrayjoin_lazy_class_init\n");
+
+	gobject_class->dispose = vips_arrayjoin_lazy_dispose;
+	gobject_class->set_property = vips_object_set_property;
+	gobject_class->get_property = vips_object_get_property;
+
+	vobject_class->nickname = "arrayjoin_lazy";
+	vobject_class->description = _("join an array of tiles, opened on demand");
+	vobject_class->build = vips_arrayjoin_lazy_build;
+
+	/* open_fn and client can't be hashed.
+	 */
+	operation_class->flags |= VIPS_OPERATION_NOCACHE;
+
+	class->get = vips_arrayjoin_lazy_get;
+	class->minimise = vips_arrayjoin_lazy_minimise;
+
+	VIPS_ARG_INT(class, "n", 3,
+		_("n"),
+		_("Number of tiles"),
+		VIPS_ARGUMENT_REQUIRED_INPUT,
+		G_STRUCT_OFFSET(VipsArrayjoinBase, n),
+		1, 100000000, 1);
+
+	VIPS_ARG_STRING(class, "filename", 11,
+		_("Filename"),
+		_("Tile filename, with %d for the tile number"),
+		VIPS_ARGUMENT_OPTIONAL_INPUT,
+		G_STRUCT_OFFSET(VipsArrayjoinLazy, filename),
+		NULL);
+
+	VIPS_ARG_POINTER(class, "open_fn", 12,
+		_("Open function"),
+		_("Call this to open each tile"),
+		VIPS_ARGUMENT_OPTIONAL_INPUT,
+		G_STRUCT_OFFSET(VipsArrayjoinLazy, open_fn));
+
+	VIPS_ARG_POINTER(class, "client", 13,
+		_("Client"),
+		_("Client data for open_fn"),
+		VIPS_ARGUMENT_OPTIONAL_INPUT,
+		G_STRUCT_OFFSET(VipsArrayjoinLazy, client));
+
+	VIPS_ARG_INT(class, "max_open", 14,
+		_("Max open"),
+		_("Maximum number of tiles to keep open"),
+		VIPS_ARGUMENT_OPTIONAL_INPUT,
+		G_STRUCT_OFFSET(VipsArrayjoinLazy, max_open),
+		1, 1000000, 100);
+}
+
+static void
+vips_arrayjoin_lazy_init(VipsArrayjoinLazy *lazy)
+{
+	lazy->max_open = 100;
+	lazy->lock = vips_g_mutex_new();
+}
+
 static int
 vips_arrayjoinv(VipsImage **in, VipsImage **out, int n, va_list ap)
 {
@@ -532,3 +978,68 @@ vips_arrayjoin(VipsImage **in, VipsImage **out, int n, ...)
 
 	return result;
 }
+
+/**
+ * VipsArrayjoinOpenFn:
+ * @i: tile number
+ * @client: client data
+ *
+ * Open tile @i for vips_arrayjoin_lazy().
+ *
+ * Returns: (transfer full): a new image, or %NULL on error
+ */
+
+/**
+ * vips_arrayjoin_lazy:
+ * @out: (out): output image
+ * @n: number of tiles
+ * @...: %NULL-terminated list of optional named arguments
+ *
+ * Optional arguments:
+ *
+ * * @filename: %gchararray, tile filename, with `%d` for the tile number
+ * * @open_fn: #VipsArrayjoinOpenFn, call this to open each tile
+ * * @client: %gpointer, client data for @open_fn
+ * * @max_open: %gint, maximum number of tiles to keep open
+ * * @across: %gint, number of images per row
+ * * @shim: %gint, space between images, in pixels
+ * * @background: #VipsArrayDouble, background ink colour
+ * * @halign: #VipsAlign, low, centre or high alignment
+ * * @valign: #VipsAlign, low, centre or high alignment
+ * * @hspacing: %gint, horizontal distance between images
+ * * @vspacing: %gint, vertical distance between images
+ *
+ * Lay out @n tiles in a grid, like vips_arrayjoin(), but open each tile only
+ * when a region of @out first needs it. Use this to join many thousands of
+ * tiles without running out of file descriptors.
+ *
+ * Tile i is either loaded from @filename, with the single `%d` replaced by
+ * i, or made by calling @open_fn with i and @client. @open_fn can be called
+ * from several threads at once. It must return a new reference, or %NULL and
+ * set an error.
+ *
+ * At most @max_open tiles are kept open, default 100. The least recently
+ * used tile is closed when another needs to open. In sequential mode, tiles
+ * are also closed once the output is well past them.
+ *
+ * Since only the first tile is opened in advance, it sets the format and the
+ * number of bands of @out, and @hspacing and @vspacing default to its size.
+ * Other tiles are cast to that format, and must have the same number of
+ * bands, or one band.
+ *
+ * See also: vips_arrayjoin().
+ *
+ * Returns: 0 on success, -1 on error
+ */
+int
+vips_arrayjoin_lazy(VipsImage **out, int n, ...)
+{
+	va_list ap;
+	int result;
+
+	va_start(ap, n);
+	result = vips_call_split("arrayjoin_lazy", ap, out, n);
+	va_end(ap);
+
+	return result;
+}
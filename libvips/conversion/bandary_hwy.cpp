@@ -0,0 +1,546 @@
+/* Highway kernels for vips_bandjoin(), vips_extract_band(),
+ * vips_bandmean() and vips_bandbool()
+ *
+ * 19/10/26
+ * 	- from bandjoin.c, extract.c and bandmean.c
+ * 	- add bandbool, from bandbool.c
+ */
+
+/*
+
+	This file is part of VIPS.
+
+	VIPS is free software; you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+	02110-1301  USA
+
+ */
+
+/*
+
+	These files are distributed with VIPS - http://www.vips.ecs.soton.ac.uk
+
+ */
+
+/* All of these work on images with up to four bands of 1, 2 or 4 byte
+ * elements, splitting and joining bands with the interleaved loads and
+ * stores, which compile to shuffles. They return the number of pixels they
+ * did, and the caller finishes the line with the C code.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif /*HAVE_CONFIG_H*/
+#include <glib/gi18n-lib.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <vips/vips.h>
+#include <vips/vector.h>
+#include <vips/debug.h>
+#include <vips/internal.h>
+
+#include "pconversion.h"
+
+#ifdef HAVE_HWY
+
+#undef HWY_TARGET_INCLUDE
+#define HWY_TARGET_INCLUDE "libvips/conversion/bandary_hwy.cpp"
+#include <hwy/foreach_target.h>
+#include <hwy/highway.h>
+
+namespace HWY_NAMESPACE {
+
+using namespace hwy::HWY_NAMESPACE;
+
+using DF32 = ScalableTag<float>;
+using DI32 = ScalableTag<int32_t>;
+constexpr DF32 df32;
+constexpr DI32 di32;
+constexpr Rebind<uint8_t, DI32> du8x32;
+constexpr Rebind<uint16_t, DI32> du16x32;
+
+/* Set band i of a pixel vector.
+ */
+template <class V>
+HWY_ATTR HWY_INLINE void
+vips_bandary_set_hwy(int i, V v, V &v0, V &v1, V &v2, V &v3)
+{
+	switch (i) {
+	case 0:
+		v0 = v;
+		break;
+
+	case 1:
+		v1 = v;
+		break;
+
+	case 2:
+		v2 = v;
+		break;
+
+	default:
+		v3 = v;
+		break;
+	}
+}
+
+/* Get band i of a pixel vector.
+ */
+template <class V>
+HWY_ATTR HWY_INLINE V
+vips_bandary_get_hwy(int i, V v0, V v1, V v2, V v3)
+{
+	switch (i) {
+	case 0:
+		return v0;
+
+	case 1:
+		return v1;
+
+	case 2:
+		return v2;
+
+	default:
+		return v3;
+	}
+}
+
+template <typename T>
+HWY_ATTR int
+vips_bandjoin_line_hwy(T *HWY_RESTRICT q, VipsPel **HWY_RESTRICT p,
+	int n, const int *HWY_RESTRICT bands, int out_bands, int width)
+{
+	const ScalableTag<T> d;
+	const int N = Lanes(d);
+
+	auto v0 = Zero(d);
+	auto v1 = Zero(d);
+	auto v2 = Zero(d);
+	auto v3 = Zero(d);
+	auto a = Zero(d);
+	auto b = Zero(d);
+	auto c = Zero(d);
+
+	int x;
+
+	for (x = 0; x + N <= width; x += N) {
+		int k;
+
+		k = 0;
+		for (int i = 0; i < n; i++) {
+			const T *p1 = (const T *) p[i] + x * bands[i];
+
+			switch (bands[i]) {
+			case 1:
+				vips_bandary_set_hwy(k, LoadU(d, p1),
+					v0, v1, v2, v3);
+				break;
+
+			case 2:
+				LoadInterleaved2(d, p1, a, b);
+				vips_bandary_set_hwy(k, a, v0, v1, v2, v3);
+				vips_bandary_set_hwy(k + 1, b, v0, v1, v2, v3);
+				break;
+
+			default:
+				LoadInterleaved3(d, p1, a, b, c);
+				vips_bandary_set_hwy(k, a, v0, v1, v2, v3);
+				vips_bandary_set_hwy(k + 1, b, v0, v1, v2, v3);
+				vips_bandary_set_hwy(k + 2, c, v0, v1, v2, v3);
+				break;
+			}
+
+			k += bands[i];
+		}
+
+		switch (out_bands) {
+		case 2:
+			StoreInterleaved2(v0, v1, d, q + x * 2);
+			break;
+
+		case 3:
+			StoreInterleaved3(v0, v1, v2, d, q + x * 3);
+			break;
+
+		default:
+			StoreInterleaved4(v0, v1, v2, v3, d, q + x * 4);
+			break;
+		}
+	}
+
+	return x;
+}
+
+HWY_ATTR int
+vips_bandjoin_hwy(VipsPel *HWY_RESTRICT q, VipsPel **HWY_RESTRICT p,
+	int n, const int *HWY_RESTRICT bands, int es, int width)
+{
+	int out_bands;
+
+	out_bands = 0;
+	for (int i = 0; i < n; i++)
+		out_bands += bands[i];
+	if (n < 2 ||
+		out_bands > 4)
+		return 0;
+
+	switch (es) {
+	case 1:
+		return vips_bandjoin_line_hwy((uint8_t *) q,
+			p, n, bands, out_bands, width);
+
+	case 2:
+		return vips_bandjoin_line_hwy((uint16_t *) q,
+			p, n, bands, out_bands, width);
+
+	case 4:
+		return vips_bandjoin_line_hwy((uint32_t *) q,
+			p, n, bands, out_bands, width);
+
+	default:
+		return 0;
+	}
+}
+
+template <typename T>
+HWY_ATTR int
+vips_extract_band_line_hwy(T *HWY_RESTRICT q, const T *HWY_RESTRICT p,
+	int in_bands, int band, int n, int width)
+{
+	const ScalableTag<T> d;
+	const int N = Lanes(d);
+
+	auto v0 = Zero(d);
+	auto v1 = Zero(d);
+	auto v2 = Zero(d);
+	auto v3 = Zero(d);
+
+	int x;
+
+	for (x = 0; x + N <= width; x += N) {
+		switch (in_bands) {
+		case 2:
+			LoadInterleaved2(d, p + x * 2, v0, v1);
+			break;
+
+		case 3:
+			LoadInterleaved3(d, p + x * 3, v0, v1, v2);
+			break;
+
+		default:
+			LoadInterleaved4(d, p + x * 4, v0, v1, v2, v3);
+			break;
+		}
+
+		switch (n) {
+		case 1:
+			StoreU(vips_bandary_get_hwy(band, v0, v1, v2, v3),
+				d, q + x);
+			break;
+
+		case 2:
+			StoreInterleaved2(
+				vips_bandary_get_hwy(band, v0, v1, v2, v3),
+				vips_bandary_get_hwy(band + 1, v0, v1, v2, v3),
+				d, q + x * 2);
+			break;
+
+		default:
+			StoreInterleaved3(
+				vips_bandary_get_hwy(band, v0, v1, v2, v3),
+				vips_bandary_get_hwy(band + 1, v0, v1, v2, v3),
+				vips_bandary_get_hwy(band + 2, v0, v1, v2, v3),
+				d, q + x * 3);
+			break;
+		}
+	}
+
+	return x;
+}
+
+HWY_ATTR int
+vips_extract_band_hwy(VipsPel *HWY_RESTRICT q, const VipsPel *HWY_RESTRICT p,
+	int in_bands, int band, int n, int es, int width)
+{
+	if (in_bands < 2 ||
+		in_bands > 4 ||
+		n > 3 ||
+		band + n > in_bands)
+		return 0;
+
+	switch (es) {
+	case 1:
+		return vips_extract_band_line_hwy((uint8_t *) q,
+			(const uint8_t *) p, in_bands, band, n, width);
+
+	case 2:
+		return vips_extract_band_line_hwy((uint16_t *) q,
+			(const uint16_t *) p, in_bands, band, n, width);
+
+	case 4:
+		return vips_extract_band_line_hwy((uint32_t *) q,
+			(const uint32_t *) p, in_bands, band, n, width);
+
+	default:
+		return 0;
+	}
+}
+
+/* Load a vector of pixels and sum the bands as int32.
+ */
+template <class D>
+HWY_ATTR HWY_INLINE Vec<DI32>
+vips_bandmean_sum_hwy(D d, const TFromD<D> *HWY_RESTRICT p, int bands)
+{
+	Vec<D> a, b, c, e;
+
+	switch (bands) {
+	case 2:
+		LoadInterleaved2(d, p, a, b);
+		return Add(PromoteTo(di32, a), PromoteTo(di32, b));
+
+	case 3:
+		LoadInterleaved3(d, p, a, b, c);
+		return Add(Add(PromoteTo(di32, a), PromoteTo(di32, b)),
+			PromoteTo(di32, c));
+
+	default:
+		LoadInterleaved4(d, p, a, b, c, e);
+		return Add(Add(PromoteTo(di32, a), PromoteTo(di32, b)),
+			Add(PromoteTo(di32, c), PromoteTo(di32, e)));
+	}
+}
+
+/* Round-to-nearest mean of unsigned int pixels, see UILOOP. The sum is
+ * always less than 2^24, so float division and truncation give exactly
+ * (sum + bands / 2) / bands.
+ */
+template <class D>
+HWY_ATTR int
+vips_bandmean_uint_hwy(D d, TFromD<D> *HWY_RESTRICT q,
+	const TFromD<D> *HWY_RESTRICT p, int bands, int width)
+{
+	const int N = Lanes(d);
+	const auto half = Set(di32, bands / 2);
+	const auto n = Set(df32, (float) bands);
+
+	int x;
+
+	for (x = 0; x + N <= width; x += N) {
+		auto sum = Add(vips_bandmean_sum_hwy(d, p + x * bands, bands),
+			half);
+		auto mean = ConvertTo(di32, Div(ConvertTo(df32, sum), n));
+
+		StoreU(DemoteTo(d, mean), d, q + x);
+	}
+
+	return x;
+}
+
+/* See FLOOP. We add to zero first, as the C does.
+ */
+HWY_ATTR int
+vips_bandmean_float_hwy(float *HWY_RESTRICT q, const float *HWY_RESTRICT p,
+	int bands, int width)
+{
+	const int N = Lanes(df32);
+	const auto n = Set(df32, (float) bands);
+
+	Vec<DF32> a, b, c, e;
+	int x;
+
+	for (x = 0; x + N <= width; x += N) {
+		auto sum = Zero(df32);
+
+		switch (bands) {
+		case 2:
+			LoadInterleaved2(df32, p + x * 2, a, b);
+			sum = Add(Add(sum, a), b);
+			break;
+
+		case 3:
+			LoadInterleaved3(df32, p + x * 3, a, b, c);
+			sum = Add(Add(Add(sum, a), b), c);
+			break;
+
+		default:
+			LoadInterleaved4(df32, p + x * 4, a, b, c, e);
+			sum = Add(Add(Add(Add(sum, a), b), c), e);
+			break;
+		}
+
+		StoreU(Div(sum, n), df32, q + x);
+	}
+
+	return x;
+}
+
+HWY_ATTR int
+vips_bandmean_hwy(VipsPel *HWY_RESTRICT q, const VipsPel *HWY_RESTRICT p,
+	int bands, VipsBandFormat format, int width)
+{
+	if (bands < 2 ||
+		bands > 4)
+		return 0;
+
+	switch (format) {
+	case VIPS_FORMAT_UCHAR:
+		return vips_bandmean_uint_hwy(du8x32, (uint8_t *) q,
+			(const uint8_t *) p, bands, width);
+
+	case VIPS_FORMAT_USHORT:
+		return vips_bandmean_uint_hwy(du16x32, (uint16_t *) q,
+			(const uint16_t *) p, bands, width);
+
+	case VIPS_FORMAT_FLOAT:
+		return vips_bandmean_float_hwy((float *) q,
+			(const float *) p, bands, width);
+
+	default:
+		return 0;
+	}
+}
+
+template <class V>
+HWY_ATTR HWY_INLINE V
+vips_bandbool_op_hwy(VipsOperationBoolean op, V a, V b)
+{
+	switch (op) {
+	case VIPS_OPERATION_BOOLEAN_OR:
+		return Or(a, b);
+
+	case VIPS_OPERATION_BOOLEAN_EOR:
+		return Xor(a, b);
+
+	default:
+		return And(a, b);
+	}
+}
+
+/* See LOOPB. The bitwise ops don't care about sign, so this works for all
+ * the int formats.
+ */
+template <typename T>
+HWY_ATTR int
+vips_bandbool_line_hwy(T *HWY_RESTRICT q, const T *HWY_RESTRICT p,
+	int bands, VipsOperationBoolean op, int width)
+{
+	const ScalableTag<T> d;
+	const int N = Lanes(d);
+
+	Vec<ScalableTag<T>> a, b, c, e;
+	int x;
+
+	for (x = 0; x + N <= width; x += N) {
+		switch (bands) {
+		case 2:
+			LoadInterleaved2(d, p + x * 2, a, b);
+			break;
+
+		case 3:
+			LoadInterleaved3(d, p + x * 3, a, b, c);
+			b = vips_bandbool_op_hwy(op, b, c);
+			break;
+
+		default:
+			LoadInterleaved4(d, p + x * 4, a, b, c, e);
+			b = vips_bandbool_op_hwy(op, b,
+				vips_bandbool_op_hwy(op, c, e));
+			break;
+		}
+
+		StoreU(vips_bandbool_op_hwy(op, a, b), d, q + x);
+	}
+
+	return x;
+}
+
+HWY_ATTR int
+vips_bandbool_hwy(VipsPel *HWY_RESTRICT q, const VipsPel *HWY_RESTRICT p,
+	int bands, VipsOperationBoolean op, int es, int width)
+{
+	if (bands < 2 ||
+		bands > 4)
+		return 0;
+
+	switch (es) {
+	case 1:
+		return vips_bandbool_line_hwy((uint8_t *) q,
+			(const uint8_t *) p, bands, op, width);
+
+	case 2:
+		return vips_bandbool_line_hwy((uint16_t *) q,
+			(const uint16_t *) p, bands, op, width);
+
+	case 4:
+		return vips_bandbool_line_hwy((uint32_t *) q,
+			(const uint32_t *) p, bands, op, width);
+
+	default:
+		return 0;
+	}
+}
+
+} /*namespace HWY_NAMESPACE*/
+
+#if HWY_ONCE
+HWY_EXPORT(vips_bandjoin_hwy);
+HWY_EXPORT(vips_extract_band_hwy);
+HWY_EXPORT(vips_bandmean_hwy);
+HWY_EXPORT(vips_bandbool_hwy);
+
+int
+vips_bandjoin_hwy(VipsPel *q, VipsPel **p,
+	int n, const int *bands, int es, int width)
+{
+	/* clang-format off */
+	return HWY_DYNAMIC_DISPATCH(vips_bandjoin_hwy)(q, p,
+		n, bands, es, width);
+	/* clang-format on */
+}
+
+int
+vips_extract_band_hwy(VipsPel *q, const VipsPel *p,
+	int in_bands, int band, int n, int es, int width)
+{
+	/* clang-format off */
+	return HWY_DYNAMIC_DISPATCH(vips_extract_band_hwy)(q, p,
+		in_bands, band, n, es, width);
+	/* clang-format on */
+}
+
+int
+vips_bandmean_hwy(VipsPel *q, const VipsPel *p,
+	int bands, VipsBandFormat format, int width)
+{
+	/* clang-format off */
+	return HWY_DYNAMIC_DISPATCH(vips_bandmean_hwy)(q, p,
+		bands, format, width);
+	/* clang-format on */
+}
+
+int
+vips_bandbool_hwy(VipsPel *q, const VipsPel *p,
+	int bands, VipsOperationBoolean op, int es, int width)
+{
+	/* clang-format off */
+	return HWY_DYNAMIC_DISPATCH(vips_bandbool_hwy)(q, p,
+		bands, op, es, width);
+	/* clang-format on */
+}
+#endif /*HWY_ONCE*/
+
+#endif /*HAVE_HWY*/
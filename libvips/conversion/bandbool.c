@@ -2,6 +2,8 @@
  *
  * 7/12/12
  * 	- from boolean.c
+ * 19/10/26
+ * 	- add a Highway path for int images
  */
 
 /*
@@ -44,6 +46,7 @@
 #include <stdlib.h>
 
 #include <vips/vips.h>
+#include <vips/vector.h>
 
 #include "bandary.h"
 
@@ -130,10 +133,10 @@ vips_bandbool_build(VipsObject *object)
 
 #define LOOPB(TYPE, OP) \
 	{ \
-		TYPE *p = (TYPE *) in[0]; \
+		TYPE *p = (TYPE *) in[0] + x0 * bands; \
 		TYPE *q = (TYPE *) out; \
 \
-		for (x = 0; x < width; x++) { \
+		for (x = x0; x < width; x++) { \
 			TYPE acc; \
 \
 			acc = p[0]; \
@@ -147,10 +150,10 @@ vips_bandbool_build(VipsObject *object)
 
 #define FLOOPB(TYPE, OP) \
 	{ \
-		TYPE *p = (TYPE *) in[0]; \
+		TYPE *p = (TYPE *) in[0] + x0 * bands; \
 		int *q = (int *) out; \
 \
-		for (x = 0; x < width; x++) { \
+		for (x = x0; x < width; x++) { \
 			int acc; \
 \
 			acc = (int) p[0]; \
@@ -171,7 +174,16 @@ vips_bandbool_buffer(VipsBandarySequence *seq,
 	VipsImage *im = bandary->ready[0];
 	int bands = im->Bands;
 
-	int x, b;
+	int x, b, x0;
+
+	x0 = 0;
+
+#ifdef HAVE_HWY
+	if (vips_vector_isenabled() &&
+		vips_band_format_isint(im->BandFmt))
+		x0 = vips_bandbool_hwy(out, in[0], bands, bandbool->operation,
+			VIPS_IMAGE_SIZEOF_ELEMENT(im), width);
+#endif /*HAVE_HWY*/
 
 	switch (bandbool->operation) {
 	case VIPS_OPERATION_BOOLEAN_AND:
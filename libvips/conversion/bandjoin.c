@@ -26,6 +26,8 @@
  * 	- rewrite as a class
  * 7/11/15
  * 	- added bandjoin_const
+ * 19/10/26
+ * 	- add a Highway path
  */
 
 /*
@@ -70,6 +72,7 @@
 #include <math.h>
 
 #include <vips/vips.h>
+#include <vips/vector.h>
 #include <vips/internal.h>
 #include <vips/debug.h>
 
@@ -99,7 +102,24 @@ vips_bandjoin_buffer(VipsBandarySequence *seq,
 	 */
 	const int ops = VIPS_IMAGE_SIZEOF_PEL(conversion->out);
 
-	int i;
+	int i, x0;
+
+	x0 = 0;
+
+#ifdef HAVE_HWY
+	/* Up to four bands of 1, 2 or 4 byte elements.
+	 */
+	if (bandary->out_bands <= 4 &&
+		vips_vector_isenabled()) {
+		int bands[4];
+
+		for (i = 0; i < bandary->n; i++)
+			bands[i] = in[i]->Bands;
+
+		x0 = vips_bandjoin_hwy(q, p, bandary->n, bands,
+			VIPS_IMAGE_SIZEOF_ELEMENT(in[0]), width);
+	}
+#endif /*HAVE_HWY*/
 
 	/* Loop for each input image. Scattered write is faster than
 	 * scattered read.
@@ -113,20 +133,21 @@ vips_bandjoin_buffer(VipsBandarySequence *seq,
 		VipsPel *restrict q1;
 		int x, z;
 
-		q1 = q;
-		p1 = p[i];
+		q1 = q + x0 * ops;
+		p1 = p[i] + x0 * ips;
 
 		if (ips == 1) {
-			for (x = 0; x < width; x++) {
-				q1[0] = p1[x];
+			for (x = x0; x < width; x++) {
+				q1[0] = p1[0];
 
+				p1 += 1;
 				q1 += ops;
 			}
 
 			q += ips;
 		}
 		else if (ips == 3) {
-			for (x = 0; x < width; x++) {
+			for (x = x0; x < width; x++) {
 				q1[0] = p1[0];
 				q1[1] = p1[1];
 				q1[2] = p1[2];
@@ -138,7 +159,7 @@ vips_bandjoin_buffer(VipsBandarySequence *seq,
 			q += ips;
 		}
 		else {
-			for (x = 0; x < width; x++) {
+			for (x = x0; x < width; x++) {
 				for (z = 0; z < ips; z++)
 					q1[z] = p1[z];
 
@@ -9,6 +9,8 @@
  * 	- get rid of the complex case, just double the width
  * 19/11/11
  * 	- redo as a class
+ * 19/10/26
+ * 	- add a Highway path
  */
 
 /*
@@ -52,6 +54,7 @@
 #include <math.h>
 
 #include <vips/vips.h>
+#include <vips/vector.h>
 
 #include "bandary.h"
 
@@ -70,7 +73,7 @@ G_DEFINE_TYPE(VipsBandmean, vips_bandmean, VIPS_TYPE_BANDARY);
  */
 #define UILOOP(TYPE, STYPE) \
 	{ \
-		TYPE *p = (TYPE *) in[0]; \
+		TYPE *p = (TYPE *) p0; \
 		TYPE *q = (TYPE *) out; \
 \
 		for (i = 0; i < sz; i++) { \
@@ -88,7 +91,7 @@ G_DEFINE_TYPE(VipsBandmean, vips_bandmean, VIPS_TYPE_BANDARY);
  */
 #define SILOOP(TYPE, STYPE) \
 	{ \
-		TYPE *p = (TYPE *) in[0]; \
+		TYPE *p = (TYPE *) p0; \
 		TYPE *q = (TYPE *) out; \
 \
 		for (i = 0; i < sz; i++) { \
@@ -108,7 +111,7 @@ G_DEFINE_TYPE(VipsBandmean, vips_bandmean, VIPS_TYPE_BANDARY);
  */
 #define FLOOP(TYPE) \
 	{ \
-		TYPE *p = (TYPE *) in[0]; \
+		TYPE *p = (TYPE *) p0; \
 		TYPE *q = (TYPE *) out; \
 \
 		for (i = 0; i < sz; i++) { \
@@ -129,11 +132,23 @@ vips_bandmean_buffer(VipsBandarySequence *seq,
 	VipsBandary *bandary = seq->bandary;
 	VipsImage *im = bandary->ready[0];
 	const int bands = im->Bands;
-	const int sz = width *
+	int sz = width *
 		(vips_band_format_iscomplex(im->BandFmt) ? 2 : 1);
+	VipsPel *p0 = in[0];
 
 	int i, j;
 
+#ifdef HAVE_HWY
+	if (vips_vector_isenabled()) {
+		int n = vips_bandmean_hwy(out, p0,
+			bands, vips_image_get_format(im), sz);
+
+		p0 += n * VIPS_IMAGE_SIZEOF_PEL(im);
+		out += n * VIPS_IMAGE_SIZEOF_ELEMENT(im);
+		sz -= n;
+	}
+#endif /*HAVE_HWY*/
+
 	switch (vips_image_get_format(im)) {
 	case VIPS_FORMAT_CHAR:
 		SILOOP(signed char, int);
@@ -56,6 +56,8 @@
  * 	- remove old overflow/underflow detect
  * 8/12/20
  * 	- fix range clip in int32 -> unsigned casts [ewelot]
+ * 19/10/26
+ * 	- add a Highway path
  */
 
 /*
@@ -100,6 +102,7 @@
 #include <math.h>
 
 #include <vips/vips.h>
+#include <vips/vector.h>
 #include <vips/internal.h>
 #include <vips/debug.h>
 
@@ -362,7 +365,7 @@ vips_cast_gen(VipsRegion *out_region,
 	VipsCast *cast = (VipsCast *) b;
 	VipsConversion *conversion = (VipsConversion *) b;
 	VipsRect *r = &out_region->valid;
-	int sz = VIPS_REGION_N_ELEMENTS(out_region);
+	int ne = VIPS_REGION_N_ELEMENTS(out_region);
 
 	int x, y;
 
@@ -374,6 +377,22 @@ vips_cast_gen(VipsRegion *out_region,
 	for (y = 0; y < r->height; y++) {
 		VipsPel *in = VIPS_REGION_ADDR(ir, r->left, r->top + y);
 		VipsPel *out = VIPS_REGION_ADDR(out_region, r->left, r->top + y);
+		int sz = ne;
+
+#ifdef HAVE_HWY
+		/* Do as much as we can with Highway, then finish the line with
+		 * the C code.
+		 */
+		if (vips_vector_isenabled()) {
+			int n = vips_cast_hwy(out, in, sz,
+				ir->im->BandFmt, conversion->out->BandFmt,
+				cast->shift);
+
+			in += n * VIPS_IMAGE_SIZEOF_ELEMENT(ir->im);
+			out += n * VIPS_IMAGE_SIZEOF_ELEMENT(conversion->out);
+			sz -= n;
+		}
+#endif /*HAVE_HWY*/
 
 		switch (ir->im->BandFmt) {
 		case VIPS_FORMAT_UCHAR:
@@ -0,0 +1,558 @@
+/* Highway kernels for vips_cast()
+ *
+ * 19/10/26
+ * 	- from cast.c
+ */
+
+/*
+
+	This file is part of VIPS.
+
+	VIPS is free software; you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+	02110-1301  USA
+
+ */
+
+/*
+
+	These files are distributed with VIPS - http://www.vips.ecs.soton.ac.uk
+
+ */
+
+/* These must match the macros in cast.c exactly.
+ *
+ * Integer sources are widened to 32-bit lanes, clipped to the output range,
+ * then narrowed with a saturating demote, which can't saturate since we've
+ * already clipped. cast.c clips uint sources going to 8 and 16-bit formats
+ * as int, so they are read as int32 here too.
+ *
+ * In shift mode, the shifted value always fits an integer of the output
+ * size with the signedness of the input, so we demote to that and then
+ * reinterpret, which wraps in the same way as the C assignment.
+ *
+ * Float sources are clipped as float or double, then truncated. INT_MAX
+ * isn't representable as a float, so float to int handles the top end
+ * separately.
+ *
+ * uint sources to float or double, and float or double to uint, need
+ * unsigned conversions we don't have on all targets, so they are left to the
+ * C code, as are complex formats.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif /*HAVE_CONFIG_H*/
+#include <glib/gi18n-lib.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits>
+#include <type_traits>
+
+#include <vips/vips.h>
+#include <vips/vector.h>
+#include <vips/debug.h>
+#include <vips/internal.h>
+
+#include "pconversion.h"
+
+#ifdef HAVE_HWY
+
+#undef HWY_TARGET_INCLUDE
+#define HWY_TARGET_INCLUDE "libvips/conversion/cast_hwy.cpp"
+#include <hwy/foreach_target.h>
+#include <hwy/highway.h>
+
+namespace HWY_NAMESPACE {
+
+using namespace hwy::HWY_NAMESPACE;
+
+/* The type we read an integer source as. uint to a smaller format is clipped
+ * as an int.
+ */
+template <typename TI, typename TO>
+using SourceT = typename std::conditional<
+	std::is_same<TI, uint32_t>::value && sizeof(TO) < 4,
+	int32_t, TI>::type;
+
+/* The 32-bit type we do integer arithmetic in.
+ */
+template <typename TS>
+using WideT = typename std::conditional<
+	std::is_same<TS, uint32_t>::value, uint32_t, int32_t>::type;
+
+/* Load a vector of integer source pixels widened to 32 bits.
+ */
+template <class D>
+HWY_ATTR HWY_INLINE Vec<D>
+vips_cast_load_hwy(D d, const uint8_t *HWY_RESTRICT p)
+{
+	return PromoteTo(d, LoadU(Rebind<uint8_t, D>(), p));
+}
+
+template <class D>
+HWY_ATTR HWY_INLINE Vec<D>
+vips_cast_load_hwy(D d, const int8_t *HWY_RESTRICT p)
+{
+	return PromoteTo(d, LoadU(Rebind<int8_t, D>(), p));
+}
+
+template <class D>
+HWY_ATTR HWY_INLINE Vec<D>
+vips_cast_load_hwy(D d, const uint16_t *HWY_RESTRICT p)
+{
+	return PromoteTo(d, LoadU(Rebind<uint16_t, D>(), p));
+}
+
+template <class D>
+HWY_ATTR HWY_INLINE Vec<D>
+vips_cast_load_hwy(D d, const int16_t *HWY_RESTRICT p)
+{
+	return PromoteTo(d, LoadU(Rebind<int16_t, D>(), p));
+}
+
+template <class D>
+HWY_ATTR HWY_INLINE Vec<D>
+vips_cast_load_hwy(D d, const uint32_t *HWY_RESTRICT p)
+{
+	return BitCast(d, LoadU(RebindToUnsigned<D>(), p));
+}
+
+template <class D>
+HWY_ATTR HWY_INLINE Vec<D>
+vips_cast_load_hwy(D d, const int32_t *HWY_RESTRICT p)
+{
+	return BitCast(d, LoadU(RebindToSigned<D>(), p));
+}
+
+/* Narrow 32-bit lanes holding in-range values to the output type.
+ */
+template <class DO, class V>
+HWY_ATTR HWY_INLINE Vec<DO>
+vips_cast_narrow_hwy(hwy::SizeTag<4>, DO d, V v)
+{
+	return BitCast(d, v);
+}
+
+template <size_t kSize, class DO, class V>
+HWY_ATTR HWY_INLINE Vec<DO>
+vips_cast_narrow_hwy(hwy::SizeTag<kSize>, DO d, V v)
+{
+	return DemoteTo(d, BitCast(Rebind<int32_t, DO>(), v));
+}
+
+/* Int to int, clipping, see CAST_INT_INT.
+ */
+template <typename TO, typename TI>
+HWY_ATTR int
+vips_cast_int_int_hwy(TO *HWY_RESTRICT q, const TI *HWY_RESTRICT p,
+	int sz)
+{
+	using TS = SourceT<TI, TO>;
+	using TW = WideT<TS>;
+	const ScalableTag<TW> dw;
+	const Rebind<TO, decltype(dw)> dout;
+	const int N = Lanes(dw);
+
+	const gint64 s_min = std::numeric_limits<TS>::min();
+	const gint64 s_max = std::numeric_limits<TS>::max();
+	const gint64 lo = VIPS_MAX(s_min,
+		(gint64) std::numeric_limits<TO>::min());
+	const gint64 hi = VIPS_MIN(s_max,
+		(gint64) std::numeric_limits<TO>::max());
+	const auto vlo = Set(dw, (TW) lo);
+	const auto vhi = Set(dw, (TW) hi);
+
+	int x;
+
+	for (x = 0; x + N <= sz; x += N) {
+		auto v = vips_cast_load_hwy(dw, (const TS *) p + x);
+
+		if (lo > s_min)
+			v = Max(v, vlo);
+		if (hi < s_max)
+			v = Min(v, vhi);
+
+		StoreU(vips_cast_narrow_hwy(hwy::SizeTag<sizeof(TO)>(), dout, v),
+			dout, q + x);
+	}
+
+	return x;
+}
+
+/* Int to int in shift mode, see SHIFT_RIGHT, SHIFT_LEFT and
+ * SHIFT_LEFT_SIGNED.
+ */
+template <typename TO, typename TI>
+HWY_ATTR int
+vips_cast_shift_hwy(TO *HWY_RESTRICT q, const TI *HWY_RESTRICT p, int sz)
+{
+	using TW = WideT<TI>;
+	using TN = typename std::conditional<std::is_signed<TI>::value,
+		hwy::MakeSigned<TO>, hwy::MakeUnsigned<TO>>::type;
+	const ScalableTag<TW> dw;
+	const Rebind<TN, decltype(dw)> dn;
+	const Rebind<TO, decltype(dw)> dout;
+	const int N = Lanes(dw);
+
+	constexpr bool right = sizeof(TI) > sizeof(TO);
+	constexpr int shift = right
+		? 8 * (sizeof(TI) - sizeof(TO))
+		: 8 * (sizeof(TO) - sizeof(TI));
+	const auto one = Set(dw, 1);
+
+	int x;
+
+	for (x = 0; x + N <= sz; x += N) {
+		auto v = vips_cast_load_hwy(dw, p + x);
+
+		if (right)
+			v = ShiftRight<shift>(v);
+		else {
+			/* Copy the bottom bit into the new bits.
+			 */
+			auto bit = And(v, one);
+
+			v = Or(ShiftLeft<shift>(v), Sub(ShiftLeft<shift>(bit), bit));
+		}
+
+		StoreU(BitCast(dout,
+				   vips_cast_narrow_hwy(hwy::SizeTag<sizeof(TO)>(), dn, v)),
+			dout, q + x);
+	}
+
+	return x;
+}
+
+/* Int to float and double, see CAST_REAL_FLOAT.
+ */
+template <typename TI>
+HWY_ATTR int
+vips_cast_int_float_hwy(float *HWY_RESTRICT q, const TI *HWY_RESTRICT p,
+	int sz)
+{
+	const ScalableTag<float> df;
+	const RebindToSigned<decltype(df)> di;
+	const int N = Lanes(df);
+
+	int x;
+
+	for (x = 0; x + N <= sz; x += N)
+		StoreU(ConvertTo(df, vips_cast_load_hwy(di, p + x)), df, q + x);
+
+	return x;
+}
+
+HWY_ATTR int
+vips_cast_int_float_hwy(float *HWY_RESTRICT q, const uint32_t *HWY_RESTRICT p,
+	int sz)
+{
+	return 0;
+}
+
+template <typename TI>
+HWY_ATTR int
+vips_cast_int_double_hwy(double *HWY_RESTRICT q, const TI *HWY_RESTRICT p,
+	int sz)
+{
+	const ScalableTag<double> dd;
+	const Rebind<int32_t, decltype(dd)> di;
+	const int N = Lanes(dd);
+
+	int x;
+
+	for (x = 0; x + N <= sz; x += N)
+		StoreU(PromoteTo(dd, vips_cast_load_hwy(di, p + x)), dd, q + x);
+
+	return x;
+}
+
+HWY_ATTR int
+vips_cast_int_double_hwy(double *HWY_RESTRICT q,
+	const uint32_t *HWY_RESTRICT p, int sz)
+{
+	return 0;
+}
+
+/* Float and double to int, see CAST_FLOAT_INT.
+ */
+template <typename TO>
+HWY_ATTR int
+vips_cast_real_int_hwy(TO *HWY_RESTRICT q, const float *HWY_RESTRICT p,
+	int sz)
+{
+	const ScalableTag<float> df;
+	const RebindToSigned<decltype(df)> di;
+	const Rebind<TO, decltype(df)> dout;
+	const int N = Lanes(df);
+
+	const auto lo = Set(df, (float) std::numeric_limits<TO>::min());
+	const auto hi = Set(df, (float) std::numeric_limits<TO>::max());
+
+	int x;
+
+	for (x = 0; x + N <= sz; x += N) {
+		auto v = Min(Max(LoadU(df, p + x), lo), hi);
+
+		StoreU(vips_cast_narrow_hwy(hwy::SizeTag<sizeof(TO)>(), dout,
+				   ConvertTo(di, v)),
+			dout, q + x);
+	}
+
+	return x;
+}
+
+HWY_ATTR int
+vips_cast_real_int_hwy(int32_t *HWY_RESTRICT q, const float *HWY_RESTRICT p,
+	int sz)
+{
+	const ScalableTag<float> df;
+	const RebindToSigned<decltype(df)> di;
+	const int N = Lanes(df);
+
+	/* Anything at or above 2^31 clips to INT_MAX.
+	 */
+	const auto lo = Set(df, (float) std::numeric_limits<int32_t>::min());
+	const auto top = Set(df, 2147483648.0f);
+	const auto max = Set(di, std::numeric_limits<int32_t>::max());
+
+	int x;
+
+	for (x = 0; x + N <= sz; x += N) {
+		auto v = Max(LoadU(df, p + x), lo);
+		auto big = Le(top, v);
+
+		StoreU(IfThenElse(RebindMask(di, big), max,
+				   ConvertTo(di, IfThenZeroElse(big, v))),
+			di, q + x);
+	}
+
+	return x;
+}
+
+HWY_ATTR int
+vips_cast_real_int_hwy(uint32_t *HWY_RESTRICT q, const float *HWY_RESTRICT p,
+	int sz)
+{
+	return 0;
+}
+
+template <typename TO>
+HWY_ATTR int
+vips_cast_real_int_hwy(TO *HWY_RESTRICT q, const double *HWY_RESTRICT p,
+	int sz)
+{
+	const ScalableTag<double> dd;
+	const Rebind<int32_t, decltype(dd)> di;
+	const Rebind<TO, decltype(dd)> dout;
+	const int N = Lanes(dd);
+
+	const auto lo = Set(dd, (double) std::numeric_limits<TO>::min());
+	const auto hi = Set(dd, (double) std::numeric_limits<TO>::max());
+
+	int x;
+
+	for (x = 0; x + N <= sz; x += N) {
+		auto v = Min(Max(LoadU(dd, p + x), lo), hi);
+
+		StoreU(vips_cast_narrow_hwy(hwy::SizeTag<sizeof(TO)>(), dout,
+				   DemoteTo(di, v)),
+			dout, q + x);
+	}
+
+	return x;
+}
+
+HWY_ATTR int
+vips_cast_real_int_hwy(uint32_t *HWY_RESTRICT q, const double *HWY_RESTRICT p,
+	int sz)
+{
+	return 0;
+}
+
+HWY_ATTR int
+vips_cast_float_double_hwy(double *HWY_RESTRICT q,
+	const float *HWY_RESTRICT p, int sz)
+{
+	const ScalableTag<double> dd;
+	const Rebind<float, decltype(dd)> df;
+	const int N = Lanes(dd);
+
+	int x;
+
+	for (x = 0; x + N <= sz; x += N)
+		StoreU(PromoteTo(dd, LoadU(df, p + x)), dd, q + x);
+
+	return x;
+}
+
+HWY_ATTR int
+vips_cast_double_float_hwy(float *HWY_RESTRICT q,
+	const double *HWY_RESTRICT p, int sz)
+{
+	const ScalableTag<double> dd;
+	const Rebind<float, decltype(dd)> df;
+	const int N = Lanes(dd);
+
+	int x;
+
+	for (x = 0; x + N <= sz; x += N)
+		StoreU(DemoteTo(df, LoadU(dd, p + x)), df, q + x);
+
+	return x;
+}
+
+template <typename TI>
+HWY_ATTR int
+vips_cast_from_int_hwy(VipsPel *HWY_RESTRICT out, const TI *HWY_RESTRICT p,
+	int sz, VipsBandFormat format, gboolean shift)
+{
+	switch (format) {
+	case VIPS_FORMAT_UCHAR:
+		return shift
+			? vips_cast_shift_hwy((uint8_t *) out, p, sz)
+			: vips_cast_int_int_hwy((uint8_t *) out, p, sz);
+
+	case VIPS_FORMAT_CHAR:
+		return shift
+			? vips_cast_shift_hwy((int8_t *) out, p, sz)
+			: vips_cast_int_int_hwy((int8_t *) out, p, sz);
+
+	case VIPS_FORMAT_USHORT:
+		return shift
+			? vips_cast_shift_hwy((uint16_t *) out, p, sz)
+			: vips_cast_int_int_hwy((uint16_t *) out, p, sz);
+
+	case VIPS_FORMAT_SHORT:
+		return shift
+			? vips_cast_shift_hwy((int16_t *) out, p, sz)
+			: vips_cast_int_int_hwy((int16_t *) out, p, sz);
+
+	case VIPS_FORMAT_UINT:
+		return shift
+			? vips_cast_shift_hwy((uint32_t *) out, p, sz)
+			: vips_cast_int_int_hwy((uint32_t *) out, p, sz);
+
+	case VIPS_FORMAT_INT:
+		return shift
+			? vips_cast_shift_hwy((int32_t *) out, p, sz)
+			: vips_cast_int_int_hwy((int32_t *) out, p, sz);
+
+	case VIPS_FORMAT_FLOAT:
+		return vips_cast_int_float_hwy((float *) out, p, sz);
+
+	case VIPS_FORMAT_DOUBLE:
+		return vips_cast_int_double_hwy((double *) out, p, sz);
+
+	default:
+		return 0;
+	}
+}
+
+template <typename TI>
+HWY_ATTR int
+vips_cast_from_real_hwy(VipsPel *HWY_RESTRICT out, const TI *HWY_RESTRICT p,
+	int sz, VipsBandFormat format)
+{
+	switch (format) {
+	case VIPS_FORMAT_UCHAR:
+		return vips_cast_real_int_hwy((uint8_t *) out, p, sz);
+
+	case VIPS_FORMAT_CHAR:
+		return vips_cast_real_int_hwy((int8_t *) out, p, sz);
+
+	case VIPS_FORMAT_USHORT:
+		return vips_cast_real_int_hwy((uint16_t *) out, p, sz);
+
+	case VIPS_FORMAT_SHORT:
+		return vips_cast_real_int_hwy((int16_t *) out, p, sz);
+
+	case VIPS_FORMAT_UINT:
+		return vips_cast_real_int_hwy((uint32_t *) out, p, sz);
+
+	case VIPS_FORMAT_INT:
+		return vips_cast_real_int_hwy((int32_t *) out, p, sz);
+
+	default:
+		return 0;
+	}
+}
+
+HWY_ATTR int
+vips_cast_hwy(VipsPel *HWY_RESTRICT out, const VipsPel *HWY_RESTRICT in,
+	int sz, VipsBandFormat in_format, VipsBandFormat out_format,
+	gboolean shift)
+{
+	switch (in_format) {
+	case VIPS_FORMAT_UCHAR:
+		return vips_cast_from_int_hwy(out,
+			(const uint8_t *) in, sz, out_format, shift);
+
+	case VIPS_FORMAT_CHAR:
+		return vips_cast_from_int_hwy(out,
+			(const int8_t *) in, sz, out_format, shift);
+
+	case VIPS_FORMAT_USHORT:
+		return vips_cast_from_int_hwy(out,
+			(const uint16_t *) in, sz, out_format, shift);
+
+	case VIPS_FORMAT_SHORT:
+		return vips_cast_from_int_hwy(out,
+			(const int16_t *) in, sz, out_format, shift);
+
+	case VIPS_FORMAT_UINT:
+		return vips_cast_from_int_hwy(out,
+			(const uint32_t *) in, sz, out_format, shift);
+
+	case VIPS_FORMAT_INT:
+		return vips_cast_from_int_hwy(out,
+			(const int32_t *) in, sz, out_format, shift);
+
+	case VIPS_FORMAT_FLOAT:
+		if (out_format == VIPS_FORMAT_DOUBLE)
+			return vips_cast_float_double_hwy((double *) out,
+				(const float *) in, sz);
+		return vips_cast_from_real_hwy(out,
+			(const float *) in, sz, out_format);
+
+	case VIPS_FORMAT_DOUBLE:
+		if (out_format == VIPS_FORMAT_FLOAT)
+			return vips_cast_double_float_hwy((float *) out,
+				(const double *) in, sz);
+		return vips_cast_from_real_hwy(out,
+			(const double *) in, sz, out_format);
+
+	default:
+		return 0;
+	}
+}
+
+} /*namespace HWY_NAMESPACE*/
+
+#if HWY_ONCE
+HWY_EXPORT(vips_cast_hwy);
+
+int
+vips_cast_hwy(VipsPel *out, const VipsPel *in, int sz,
+	VipsBandFormat in_format, VipsBandFormat out_format, gboolean shift)
+{
+	/* clang-format off */
+	return HWY_DYNAMIC_DISPATCH(vips_cast_hwy)(out, in, sz,
+		in_format, out_format, shift);
+	/* clang-format on */
+}
+#endif /*HWY_ONCE*/
+
+#endif /*HAVE_HWY*/
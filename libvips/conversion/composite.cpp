@@ -15,6 +15,11 @@
  *	- do our own subimage positioning
  * 8/5/19
  * 	- revise in/out/dest-in/dest-out to make smoother alpha
+ * 19/10/26
+ * 	- add Highway paths for RGBA
+ * 	- add a fixed-point path for premultiplied 8 and 16-bit Porter-Duff
+ * 	  modes
+ * 	- index layers with a grid, and make input regions on demand
  */
 
 /*
@@ -67,6 +72,7 @@
 #endif
 
 #include <vips/vips.h>
+#include <vips/vector.h>
 #include <vips/internal.h>
 #include <vips/debug.h>
 
@@ -134,6 +140,28 @@ typedef struct _VipsCompositeBase {
 	 */
 	gboolean skippable;
 
+	/* TRUE if we can use the fixed-point path: premultiplied 8 or 16-bit
+	 * RGBA, and only modes vips_composite_mode_fixed() allows.
+	 */
+	gboolean fixed;
+
+	/* In skippable mode, a uniform grid of cells over the output for
+	 * finding the layers which intersect a request. The layers touching
+	 * cell i are cell_layers[cell_start[i]] to
+	 * cell_layers[cell_start[i + 1] - 1], in stack order.
+	 */
+	int cell_size;
+	int cells_across;
+	int cells_down;
+	int *cell_start;
+	int *cell_layers;
+
+	/* Layers which cover too many cells to list. We test these for
+	 * every request.
+	 */
+	int n_big;
+	int *big;
+
 } VipsCompositeBase;
 
 typedef VipsConversionClass VipsCompositeBaseClass;
@@ -159,6 +187,9 @@ vips_composite_base_dispose(GObject *gobject)
 		composite->mode = NULL;
 	}
 	VIPS_FREE(composite->subimages);
+	VIPS_FREE(composite->cell_start);
+	VIPS_FREE(composite->cell_layers);
+	VIPS_FREE(composite->big);
 
 	G_OBJECT_CLASS(vips_composite_base_parent_class)->dispose(gobject);
 }
@@ -176,13 +207,26 @@ typedef struct {
 
 	VipsCompositeBase *composite;
 
-	/* Full set of input regions, each made on the corresponding input
-	 * image.
+	/* The input images, and how many there are.
+	 */
+	VipsImage **in;
+	int n_in;
+
+	/* Input regions, each made on the corresponding input image. These
+	 * are only made when a request first needs that layer, and are
+	 * freed again once requests have moved past it, so the number open
+	 * depends on the number of layers we can see, not the total.
 	 */
 	VipsRegion **input_regions;
 
+	/* The layers which currently have an input region.
+	 */
+	int *live;
+	int n_live;
+
 	/* We then vips_region_prepare_to() to one of this set of regions,
-	 * each defined on the base image.
+	 * each defined on the base image. There's one for each enabled
+	 * layer, made as we need them.
 	 */
 	VipsRegion **composite_regions;
 
@@ -190,12 +234,23 @@ typedef struct {
 	 */
 	int n;
 
+	/* Stamp layers with this as we select them, so we only add layers
+	 * which appear in several grid cells once.
+	 */
+	guint stamp;
+	guint *seen;
+
 	/* For each of @n above (inputs which intersect this request), the
 	 * index of the input image we need. We can use this index to get the
 	 * position, input region and composite region.
 	 */
 	int *enabled;
 
+	/* For each enabled image, the blend mode we use to composite it. The
+	 * mode for the first enabled image is not used.
+	 */
+	VipsBlendMode *mode;
+
 	/* For each enabled image, an input pointer.
 	 */
 	VipsPel **p;
@@ -243,18 +298,21 @@ vips_composite_stop(void *vseq, void *a, void *b)
 	VipsCompositeSequence *seq = (VipsCompositeSequence *) vseq;
 
 	if (seq->input_regions) {
-		for (int i = 0; seq->input_regions[i]; i++)
+		for (int i = 0; i < seq->n_in; i++)
 			VIPS_UNREF(seq->input_regions[i]);
 		VIPS_FREE(seq->input_regions);
 	}
 
 	if (seq->composite_regions) {
-		for (int i = 0; seq->composite_regions[i]; i++)
+		for (int i = 0; i < seq->n_in; i++)
 			VIPS_UNREF(seq->composite_regions[i]);
 		VIPS_FREE(seq->composite_regions);
 	}
 
+	VIPS_FREE(seq->live);
+	VIPS_FREE(seq->seen);
 	VIPS_FREE(seq->enabled);
+	VIPS_FREE(seq->mode);
 	VIPS_FREE(seq->p);
 
 #ifdef HAVE_VECTOR_ARITH
@@ -286,51 +344,48 @@ vips_composite_start(VipsImage *out, void *a, void *b)
 		return NULL;
 
 	seq->composite = composite;
+	seq->in = in;
+	seq->n_in = 0;
 	seq->input_regions = NULL;
+	seq->live = NULL;
+	seq->n_live = 0;
+	seq->composite_regions = NULL;
+	seq->stamp = 0;
+	seq->seen = NULL;
 	seq->enabled = NULL;
+	seq->mode = NULL;
 	seq->p = NULL;
 
 	/* How many images?
 	 */
 	for (n = 0; in[n]; n++)
 		;
+	seq->n_in = n;
 
-	/* Allocate space for region array.
+	/* Regions are made on demand, see vips_composite_region().
 	 */
-	if (!(seq->input_regions = VIPS_ARRAY(NULL, n + 1, VipsRegion *))) {
-		vips_composite_stop(seq, NULL, NULL);
-		return NULL;
-	}
-	for (i = 0; i < n + 1; i++)
-		seq->input_regions[i] = NULL;
-
-	if (!(seq->composite_regions =
-				VIPS_ARRAY(NULL, n + 1, VipsRegion *))) {
-		vips_composite_stop(seq, NULL, NULL);
-		return NULL;
-	}
-	for (i = 0; i < n + 1; i++)
-		seq->composite_regions[i] = NULL;
-
+	seq->input_regions = VIPS_ARRAY(NULL, n, VipsRegion *);
+	seq->composite_regions = VIPS_ARRAY(NULL, n, VipsRegion *);
+	seq->live = VIPS_ARRAY(NULL, n, int);
+	seq->seen = VIPS_ARRAY(NULL, n, guint);
 	seq->enabled = VIPS_ARRAY(NULL, n, int);
+	seq->mode = VIPS_ARRAY(NULL, n, VipsBlendMode);
 	seq->p = VIPS_ARRAY(NULL, n, VipsPel *);
-	if (!seq->enabled ||
+	if (!seq->input_regions ||
+		!seq->composite_regions ||
+		!seq->live ||
+		!seq->seen ||
+		!seq->enabled ||
+		!seq->mode ||
 		!seq->p) {
 		vips_composite_stop(seq, NULL, NULL);
 		return NULL;
 	}
 
-	/* Create a set of regions.
-	 */
 	for (i = 0; i < n; i++) {
-		seq->input_regions[i] = vips_region_new(in[i]);
-		seq->composite_regions[i] = vips_region_new(in[0]);
-
-		if (!seq->input_regions[i] ||
-			!seq->composite_regions[i]) {
-			vips_composite_stop(seq, NULL, NULL);
-			return NULL;
-		}
+		seq->input_regions[i] = NULL;
+		seq->composite_regions[i] = NULL;
+		seq->seen[i] = 0;
 	}
 
 #ifdef HAVE_VECTOR_ARITH
@@ -438,6 +493,27 @@ vips_composite_base_max_band(VipsCompositeBase *composite, double *max_band)
 	return 0;
 }
 
+/* Enable layer i if it touches r and we've not seen it before for this
+ * request.
+ */
+static void
+vips_composite_base_select_layer(VipsCompositeSequence *seq,
+	VipsRect *r, int i)
+{
+	if (seq->seen[i] != seq->stamp &&
+		vips_rect_overlapsrect(r, &seq->composite->subimages[i])) {
+		seq->seen[i] = seq->stamp;
+		seq->enabled[seq->n] = i;
+		seq->n += 1;
+	}
+}
+
+static int
+vips_composite_base_layer_compare(const void *a, const void *b)
+{
+	return *((int *) a) - *((int *) b);
+}
+
 /* Find the subset of our input images which intersect this region. If we are
  * not in skippable mode, we must enable all layers.
  */
@@ -445,16 +521,104 @@ static void
 vips_composite_base_select(VipsCompositeSequence *seq, VipsRect *r)
 {
 	VipsCompositeBase *composite = seq->composite;
+	VipsBlendMode *mode = (VipsBlendMode *) composite->mode->area.data;
+	int n_mode = composite->mode->area.n;
 	int n = composite->in->area.n;
 
-	seq->n = 0;
-	for (int i = 0; i < n; i++)
-		if (!composite->skippable ||
-			vips_rect_overlapsrect(r,
-				&composite->subimages[i])) {
-			seq->enabled[seq->n] = i;
-			seq->n += 1;
+	if (!composite->skippable) {
+		for (int i = 0; i < n; i++)
+			seq->enabled[i] = i;
+		seq->n = n;
+	}
+	else {
+		int size = composite->cell_size;
+		int left = r->left / size;
+		int top = r->top / size;
+		int right = VIPS_MIN(composite->cells_across - 1,
+			(VIPS_RECT_RIGHT(r) - 1) / size);
+		int bottom = VIPS_MIN(composite->cells_down - 1,
+			(VIPS_RECT_BOTTOM(r) - 1) / size);
+
+		/* A new stamp for this request. If we've wrapped, old stamps
+		 * could match, so clear them.
+		 */
+		seq->stamp += 1;
+		if (seq->stamp == 0) {
+			for (int i = 0; i < n; i++)
+				seq->seen[i] = 0;
+			seq->stamp = 1;
 		}
+
+		/* The background is always there.
+		 */
+		seq->enabled[0] = 0;
+		seq->n = 1;
+
+		for (int i = 0; i < composite->n_big; i++)
+			vips_composite_base_select_layer(seq, r,
+				composite->big[i]);
+
+		for (int y = top; y <= bottom; y++)
+			for (int x = left; x <= right; x++) {
+				int cell = x + y * composite->cells_across;
+
+				for (int k = composite->cell_start[cell];
+					 k < composite->cell_start[cell + 1]; k++)
+					vips_composite_base_select_layer(seq, r,
+						composite->cell_layers[k]);
+			}
+
+		/* Back to stack order.
+		 */
+		if (seq->n > 2)
+			qsort(seq->enabled + 1, seq->n - 1, sizeof(int),
+				vips_composite_base_layer_compare);
+	}
+
+	for (int i = 0; i < seq->n; i++) {
+		int j = seq->enabled[i];
+
+		seq->mode[i] = j == 0
+			? VIPS_BLEND_MODE_SOURCE
+			: n_mode == 1 ? mode[0] : mode[j - 1];
+	}
+}
+
+/* Get the input region for layer i, making it if necessary.
+ */
+static VipsRegion *
+vips_composite_base_input(VipsCompositeSequence *seq, int i)
+{
+	if (!seq->input_regions[i]) {
+		if (!(seq->input_regions[i] = vips_region_new(seq->in[i])))
+			return NULL;
+		seq->live[seq->n_live++] = i;
+	}
+
+	return seq->input_regions[i];
+}
+
+/* Free the input regions for any layers which are entirely above r.
+ * Requests mostly move down the image, so we won't need these again, and
+ * if we do, they'll just be made again.
+ */
+static void
+vips_composite_base_trim(VipsCompositeSequence *seq, VipsRect *r)
+{
+	VipsCompositeBase *composite = seq->composite;
+
+	for (int k = 0; k < seq->n_live;) {
+		int i = seq->live[k];
+
+		if (i != 0 &&
+			VIPS_RECT_BOTTOM(&composite->subimages[i]) <= r->top) {
+			VIPS_UNREF(seq->input_regions[i]);
+			seq->live[k] = seq->live[seq->n_live - 1];
+			seq->n_live -= 1;
+		}
+		else
+			k += 1;
+	}
 }
 
 /* Cairo naming conventions:
@@ -951,8 +1115,6 @@ static void
 vips_combine_pixels(VipsCompositeSequence *seq, VipsPel *q)
 {
 	VipsCompositeBase *composite = seq->composite;
-	VipsBlendMode *mode = (VipsBlendMode *) composite->mode->area.data;
-	int n_mode = composite->mode->area.n;
 	int n = seq->n;
 	int bands = composite->bands;
 	T *restrict tq = (T *restrict) q;
@@ -971,12 +1133,8 @@ vips_combine_pixels(VipsCompositeSequence *seq, VipsPel *q)
 		for (int b = 0; b < bands; b++)
 			B[b] *= aB;
 
-	for (int i = 1; i < n; i++) {
-		int j = seq->enabled[i];
-		VipsBlendMode m = n_mode == 1 ? mode[0] : mode[j - 1];
-
-		vips_composite_base_blend<T>(composite, m, B, tp[i]);
-	}
+	for (int i = 1; i < n; i++)
+		vips_composite_base_blend<T>(composite, seq->mode[i], B, tp[i]);
 
 	/* Unpremultiply, if necessary.
 	 */
@@ -1016,8 +1174,6 @@ static void
 vips_combine_pixels3(VipsCompositeSequence *seq, VipsPel *q)
 {
 	VipsCompositeBase *composite = seq->composite;
-	VipsBlendMode *mode = (VipsBlendMode *) composite->mode->area.data;
-	int n_mode = composite->mode->area.n;
 	int n = seq->n;
 	T *restrict tq = (T *restrict) q;
 	T **restrict tp = (T * *restrict) seq->p;
@@ -1040,12 +1196,8 @@ vips_combine_pixels3(VipsCompositeSequence *seq, VipsPel *q)
 		B[3] = aB;
 	}
 
-	for (int i = 1; i < n; i++) {
-		int j = seq->enabled[i];
-		VipsBlendMode m = n_mode == 1 ? mode[0] : mode[j - 1];
-
-		vips_composite_base_blend3<T>(seq, m, B, tp[i]);
-	}
+	for (int i = 1; i < n; i++)
+		vips_composite_base_blend3<T>(seq, seq->mode[i], B, tp[i]);
 
 	/* Unpremultiply, if necessary.
 	 */
@@ -1079,6 +1231,130 @@ vips_combine_pixels3(VipsCompositeSequence *seq, VipsPel *q)
 }
 #endif /*HAVE_VECTOR_ARITH*/
 
+/* Is a mode one of the Porter-Duff operators we can do in fixed point?
+ *
+ * These are the modes where the premultiplied result can be written as
+ * A * Fa + B * Fb, with Fa and Fb drawn from 0, 1, aA, aB, 1 - aA and
+ * 1 - aB. vips_composite_base_blend() gives the same result for valid
+ * premultiplied pixels.
+ */
+static gboolean
+vips_composite_mode_fixed(VipsBlendMode mode)
+{
+	switch (mode) {
+	case VIPS_BLEND_MODE_CLEAR:
+	case VIPS_BLEND_MODE_SOURCE:
+	case VIPS_BLEND_MODE_OVER:
+	case VIPS_BLEND_MODE_IN:
+	case VIPS_BLEND_MODE_OUT:
+	case VIPS_BLEND_MODE_DEST:
+	case VIPS_BLEND_MODE_DEST_OVER:
+	case VIPS_BLEND_MODE_DEST_IN:
+	case VIPS_BLEND_MODE_DEST_OUT:
+	case VIPS_BLEND_MODE_XOR:
+		return TRUE;
+
+	default:
+		return FALSE;
+	}
+}
+
+/* Premultiplied 8 and 16-bit RGBA, fixed-point modes only. max_T is 255 or
+ * 65535. We truncate, as vips_combine_pixels() does when it casts back, and
+ * this must match vips_composite_fixed_hwy() exactly.
+ */
+template <typename T, guint64 max_T>
+static void
+vips_combine_pixels_fixed(VipsCompositeSequence *seq, VipsPel *q)
+{
+	int n = seq->n;
+	T *restrict tq = (T *restrict) q;
+	T **restrict tp = (T * *restrict) seq->p;
+
+	guint64 B[4];
+
+	for (int b = 0; b < 4; b++)
+		B[b] = tp[0][b];
+
+	for (int i = 1; i < n; i++) {
+		guint64 aA = tp[i][3];
+		guint64 aB = B[3];
+
+		guint64 Fa;
+		guint64 Fb;
+
+		switch (seq->mode[i]) {
+		case VIPS_BLEND_MODE_CLEAR:
+			Fa = 0;
+			Fb = 0;
+			break;
+
+		case VIPS_BLEND_MODE_SOURCE:
+			Fa = max_T;
+			Fb = 0;
+			break;
+
+		case VIPS_BLEND_MODE_OVER:
+			Fa = max_T;
+			Fb = max_T - aA;
+			break;
+
+		case VIPS_BLEND_MODE_IN:
+			Fa = aB;
+			Fb = 0;
+			break;
+
+		case VIPS_BLEND_MODE_OUT:
+			Fa = max_T - aB;
+			Fb = 0;
+			break;
+
+		case VIPS_BLEND_MODE_DEST:
+			Fa = 0;
+			Fb = max_T;
+			break;
+
+		case VIPS_BLEND_MODE_DEST_OVER:
+			Fa = max_T - aB;
+			Fb = max_T;
+			break;
+
+		case VIPS_BLEND_MODE_DEST_IN:
+			Fa = 0;
+			Fb = aA;
+			break;
+
+		case VIPS_BLEND_MODE_DEST_OUT:
+			Fa = 0;
+			Fb = max_T - aA;
+			break;
+
+		case VIPS_BLEND_MODE_XOR:
+			Fa = max_T - aB;
+			Fb = max_T - aA;
+			break;
+
+		default:
+			g_assert_not_reached();
+			Fa = 0;
+			Fb = 0;
+		}
+
+		/* The sum can only go over max_T * max_T for invalid
+		 * premultiplied pixels, but clip anyway.
+		 */
+		for (int b = 0; b < 4; b++) {
+			guint64 v = tp[i][b] * Fa + B[b] * Fb;
+
+			v = VIPS_MIN(v, max_T * max_T);
+			B[b] = v / max_T;
+		}
+	}
+
+	for (int b = 0; b < 4; b++)
+		tq[b] = B[b];
+}
+
 static int
 vips_composite_base_gen(VipsRegion *output_region,
 	void *vseq, void *a, void *b, gboolean *stop)
@@ -1087,6 +1363,7 @@ vips_composite_base_gen(VipsRegion *output_region,
 	VipsCompositeBase *composite = (VipsCompositeBase *) b;
 	VipsRect *r = &output_region->valid;
 	int ps = VIPS_IMAGE_SIZEOF_PEL(output_region->im);
+	VipsBandFormat format = seq->in[0]->BandFmt;
 
 	VIPS_DEBUG_MSG("vips_composite_base_gen: at %d x %d, size %d x %d\n",
 		r->left, r->top, r->width, r->height);
@@ -1097,17 +1374,22 @@ vips_composite_base_gen(VipsRegion *output_region,
 
 	VIPS_DEBUG_MSG("  selected %d images\n", seq->n);
 
+	if (composite->skippable)
+		vips_composite_base_trim(seq, r);
+
 	/* Is there just one? We can prepare directly to output and return.
 	 */
 	if (seq->n == 1) {
 		/* This can only be the background image, since it's the only
 		 * image which exactly fills the whole output.
 		 */
+		VipsRegion *input;
+
 		g_assert(seq->enabled[0] == 0);
 
-		if (vips_region_prepare(seq->input_regions[0], r))
-			return -1;
-		if (vips_region_region(output_region, seq->input_regions[0],
+		if (!(input = vips_composite_base_input(seq, 0)) ||
+			vips_region_prepare(input, r) ||
+			vips_region_region(output_region, input,
 				r, r->left, r->top))
 			return -1;
 
@@ -1123,10 +1405,14 @@ vips_composite_base_gen(VipsRegion *output_region,
 		VipsRect hit;
 		VipsRect request;
 
-		/* Set the composite region up to be a bit of memory at the
-		 * right position.
+		/* Set the composite region for this slot up to be a bit of
+		 * memory at the right position.
 		 */
-		if (vips_region_buffer(seq->composite_regions[j], r))
+		if (!seq->composite_regions[i] &&
+			!(seq->composite_regions[i] =
+					vips_region_new(seq->in[0])))
+			return -1;
+		if (vips_region_buffer(seq->composite_regions[i], r))
 			return -1;
 
 		/* Clip against this subimage position and size.
@@ -1145,7 +1431,7 @@ vips_composite_base_gen(VipsRegion *output_region,
 		 */
 		if (request.width < r->width ||
 			request.height < r->height)
-			vips_region_black(seq->composite_regions[j]);
+			vips_region_black(seq->composite_regions[i]);
 
 		/* And render the right part of the input image to the
 		 * composite region.
@@ -1154,9 +1440,12 @@ vips_composite_base_gen(VipsRegion *output_region,
 		 * outside the subimage area.
 		 */
 		if (!vips_rect_isempty(&request)) {
+			VipsRegion *input;
+
 			VIPS_DEBUG_MSG("  fetching pixels for input %d\n", j);
-			if (vips_region_prepare_to(seq->input_regions[j],
-					seq->composite_regions[j], &request,
+			if (!(input = vips_composite_base_input(seq, j)) ||
+				vips_region_prepare_to(input,
+					seq->composite_regions[i], &request,
 					hit.left, hit.top))
 				return -1;
 		}
@@ -1166,18 +1455,39 @@ vips_composite_base_gen(VipsRegion *output_region,
 
 	for (int y = 0; y < r->height; y++) {
 		VipsPel *q;
+		int x;
 
-		for (int i = 0; i < seq->n; i++) {
-			int j = seq->enabled[i];
-
-			seq->p[i] = VIPS_REGION_ADDR(seq->composite_regions[j],
+		for (int i = 0; i < seq->n; i++)
+			seq->p[i] = VIPS_REGION_ADDR(seq->composite_regions[i],
 				r->left, r->top + y);
-		}
 		q = VIPS_REGION_ADDR(output_region, r->left, r->top + y);
 
-		for (int x = 0; x < r->width; x++) {
-			switch (seq->input_regions[0]->im->BandFmt) {
+		x = 0;
+
+#ifdef HAVE_HWY
+		if (composite->bands == 3 &&
+			vips_vector_isenabled()) {
+			if (composite->fixed)
+				x = vips_composite_fixed_hwy(q, seq->p, seq->n,
+					seq->mode, format, r->width);
+			else
+				x = vips_composite_blend_hwy(q, seq->p, seq->n,
+					seq->mode, composite->premultiplied,
+					composite->max_band, format, r->width);
+
+			for (int i = 0; i < seq->n; i++)
+				seq->p[i] += x * ps;
+			q += x * ps;
+		}
+#endif /*HAVE_HWY*/
+
+		for (; x < r->width; x++) {
+			switch (format) {
 			case VIPS_FORMAT_UCHAR:
+				if (composite->fixed)
+					vips_combine_pixels_fixed<unsigned char,
+						UCHAR_MAX>(seq, q);
+				else
 #ifdef HAVE_VECTOR_ARITH
 				if (composite->bands == 3)
 					vips_combine_pixels3<unsigned char,
@@ -1194,6 +1504,10 @@ vips_composite_base_gen(VipsRegion *output_region,
 				break;
 
 			case VIPS_FORMAT_USHORT:
+				if (composite->fixed)
+					vips_combine_pixels_fixed<unsigned short,
+						USHRT_MAX>(seq, q);
+				else
 #ifdef HAVE_VECTOR_ARITH
 				if (composite->bands == 3)
 					vips_combine_pixels3<unsigned short,
@@ -1251,6 +1565,127 @@ vips_composite_base_gen(VipsRegion *output_region,
 	return 0;
 }
 
+/* Layers which cover more than this many grid cells go on the big list.
+ */
+#define MAX_CELLS_PER_LAYER (16)
+
+/* Find the range of grid cells that subimage i touches. FALSE if it's
+ * entirely outside the output.
+ */
+static gboolean
+vips_composite_base_cells(VipsCompositeBase *composite, int i,
+	int *left, int *top, int *right, int *bottom)
+{
+	VipsRect area = { 0, 0, composite->cells_across * composite->cell_size,
+		composite->cells_down * composite->cell_size };
+	VipsRect hit;
+
+	vips_rect_intersectrect(&area, &composite->subimages[i], &hit);
+	if (vips_rect_isempty(&hit))
+		return FALSE;
+
+	*left = hit.left / composite->cell_size;
+	*top = hit.top / composite->cell_size;
+	*right = (VIPS_RECT_RIGHT(&hit) - 1) / composite->cell_size;
+	*bottom = (VIPS_RECT_BOTTOM(&hit) - 1) / composite->cell_size;
+
+	return TRUE;
+}
+
+/* Build a uniform grid over the output, listing the layers that touch each
+ * cell, so _select() can find the layers for a request without testing
+ * every one. Layer 0 covers everything, so it's not indexed.
+ */
+static int
+vips_composite_base_index(VipsCompositeBase *composite,
+	int width, int height)
+{
+	int n = composite->in->area.n;
+
+	int ncells;
+	int total;
+
+	/* Cells of at least 128 pixels, but not more than 64k of them.
+	 */
+	composite->cell_size = 128;
+	for (;;) {
+		composite->cells_across =
+			VIPS_ROUND_UP(width, composite->cell_size) /
+			composite->cell_size;
+		composite->cells_down =
+			VIPS_ROUND_UP(height, composite->cell_size) /
+			composite->cell_size;
+		ncells = composite->cells_across * composite->cells_down;
+		if (ncells <= 65536)
+			break;
+
+		composite->cell_size *= 2;
+	}
+
+	if (!(composite->cell_start = VIPS_ARRAY(NULL, ncells + 1, int)) ||
+		!(composite->big = VIPS_ARRAY(NULL, n, int)))
+		return -1;
+	for (int i = 0; i < ncells + 1; i++)
+		composite->cell_start[i] = 0;
+	composite->n_big = 0;
+
+	/* Count the layers in each cell.
+	 */
+	total = 0;
+	for (int i = 1; i < n; i++) {
+		int left, top, right, bottom;
+
+		if (!vips_composite_base_cells(composite, i,
+				&left, &top, &right, &bottom))
+			continue;
+
+		if ((right - left + 1) * (bottom - top + 1) >
+			MAX_CELLS_PER_LAYER) {
+			composite->big[composite->n_big++] = i;
+			continue;
+		}
+
+		for (int y = top; y <= bottom; y++)
+			for (int x = left; x <= right; x++)
+				composite->cell_start[x +
+					y * composite->cells_across + 1] += 1;
+		total += (right - left + 1) * (bottom - top + 1);
+	}
+
+	/* Turn the counts into offsets, then fill. We use cell_start[i + 1]
+	 * as the fill pointer for cell i, so it ends up as the start of the
+	 * next cell.
+	 */
+	for (int i = 0; i < ncells; i++)
+		composite->cell_start[i + 1] += composite->cell_start[i];
+	if (!(composite->cell_layers =
+				VIPS_ARRAY(NULL, VIPS_MAX(1, total), int)))
+		return -1;
+	for (int i = ncells; i > 0; i--)
+		composite->cell_start[i] = composite->cell_start[i - 1];
+	composite->cell_start[0] = 0;
+
+	for (int i = 1; i < n; i++) {
+		int left, top, right, bottom;
+
+		if (!vips_composite_base_cells(composite, i,
+				&left, &top, &right, &bottom) ||
+			(right - left + 1) * (bottom - top + 1) >
+				MAX_CELLS_PER_LAYER)
+			continue;
+
+		for (int y = top; y <= bottom; y++)
+			for (int x = left; x <= right; x++) {
+				int cell = x + y * composite->cells_across;
+				int k = composite->cell_start[cell + 1]++;
+
+				composite->cell_layers[k] = i;
+			}
+	}
+
+	return 0;
+}
+
 /* Is a mode "skippable"?
  *
  * Skippable modes are ones where a black (0, 0, 0, 0) layer placed over the
@@ -1347,6 +1782,11 @@ vips_composite_base_build(VipsObject *object)
 				composite->y_offset[i - 1];
 		}
 
+	if (composite->skippable &&
+		vips_composite_base_index(composite,
+			in[0]->Xsize, in[0]->Ysize))
+		return -1;
+
 	decode = (VipsImage **) vips_object_local_array(object, n);
 	for (int i = 0; i < n; i++)
 		if (vips_image_decode(in[i], &decode[i]))
@@ -1439,6 +1879,23 @@ vips_composite_base_build(VipsObject *object)
 		return -1;
 	in = format;
 
+	/* Premultiplied 8 and 16-bit RGBA with only Porter-Duff modes can
+	 * use the fixed-point path.
+	 */
+	composite->fixed = composite->premultiplied &&
+		composite->bands == 3 &&
+		(in[0]->BandFmt == VIPS_FORMAT_UCHAR ||
+			in[0]->BandFmt == VIPS_FORMAT_USHORT);
+	for (int b = 0; b <= composite->bands; b++)
+		if (composite->max_band[b] !=
+			(in[0]->BandFmt == VIPS_FORMAT_UCHAR
+					? UCHAR_MAX
+					: USHRT_MAX))
+			composite->fixed = FALSE;
+	for (int i = 0; i < composite->mode->area.n; i++)
+		if (!vips_composite_mode_fixed(mode[i]))
+			composite->fixed = FALSE;
+
 	/* We want locality, so that we only prepare a few subimages each
 	 * time.
 	 */
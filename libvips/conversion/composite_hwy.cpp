@@ -0,0 +1,631 @@
+/* Highway kernels for vips_composite()
+ *
+ * 19/10/26
+ * 	- from composite.cpp
+ */
+
+/*
+
+	This file is part of VIPS.
+
+	VIPS is free software; you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+	02110-1301  USA
+
+ */
+
+/*
+
+	These files are distributed with VIPS - http://www.vips.ecs.soton.ac.uk
+
+ */
+
+/* Both kernels work on RGBA lines and blend a whole vector of pixels through
+ * the stack of layers before moving on, so the accumulator stays in
+ * registers. They return the number of pixels they did, and the caller
+ * finishes the line with the scalar code.
+ *
+ * vips_composite_blend_hwy() is the float path, for all blend modes. It
+ * follows the arithmetic of vips_composite_base_blend3().
+ *
+ * vips_composite_fixed_hwy() is for premultiplied 8 and 16-bit images
+ * where every mode is a Porter-Duff operator that can be written as:
+ *
+ * 	R = A * Fa + B * Fb
+ *
+ * with Fa and Fb drawn from 0, 1, aA, aB, 1 - aA and 1 - aB. We work in
+ * 16-bit lanes for uchar and 32-bit lanes for ushort, and divide by the
+ * max value truncating, as the float path does when it casts back, so the
+ * result matches vips_combine_pixels_fixed() exactly.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif /*HAVE_CONFIG_H*/
+#include <glib/gi18n-lib.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include <vips/vips.h>
+#include <vips/vector.h>
+#include <vips/debug.h>
+#include <vips/internal.h>
+
+#include "pconversion.h"
+
+#ifdef HAVE_HWY
+
+#undef HWY_TARGET_INCLUDE
+#define HWY_TARGET_INCLUDE "libvips/conversion/composite_hwy.cpp"
+#include <hwy/foreach_target.h>
+#include <hwy/highway.h>
+
+namespace HWY_NAMESPACE {
+
+using namespace hwy::HWY_NAMESPACE;
+
+using DF32 = ScalableTag<float>;
+using DI32 = ScalableTag<int32_t>;
+using DU16 = ScalableTag<uint16_t>;
+using DU32 = ScalableTag<uint32_t>;
+constexpr DF32 df32;
+constexpr DI32 di32;
+constexpr DU16 du16;
+constexpr DU32 du32;
+constexpr Rebind<uint8_t, DI32> du8x32;
+constexpr Rebind<uint16_t, DI32> du16x32;
+using VF32 = Vec<DF32>;
+
+/* Load four interleaved bands as float.
+ */
+HWY_ATTR HWY_INLINE void
+vips_composite_load_hwy(const uint8_t *HWY_RESTRICT p,
+	VF32 &v0, VF32 &v1, VF32 &v2, VF32 &v3)
+{
+	Vec<Rebind<uint8_t, DI32>> a, b, c, d;
+
+	LoadInterleaved4(du8x32, p, a, b, c, d);
+	v0 = ConvertTo(df32, PromoteTo(di32, a));
+	v1 = ConvertTo(df32, PromoteTo(di32, b));
+	v2 = ConvertTo(df32, PromoteTo(di32, c));
+	v3 = ConvertTo(df32, PromoteTo(di32, d));
+}
+
+HWY_ATTR HWY_INLINE void
+vips_composite_load_hwy(const uint16_t *HWY_RESTRICT p,
+	VF32 &v0, VF32 &v1, VF32 &v2, VF32 &v3)
+{
+	Vec<Rebind<uint16_t, DI32>> a, b, c, d;
+
+	LoadInterleaved4(du16x32, p, a, b, c, d);
+	v0 = ConvertTo(df32, PromoteTo(di32, a));
+	v1 = ConvertTo(df32, PromoteTo(di32, b));
+	v2 = ConvertTo(df32, PromoteTo(di32, c));
+	v3 = ConvertTo(df32, PromoteTo(di32, d));
+}
+
+HWY_ATTR HWY_INLINE void
+vips_composite_load_hwy(const float *HWY_RESTRICT p,
+	VF32 &v0, VF32 &v1, VF32 &v2, VF32 &v3)
+{
+	LoadInterleaved4(df32, p, v0, v1, v2, v3);
+}
+
+/* Store four bands, already clipped to the range of the type. The int
+ * conversion truncates, as the scalar path does.
+ */
+HWY_ATTR HWY_INLINE void
+vips_composite_store_hwy(uint8_t *HWY_RESTRICT q,
+	VF32 v0, VF32 v1, VF32 v2, VF32 v3)
+{
+	StoreInterleaved4(
+		DemoteTo(du8x32, ConvertTo(di32, v0)),
+		DemoteTo(du8x32, ConvertTo(di32, v1)),
+		DemoteTo(du8x32, ConvertTo(di32, v2)),
+		DemoteTo(du8x32, ConvertTo(di32, v3)),
+		du8x32, q);
+}
+
+HWY_ATTR HWY_INLINE void
+vips_composite_store_hwy(uint16_t *HWY_RESTRICT q,
+	VF32 v0, VF32 v1, VF32 v2, VF32 v3)
+{
+	StoreInterleaved4(
+		DemoteTo(du16x32, ConvertTo(di32, v0)),
+		DemoteTo(du16x32, ConvertTo(di32, v1)),
+		DemoteTo(du16x32, ConvertTo(di32, v2)),
+		DemoteTo(du16x32, ConvertTo(di32, v3)),
+		du16x32, q);
+}
+
+HWY_ATTR HWY_INLINE void
+vips_composite_store_hwy(float *HWY_RESTRICT q,
+	VF32 v0, VF32 v1, VF32 v2, VF32 v3)
+{
+	StoreInterleaved4(v0, v1, v2, v3, df32, q);
+}
+
+/* The blend function f() for the PDF separable modes.
+ */
+HWY_ATTR HWY_INLINE VF32
+vips_composite_pdf_hwy(VipsBlendMode mode, VF32 A, VF32 B)
+{
+	const auto zero = Zero(df32);
+	const auto one = Set(df32, 1.0f);
+	const auto two = Set(df32, 2.0f);
+	const auto half = Set(df32, 0.5f);
+
+	switch (mode) {
+	case VIPS_BLEND_MODE_MULTIPLY:
+		return Mul(A, B);
+
+	case VIPS_BLEND_MODE_SCREEN:
+		return Sub(Add(A, B), Mul(A, B));
+
+	case VIPS_BLEND_MODE_OVERLAY:
+		return IfThenElse(Le(B, half),
+			Mul(two, Mul(A, B)),
+			Sub(one, Mul(two, Mul(Sub(one, A), Sub(one, B)))));
+
+	case VIPS_BLEND_MODE_DARKEN:
+		return Min(A, B);
+
+	case VIPS_BLEND_MODE_LIGHTEN:
+		return Max(A, B);
+
+	case VIPS_BLEND_MODE_COLOUR_DODGE:
+		/* The lanes we discard can divide by zero.
+		 */
+		return IfThenElse(Lt(A, one),
+			Min(one, Div(B, Sub(one, A))),
+			one);
+
+	case VIPS_BLEND_MODE_COLOUR_BURN:
+		return IfThenElse(Gt(A, zero),
+			Sub(one, Min(one, Div(Sub(one, B), A))),
+			zero);
+
+	case VIPS_BLEND_MODE_HARD_LIGHT:
+		return IfThenElse(Le(A, half),
+			Mul(two, Mul(A, B)),
+			Sub(one, Mul(two, Mul(Sub(one, A), Sub(one, B)))));
+
+	case VIPS_BLEND_MODE_SOFT_LIGHT: {
+		const auto g = IfThenElse(Le(B, Set(df32, 0.25f)),
+			Mul(MulAdd(Sub(Mul(Set(df32, 16.0f), B),
+							Set(df32, 12.0f)),
+					B, Set(df32, 4.0f)),
+				B),
+			Sqrt(Max(B, zero)));
+
+		return IfThenElse(Le(A, half),
+			Sub(B, Mul(Mul(Sub(one, Mul(two, A)), B), Sub(one, B))),
+			Add(B, Mul(Sub(Mul(two, A), one), Sub(g, B))));
+	}
+
+	case VIPS_BLEND_MODE_DIFFERENCE:
+		return Abs(Sub(B, A));
+
+	case VIPS_BLEND_MODE_EXCLUSION:
+		return Sub(Add(A, B), Mul(two, Mul(A, B)));
+
+	default:
+		return A;
+	}
+}
+
+/* The result alpha for each mode.
+ */
+HWY_ATTR HWY_INLINE VF32
+vips_composite_alpha_hwy(VipsBlendMode mode, VF32 aA, VF32 aB)
+{
+	const auto one = Set(df32, 1.0f);
+
+	switch (mode) {
+	case VIPS_BLEND_MODE_CLEAR:
+		return Zero(df32);
+
+	case VIPS_BLEND_MODE_SOURCE:
+	case VIPS_BLEND_MODE_DEST_ATOP:
+		return aA;
+
+	case VIPS_BLEND_MODE_IN:
+	case VIPS_BLEND_MODE_DEST_IN:
+		return Mul(aA, aB);
+
+	case VIPS_BLEND_MODE_OUT:
+		return Mul(aA, Sub(one, aB));
+
+	case VIPS_BLEND_MODE_ATOP:
+	case VIPS_BLEND_MODE_DEST:
+		return aB;
+
+	case VIPS_BLEND_MODE_DEST_OVER:
+		return MulAdd(aA, Sub(one, aB), aB);
+
+	case VIPS_BLEND_MODE_DEST_OUT:
+		return Mul(Sub(one, aA), aB);
+
+	case VIPS_BLEND_MODE_XOR:
+		return Sub(Add(aA, aB), Mul(Set(df32, 2.0f), Mul(aA, aB)));
+
+	case VIPS_BLEND_MODE_ADD:
+	case VIPS_BLEND_MODE_SATURATE:
+		return Min(one, Add(aA, aB));
+
+	default:
+		/* OVER and the PDF modes.
+		 */
+		return MulAdd(aB, Sub(one, aA), aA);
+	}
+}
+
+/* Blend one premultiplied colour band. aR is the result alpha.
+ */
+HWY_ATTR HWY_INLINE VF32
+vips_composite_band_hwy(VipsBlendMode mode,
+	VF32 A, VF32 B, VF32 aA, VF32 aB, VF32 aR)
+{
+	const auto zero = Zero(df32);
+	const auto one = Set(df32, 1.0f);
+
+	switch (mode) {
+	case VIPS_BLEND_MODE_CLEAR:
+		return zero;
+
+	case VIPS_BLEND_MODE_SOURCE:
+		return A;
+
+	case VIPS_BLEND_MODE_OVER:
+	case VIPS_BLEND_MODE_ATOP:
+		return MulAdd(Sub(one, aA), B, A);
+
+	case VIPS_BLEND_MODE_IN:
+	case VIPS_BLEND_MODE_OUT:
+		// if aA == 0, then aR == 0 and so B will already be 0
+		return IfThenElse(Ne(aA, zero), Div(Mul(A, aR), aA), B);
+
+	case VIPS_BLEND_MODE_DEST:
+		return B;
+
+	case VIPS_BLEND_MODE_DEST_OVER:
+		return MulAdd(Sub(one, aB), A, B);
+
+	case VIPS_BLEND_MODE_DEST_IN:
+	case VIPS_BLEND_MODE_DEST_OUT:
+		// if aB is 0, then B is already 0
+		return IfThenElse(Ne(aB, zero), Mul(B, Div(aR, aB)), B);
+
+	case VIPS_BLEND_MODE_DEST_ATOP:
+		return MulAdd(Sub(one, aA), A, B);
+
+	case VIPS_BLEND_MODE_XOR:
+		return MulAdd(Sub(one, aB), A, Mul(Sub(one, aA), B));
+
+	case VIPS_BLEND_MODE_ADD:
+		return Add(A, B);
+
+	case VIPS_BLEND_MODE_SATURATE:
+		return MulAdd(Min(aA, Sub(one, aB)), A, B);
+
+	default:
+		/* The PDF modes are a bit different.
+		 */
+		return MulAdd(Sub(one, aB), A,
+			MulAdd(Sub(one, aA), B,
+				Mul(Mul(aA, aB), vips_composite_pdf_hwy(mode, A, B))));
+	}
+}
+
+template <typename T>
+HWY_ATTR int32_t
+vips_composite_blend_line_hwy(T *HWY_RESTRICT q, VipsPel **HWY_RESTRICT p,
+	int32_t n, const VipsBlendMode *HWY_RESTRICT mode,
+	int32_t premultiplied, const double *HWY_RESTRICT max_band,
+	int32_t width)
+{
+	const int32_t N = Lanes(df32);
+	const auto zero = Zero(df32);
+	const auto m0 = Set(df32, max_band[0]);
+	const auto m1 = Set(df32, max_band[1]);
+	const auto m2 = Set(df32, max_band[2]);
+	const auto m3 = Set(df32, max_band[3]);
+
+	/* As the scalar path, float is clipped to the ushort range.
+	 */
+	const auto high = Set(df32, sizeof(T) == 1 ? 255.0f : 65535.0f);
+
+	int32_t x;
+
+	for (x = 0; x + N <= width; x += N) {
+		VF32 B0, B1, B2, aB;
+
+		vips_composite_load_hwy((T *) p[0] + 4 * x, B0, B1, B2, aB);
+
+		/* Scale the base pixel to 0 - 1.
+		 */
+		B0 = Div(B0, m0);
+		B1 = Div(B1, m1);
+		B2 = Div(B2, m2);
+		aB = Div(aB, m3);
+
+		if (!premultiplied) {
+			B0 = Mul(B0, aB);
+			B1 = Mul(B1, aB);
+			B2 = Mul(B2, aB);
+		}
+
+		for (int32_t i = 1; i < n; i++) {
+			VF32 A0, A1, A2, aA;
+
+			vips_composite_load_hwy((T *) p[i] + 4 * x,
+				A0, A1, A2, aA);
+
+			A0 = Div(A0, m0);
+			A1 = Div(A1, m1);
+			A2 = Div(A2, m2);
+			aA = Div(aA, m3);
+
+			if (!premultiplied) {
+				A0 = Mul(A0, aA);
+				A1 = Mul(A1, aA);
+				A2 = Mul(A2, aA);
+			}
+
+			const auto aR = vips_composite_alpha_hwy(mode[i], aA, aB);
+
+			B0 = vips_composite_band_hwy(mode[i], A0, B0, aA, aB, aR);
+			B1 = vips_composite_band_hwy(mode[i], A1, B1, aA, aB, aR);
+			B2 = vips_composite_band_hwy(mode[i], A2, B2, aA, aB, aR);
+			aB = aR;
+		}
+
+		/* Unpremultiply, if necessary.
+		 */
+		if (!premultiplied) {
+			const auto nonzero = Ne(aB, zero);
+
+			B0 = IfThenElseZero(nonzero, Div(B0, aB));
+			B1 = IfThenElseZero(nonzero, Div(B1, aB));
+			B2 = IfThenElseZero(nonzero, Div(B2, aB));
+		}
+
+		/* Write back as a full range pixel, clipping to range.
+		 */
+		B0 = Min(Max(Mul(B0, m0), zero), high);
+		B1 = Min(Max(Mul(B1, m1), zero), high);
+		B2 = Min(Max(Mul(B2, m2), zero), high);
+		aB = Min(Max(Mul(aB, m3), zero), high);
+
+		vips_composite_store_hwy(q + 4 * x, B0, B1, B2, aB);
+	}
+
+	return x;
+}
+
+HWY_ATTR int32_t
+vips_composite_blend_hwy(VipsPel *HWY_RESTRICT q, VipsPel **HWY_RESTRICT p,
+	int32_t n, const VipsBlendMode *HWY_RESTRICT mode,
+	int32_t premultiplied, const double *HWY_RESTRICT max_band,
+	int32_t format, int32_t width)
+{
+	switch (format) {
+	case VIPS_FORMAT_UCHAR:
+		return vips_composite_blend_line_hwy((uint8_t *) q, p,
+			n, mode, premultiplied, max_band, width);
+
+	case VIPS_FORMAT_USHORT:
+		return vips_composite_blend_line_hwy((uint16_t *) q, p,
+			n, mode, premultiplied, max_band, width);
+
+	case VIPS_FORMAT_FLOAT:
+		return vips_composite_blend_line_hwy((float *) q, p,
+			n, mode, premultiplied, max_band, width);
+
+	default:
+		return 0;
+	}
+}
+
+/* x / max, truncated, for 0 <= x <= max * max, where max is 255 for
+ * 16-bit lanes and 65535 for 32-bit lanes.
+ */
+template <class DW>
+HWY_ATTR HWY_INLINE Vec<DW>
+vips_composite_div_hwy(DW dw, Vec<DW> x)
+{
+	constexpr int shift = 4 * sizeof(TFromD<DW>);
+
+	return ShiftRight<shift>(
+		Add(Add(x, Set(dw, (TFromD<DW>) 1)), ShiftRight<shift>(x)));
+}
+
+/* A * Fa + B * Fb, scaled back to the pixel range. The sum can't go over
+ * max * max for valid premultiplied pixels, but we clip for safety.
+ */
+template <class DW>
+HWY_ATTR HWY_INLINE Vec<DW>
+vips_composite_pd_hwy(DW dw,
+	Vec<DW> A, Vec<DW> B, Vec<DW> Fa, Vec<DW> Fb, Vec<DW> limit)
+{
+	const auto a = Mul(A, Fa);
+	const auto b = Mul(B, Fb);
+
+	return vips_composite_div_hwy(dw, Add(a, Min(b, Sub(limit, a))));
+}
+
+template <typename T, class DW>
+HWY_ATTR int32_t
+vips_composite_fixed_line_hwy(DW dw, T *HWY_RESTRICT q,
+	VipsPel **HWY_RESTRICT p, int32_t n,
+	const VipsBlendMode *HWY_RESTRICT mode, int32_t width)
+{
+	using TW = TFromD<DW>;
+	const Rebind<T, DW> dn;
+	const RebindToSigned<DW> ds;
+	const int32_t N = Lanes(dw);
+	const TW max = (TW) ((1U << (8 * sizeof(T))) - 1);
+	const auto zero = Zero(dw);
+	const auto vmax = Set(dw, max);
+	const auto limit = Set(dw, (TW) (max * max));
+
+	int32_t x;
+
+	for (x = 0; x + N <= width; x += N) {
+		Vec<Rebind<T, DW>> n0, n1, n2, n3;
+
+		LoadInterleaved4(dn, (T *) p[0] + 4 * x, n0, n1, n2, n3);
+		auto B0 = PromoteTo(dw, n0);
+		auto B1 = PromoteTo(dw, n1);
+		auto B2 = PromoteTo(dw, n2);
+		auto aB = PromoteTo(dw, n3);
+
+		for (int32_t i = 1; i < n; i++) {
+			LoadInterleaved4(dn, (T *) p[i] + 4 * x, n0, n1, n2, n3);
+			const auto A0 = PromoteTo(dw, n0);
+			const auto A1 = PromoteTo(dw, n1);
+			const auto A2 = PromoteTo(dw, n2);
+			const auto aA = PromoteTo(dw, n3);
+
+			Vec<DW> Fa, Fb;
+
+			switch (mode[i]) {
+			case VIPS_BLEND_MODE_CLEAR:
+				Fa = zero;
+				Fb = zero;
+				break;
+
+			case VIPS_BLEND_MODE_SOURCE:
+				Fa = vmax;
+				Fb = zero;
+				break;
+
+			case VIPS_BLEND_MODE_OVER:
+				Fa = vmax;
+				Fb = Sub(vmax, aA);
+				break;
+
+			case VIPS_BLEND_MODE_IN:
+				Fa = aB;
+				Fb = zero;
+				break;
+
+			case VIPS_BLEND_MODE_OUT:
+				Fa = Sub(vmax, aB);
+				Fb = zero;
+				break;
+
+			case VIPS_BLEND_MODE_DEST:
+				Fa = zero;
+				Fb = vmax;
+				break;
+
+			case VIPS_BLEND_MODE_DEST_OVER:
+				Fa = Sub(vmax, aB);
+				Fb = vmax;
+				break;
+
+			case VIPS_BLEND_MODE_DEST_IN:
+				Fa = zero;
+				Fb = aA;
+				break;
+
+			case VIPS_BLEND_MODE_DEST_OUT:
+				Fa = zero;
+				Fb = Sub(vmax, aA);
+				break;
+
+			case VIPS_BLEND_MODE_XOR:
+				Fa = Sub(vmax, aB);
+				Fb = Sub(vmax, aA);
+				break;
+
+			default:
+				/* Not a fixed-point mode, the caller should
+				 * never send us these.
+				 */
+				return 0;
+			}
+
+			B0 = vips_composite_pd_hwy(dw, A0, B0, Fa, Fb, limit);
+			B1 = vips_composite_pd_hwy(dw, A1, B1, Fa, Fb, limit);
+			B2 = vips_composite_pd_hwy(dw, A2, B2, Fa, Fb, limit);
+			aB = vips_composite_pd_hwy(dw, aA, aB, Fa, Fb, limit);
+		}
+
+		/* Everything is in range, so we can demote from signed.
+		 */
+		StoreInterleaved4(
+			DemoteTo(dn, BitCast(ds, B0)),
+			DemoteTo(dn, BitCast(ds, B1)),
+			DemoteTo(dn, BitCast(ds, B2)),
+			DemoteTo(dn, BitCast(ds, aB)),
+			dn, (T *) q + 4 * x);
+	}
+
+	return x;
+}
+
+HWY_ATTR int32_t
+vips_composite_fixed_hwy(VipsPel *HWY_RESTRICT q, VipsPel **HWY_RESTRICT p,
+	int32_t n, const VipsBlendMode *HWY_RESTRICT mode,
+	int32_t format, int32_t width)
+{
+	switch (format) {
+	case VIPS_FORMAT_UCHAR:
+		return vips_composite_fixed_line_hwy(du16, (uint8_t *) q, p,
+			n, mode, width);
+
+	case VIPS_FORMAT_USHORT:
+		return vips_composite_fixed_line_hwy(du32, (uint16_t *) q, p,
+			n, mode, width);
+
+	default:
+		return 0;
+	}
+}
+
+} /*namespace HWY_NAMESPACE*/
+
+#if HWY_ONCE
+HWY_EXPORT(vips_composite_blend_hwy);
+HWY_EXPORT(vips_composite_fixed_hwy);
+
+int
+vips_composite_blend_hwy(VipsPel *restrict q, VipsPel **restrict p,
+	int n, const VipsBlendMode *restrict mode,
+	gboolean premultiplied, const double *restrict max_band,
+	VipsBandFormat format, int width)
+{
+	/* clang-format off */
+	return HWY_DYNAMIC_DISPATCH(vips_composite_blend_hwy)(q, p,
+		n, mode, premultiplied, max_band, format, width);
+	/* clang-format on */
+}
+
+int
+vips_composite_fixed_hwy(VipsPel *restrict q, VipsPel **restrict p,
+	int n, const VipsBlendMode *restrict mode,
+	VipsBandFormat format, int width)
+{
+	/* clang-format off */
+	return HWY_DYNAMIC_DISPATCH(vips_composite_fixed_hwy)(q, p,
+		n, mode, format, width);
+	/* clang-format on */
+}
+#endif /*HWY_ONCE*/
+
+#endif /*HAVE_HWY*/
@@ -216,6 +216,7 @@
  * @VIPS_INTERESTING_LOW: position the crop towards the low coordinate
  * @VIPS_INTERESTING_HIGH: position the crop towards the high coordinate
  * @VIPS_INTERESTING_ALL: everything is interesting
+ * @VIPS_INTERESTING_ATTENTION_WINDOW: score every crop window for attention
  *
  * Pick the algorithm vips uses to decide image "interestingness". This is used
  * by vips_smartcrop(), for example, to decide what parts of the image to
@@ -225,6 +226,11 @@
  * crop is positioned at the top or left. #VIPS_INTERESTING_HIGH positions at
  * the bottom or right.
  *
+ * #VIPS_INTERESTING_ATTENTION_WINDOW finds the same features as
+ * #VIPS_INTERESTING_ATTENTION, but on a small proxy image, and then picks the
+ * crop window with the highest total attention, rather than centring on the
+ * peak.
+ *
  * See also: vips_smartcrop().
  */
 
@@ -371,6 +377,7 @@ vips_conversion_operation_init(void)
 	extern GType vips_insert_get_type(void);
 	extern GType vips_join_get_type(void);
 	extern GType vips_arrayjoin_get_type(void);
+	extern GType vips_arrayjoin_lazy_get_type(void);
 	extern GType vips_extract_area_get_type(void);
 	extern GType vips_crop_get_type(void);
 	extern GType vips_smartcrop_get_type(void);
@@ -421,6 +428,7 @@ vips_conversion_operation_init(void)
 	vips_insert_get_type();
 	vips_join_get_type();
 	vips_arrayjoin_get_type();
+	vips_arrayjoin_lazy_get_type();
 	vips_extract_area_get_type();
 	vips_crop_get_type();
 	vips_smartcrop_get_type();
@@ -37,6 +37,8 @@
  * 	- gtkdoc
  * 26/10/11
  * 	- redone as a class
+ * 19/10/26
+ * 	- add a Highway path to extract_band
  */
 
 /*
@@ -80,6 +82,7 @@
 #include <stdlib.h>
 
 #include <vips/vips.h>
+#include <vips/vector.h>
 #include <vips/internal.h>
 #include <vips/debug.h>
 
@@ -356,18 +359,27 @@ vips_extract_band_buffer(VipsBandarySequence *seq,
 
 	VipsPel *restrict p;
 	VipsPel *restrict q;
-	int x, z;
+	int x, x0, z;
 
-	p = in[0] + extract->band * es;
-	q = out;
+	x0 = 0;
+
+#ifdef HAVE_HWY
+	if (vips_vector_isenabled())
+		x0 = vips_extract_band_hwy(out, in[0],
+			im->Bands, extract->band, extract->n, es, width);
+#endif /*HAVE_HWY*/
+
+	p = in[0] + x0 * ips + extract->band * es;
+	q = out + x0 * ops;
 	if (ops == 1) {
-		for (x = 0; x < width; x++) {
-			q[x] = p[0];
+		for (x = x0; x < width; x++) {
+			q[0] = p[0];
 			p += ips;
+			q += 1;
 		}
 	}
 	else {
-		for (x = 0; x < width; x++) {
+		for (x = x0; x < width; x++) {
 			for (z = 0; z < ops; z++)
 				q[z] = p[z];
 
@@ -11,6 +11,8 @@
  * 	- max_alpha defaults to 65535 for RGB16/GREY16
  * 12/9/21
  * 	- out of range alpha and max_alpha correctly
+ * 19/10/26
+ * 	- add a Highway path
  */
 
 /*
@@ -55,6 +57,7 @@
 #include <math.h>
 
 #include <vips/vips.h>
+#include <vips/vector.h>
 #include <vips/internal.h>
 #include <vips/debug.h>
 
@@ -90,7 +93,7 @@ G_DEFINE_TYPE(VipsFlatten, vips_flatten, VIPS_TYPE_CONVERSION);
 		TYPE *restrict p = (TYPE *) in; \
 		TYPE *restrict q = (TYPE *) out; \
 \
-		for (x = 0; x < width; x++) { \
+		for (x = x0; x < width; x++) { \
 			TYPE alpha = p[bands - 1]; \
 			int b; \
 \
@@ -110,7 +113,7 @@ G_DEFINE_TYPE(VipsFlatten, vips_flatten, VIPS_TYPE_CONVERSION);
 		TYPE *restrict p = (TYPE *) in; \
 		TYPE *restrict q = (TYPE *) out; \
 \
-		for (x = 0; x < width; x++) { \
+		for (x = x0; x < width; x++) { \
 			TYPE alpha = p[bands - 1]; \
 			int b; \
 \
@@ -129,7 +132,7 @@ G_DEFINE_TYPE(VipsFlatten, vips_flatten, VIPS_TYPE_CONVERSION);
 		TYPE *restrict p = (TYPE *) in; \
 		TYPE *restrict q = (TYPE *) out; \
 \
-		for (x = 0; x < width; x++) { \
+		for (x = x0; x < width; x++) { \
 			TYPE alpha = p[bands - 1]; \
 			TYPE nalpha = max_alpha - alpha; \
 			TYPE *restrict bg = (TYPE *) flatten->ink; \
@@ -148,7 +151,7 @@ G_DEFINE_TYPE(VipsFlatten, vips_flatten, VIPS_TYPE_CONVERSION);
 		TYPE *restrict p = (TYPE *) in; \
 		TYPE *restrict q = (TYPE *) out; \
 \
-		for (x = 0; x < width; x++) { \
+		for (x = x0; x < width; x++) { \
 			TYPE alpha = p[bands - 1]; \
 			TYPE nalpha = max_alpha - alpha; \
 			TYPE *restrict bg = (TYPE *) flatten->ink; \
@@ -183,6 +186,18 @@ vips_flatten_black_gen(VipsRegion *out_region,
 	for (y = 0; y < r->height; y++) {
 		VipsPel *in = VIPS_REGION_ADDR(ir, r->left, r->top + y);
 		VipsPel *out = VIPS_REGION_ADDR(out_region, r->left, r->top + y);
+		int x0;
+
+		x0 = 0;
+
+#ifdef HAVE_HWY
+		if (vips_vector_isenabled()) {
+			x0 = vips_flatten_hwy(out, in,
+				bands, ir->im->BandFmt, max_alpha, NULL, width);
+			in += x0 * VIPS_IMAGE_SIZEOF_PEL(ir->im);
+			out += x0 * VIPS_IMAGE_SIZEOF_PEL(out_region->im);
+		}
+#endif /*HAVE_HWY*/
 
 		switch (ir->im->BandFmt) {
 		case VIPS_FORMAT_UCHAR:
@@ -248,6 +263,18 @@ vips_flatten_gen(VipsRegion *out_region,
 	for (y = 0; y < r->height; y++) {
 		VipsPel *in = VIPS_REGION_ADDR(ir, r->left, r->top + y);
 		VipsPel *out = VIPS_REGION_ADDR(out_region, r->left, r->top + y);
+		int x0;
+
+		x0 = 0;
+
+#ifdef HAVE_HWY
+		if (vips_vector_isenabled()) {
+			x0 = vips_flatten_hwy(out, in,
+				bands, ir->im->BandFmt, max_alpha, flatten->ink, width);
+			in += x0 * VIPS_IMAGE_SIZEOF_PEL(ir->im);
+			out += x0 * VIPS_IMAGE_SIZEOF_PEL(out_region->im);
+		}
+#endif /*HAVE_HWY*/
 
 		switch (ir->im->BandFmt) {
 		case VIPS_FORMAT_UCHAR:
@@ -17,6 +17,8 @@
  * 	- gtkdoc
  * 17/10/11
  * 	- redone as a class
+ * 19/10/26
+ * 	- Highway path for horizontal flip
  */
 
 /*
@@ -60,6 +62,7 @@
 #include <stdlib.h>
 
 #include <vips/vips.h>
+#include <vips/vector.h>
 #include <vips/internal.h>
 #include <vips/debug.h>
 
@@ -168,7 +171,19 @@ vips_flip_horizontal_gen(VipsRegion *out_region,
 		p = VIPS_REGION_ADDR(ir, lastx, y);
 		q = VIPS_REGION_ADDR(out_region, le, y);
 
-		for (x = le; x < ri; x++) {
+		x = le;
+
+#ifdef HAVE_HWY
+		if (vips_vector_isenabled()) {
+			int n = vips_rot_reverse_hwy(q, p, r->width, ps);
+
+			x += n;
+			q += n * ps;
+			p -= n * ps;
+		}
+#endif /*HAVE_HWY*/
+
+		for (; x < ri; x++) {
 			/* Copy the pel.
 			 */
 			for (z = 0; z < ps; z++)
@@ -25,6 +25,10 @@
  * 19/4/12
  * 	- fix blend
  * 	- small blend speedup
+ * 19/10/26
+ * 	- add Highway paths for select and blend
+ * 	- add "relational" and "c" to compare cond against a constant in the
+ * 	  same pass
  */
 
 /*
@@ -68,6 +72,7 @@
 #include <math.h>
 
 #include <vips/vips.h>
+#include <vips/vector.h>
 #include <vips/internal.h>
 #include <vips/debug.h>
 
@@ -83,6 +88,14 @@ typedef struct _VipsIfthenelse {
 	VipsImage *in2;
 
 	gboolean blend;
+	VipsOperationRelational relational;
+	VipsArrayDouble *c;
+
+	/* c expanded to one constant per band, and TRUE if they are all the
+	 * same.
+	 */
+	double *c_bands;
+	gboolean c_uniform;
 
 } VipsIfthenelse;
 
@@ -275,11 +288,12 @@ vips_blendn_buffer(VipsPel *qp,
 	}
 }
 
+/* Blend from a mask of 0 - 255 condition bytes, one row every lskip bytes.
+ */
 static int
-vips_blend_gen(VipsRegion *out_region,
-	void *seq, void *client1, void *client2, gboolean *stop)
+vips_blend_mask(VipsRegion *out_region, VipsRegion **ir,
+	VipsPel *mask, size_t lskip)
 {
-	VipsRegion **ir = (VipsRegion **) seq;
 	VipsRect *r = &out_region->valid;
 	int le = r->left;
 	int to = r->top;
@@ -291,16 +305,13 @@ vips_blend_gen(VipsRegion *out_region,
 	int x, y;
 	int all0, all255;
 
-	if (vips_region_prepare(ir[2], r))
-		return -1;
-
 	/* Is the conditional all zero or all 255? We can avoid asking
 	 * for one of the inputs to be calculated.
 	 */
-	all0 = *VIPS_REGION_ADDR(ir[2], le, to) == 0;
-	all255 = *VIPS_REGION_ADDR(ir[2], le, to) == 255;
+	all0 = *mask == 0;
+	all255 = *mask == 255;
 	for (y = to; y < bo; y++) {
-		VipsPel *p = VIPS_REGION_ADDR(ir[2], le, y);
+		VipsPel *p = mask + (y - to) * lskip;
 		int width = r->width * c->Bands;
 
 		for (x = 0; x < width; x++) {
@@ -340,15 +351,28 @@ vips_blend_gen(VipsRegion *out_region,
 		for (y = to; y < bo; y++) {
 			VipsPel *ap = VIPS_REGION_ADDR(ir[0], le, y);
 			VipsPel *bp = VIPS_REGION_ADDR(ir[1], le, y);
-			VipsPel *cp = VIPS_REGION_ADDR(ir[2], le, y);
+			VipsPel *cp = mask + (y - to) * lskip;
 			VipsPel *q = VIPS_REGION_ADDR(out_region, le, y);
+			int width = r->width;
+
+#ifdef HAVE_HWY
+			if (vips_vector_isenabled()) {
+				int n = vips_blend_hwy(q, cp, ap, bp,
+					a->BandFmt, width * a->Bands) / a->Bands;
+				size_t ps = n * VIPS_IMAGE_SIZEOF_PEL(a);
+
+				q += ps;
+				ap += ps;
+				bp += ps;
+				cp += n * c->Bands;
+				width -= n;
+			}
+#endif /*HAVE_HWY*/
 
 			if (c->Bands == 1)
-				vips_blend1_buffer(q, cp, ap, bp,
-					r->width, a);
+				vips_blend1_buffer(q, cp, ap, bp, width, a);
 			else
-				vips_blendn_buffer(q, cp, ap, bp,
-					r->width, a);
+				vips_blendn_buffer(q, cp, ap, bp, width, a);
 		}
 	}
 
@@ -356,11 +380,27 @@ vips_blend_gen(VipsRegion *out_region,
 }
 
 static int
-vips_ifthenelse_gen(VipsRegion *out_region,
+vips_blend_gen(VipsRegion *out_region,
 	void *seq, void *client1, void *client2, gboolean *stop)
 {
 	VipsRegion **ir = (VipsRegion **) seq;
 	VipsRect *r = &out_region->valid;
+
+	if (vips_region_prepare(ir[2], r))
+		return -1;
+
+	return vips_blend_mask(out_region, ir,
+		VIPS_REGION_ADDR(ir[2], r->left, r->top),
+		VIPS_REGION_LSKIP(ir[2]));
+}
+
+/* Select from a mask of condition bytes, one row every lskip bytes.
+ */
+static int
+vips_ifthenelse_mask(VipsRegion *out_region, VipsRegion **ir,
+	VipsPel *mask, size_t lskip)
+{
+	VipsRect *r = &out_region->valid;
 	int le = r->left;
 	int to = r->top;
 	int bo = VIPS_RECT_BOTTOM(r);
@@ -386,16 +426,13 @@ vips_ifthenelse_gen(VipsRegion *out_region,
 		width = r->width * a->Bands;
 	}
 
-	if (vips_region_prepare(ir[2], r))
-		return -1;
-
 	/* Is the conditional all zero or all non-zero? We can avoid asking
 	 * for one of the inputs to be calculated.
 	 */
-	all0 = *VIPS_REGION_ADDR(ir[2], le, to) == 0;
-	alln0 = *VIPS_REGION_ADDR(ir[2], le, to) != 0;
+	all0 = *mask == 0;
+	alln0 = *mask != 0;
 	for (y = to; y < bo; y++) {
-		VipsPel *p = VIPS_REGION_ADDR(ir[2], le, y);
+		VipsPel *p = mask + (y - to) * lskip;
 
 		for (x = 0; x < width; x++) {
 			all0 &= p[x] == 0;
@@ -431,10 +468,18 @@ vips_ifthenelse_gen(VipsRegion *out_region,
 		for (y = to; y < bo; y++) {
 			VipsPel *ap = VIPS_REGION_ADDR(ir[0], le, y);
 			VipsPel *bp = VIPS_REGION_ADDR(ir[1], le, y);
-			VipsPel *cp = VIPS_REGION_ADDR(ir[2], le, y);
+			VipsPel *cp = mask + (y - to) * lskip;
 			VipsPel *q = VIPS_REGION_ADDR(out_region, le, y);
+			int i0;
+
+			i0 = 0;
 
-			for (x = 0, i = 0; i < width; i++, x += size)
+#ifdef HAVE_HWY
+			if (vips_vector_isenabled())
+				i0 = vips_ifthenelse_hwy(q, cp, ap, bp, size, width);
+#endif /*HAVE_HWY*/
+
+			for (x = i0 * size, i = i0; i < width; i++, x += size)
 				if (cp[i])
 					for (z = x; z < x + size; z++)
 						q[z] = ap[z];
@@ -447,6 +492,186 @@ vips_ifthenelse_gen(VipsRegion *out_region,
 	return 0;
 }
 
+static int
+vips_ifthenelse_gen(VipsRegion *out_region,
+	void *seq, void *client1, void *client2, gboolean *stop)
+{
+	VipsRegion **ir = (VipsRegion **) seq;
+	VipsRect *r = &out_region->valid;
+
+	if (vips_region_prepare(ir[2], r))
+		return -1;
+
+	return vips_ifthenelse_mask(out_region, ir,
+		VIPS_REGION_ADDR(ir[2], r->left, r->top),
+		VIPS_REGION_LSKIP(ir[2]));
+}
+
+/* With a constant, the condition is computed from cond a tile at a time
+ * into a buffer, rather than by a separate relational operation.
+ */
+typedef struct _VipsIfthenelseSequence {
+	VipsRegion **ir;
+
+	VipsPel *mask;
+	size_t mask_size;
+} VipsIfthenelseSequence;
+
+static int
+vips_ifthenelse_stop(void *vseq, void *a, void *b)
+{
+	VipsIfthenelseSequence *seq = (VipsIfthenelseSequence *) vseq;
+
+	if (seq->ir)
+		vips_stop_many(seq->ir, a, b);
+	VIPS_FREE(seq->mask);
+	g_free(seq);
+
+	return 0;
+}
+
+static void *
+vips_ifthenelse_start(VipsImage *out, void *a, void *b)
+{
+	VipsIfthenelseSequence *seq;
+
+	seq = g_new0(VipsIfthenelseSequence, 1);
+	if (!(seq->ir = (VipsRegion **) vips_start_many(out, a, b))) {
+		vips_ifthenelse_stop(seq, a, b);
+		return NULL;
+	}
+
+	return seq;
+}
+
+#define CLOOP(TYPE, OP) \
+	{ \
+		TYPE *restrict tp = (TYPE *) p; \
+\
+		for (i = i0, b = i0 % bands; i < n; i++) { \
+			q[i] = (tp[i] OP c[b]) ? 255 : 0; \
+\
+			if (++b == bands) \
+				b = 0; \
+		} \
+	}
+
+#define CSWITCH(OP) \
+	switch (im->BandFmt) { \
+	case VIPS_FORMAT_UCHAR: \
+		CLOOP(unsigned char, OP); \
+		break; \
+	case VIPS_FORMAT_CHAR: \
+		CLOOP(signed char, OP); \
+		break; \
+	case VIPS_FORMAT_USHORT: \
+		CLOOP(unsigned short, OP); \
+		break; \
+	case VIPS_FORMAT_SHORT: \
+		CLOOP(signed short, OP); \
+		break; \
+	case VIPS_FORMAT_UINT: \
+		CLOOP(unsigned int, OP); \
+		break; \
+	case VIPS_FORMAT_INT: \
+		CLOOP(signed int, OP); \
+		break; \
+	case VIPS_FORMAT_FLOAT: \
+		CLOOP(float, OP); \
+		break; \
+	case VIPS_FORMAT_DOUBLE: \
+		CLOOP(double, OP); \
+		break; \
+\
+	default: \
+		g_assert_not_reached(); \
+	}
+
+/* Compare a line of cond against the constant, making 0 / 255.
+ */
+static void
+vips_ifthenelse_compare(VipsIfthenelse *ifthenelse,
+	VipsPel *q, VipsPel *p, VipsImage *im, int width)
+{
+	const int bands = im->Bands;
+	const int n = width * bands;
+	const double *c = ifthenelse->c_bands;
+
+	int i, b, i0;
+
+	i0 = 0;
+
+#ifdef HAVE_HWY
+	if (vips_vector_isenabled() &&
+		ifthenelse->c_uniform)
+		i0 = vips__relational_const_hwy(q, p,
+			ifthenelse->relational, im->BandFmt, c[0], n);
+#endif /*HAVE_HWY*/
+
+	switch (ifthenelse->relational) {
+	case VIPS_OPERATION_RELATIONAL_EQUAL:
+		CSWITCH(==);
+		break;
+
+	case VIPS_OPERATION_RELATIONAL_NOTEQ:
+		CSWITCH(!=);
+		break;
+
+	case VIPS_OPERATION_RELATIONAL_LESS:
+		CSWITCH(<);
+		break;
+
+	case VIPS_OPERATION_RELATIONAL_LESSEQ:
+		CSWITCH(<=);
+		break;
+
+	case VIPS_OPERATION_RELATIONAL_MORE:
+		CSWITCH(>);
+		break;
+
+	case VIPS_OPERATION_RELATIONAL_MOREEQ:
+		CSWITCH(>=);
+		break;
+
+	default:
+		g_assert_not_reached();
+	}
+}
+
+static int
+vips_ifthenelse_const_gen(VipsRegion *out_region,
+	void *vseq, void *client1, void *client2, gboolean *stop)
+{
+	VipsIfthenelseSequence *seq = (VipsIfthenelseSequence *) vseq;
+	VipsIfthenelse *ifthenelse = (VipsIfthenelse *) client2;
+	VipsRegion **ir = seq->ir;
+	VipsRect *r = &out_region->valid;
+	VipsImage *c = ir[2]->im;
+	size_t lskip = (size_t) r->width * c->Bands;
+	size_t size = lskip * r->height;
+
+	int y;
+
+	if (vips_region_prepare(ir[2], r))
+		return -1;
+
+	if (size > seq->mask_size) {
+		VIPS_FREE(seq->mask);
+		if (!(seq->mask = VIPS_ARRAY(NULL, size, VipsPel)))
+			return -1;
+		seq->mask_size = size;
+	}
+
+	for (y = 0; y < r->height; y++)
+		vips_ifthenelse_compare(ifthenelse, seq->mask + y * lskip,
+			VIPS_REGION_ADDR(ir[2], r->left, r->top + y), c, r->width);
+
+	if (ifthenelse->blend)
+		return vips_blend_mask(out_region, ir, seq->mask, lskip);
+	else
+		return vips_ifthenelse_mask(out_region, ir, seq->mask, lskip);
+}
+
 static int
 vips_ifthenelse_build(VipsObject *object)
 {
@@ -463,6 +688,7 @@ vips_ifthenelse_build(VipsObject *object)
 		(VipsImage **) vips_object_local_array(object, 3);
 
 	VipsImage *all[3];
+	int base_bands;
 
 	if (VIPS_OBJECT_CLASS(vips_ifthenelse_parent_class)->build(object))
 		return -1;
@@ -478,15 +704,31 @@ vips_ifthenelse_build(VipsObject *object)
 	 * for us.
 	 */
 
+	/* A many-element constant can make a many-band output.
+	 */
+	base_bands = 0;
+	if (ifthenelse->c) {
+		if (vips_check_noncomplex(class->nickname, ifthenelse->cond))
+			return -1;
+
+		base_bands = ifthenelse->c->n;
+	}
+
 	/* Cast our input images up to a common bands and size.
 	 */
-	if (vips__bandalike_vec(class->nickname, all, band, 3, 0) ||
+	if (vips__bandalike_vec(class->nickname, all, band, 3, base_bands) ||
 		vips__sizealike_vec(band, size, 3))
 		return -1;
 
-	/* Condition is cast to uchar, then/else to a common type.
+	if (ifthenelse->c &&
+		vips_check_vector(class->nickname, ifthenelse->c->n, band[2]))
+		return -1;
+
+	/* Condition is cast to uchar, then/else to a common type. With a
+	 * constant, we compare in the condition's own format.
 	 */
-	if (size[2]->BandFmt != VIPS_FORMAT_UCHAR) {
+	if (!ifthenelse->c &&
+		size[2]->BandFmt != VIPS_FORMAT_UCHAR) {
 		if (vips_cast(size[2], &format[2], VIPS_FORMAT_UCHAR, NULL))
 			return -1;
 	}
@@ -498,14 +740,41 @@ vips_ifthenelse_build(VipsObject *object)
 	if (vips__formatalike_vec(size, format, 2))
 		return -1;
 
+	if (ifthenelse->c) {
+		int bands = format[2]->Bands;
+		double *c = (double *) ifthenelse->c->data;
+
+		int i;
+
+		if (!(ifthenelse->c_bands = VIPS_ARRAY(object, bands, double)))
+			return -1;
+		for (i = 0; i < bands; i++)
+			ifthenelse->c_bands[i] =
+				c[VIPS_MIN(i, ifthenelse->c->n - 1)];
+
+		ifthenelse->c_uniform = TRUE;
+		for (i = 1; i < bands; i++)
+			if (ifthenelse->c_bands[i] != ifthenelse->c_bands[0])
+				ifthenelse->c_uniform = FALSE;
+	}
+
 	if (vips_image_pipeline_array(conversion->out,
 			VIPS_DEMAND_STYLE_SMALLTILE, format))
 		return -1;
 
-	if (vips_image_generate(conversion->out,
-			vips_start_many, generate_fn, vips_stop_many,
-			format, ifthenelse))
-		return -1;
+	if (ifthenelse->c) {
+		if (vips_image_generate(conversion->out,
+				vips_ifthenelse_start, vips_ifthenelse_const_gen,
+				vips_ifthenelse_stop,
+				format, ifthenelse))
+			return -1;
+	}
+	else {
+		if (vips_image_generate(conversion->out,
+				vips_start_many, generate_fn, vips_stop_many,
+				format, ifthenelse))
+			return -1;
+	}
 
 	return 0;
 }
@@ -549,11 +818,27 @@ vips_ifthenelse_class_init(VipsIfthenelseClass *class)
 		VIPS_ARGUMENT_OPTIONAL_INPUT,
 		G_STRUCT_OFFSET(VipsIfthenelse, blend),
 		FALSE);
+
+	VIPS_ARG_ENUM(class, "relational", 5,
+		_("Relational"),
+		_("Compare cond against c with this"),
+		VIPS_ARGUMENT_OPTIONAL_INPUT,
+		G_STRUCT_OFFSET(VipsIfthenelse, relational),
+		VIPS_TYPE_OPERATION_RELATIONAL,
+		VIPS_OPERATION_RELATIONAL_NOTEQ);
+
+	VIPS_ARG_BOXED(class, "c", 6,
+		_("c"),
+		_("Compare cond against these constants"),
+		VIPS_ARGUMENT_OPTIONAL_INPUT,
+		G_STRUCT_OFFSET(VipsIfthenelse, c),
+		VIPS_TYPE_ARRAY_DOUBLE);
 }
 
 static void
 vips_ifthenelse_init(VipsIfthenelse *ifthenelse)
 {
+	ifthenelse->relational = VIPS_OPERATION_RELATIONAL_NOTEQ;
 }
 
 /**
@@ -567,6 +852,8 @@ vips_ifthenelse_init(VipsIfthenelse *ifthenelse)
  * Optional arguments:
  *
  * * @blend: blend smoothly between @in1 and @in2
+ * * @relational: #VipsOperationRelational, compare @cond against @c with this
+ * * @c: #VipsArrayDouble, compare @cond against these constants
  *
  * This operation scans the condition image @cond
  * and uses it to select pixels from either the then image @in1 or the else
@@ -587,7 +874,18 @@ vips_ifthenelse_init(VipsIfthenelse *ifthenelse)
  *
  *   @out = (@cond / 255) * @in1 + (1 - @cond / 255) * @in2
  *
- * See also: vips_equal().
+ * If @c is set, @cond is not cast to uchar. Instead, each band is compared
+ * against the matching element of @c with @relational (default
+ * #VIPS_OPERATION_RELATIONAL_NOTEQ), and the result, 0 or 255, is used as
+ * the condition. This is the same as:
+ *
+ *   vips_relational_const(cond, &mask, relational, c, n, NULL);
+ *   vips_ifthenelse(mask, in1, in2, &out, NULL);
+ *
+ * but is done in a single pass, without the intermediate mask image. The
+ * comparison is done as double, so it's exact for all non-complex formats.
+ *
+ * See also: vips_equal(), vips_relational_const().
  *
  * Returns: 0 on success, -1 on error
  */
@@ -0,0 +1,242 @@
+/* Highway kernels for vips_ifthenelse()
+ *
+ * 19/10/26
+ * 	- from ifthenelse.c
+ */
+
+/*
+
+	This file is part of VIPS.
+
+	VIPS is free software; you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+	02110-1301  USA
+
+ */
+
+/*
+
+	These files are distributed with VIPS - http://www.vips.ecs.soton.ac.uk
+
+ */
+
+/* The condition always has the same number of bands as then and else, so
+ * these work element by element, with one condition byte per element. They
+ * return the number of elements done and the caller finishes the line.
+ *
+ * Select does 1, 2 and 4 byte elements. Blend does uchar and ushort, and
+ * must match IBLEND exactly. For uchar the sum fits in 16 bits and we
+ * divide by 255 with a shift and add. For ushort it's less than 2^24, so a
+ * float division truncates to the same result as the int division. Both
+ * have been checked for every sum we can make.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif /*HAVE_CONFIG_H*/
+#include <glib/gi18n-lib.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <vips/vips.h>
+#include <vips/vector.h>
+#include <vips/debug.h>
+#include <vips/internal.h>
+
+#include "pconversion.h"
+
+#ifdef HAVE_HWY
+
+#undef HWY_TARGET_INCLUDE
+#define HWY_TARGET_INCLUDE "libvips/conversion/ifthenelse_hwy.cpp"
+#include <hwy/foreach_target.h>
+#include <hwy/highway.h>
+
+namespace HWY_NAMESPACE {
+
+using namespace hwy::HWY_NAMESPACE;
+
+using DF32 = ScalableTag<float>;
+using DI32 = ScalableTag<int32_t>;
+using DU16 = ScalableTag<uint16_t>;
+constexpr DF32 df32;
+constexpr DI32 di32;
+constexpr DU16 du16;
+constexpr Rebind<int16_t, DU16> di16;
+constexpr Rebind<uint8_t, DU16> du8x16;
+constexpr Rebind<uint8_t, DI32> du8x32;
+constexpr Rebind<uint16_t, DI32> du16x32;
+
+/* Load a vector of condition bytes as a mask of the zero elements.
+ */
+template <class D>
+HWY_ATTR HWY_INLINE Mask<D>
+vips_ifthenelse_zero_hwy(D d, const uint8_t *HWY_RESTRICT c,
+	hwy::SizeTag<1>)
+{
+	return Eq(LoadU(d, c), Zero(d));
+}
+
+template <class D, size_t kSize>
+HWY_ATTR HWY_INLINE Mask<D>
+vips_ifthenelse_zero_hwy(D d, const uint8_t *HWY_RESTRICT c,
+	hwy::SizeTag<kSize>)
+{
+	const Rebind<uint8_t, D> du8;
+
+	return Eq(PromoteTo(d, LoadU(du8, c)), Zero(d));
+}
+
+template <typename T>
+HWY_ATTR int
+vips_ifthenelse_line_hwy(T *HWY_RESTRICT q, const uint8_t *HWY_RESTRICT c,
+	const T *HWY_RESTRICT a, const T *HWY_RESTRICT b, int n)
+{
+	const ScalableTag<T> d;
+	const int N = Lanes(d);
+
+	int x;
+
+	for (x = 0; x + N <= n; x += N) {
+		const auto zero = vips_ifthenelse_zero_hwy(d, c + x,
+			hwy::SizeTag<sizeof(T)>());
+
+		StoreU(IfThenElse(zero, LoadU(d, b + x), LoadU(d, a + x)),
+			d, q + x);
+	}
+
+	return x;
+}
+
+HWY_ATTR int
+vips_ifthenelse_hwy(VipsPel *HWY_RESTRICT q, const VipsPel *HWY_RESTRICT c,
+	const VipsPel *HWY_RESTRICT a, const VipsPel *HWY_RESTRICT b,
+	int es, int n)
+{
+	switch (es) {
+	case 1:
+		return vips_ifthenelse_line_hwy((uint8_t *) q, c,
+			(const uint8_t *) a, (const uint8_t *) b, n);
+
+	case 2:
+		return vips_ifthenelse_line_hwy((uint16_t *) q, c,
+			(const uint16_t *) a, (const uint16_t *) b, n);
+
+	case 4:
+		return vips_ifthenelse_line_hwy((uint32_t *) q, c,
+			(const uint32_t *) a, (const uint32_t *) b, n);
+
+	default:
+		return 0;
+	}
+}
+
+/* See IBLEND1.
+ */
+HWY_ATTR int
+vips_blend_uchar_hwy(uint8_t *HWY_RESTRICT q, const uint8_t *HWY_RESTRICT c,
+	const uint8_t *HWY_RESTRICT a, const uint8_t *HWY_RESTRICT b, int n)
+{
+	const int N = Lanes(du16);
+	const auto max = Set(du16, 255);
+	const auto round = Set(du16, 128);
+	const auto one = Set(du16, 1);
+
+	int x;
+
+	for (x = 0; x + N <= n; x += N) {
+		const auto v = PromoteTo(du16, LoadU(du8x16, c + x));
+		const auto av = PromoteTo(du16, LoadU(du8x16, a + x));
+		const auto bv = PromoteTo(du16, LoadU(du8x16, b + x));
+
+		auto t = Add(Add(Mul(v, av), Mul(Sub(max, v), bv)), round);
+		t = ShiftRight<8>(Add(Add(t, one), ShiftRight<8>(t)));
+
+		StoreU(DemoteTo(du8x16, BitCast(di16, t)), du8x16, q + x);
+	}
+
+	return x;
+}
+
+HWY_ATTR int
+vips_blend_ushort_hwy(uint16_t *HWY_RESTRICT q, const uint8_t *HWY_RESTRICT c,
+	const uint16_t *HWY_RESTRICT a, const uint16_t *HWY_RESTRICT b, int n)
+{
+	const int N = Lanes(di32);
+	const auto max = Set(di32, 255);
+	const auto round = Set(di32, 128);
+	const auto scale = Set(df32, 255.0f);
+
+	int x;
+
+	for (x = 0; x + N <= n; x += N) {
+		const auto v = PromoteTo(di32, LoadU(du8x32, c + x));
+		const auto av = PromoteTo(di32, LoadU(du16x32, a + x));
+		const auto bv = PromoteTo(di32, LoadU(du16x32, b + x));
+
+		const auto t = Add(Add(Mul(v, av), Mul(Sub(max, v), bv)), round);
+		const auto r = ConvertTo(di32, Div(ConvertTo(df32, t), scale));
+
+		StoreU(DemoteTo(du16x32, r), du16x32, q + x);
+	}
+
+	return x;
+}
+
+HWY_ATTR int
+vips_blend_hwy(VipsPel *HWY_RESTRICT q, const VipsPel *HWY_RESTRICT c,
+	const VipsPel *HWY_RESTRICT a, const VipsPel *HWY_RESTRICT b,
+	VipsBandFormat format, int n)
+{
+	switch (format) {
+	case VIPS_FORMAT_UCHAR:
+		return vips_blend_uchar_hwy((uint8_t *) q, c,
+			(const uint8_t *) a, (const uint8_t *) b, n);
+
+	case VIPS_FORMAT_USHORT:
+		return vips_blend_ushort_hwy((uint16_t *) q, c,
+			(const uint16_t *) a, (const uint16_t *) b, n);
+
+	default:
+		return 0;
+	}
+}
+
+} /*namespace HWY_NAMESPACE*/
+
+#if HWY_ONCE
+HWY_EXPORT(vips_ifthenelse_hwy);
+HWY_EXPORT(vips_blend_hwy);
+
+int
+vips_ifthenelse_hwy(VipsPel *q, const VipsPel *c,
+	const VipsPel *a, const VipsPel *b, int es, int n)
+{
+	/* clang-format off */
+	return HWY_DYNAMIC_DISPATCH(vips_ifthenelse_hwy)(q, c, a, b, es, n);
+	/* clang-format on */
+}
+
+int
+vips_blend_hwy(VipsPel *q, const VipsPel *c,
+	const VipsPel *a, const VipsPel *b, VipsBandFormat format, int n)
+{
+	/* clang-format off */
+	return HWY_DYNAMIC_DISPATCH(vips_blend_hwy)(q, c, a, b, format, n);
+	/* clang-format on */
+}
+#endif /*HWY_ONCE*/
+
+#endif /*HAVE_HWY*/
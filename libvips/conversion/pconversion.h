@@ -66,6 +66,76 @@ typedef struct _VipsConversionClass {
 
 GType vips_conversion_get_type(void);
 
+/* Highway paths for vips_composite(). These do as many whole vectors of
+ * RGBA pixels as they can and return the number processed.
+ */
+int vips_composite_blend_hwy(VipsPel *restrict q, VipsPel **restrict p,
+	int n, const VipsBlendMode *restrict mode,
+	gboolean premultiplied, const double *restrict max_band,
+	VipsBandFormat format, int width);
+int vips_composite_fixed_hwy(VipsPel *restrict q, VipsPel **restrict p,
+	int n, const VipsBlendMode *restrict mode,
+	VipsBandFormat format, int width);
+
+/* Highway paths for vips_rot() and vips_flip(). The transpose does all the
+ * whole blocks it can and returns the block size, or 0 for pixel sizes it
+ * can't do. The reverse reads backwards from p and returns the number of
+ * pixels done.
+ */
+int vips_rot_transpose_hwy(VipsPel *q, int q_stride,
+	const VipsPel *p, int p_stride,
+	int width, int height, int ps);
+int vips_rot_reverse_hwy(VipsPel *q, const VipsPel *p, int width, int ps);
+
+/* Highway path for vips_cast(). Returns the number of elements done, or 0 for
+ * format pairs it can't do.
+ */
+int vips_cast_hwy(VipsPel *out, const VipsPel *in, int sz,
+	VipsBandFormat in_format, VipsBandFormat out_format, gboolean shift);
+
+/* Highway paths for vips_bandjoin(), vips_extract_band(), vips_bandmean()
+ * and vips_bandbool(). They return the number of pixels done, or 0 for band
+ * layouts and formats they can't do.
+ */
+int vips_bandjoin_hwy(VipsPel *q, VipsPel **p,
+	int n, const int *bands, int es, int width);
+int vips_extract_band_hwy(VipsPel *q, const VipsPel *p,
+	int in_bands, int band, int n, int es, int width);
+int vips_bandmean_hwy(VipsPel *q, const VipsPel *p,
+	int bands, VipsBandFormat format, int width);
+int vips_bandbool_hwy(VipsPel *q, const VipsPel *p,
+	int bands, VipsOperationBoolean op, int es, int width);
+
+/* Highway paths for vips_premultiply(), vips_unpremultiply() and
+ * vips_flatten(). They return the number of pixels done, or 0 for images
+ * and max_alpha they can't do exactly. flatten takes a NULL ink for a black
+ * background.
+ */
+int vips_premultiply_hwy(float *q, const VipsPel *p,
+	int bands, VipsBandFormat format, double max_alpha, int width);
+int vips_unpremultiply_hwy(float *q, const VipsPel *p,
+	int bands, VipsBandFormat format, double max_alpha, int width);
+int vips_flatten_hwy(VipsPel *q, const VipsPel *p,
+	int bands, VipsBandFormat format, double max_alpha,
+	const VipsPel *ink, int width);
+
+/* Highway paths for vips_ifthenelse(). They take one condition byte per
+ * element and return the number of elements done.
+ */
+int vips_ifthenelse_hwy(VipsPel *q, const VipsPel *c,
+	const VipsPel *a, const VipsPel *b, int es, int n);
+int vips_blend_hwy(VipsPel *q, const VipsPel *c,
+	const VipsPel *a, const VipsPel *b, VipsBandFormat format, int n);
+
+#ifdef HAVE_HWY
+/* Highway path for vips_recomb(). It does 3x3 to 4x4 matrices on uchar,
+ * ushort and float pixels and returns the number of pixels done, or 0 if it
+ * can't help.
+ */
+int vips_recomb_hwy(float *q, const VipsPel *p, VipsBandFormat format,
+	const double *matrix, int mwidth, int mheight, int width);
+#endif /*HAVE_HWY*/
+
 #ifdef __cplusplus
 }
 #endif /*__cplusplus*/
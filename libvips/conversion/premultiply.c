@@ -9,6 +9,8 @@
  * 	- max_alpha defaults to 65535 for RGB16/GREY16
  * 24/11/17 lovell
  * 	- match normalised alpha to output type
+ * 19/10/26
+ * 	- add a Highway path
  */
 
 /*
@@ -53,6 +55,7 @@
 #include <math.h>
 
 #include <vips/vips.h>
+#include <vips/vector.h>
 #include <vips/internal.h>
 #include <vips/debug.h>
 
@@ -78,7 +81,7 @@ G_DEFINE_TYPE(VipsPremultiply, vips_premultiply, VIPS_TYPE_CONVERSION);
 		IN *restrict p = (IN *) in; \
 		OUT *restrict q = (OUT *) out; \
 \
-		for (x = 0; x < width; x++) { \
+		for (x = x0; x < width; x++) { \
 			IN alpha = p[bands - 1]; \
 			IN clip_alpha = VIPS_CLIP(0, alpha, max_alpha); \
 			OUT nalpha = (OUT) clip_alpha / max_alpha; \
@@ -99,7 +102,7 @@ G_DEFINE_TYPE(VipsPremultiply, vips_premultiply, VIPS_TYPE_CONVERSION);
 		IN *restrict p = (IN *) in; \
 		OUT *restrict q = (OUT *) out; \
 \
-		for (x = 0; x < width; x++) { \
+		for (x = x0; x < width; x++) { \
 			IN alpha = p[3]; \
 			IN clip_alpha = VIPS_CLIP(0, alpha, max_alpha); \
 			OUT nalpha = (OUT) clip_alpha / max_alpha; \
@@ -145,6 +148,19 @@ vips_premultiply_gen(VipsRegion *out_region,
 	for (y = 0; y < r->height; y++) {
 		VipsPel *in = VIPS_REGION_ADDR(ir, r->left, r->top + y);
 		VipsPel *out = VIPS_REGION_ADDR(out_region, r->left, r->top + y);
+		int x0;
+
+		x0 = 0;
+
+#ifdef HAVE_HWY
+		if (vips_vector_isenabled() &&
+			im->BandFmt != VIPS_FORMAT_DOUBLE) {
+			x0 = vips_premultiply_hwy((float *) out, in,
+				bands, im->BandFmt, max_alpha, width);
+			in += x0 * VIPS_IMAGE_SIZEOF_PEL(im);
+			out += x0 * VIPS_IMAGE_SIZEOF_PEL(out_region->im);
+		}
+#endif /*HAVE_HWY*/
 
 		switch (im->BandFmt) {
 		case VIPS_FORMAT_UCHAR:
@@ -0,0 +1,418 @@
+/* Highway kernels for vips_premultiply(), vips_unpremultiply() and
+ * vips_flatten()
+ *
+ * 19/10/26
+ * 	- from premultiply.c
+ */
+
+/*
+
+	This file is part of VIPS.
+
+	VIPS is free software; you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+	02110-1301  USA
+
+ */
+
+/*
+
+	These files are distributed with VIPS - http://www.vips.ecs.soton.ac.uk
+
+ */
+
+/* These do two and four band images with alpha in the final band, which is
+ * almost everything in practice.
+ *
+ * premultiply and unpremultiply work in float and must give exactly the same
+ * result as the C. The C computes nalpha and factor with a double division
+ * and rounds to float. If both operands are exact floats, that's the same
+ * as a single float division, so we insist that max_alpha is an exact
+ * float. Int alpha is clipped in the input type, so for int images we also
+ * need an integer max_alpha.
+ *
+ * flatten for uchar and ushort with the usual max_alpha uses integer
+ * arithmetic in lanes twice as wide as the pixel, and divides by 255 or
+ * 65535 with a shift and add. This is exact for all the values we can see.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif /*HAVE_CONFIG_H*/
+#include <glib/gi18n-lib.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include <vips/vips.h>
+#include <vips/vector.h>
+#include <vips/debug.h>
+#include <vips/internal.h>
+
+#include "pconversion.h"
+
+#ifdef HAVE_HWY
+
+#undef HWY_TARGET_INCLUDE
+#define HWY_TARGET_INCLUDE "libvips/conversion/premultiply_hwy.cpp"
+#include <hwy/foreach_target.h>
+#include <hwy/highway.h>
+
+namespace HWY_NAMESPACE {
+
+using namespace hwy::HWY_NAMESPACE;
+
+using DF32 = ScalableTag<float>;
+using DI32 = ScalableTag<int32_t>;
+constexpr DF32 df32;
+constexpr DI32 di32;
+constexpr Rebind<uint8_t, DI32> du8x32;
+constexpr Rebind<uint16_t, DI32> du16x32;
+
+template <class D, class V>
+HWY_ATTR HWY_INLINE Vec<DF32>
+vips_premultiply_tofloat_hwy(D d, V v)
+{
+	return ConvertTo(df32, PromoteTo(di32, v));
+}
+
+HWY_ATTR HWY_INLINE Vec<DF32>
+vips_premultiply_tofloat_hwy(DF32 d, Vec<DF32> v)
+{
+	return v;
+}
+
+/* Load a vector of two or four band pixels as float.
+ */
+template <class D>
+HWY_ATTR HWY_INLINE void
+vips_premultiply_load_hwy(D d, const TFromD<D> *HWY_RESTRICT p, int bands,
+	Vec<DF32> &v0, Vec<DF32> &v1, Vec<DF32> &v2, Vec<DF32> &alpha)
+{
+	Vec<D> a, b, c, e;
+
+	if (bands == 2) {
+		LoadInterleaved2(d, p, a, e);
+		v0 = vips_premultiply_tofloat_hwy(d, a);
+	}
+	else {
+		LoadInterleaved4(d, p, a, b, c, e);
+		v0 = vips_premultiply_tofloat_hwy(d, a);
+		v1 = vips_premultiply_tofloat_hwy(d, b);
+		v2 = vips_premultiply_tofloat_hwy(d, c);
+	}
+
+	alpha = vips_premultiply_tofloat_hwy(d, e);
+}
+
+/* VIPS_CLIP(0, alpha, max_alpha), with the same compares, so NaN and -0
+ * come out the same way.
+ */
+HWY_ATTR HWY_INLINE Vec<DF32>
+vips_premultiply_clip_hwy(Vec<DF32> alpha, Vec<DF32> max)
+{
+	const auto zero = Zero(df32);
+	const auto clip = IfThenElse(Lt(max, alpha), max, alpha);
+
+	return IfThenElse(Gt(zero, clip), zero, clip);
+}
+
+/* See PRE_RGBA.
+ */
+template <class D>
+HWY_ATTR int
+vips_premultiply_line_hwy(D d, float *HWY_RESTRICT q,
+	const TFromD<D> *HWY_RESTRICT p, int bands, float max_alpha, int width)
+{
+	const int N = Lanes(df32);
+	const auto max = Set(df32, max_alpha);
+
+	auto v0 = Zero(df32);
+	auto v1 = Zero(df32);
+	auto v2 = Zero(df32);
+	auto alpha = Zero(df32);
+
+	int x;
+
+	for (x = 0; x + N <= width; x += N) {
+		vips_premultiply_load_hwy(d, p + x * bands, bands,
+			v0, v1, v2, alpha);
+
+		const auto nalpha =
+			Div(vips_premultiply_clip_hwy(alpha, max), max);
+
+		if (bands == 2)
+			StoreInterleaved2(Mul(v0, nalpha), alpha,
+				df32, q + x * 2);
+		else
+			StoreInterleaved4(Mul(v0, nalpha), Mul(v1, nalpha),
+				Mul(v2, nalpha), alpha,
+				df32, q + x * 4);
+	}
+
+	return x;
+}
+
+/* See UNPRE_RGBA and FUNPRE_RGBA. Alpha below threshold gives a zero factor,
+ * with no branch.
+ */
+template <class D>
+HWY_ATTR int
+vips_unpremultiply_line_hwy(D d, float *HWY_RESTRICT q,
+	const TFromD<D> *HWY_RESTRICT p, int bands, float max_alpha,
+	float threshold, int width)
+{
+	const int N = Lanes(df32);
+	const auto max = Set(df32, max_alpha);
+	const auto t = Set(df32, threshold);
+
+	auto v0 = Zero(df32);
+	auto v1 = Zero(df32);
+	auto v2 = Zero(df32);
+	auto alpha = Zero(df32);
+
+	int x;
+
+	for (x = 0; x + N <= width; x += N) {
+		vips_premultiply_load_hwy(d, p + x * bands, bands,
+			v0, v1, v2, alpha);
+
+		const auto factor =
+			IfThenZeroElse(Lt(Abs(alpha), t), Div(max, alpha));
+		const auto clip = vips_premultiply_clip_hwy(alpha, max);
+
+		if (bands == 2)
+			StoreInterleaved2(Mul(factor, v0), clip,
+				df32, q + x * 2);
+		else
+			StoreInterleaved4(Mul(factor, v0), Mul(factor, v1),
+				Mul(factor, v2), clip,
+				df32, q + x * 4);
+	}
+
+	return x;
+}
+
+/* Can we match the C for this max_alpha?
+ */
+static bool
+vips_premultiply_max_alpha_ok(VipsBandFormat format, double max_alpha)
+{
+	if ((float) max_alpha != max_alpha)
+		return false;
+
+	if (format != VIPS_FORMAT_FLOAT &&
+		(max_alpha < 0 ||
+			max_alpha != rint(max_alpha)))
+		return false;
+
+	return true;
+}
+
+HWY_ATTR int
+vips_premultiply_hwy(float *HWY_RESTRICT q, const VipsPel *HWY_RESTRICT p,
+	int bands, VipsBandFormat format, double max_alpha, int width)
+{
+	if ((bands != 2 &&
+			bands != 4) ||
+		!vips_premultiply_max_alpha_ok(format, max_alpha))
+		return 0;
+
+	switch (format) {
+	case VIPS_FORMAT_UCHAR:
+		return vips_premultiply_line_hwy(du8x32, q,
+			(const uint8_t *) p, bands, max_alpha, width);
+
+	case VIPS_FORMAT_USHORT:
+		return vips_premultiply_line_hwy(du16x32, q,
+			(const uint16_t *) p, bands, max_alpha, width);
+
+	case VIPS_FORMAT_FLOAT:
+		return vips_premultiply_line_hwy(df32, q,
+			(const float *) p, bands, max_alpha, width);
+
+	default:
+		return 0;
+	}
+}
+
+HWY_ATTR int
+vips_unpremultiply_hwy(float *HWY_RESTRICT q, const VipsPel *HWY_RESTRICT p,
+	int bands, VipsBandFormat format, double max_alpha, int width)
+{
+	if ((bands != 2 &&
+			bands != 4) ||
+		!vips_premultiply_max_alpha_ok(format, max_alpha))
+		return 0;
+
+	switch (format) {
+	case VIPS_FORMAT_UCHAR:
+		/* Int alpha is >= 0, so alpha == 0 is alpha < 1.
+		 */
+		return vips_unpremultiply_line_hwy(du8x32, q,
+			(const uint8_t *) p, bands, max_alpha, 1.0f, width);
+
+	case VIPS_FORMAT_USHORT:
+		return vips_unpremultiply_line_hwy(du16x32, q,
+			(const uint16_t *) p, bands, max_alpha, 1.0f, width);
+
+	case VIPS_FORMAT_FLOAT:
+		/* The C tests VIPS_ABS(alpha) < 0.01 in double. 0.01f is just
+		 * below 0.01, so that's the same as less than the next float.
+		 */
+		return vips_unpremultiply_line_hwy(df32, q,
+			(const float *) p, bands, max_alpha,
+			nextafterf(0.01f, 1.0f), width);
+
+	default:
+		return 0;
+	}
+}
+
+/* See VIPS_FLATTEN_INT. T is uchar or ushort, we compute in TW, and TS is
+ * the signed TW we demote from. With a black background, ink is NULL.
+ */
+template <typename T>
+HWY_ATTR int
+vips_flatten_line_hwy(T *HWY_RESTRICT q, const T *HWY_RESTRICT p,
+	int bands, const T *HWY_RESTRICT ink, int width)
+{
+	using TW = hwy::MakeWide<T>;
+	const ScalableTag<TW> dw;
+	const RebindToSigned<decltype(dw)> ds;
+	const Rebind<T, decltype(dw)> d;
+	const int N = Lanes(dw);
+	const auto max = Set(dw, (TW) hwy::LimitsMax<T>());
+	const auto one = Set(dw, 1);
+	const auto bg0 = Set(dw, ink ? ink[0] : 0);
+	const auto bg1 = Set(dw, ink && bands == 4 ? ink[1] : 0);
+	const auto bg2 = Set(dw, ink && bands == 4 ? ink[2] : 0);
+
+	Vec<decltype(d)> a, b, c, e;
+	int x;
+
+	for (x = 0; x + N <= width; x += N) {
+		auto v0 = Zero(dw);
+		auto v1 = Zero(dw);
+		auto v2 = Zero(dw);
+
+		if (bands == 2) {
+			LoadInterleaved2(d, p + x * 2, a, e);
+			v0 = PromoteTo(dw, a);
+		}
+		else {
+			LoadInterleaved4(d, p + x * 4, a, b, c, e);
+			v0 = PromoteTo(dw, a);
+			v1 = PromoteTo(dw, b);
+			v2 = PromoteTo(dw, c);
+		}
+
+		const auto alpha = PromoteTo(dw, e);
+		const auto nalpha = Sub(max, alpha);
+
+		/* p * alpha + bg * nalpha is at most max * max, so this fits,
+		 * and with n the bits in T, (v + 1 + (v >> n)) >> n is exactly v / max.
+		 */
+		v0 = Add(Mul(v0, alpha), Mul(bg0, nalpha));
+		v0 = ShiftRight<8 * sizeof(T)>(
+			Add(Add(v0, one), ShiftRight<8 * sizeof(T)>(v0)));
+
+		if (bands == 2)
+			StoreU(DemoteTo(d, BitCast(ds, v0)), d, q + x);
+		else {
+			v1 = Add(Mul(v1, alpha), Mul(bg1, nalpha));
+			v1 = ShiftRight<8 * sizeof(T)>(
+				Add(Add(v1, one), ShiftRight<8 * sizeof(T)>(v1)));
+			v2 = Add(Mul(v2, alpha), Mul(bg2, nalpha));
+			v2 = ShiftRight<8 * sizeof(T)>(
+				Add(Add(v2, one), ShiftRight<8 * sizeof(T)>(v2)));
+
+			StoreInterleaved3(DemoteTo(d, BitCast(ds, v0)),
+				DemoteTo(d, BitCast(ds, v1)),
+				DemoteTo(d, BitCast(ds, v2)),
+				d, q + x * 3);
+		}
+	}
+
+	return x;
+}
+
+HWY_ATTR int
+vips_flatten_hwy(VipsPel *HWY_RESTRICT q, const VipsPel *HWY_RESTRICT p,
+	int bands, VipsBandFormat format, double max_alpha,
+	const VipsPel *HWY_RESTRICT ink, int width)
+{
+	if (bands != 2 &&
+		bands != 4)
+		return 0;
+
+	switch (format) {
+	case VIPS_FORMAT_UCHAR:
+		if (max_alpha != 255)
+			return 0;
+		return vips_flatten_line_hwy((uint8_t *) q,
+			(const uint8_t *) p, bands, (const uint8_t *) ink, width);
+
+	case VIPS_FORMAT_USHORT:
+		if (max_alpha != 65535)
+			return 0;
+		return vips_flatten_line_hwy((uint16_t *) q,
+			(const uint16_t *) p, bands, (const uint16_t *) ink, width);
+
+	default:
+		return 0;
+	}
+}
+
+} /*namespace HWY_NAMESPACE*/
+
+#if HWY_ONCE
+HWY_EXPORT(vips_premultiply_hwy);
+HWY_EXPORT(vips_unpremultiply_hwy);
+HWY_EXPORT(vips_flatten_hwy);
+
+int
+vips_premultiply_hwy(float *q, const VipsPel *p,
+	int bands, VipsBandFormat format, double max_alpha, int width)
+{
+	/* clang-format off */
+	return HWY_DYNAMIC_DISPATCH(vips_premultiply_hwy)(q, p,
+		bands, format, max_alpha, width);
+	/* clang-format on */
+}
+
+int
+vips_unpremultiply_hwy(float *q, const VipsPel *p,
+	int bands, VipsBandFormat format, double max_alpha, int width)
+{
+	/* clang-format off */
+	return HWY_DYNAMIC_DISPATCH(vips_unpremultiply_hwy)(q, p,
+		bands, format, max_alpha, width);
+	/* clang-format on */
+}
+
+int
+vips_flatten_hwy(VipsPel *q, const VipsPel *p,
+	int bands, VipsBandFormat format, double max_alpha,
+	const VipsPel *ink, int width)
+{
+	/* clang-format off */
+	return HWY_DYNAMIC_DISPATCH(vips_flatten_hwy)(q, p,
+		bands, format, max_alpha, ink, width);
+	/* clang-format on */
+}
+#endif /*HWY_ONCE*/
+
+#endif /*HAVE_HWY*/
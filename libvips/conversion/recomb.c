@@ -7,6 +7,8 @@
  * 	- gtkdoc
  * 9/11/11
  * 	- redo as a class
+ * 19/10/26
+ * 	- add a Highway path for 3 and 4 band matrices
  */
 
 /*
@@ -50,6 +52,7 @@
 #include <math.h>
 
 #include <vips/vips.h>
+#include <vips/vector.h>
 #include <vips/internal.h>
 
 #include "pconversion.h"
@@ -74,10 +77,10 @@ G_DEFINE_TYPE(VipsRecomb, vips_recomb, VIPS_TYPE_CONVERSION);
  */
 #define LOOP(IN, OUT) \
 	{ \
-		IN *restrict p = (IN *) in; \
-		OUT *restrict q = (OUT *) out; \
+		IN *restrict p = (IN *) in + x0 * mwidth; \
+		OUT *restrict q = (OUT *) out + x0 * mheight; \
 \
-		for (x = 0; x < out_region->valid.width; x++) { \
+		for (x = x0; x < out_region->valid.width; x++) { \
 			double *restrict m = VIPS_MATRIX(recomb->coeff, 0, 0); \
 \
 			for (v = 0; v < mheight; v++) { \
@@ -117,6 +120,17 @@ vips_recomb_gen(VipsRegion *out_region,
 			out_region->valid.left, out_region->valid.top + y);
 		VipsPel *out = VIPS_REGION_ADDR(out_region,
 			out_region->valid.left, out_region->valid.top + y);
+		int x0;
+
+		x0 = 0;
+
+#ifdef HAVE_HWY
+		if (vips_vector_isenabled())
+			x0 = vips_recomb_hwy((float *) out, in,
+				vips_image_get_format(im),
+				VIPS_MATRIX(recomb->coeff, 0, 0), mwidth, mheight,
+				out_region->valid.width);
+#endif /*HAVE_HWY*/
 
 		switch (vips_image_get_format(im)) {
 		case VIPS_FORMAT_UCHAR:
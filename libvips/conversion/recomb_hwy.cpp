@@ -0,0 +1,214 @@
+/* Highway kernel for vips_recomb()
+ *
+ * 19/10/26
+ * 	- from recomb.c
+ */
+
+/*
+
+	This file is part of VIPS.
+
+	VIPS is free software; you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+	02110-1301  USA
+
+ */
+
+/*
+
+	These files are distributed with VIPS - http://www.vips.ecs.soton.ac.uk
+
+ */
+
+/* This does the 3x3, 3x4, 4x3 and 4x4 matrices (three or four bands in,
+ * three or four bands out) for uchar, ushort and float images, which covers
+ * colour matrices with and without alpha.
+ *
+ * uchar and ushort pixels are exact in float, so everything is widened to
+ * float and summed with MulAdd(). The scalar path sums in double, so the
+ * result can differ from it by a few float ULP of the sum of the absolute
+ * values of the terms, about 1e-6 relative in practice.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif /*HAVE_CONFIG_H*/
+#include <glib/gi18n-lib.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include <vips/vips.h>
+#include <vips/vector.h>
+#include <vips/debug.h>
+#include <vips/internal.h>
+
+#include "pconversion.h"
+
+#ifdef HAVE_HWY
+
+#undef HWY_TARGET_INCLUDE
+#define HWY_TARGET_INCLUDE "libvips/conversion/recomb_hwy.cpp"
+#include <hwy/foreach_target.h>
+#include <hwy/highway.h>
+
+namespace HWY_NAMESPACE {
+
+using namespace hwy::HWY_NAMESPACE;
+
+using DF32 = ScalableTag<float>;
+using DI32 = ScalableTag<int32_t>;
+constexpr DF32 df32;
+constexpr DI32 di32;
+constexpr Rebind<uint8_t, DI32> du8x32;
+constexpr Rebind<uint16_t, DI32> du16x32;
+
+template <class D, class V>
+HWY_ATTR HWY_INLINE Vec<DF32>
+vips_recomb_tofloat_hwy(D d, V v)
+{
+	return ConvertTo(df32, PromoteTo(di32, v));
+}
+
+HWY_ATTR HWY_INLINE Vec<DF32>
+vips_recomb_tofloat_hwy(DF32 d, Vec<DF32> v)
+{
+	return v;
+}
+
+/* Load a vector of three or four band pixels as float. The fourth band is
+ * zero for three band images.
+ */
+template <class D>
+HWY_ATTR HWY_INLINE void
+vips_recomb_load_hwy(D d, const TFromD<D> *HWY_RESTRICT p, int bands,
+	Vec<DF32> &v0, Vec<DF32> &v1, Vec<DF32> &v2, Vec<DF32> &v3)
+{
+	Vec<D> a, b, c, e;
+
+	if (bands == 3) {
+		LoadInterleaved3(d, p, a, b, c);
+		v3 = Zero(df32);
+	}
+	else {
+		LoadInterleaved4(d, p, a, b, c, e);
+		v3 = vips_recomb_tofloat_hwy(d, e);
+	}
+
+	v0 = vips_recomb_tofloat_hwy(d, a);
+	v1 = vips_recomb_tofloat_hwy(d, b);
+	v2 = vips_recomb_tofloat_hwy(d, c);
+}
+
+/* One row of the matrix. Set() is loop invariant, so the compiler can keep
+ * the coefficients in registers.
+ */
+HWY_ATTR HWY_INLINE Vec<DF32>
+vips_recomb_row_hwy(const float *m, int bands,
+	Vec<DF32> v0, Vec<DF32> v1, Vec<DF32> v2, Vec<DF32> v3)
+{
+	auto t = Mul(Set(df32, m[0]), v0);
+
+	t = MulAdd(Set(df32, m[1]), v1, t);
+	t = MulAdd(Set(df32, m[2]), v2, t);
+	if (bands == 4)
+		t = MulAdd(Set(df32, m[3]), v3, t);
+
+	return t;
+}
+
+template <class D>
+HWY_ATTR int
+vips_recomb_line_hwy(D d, float *HWY_RESTRICT q,
+	const TFromD<D> *HWY_RESTRICT p,
+	const float *m, int mwidth, int mheight, int width)
+{
+	const int N = Lanes(df32);
+
+	int x;
+
+	for (x = 0; x + N <= width; x += N) {
+		Vec<DF32> v0, v1, v2, v3;
+
+		vips_recomb_load_hwy(d, p + mwidth * x, mwidth, v0, v1, v2, v3);
+
+		const auto o0 = vips_recomb_row_hwy(m, mwidth, v0, v1, v2, v3);
+		const auto o1 = vips_recomb_row_hwy(m + mwidth, mwidth,
+			v0, v1, v2, v3);
+		const auto o2 = vips_recomb_row_hwy(m + 2 * mwidth, mwidth,
+			v0, v1, v2, v3);
+
+		if (mheight == 3)
+			StoreInterleaved3(o0, o1, o2, df32, q + 3 * x);
+		else {
+			const auto o3 = vips_recomb_row_hwy(m + 3 * mwidth, mwidth,
+				v0, v1, v2, v3);
+
+			StoreInterleaved4(o0, o1, o2, o3, df32, q + 4 * x);
+		}
+	}
+
+	return x;
+}
+
+HWY_ATTR int
+vips_recomb_hwy(float *q, const VipsPel *p, VipsBandFormat format,
+	const double *matrix, int mwidth, int mheight, int width)
+{
+	float m[16];
+	int i;
+
+	if ((mwidth != 3 && mwidth != 4) ||
+		(mheight != 3 && mheight != 4))
+		return 0;
+
+	for (i = 0; i < mwidth * mheight; i++)
+		m[i] = matrix[i];
+
+	switch (format) {
+	case VIPS_FORMAT_UCHAR:
+		return vips_recomb_line_hwy(du8x32, q, (const uint8_t *) p,
+			m, mwidth, mheight, width);
+
+	case VIPS_FORMAT_USHORT:
+		return vips_recomb_line_hwy(du16x32, q, (const uint16_t *) p,
+			m, mwidth, mheight, width);
+
+	case VIPS_FORMAT_FLOAT:
+		return vips_recomb_line_hwy(df32, q, (const float *) p,
+			m, mwidth, mheight, width);
+
+	default:
+		return 0;
+	}
+}
+
+} /*namespace HWY_NAMESPACE*/
+
+#if HWY_ONCE
+HWY_EXPORT(vips_recomb_hwy);
+
+int
+vips_recomb_hwy(float *q, const VipsPel *p, VipsBandFormat format,
+	const double *matrix, int mwidth, int mheight, int width)
+{
+	/* clang-format off */
+	return HWY_DYNAMIC_DISPATCH(vips_recomb_hwy)(q, p, format,
+		matrix, mwidth, mheight, width);
+	/* clang-format on */
+}
+#endif /*HWY_ONCE*/
+
+#endif /*HAVE_HWY*/
@@ -30,6 +30,9 @@
  * 	- added 90/180/270 convenience functions
  * 10/11/22 alantudyk
  * 	- swapped memcpy() in d180 for a loop
+ * 19/10/26
+ * 	- cache-blocked 90 and 270, with Highway block transposes
+ * 	- Highway path for 180
  */
 
 /*
@@ -73,6 +76,7 @@
 #include <stdlib.h>
 
 #include <vips/vips.h>
+#include <vips/vector.h>
 #include <vips/internal.h>
 #include <vips/debug.h>
 
@@ -95,6 +99,77 @@ typedef VipsConversionClass VipsRotClass;
 
 G_DEFINE_TYPE(VipsRot, vips_rot, VIPS_TYPE_CONVERSION);
 
+/* We transpose in blocks of this many pixels square, so the input lines
+ * we touch stay in cache.
+ */
+#define VIPS_ROT_BLOCK (32)
+
+/* Transpose an area of pixels, so output line y comes from input column y.
+ * Strides are in bytes, and can be negative.
+ */
+static void
+vips_rot_transpose_area(VipsPel *q, int q_stride,
+	VipsPel *p, int p_stride, int width, int height, int ps)
+{
+	int x, y, i;
+
+	for (y = 0; y < height; y++) {
+		VipsPel *q1 = q + (gint64) y * q_stride;
+		VipsPel *p1 = p + y * ps;
+
+		for (x = 0; x < width; x++) {
+			for (i = 0; i < ps; i++)
+				q1[i] = p1[i];
+
+			q1 += ps;
+			p1 += p_stride;
+		}
+	}
+}
+
+static void
+vips_rot_transpose(VipsPel *q, int q_stride,
+	VipsPel *p, int p_stride, int width, int height, int ps)
+{
+	int bx, by;
+
+	for (by = 0; by < height; by += VIPS_ROT_BLOCK)
+		for (bx = 0; bx < width; bx += VIPS_ROT_BLOCK) {
+			int bw = VIPS_MIN(VIPS_ROT_BLOCK, width - bx);
+			int bh = VIPS_MIN(VIPS_ROT_BLOCK, height - by);
+			VipsPel *q1 = q + (gint64) by * q_stride + bx * ps;
+			VipsPel *p1 = p + (gint64) bx * p_stride + by * ps;
+
+			int n;
+
+			n = 0;
+#ifdef HAVE_HWY
+			if (vips_vector_isenabled())
+				n = vips_rot_transpose_hwy(q1, q_stride,
+					p1, p_stride, bw, bh, ps);
+#endif /*HAVE_HWY*/
+
+			if (n == 0)
+				vips_rot_transpose_area(q1, q_stride,
+					p1, p_stride, bw, bh, ps);
+			else {
+				/* Only whole n x n blocks were done, finish
+				 * the right and bottom edges.
+				 */
+				int dw = VIPS_ROUND_DOWN(bw, n);
+				int dh = VIPS_ROUND_DOWN(bh, n);
+
+				vips_rot_transpose_area(q1 + dw * ps, q_stride,
+					p1 + (gint64) dw * p_stride, p_stride,
+					bw - dw, dh, ps);
+				vips_rot_transpose_area(q1 + (gint64) dh * q_stride,
+					q_stride,
+					p1 + dh * ps, p_stride,
+					bw, bh - dh, ps);
+			}
+		}
+}
+
 static int
 vips_rot90_gen(VipsRegion *out_region,
 	void *seq, void *a, void *b, gboolean *stop)
@@ -108,9 +183,6 @@ vips_rot90_gen(VipsRegion *out_region,
 	int le = r->left;
 	int ri = VIPS_RECT_RIGHT(r);
 	int to = r->top;
-	int bo = VIPS_RECT_BOTTOM(r);
-
-	int x, y, i;
 
 	/* Pixel geometry.
 	 */
@@ -132,27 +204,14 @@ vips_rot90_gen(VipsRegion *out_region,
 	ps = VIPS_IMAGE_SIZEOF_PEL(in);
 	ls = VIPS_REGION_LSKIP(ir);
 
-	/* Rotate the bit we now have.
+	/* Rotate the bit we now have. Output lines are input columns, read
+	 * bottom to top.
 	 */
-	for (y = to; y < bo; y++) {
-		/* Start of this output line.
-		 */
-		VipsPel *q = VIPS_REGION_ADDR(out_region, le, y);
-
-		/* Corresponding position in ir.
-		 */
-		VipsPel *p = VIPS_REGION_ADDR(ir,
-			need.left + y - to,
-			need.top + need.height - 1);
-
-		for (x = le; x < ri; x++) {
-			for (i = 0; i < ps; i++)
-				q[i] = p[i];
-
-			q += ps;
-			p -= ls;
-		}
-	}
+	vips_rot_transpose(VIPS_REGION_ADDR(out_region, le, to),
+		VIPS_REGION_LSKIP(out_region),
+		VIPS_REGION_ADDR(ir, need.left, need.top + need.height - 1),
+		-ls,
+		r->width, r->height, ps);
 
 	return 0;
 }
@@ -206,9 +265,21 @@ vips_rot180_gen(VipsRegion *out_region,
 			need.left + need.width - 1,
 			need.top + need.height - (y - to) - 1);
 
+		x = le;
+
+#ifdef HAVE_HWY
+		if (vips_vector_isenabled()) {
+			int n = vips_rot_reverse_hwy(q, p, r->width, ps);
+
+			x += n;
+			q += n * ps;
+			p -= n * ps;
+		}
+#endif /*HAVE_HWY*/
+
 		/* Blap across!
 		 */
-		for (x = le; x < ri; x++) {
+		for (; x < ri; x++) {
 			for (i = 0; i < ps; i++)
 				q[i] = p[i];
 
@@ -231,12 +302,8 @@ vips_rot270_gen(VipsRegion *out_region,
 	 */
 	VipsRect *r = &out_region->valid;
 	int le = r->left;
-	int ri = VIPS_RECT_RIGHT(r);
-	int to = r->top;
 	int bo = VIPS_RECT_BOTTOM(r);
 
-	int x, y, i;
-
 	/* Pixel geometry.
 	 */
 	int ps, ls;
@@ -257,27 +324,14 @@ vips_rot270_gen(VipsRegion *out_region,
 	ps = VIPS_IMAGE_SIZEOF_PEL(in);
 	ls = VIPS_REGION_LSKIP(ir);
 
-	/* Rotate the bit we now have.
+	/* Rotate the bit we now have. Output lines, bottom to top, are input
+	 * columns.
 	 */
-	for (y = to; y < bo; y++) {
-		/* Start of this output line.
-		 */
-		VipsPel *q = VIPS_REGION_ADDR(out_region, le, y);
-
-		/* Corresponding position in ir.
-		 */
-		VipsPel *p = VIPS_REGION_ADDR(ir,
-			need.left + need.width - (y - to) - 1,
-			need.top);
-
-		for (x = le; x < ri; x++) {
-			for (i = 0; i < ps; i++)
-				q[i] = p[i];
-
-			q += ps;
-			p += ls;
-		}
-	}
+	vips_rot_transpose(VIPS_REGION_ADDR(out_region, le, bo - 1),
+		-((int) VIPS_REGION_LSKIP(out_region)),
+		VIPS_REGION_ADDR(ir, need.left, need.top),
+		ls,
+		r->width, r->height, ps);
 
 	return 0;
 }
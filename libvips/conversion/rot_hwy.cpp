@@ -0,0 +1,300 @@
+/* Highway kernels for vips_rot() and vips_flip()
+ *
+ * 19/10/26
+ * 	- from rot.c
+ */
+
+/*
+
+	This file is part of VIPS.
+
+	VIPS is free software; you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+	02110-1301  USA
+
+ */
+
+/*
+
+	These files are distributed with VIPS - http://www.vips.ecs.soton.ac.uk
+
+ */
+
+/* vips_rot_transpose_hwy() transposes square blocks of pixels in registers.
+ * We load one input row per vector, then run the usual butterfly of
+ * interleaves, doubling the lane width each time. After that, vector k
+ * holds input column bitreverse(k), so we store it to that output row.
+ *
+ * Blocks are 8 x 8 for 1 and 2 byte pixels, 4 x 4 for 4 byte pixels and
+ * 2 x 2 for 8 byte pixels. We use fixed 64 and 128-bit vectors since
+ * interleaves work within 128-bit blocks on wider targets.
+ *
+ * vips_rot_reverse_hwy() reverses the order of the pixels in a line, for
+ * rot180 and horizontal flip.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif /*HAVE_CONFIG_H*/
+#include <glib/gi18n-lib.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <vips/vips.h>
+#include <vips/vector.h>
+#include <vips/debug.h>
+#include <vips/internal.h>
+
+#include "pconversion.h"
+
+#ifdef HAVE_HWY
+
+#undef HWY_TARGET_INCLUDE
+#define HWY_TARGET_INCLUDE "libvips/conversion/rot_hwy.cpp"
+#include <hwy/foreach_target.h>
+#include <hwy/highway.h>
+
+namespace HWY_NAMESPACE {
+
+using namespace hwy::HWY_NAMESPACE;
+
+/* Interleave a and b as lanes of type T, leaving the lower half in a and the
+ * upper half in b.
+ */
+template <typename T, class D, class V>
+HWY_ATTR HWY_INLINE void
+vips_rot_zip_hwy(D d, V &a, V &b)
+{
+	const Repartition<T, D> dt;
+	const auto ta = BitCast(dt, a);
+	const auto tb = BitCast(dt, b);
+
+	a = BitCast(d, InterleaveLower(dt, ta, tb));
+	b = BitCast(d, InterleaveUpper(dt, ta, tb));
+}
+
+/* Transpose an 8 x 8 block of pixels of type T. D is a tag for bytes,
+ * 8 * sizeof(T) wide.
+ */
+template <typename T, class D>
+HWY_ATTR HWY_INLINE void
+vips_rot_block8_hwy(D d,
+	uint8_t *HWY_RESTRICT q, ptrdiff_t q_stride,
+	const uint8_t *HWY_RESTRICT p, ptrdiff_t p_stride)
+{
+	using T2 = hwy::MakeWide<T>;
+	using T4 = hwy::MakeWide<T2>;
+
+	auto v0 = LoadU(d, p);
+	auto v1 = LoadU(d, p + p_stride);
+	auto v2 = LoadU(d, p + 2 * p_stride);
+	auto v3 = LoadU(d, p + 3 * p_stride);
+	auto v4 = LoadU(d, p + 4 * p_stride);
+	auto v5 = LoadU(d, p + 5 * p_stride);
+	auto v6 = LoadU(d, p + 6 * p_stride);
+	auto v7 = LoadU(d, p + 7 * p_stride);
+
+	vips_rot_zip_hwy<T>(d, v0, v1);
+	vips_rot_zip_hwy<T>(d, v2, v3);
+	vips_rot_zip_hwy<T>(d, v4, v5);
+	vips_rot_zip_hwy<T>(d, v6, v7);
+
+	vips_rot_zip_hwy<T2>(d, v0, v2);
+	vips_rot_zip_hwy<T2>(d, v1, v3);
+	vips_rot_zip_hwy<T2>(d, v4, v6);
+	vips_rot_zip_hwy<T2>(d, v5, v7);
+
+	vips_rot_zip_hwy<T4>(d, v0, v4);
+	vips_rot_zip_hwy<T4>(d, v1, v5);
+	vips_rot_zip_hwy<T4>(d, v2, v6);
+	vips_rot_zip_hwy<T4>(d, v3, v7);
+
+	StoreU(v0, d, q);
+	StoreU(v4, d, q + q_stride);
+	StoreU(v2, d, q + 2 * q_stride);
+	StoreU(v6, d, q + 3 * q_stride);
+	StoreU(v1, d, q + 4 * q_stride);
+	StoreU(v5, d, q + 5 * q_stride);
+	StoreU(v3, d, q + 6 * q_stride);
+	StoreU(v7, d, q + 7 * q_stride);
+}
+
+/* Transpose a 4 x 4 block of 4 byte pixels.
+ */
+HWY_ATTR HWY_INLINE void
+vips_rot_block4_hwy(uint8_t *HWY_RESTRICT q, ptrdiff_t q_stride,
+	const uint8_t *HWY_RESTRICT p, ptrdiff_t p_stride)
+{
+	const Full128<uint8_t> d;
+
+	auto v0 = LoadU(d, p);
+	auto v1 = LoadU(d, p + p_stride);
+	auto v2 = LoadU(d, p + 2 * p_stride);
+	auto v3 = LoadU(d, p + 3 * p_stride);
+
+	vips_rot_zip_hwy<uint32_t>(d, v0, v1);
+	vips_rot_zip_hwy<uint32_t>(d, v2, v3);
+
+	vips_rot_zip_hwy<uint64_t>(d, v0, v2);
+	vips_rot_zip_hwy<uint64_t>(d, v1, v3);
+
+	StoreU(v0, d, q);
+	StoreU(v2, d, q + q_stride);
+	StoreU(v1, d, q + 2 * q_stride);
+	StoreU(v3, d, q + 3 * q_stride);
+}
+
+/* Transpose a 2 x 2 block of 8 byte pixels.
+ */
+HWY_ATTR HWY_INLINE void
+vips_rot_block2_hwy(uint8_t *HWY_RESTRICT q, ptrdiff_t q_stride,
+	const uint8_t *HWY_RESTRICT p, ptrdiff_t p_stride)
+{
+	const Full128<uint8_t> d;
+
+	auto v0 = LoadU(d, p);
+	auto v1 = LoadU(d, p + p_stride);
+
+	vips_rot_zip_hwy<uint64_t>(d, v0, v1);
+
+	StoreU(v0, d, q);
+	StoreU(v1, d, q + q_stride);
+}
+
+HWY_ATTR int
+vips_rot_transpose_hwy(VipsPel *q, int q_stride,
+	const VipsPel *p, int p_stride,
+	int width, int height, int ps)
+{
+	int n;
+
+	switch (ps) {
+	case 1:
+	case 2:
+		n = 8;
+		break;
+
+	case 4:
+		n = 4;
+		break;
+
+	case 8:
+		n = 2;
+		break;
+
+	default:
+		return 0;
+	}
+
+	for (int y = 0; y + n <= height; y += n)
+		for (int x = 0; x + n <= width; x += n) {
+			/* Output rows y ... come from input columns y ..., and
+			 * output columns x ... come from input rows x ...
+			 */
+			uint8_t *q1 = q + (ptrdiff_t) y * q_stride + x * ps;
+			const uint8_t *p1 = p + (ptrdiff_t) x * p_stride + y * ps;
+
+			switch (ps) {
+			case 1:
+				vips_rot_block8_hwy<uint8_t>(Full64<uint8_t>(),
+					q1, q_stride, p1, p_stride);
+				break;
+
+			case 2:
+				vips_rot_block8_hwy<uint16_t>(Full128<uint8_t>(),
+					q1, q_stride, p1, p_stride);
+				break;
+
+			case 4:
+				vips_rot_block4_hwy(q1, q_stride, p1, p_stride);
+				break;
+
+			case 8:
+				vips_rot_block2_hwy(q1, q_stride, p1, p_stride);
+				break;
+			}
+		}
+
+	return n;
+}
+
+template <typename T>
+HWY_ATTR HWY_INLINE int
+vips_rot_reverse_line_hwy(T *HWY_RESTRICT q, const T *HWY_RESTRICT p,
+	int width)
+{
+	const ScalableTag<T> d;
+	const int N = Lanes(d);
+
+	int x;
+
+	for (x = 0; x + N <= width; x += N)
+		StoreU(Reverse(d, LoadU(d, p - x - N + 1)), d, q + x);
+
+	return x;
+}
+
+HWY_ATTR int
+vips_rot_reverse_hwy(VipsPel *q, const VipsPel *p, int width, int ps)
+{
+	switch (ps) {
+	case 1:
+		return vips_rot_reverse_line_hwy((uint8_t *) q,
+			(const uint8_t *) p, width);
+
+	case 2:
+		return vips_rot_reverse_line_hwy((uint16_t *) q,
+			(const uint16_t *) p, width);
+
+	case 4:
+		return vips_rot_reverse_line_hwy((uint32_t *) q,
+			(const uint32_t *) p, width);
+
+	case 8:
+		return vips_rot_reverse_line_hwy((uint64_t *) q,
+			(const uint64_t *) p, width);
+
+	default:
+		return 0;
+	}
+}
+
+} /*namespace HWY_NAMESPACE*/
+
+#if HWY_ONCE
+HWY_EXPORT(vips_rot_transpose_hwy);
+HWY_EXPORT(vips_rot_reverse_hwy);
+
+int
+vips_rot_transpose_hwy(VipsPel *q, int q_stride,
+	const VipsPel *p, int p_stride,
+	int width, int height, int ps)
+{
+	/* clang-format off */
+	return HWY_DYNAMIC_DISPATCH(vips_rot_transpose_hwy)(q, q_stride,
+		p, p_stride, width, height, ps);
+	/* clang-format on */
+}
+
+int
+vips_rot_reverse_hwy(VipsPel *q, const VipsPel *p, int width, int ps)
+{
+	/* clang-format off */
+	return HWY_DYNAMIC_DISPATCH(vips_rot_reverse_hwy)(q, p, width, ps);
+	/* clang-format on */
+}
+#endif /*HWY_ONCE*/
+
+#endif /*HAVE_HWY*/
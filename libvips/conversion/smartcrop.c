@@ -16,6 +16,8 @@
  * 	- add all
  * 26/11/22 ejoebstl
  *  - expose location of interest when using attention based cropping
+ * 19/10/26
+ * 	- add attention_window
  */
 
 /*
@@ -199,9 +201,12 @@ pythagoras(VipsSmartcrop *smartcrop, VipsImage *in, VipsImage **out)
 	return 0;
 }
 
+/* Find the edge, skin and saturation features of in, scaled by hscale and
+ * vscale, and sum them to make an attention map.
+ */
 static int
-vips_smartcrop_attention(VipsSmartcrop *smartcrop,
-	VipsImage *in, int *left, int *top, int *attention_x, int *attention_y)
+vips_smartcrop_features(VipsSmartcrop *smartcrop,
+	VipsImage *in, double hscale, double vscale, VipsImage **out)
 {
 	/* From smartcrop.js.
 	 */
@@ -211,22 +216,6 @@ vips_smartcrop_attention(VipsSmartcrop *smartcrop,
 	VipsImage **t = (VipsImage **)
 		vips_object_local_array(VIPS_OBJECT(smartcrop), 24);
 
-	double hscale;
-	double vscale;
-	double sigma;
-	double max;
-	int x_pos;
-	int y_pos;
-
-	/* The size we shrink to gives the precision with which we can place
-	 * the crop
-	 */
-	hscale = 32.0 / in->Xsize;
-	vscale = 32.0 / in->Ysize;
-	sigma = sqrt(pow(smartcrop->width * hscale, 2) +
-		pow(smartcrop->height * vscale, 2));
-	sigma = VIPS_MAX(sigma / 10, 1.0);
-
 	if (vips_resize(in, &t[17], hscale,
 			"vscale", vscale,
 			NULL))
@@ -288,16 +277,44 @@ vips_smartcrop_attention(VipsSmartcrop *smartcrop,
 		vips_ifthenelse(t[10], t[13], t[11], &t[16], NULL))
 		return -1;
 
+	if (vips_sum(&t[14], out, 3, NULL))
+		return -1;
+
+	return 0;
+}
+
+static int
+vips_smartcrop_attention(VipsSmartcrop *smartcrop,
+	VipsImage *in, int *left, int *top, int *attention_x, int *attention_y)
+{
+	VipsImage **t = (VipsImage **)
+		vips_object_local_array(VIPS_OBJECT(smartcrop), 2);
+
+	double hscale;
+	double vscale;
+	double sigma;
+	double max;
+	int x_pos;
+	int y_pos;
+
+	/* The size we shrink to gives the precision with which we can place
+	 * the crop
+	 */
+	hscale = 32.0 / in->Xsize;
+	vscale = 32.0 / in->Ysize;
+	sigma = sqrt(pow(smartcrop->width * hscale, 2) +
+		pow(smartcrop->height * vscale, 2));
+	sigma = VIPS_MAX(sigma / 10, 1.0);
+
 	/* Sum, blur and find maxpos.
 	 *
 	 * The amount of blur is related to the size of the crop
 	 * area: how large an area we want to consider for the scoring
 	 * function.
 	 */
-
-	if (vips_sum(&t[14], &t[18], 3, NULL) ||
-		vips_gaussblur(t[18], &t[19], sigma, NULL) ||
-		vips_max(t[19], &max, "x", &x_pos, "y", &y_pos, NULL))
+	if (vips_smartcrop_features(smartcrop, in, hscale, vscale, &t[0]) ||
+		vips_gaussblur(t[0], &t[1], sigma, NULL) ||
+		vips_max(t[1], &max, "x", &x_pos, "y", &y_pos, NULL))
 		return -1;
 
 	/* Transform back into image coordinates.
@@ -317,6 +334,96 @@ vips_smartcrop_attention(VipsSmartcrop *smartcrop,
 	return 0;
 }
 
+/* The largest axis of the proxy we search for
+ * VIPS_INTERESTING_ATTENTION_WINDOW.
+ */
+#define VIPS_SMARTCROP_PROXY_SIZE (256)
+
+/* Find the attention map on a small proxy, then use a summed-area table to
+ * score every position of the crop window in O(1) each. The cost depends on
+ * the proxy size, not the crop size.
+ */
+static int
+vips_smartcrop_attention_window(VipsSmartcrop *smartcrop,
+	VipsImage *in, int *left, int *top, int *attention_x, int *attention_y)
+{
+	VipsImage **t = (VipsImage **)
+		vips_object_local_array(VIPS_OBJECT(smartcrop), 3);
+
+	double scale;
+	int width;
+	int height;
+	int window_width;
+	int window_height;
+	double *sat;
+	double best;
+	int best_x;
+	int best_y;
+	int x, y;
+
+	scale = VIPS_MIN(1.0, (double) VIPS_SMARTCROP_PROXY_SIZE /
+			VIPS_MAX(in->Xsize, in->Ysize));
+
+	if (vips_smartcrop_features(smartcrop, in, scale, scale, &t[0]) ||
+		vips_cast(t[0], &t[1], VIPS_FORMAT_DOUBLE, NULL) ||
+		!(t[2] = vips_image_copy_memory(t[1])))
+		return -1;
+
+	width = t[2]->Xsize;
+	height = t[2]->Ysize;
+	window_width = VIPS_CLIP(1, VIPS_RINT(smartcrop->width * scale), width);
+	window_height =
+		VIPS_CLIP(1, VIPS_RINT(smartcrop->height * scale), height);
+
+	/* sat[y][x] is the sum of the map above and to the left of (x, y),
+	 * with an extra zero row and column.
+	 */
+	sat = VIPS_ARRAY(smartcrop, (width + 1) * (height + 1), double);
+	for (y = 0; y < height; y++) {
+		double *p = (double *) VIPS_IMAGE_ADDR(t[2], 0, y);
+		double *q = sat + (y + 1) * (width + 1);
+		double row = 0.0;
+
+		for (x = 0; x < width; x++) {
+			row += p[x];
+			q[x + 1] = q[x + 1 - (width + 1)] + row;
+		}
+	}
+
+	best = 0.0;
+	best_x = 0;
+	best_y = 0;
+	for (y = 0; y + window_height <= height; y++) {
+		double *p = sat + y * (width + 1);
+		double *q = sat + (y + window_height) * (width + 1);
+
+		for (x = 0; x + window_width <= width; x++) {
+			double score = q[x + window_width] - q[x] -
+				p[x + window_width] + p[x];
+
+			if ((x == 0 && y == 0) ||
+				score > best) {
+				best = score;
+				best_x = x;
+				best_y = y;
+			}
+		}
+	}
+
+	/* Transform back into image coordinates.
+	 */
+	*left = VIPS_CLIP(0,
+		VIPS_RINT(best_x / scale),
+		in->Xsize - smartcrop->width);
+	*top = VIPS_CLIP(0,
+		VIPS_RINT(best_y / scale),
+		in->Ysize - smartcrop->height);
+	*attention_x = *left + smartcrop->width / 2;
+	*attention_y = *top + smartcrop->height / 2;
+
+	return 0;
+}
+
 static int
 vips_smartcrop_build(VipsObject *object)
 {
@@ -378,6 +485,13 @@ vips_smartcrop_build(VipsObject *object)
 			return -1;
 		break;
 
+	case VIPS_INTERESTING_ATTENTION_WINDOW:
+		if (vips_smartcrop_attention_window(smartcrop, in,
+				&left, &top,
+				&attention_x, &attention_y))
+			return -1;
+		break;
+
 	case VIPS_INTERESTING_HIGH:
 		left = in->Xsize - smartcrop->width;
 		top = in->Ysize - smartcrop->height;
@@ -505,6 +619,11 @@ vips_smartcrop_init(VipsSmartcrop *smartcrop)
  * Use @interesting to pick the method vips uses to decide which bits of the
  * image should be kept.
  *
+ * #VIPS_INTERESTING_ATTENTION_WINDOW finds features on a proxy at most 256
+ * pixels across, so it costs about the same for any crop size. The time is
+ * dominated by the shrink to the proxy, so load with shrink-on-load, or use
+ * vips_thumbnail(), if you can.
+ *
  * You can test xoffset / yoffset on @out to find the location of the crop
  * within the input image.
  *
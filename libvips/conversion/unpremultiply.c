@@ -11,6 +11,8 @@
  * 	- revise range clipping and 1/x, again
  * 8/8/22
  *      - look for alpha near 0, not just exactly 0
+ * 19/10/26
+ * 	- add a Highway path
  */
 
 /*
@@ -55,6 +57,7 @@
 #include <math.h>
 
 #include <vips/vips.h>
+#include <vips/vector.h>
 #include <vips/internal.h>
 #include <vips/debug.h>
 
@@ -82,7 +85,7 @@ G_DEFINE_TYPE(VipsUnpremultiply, vips_unpremultiply, VIPS_TYPE_CONVERSION);
 		IN *restrict p = (IN *) in; \
 		OUT *restrict q = (OUT *) out; \
 \
-		for (x = 0; x < width; x++) { \
+		for (x = x0; x < width; x++) { \
 			IN alpha = p[alpha_band]; \
 			OUT factor = alpha == 0 ? 0 : max_alpha / alpha; \
 \
@@ -104,7 +107,7 @@ G_DEFINE_TYPE(VipsUnpremultiply, vips_unpremultiply, VIPS_TYPE_CONVERSION);
 		IN *restrict p = (IN *) in; \
 		OUT *restrict q = (OUT *) out; \
 \
-		for (x = 0; x < width; x++) { \
+		for (x = x0; x < width; x++) { \
 			IN alpha = p[3]; \
 			OUT factor = alpha == 0 ? 0 : max_alpha / alpha; \
 \
@@ -136,7 +139,7 @@ G_DEFINE_TYPE(VipsUnpremultiply, vips_unpremultiply, VIPS_TYPE_CONVERSION);
 		IN *restrict p = (IN *) in; \
 		OUT *restrict q = (OUT *) out; \
 \
-		for (x = 0; x < width; x++) { \
+		for (x = x0; x < width; x++) { \
 			IN alpha = p[alpha_band]; \
 			OUT factor = VIPS_ABS(alpha) < 0.01 ? 0 : max_alpha / alpha; \
 \
@@ -156,7 +159,7 @@ G_DEFINE_TYPE(VipsUnpremultiply, vips_unpremultiply, VIPS_TYPE_CONVERSION);
 		IN *restrict p = (IN *) in; \
 		OUT *restrict q = (OUT *) out; \
 \
-		for (x = 0; x < width; x++) { \
+		for (x = x0; x < width; x++) { \
 			IN alpha = p[3]; \
 			OUT factor = VIPS_ABS(alpha) < 0.01 ? 0 : max_alpha / alpha; \
 \
@@ -202,6 +205,20 @@ vips_unpremultiply_gen(VipsRegion *out_region,
 	for (y = 0; y < r->height; y++) {
 		VipsPel *in = VIPS_REGION_ADDR(ir, r->left, r->top + y);
 		VipsPel *out = VIPS_REGION_ADDR(out_region, r->left, r->top + y);
+		int x0;
+
+		x0 = 0;
+
+#ifdef HAVE_HWY
+		if (vips_vector_isenabled() &&
+			alpha_band == bands - 1 &&
+			im->BandFmt != VIPS_FORMAT_DOUBLE) {
+			x0 = vips_unpremultiply_hwy((float *) out, in,
+				bands, im->BandFmt, max_alpha, width);
+			in += x0 * VIPS_IMAGE_SIZEOF_PEL(im);
+			out += x0 * VIPS_IMAGE_SIZEOF_PEL(out_region->im);
+		}
+#endif /*HAVE_HWY*/
 
 		switch (im->BandFmt) {
 		case VIPS_FORMAT_UCHAR:
@@ -5,6 +5,8 @@
  * 8/5/17
  * 	- default to float ... int will often lose precision and should not be
  * 	  the default
+ * 19/10/26
+ * 	- use an FFT for large masks
  */
 
 /*
@@ -85,6 +87,23 @@ vips_conv_build(VipsObject *object)
 		return -1;
 	in = t[0];
 
+#ifdef HAVE_FFTW
+	/* Large masks are quicker by FFT.
+	 */
+	if (vips__convfft_use(in, convolution->M, conv->precision)) {
+		g_info("conv: using FFT path");
+
+		if (vips__convfft(in, &t[1], convolution->M, conv->precision) ||
+			vips_image_write(t[1], convolution->out))
+			return -1;
+
+		vips_reorder_margin_hint(convolution->out,
+			convolution->M->Xsize * convolution->M->Ysize);
+
+		return 0;
+	}
+#endif /*HAVE_FFTW*/
+
 	switch (conv->precision) {
 	case VIPS_PRECISION_FLOAT:
 		if (vips_convf(in, &t[1], convolution->M, NULL) ||
@@ -201,6 +220,12 @@ vips_conv_init(VipsConv *conv)
  * Disable the vector path with `--vips-novector` or `VIPS_NOVECTOR` or
  * vips_vector_set_enabled().
  *
+ * For large masks with #VIPS_PRECISION_FLOAT or #VIPS_PRECISION_INTEGER,
+ * if VIPS was built with fftw, vips_conv() convolves by FFT instead, a tile
+ * at a time. It does this when it estimates the FFT will be quicker, which is
+ * usually for dense masks larger than about 31 x 31. Results match the
+ * direct path to within rounding error.
+ *
  * If @precision is #VIPS_PRECISION_APPROXIMATE then, like
  * #VIPS_PRECISION_INTEGER, @mask is converted to int before convolution, and
  * the output image
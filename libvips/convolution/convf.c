@@ -51,6 +51,8 @@
  * 	- remove pts for a small speedup
  * 2/8/22 kleisauke
  * 	- bake the scale into the mask
+ * 19/10/26
+ * 	- add a highway path, with a special case for 1D masks
  */
 
 /*
@@ -94,6 +96,7 @@
 #include <limits.h>
 
 #include <vips/vips.h>
+#include <vips/vector.h>
 
 #include "pconvolution.h"
 
@@ -105,6 +108,12 @@ typedef struct {
 	int nnz;		/* Number of non-zero mask elements */
 	double *coeff;	/* Array of non-zero mask coefficients */
 	int *coeff_pos; /* Index of each nnz element in mask->coeff */
+
+	/* 1D masks are run in full, with taps a fixed distance apart, and
+	 * symmetric ones fold each pair of taps.
+	 */
+	gboolean is1d;
+	gboolean symmetric;
 } VipsConvf;
 
 typedef VipsConvolutionClass VipsConvfClass;
@@ -161,11 +170,11 @@ vips_convf_start(VipsImage *out, void *a, void *b)
 
 #define CONV_FLOAT(ITYPE, OTYPE) \
 	{ \
-		ITYPE *restrict p = (ITYPE *) VIPS_REGION_ADDR(ir, le, y); \
+		ITYPE *restrict p = (ITYPE *) VIPS_REGION_ADDR(ir, le, y) + x0; \
 		OTYPE *restrict q = (OTYPE *) VIPS_REGION_ADDR(out_region, le, y); \
 		int *restrict offsets = seq->offsets; \
 \
-		for (x = 0; x < sz; x++) { \
+		for (x = x0; x < sz; x++) { \
 			double sum; \
 			int i; \
 \
@@ -202,6 +211,7 @@ vips_convf_gen(VipsRegion *out_region,
 
 	VipsRect s;
 	int x, y, z, i;
+	int x0;
 
 	/* Prepare the section of the input image we need. A little larger
 	 * than the section of the output image we are producing.
@@ -233,6 +243,29 @@ vips_convf_gen(VipsRegion *out_region,
 	VIPS_GATE_START("vips_convf_gen: work");
 
 	for (y = to; y < bo; y++) {
+		x0 = 0;
+#ifdef HAVE_HWY
+		if (vips_vector_isenabled() &&
+			!vips_band_format_iscomplex(in->BandFmt)) {
+			VipsPel *p = VIPS_REGION_ADDR(ir, le, y);
+			VipsPel *q = VIPS_REGION_ADDR(out_region, le, y);
+
+			if (convf->is1d) {
+				int stride = M->Ysize == 1
+					? in->Bands
+					: VIPS_REGION_LSKIP(ir) /
+						VIPS_IMAGE_SIZEOF_ELEMENT(in);
+
+				x0 = vips_convf_1d_hwy(q, p, in->BandFmt, sz, stride,
+					(double *) VIPS_IMAGE_ADDR(M, 0, 0),
+					M->Xsize * M->Ysize, convf->symmetric, offset);
+			}
+			else
+				x0 = vips_convf_hwy(q, p, in->BandFmt, sz,
+					seq->offsets, t, nnz, offset);
+		}
+#endif /*HAVE_HWY*/
+
 		switch (in->BandFmt) {
 		case VIPS_FORMAT_UCHAR:
 			CONV_FLOAT(unsigned char, float);
@@ -329,6 +362,14 @@ vips_convf_build(VipsObject *object)
 		convf->nnz = 1;
 	}
 
+	convf->is1d = M->Xsize == 1 || M->Ysize == 1;
+	convf->symmetric = TRUE;
+	for (i = 0; i < ne / 2; i++)
+		if (coeff[i] != coeff[ne - 1 - i]) {
+			convf->symmetric = FALSE;
+			break;
+		}
+
 	in = convolution->in;
 
 	if (vips_embed(in, &t[0],
@@ -0,0 +1,339 @@
+/* Highway kernels for vips_convf()
+ *
+ * 19/10/26
+ * 	- from convf.c
+ */
+
+/*
+
+	This file is part of VIPS.
+
+	VIPS is free software; you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+	02110-1301  USA
+
+ */
+
+/*
+
+	These files are distributed with VIPS - http://www.vips.ecs.soton.ac.uk
+
+ */
+
+/* These work along a line of band elements, a vector of output elements at a
+ * time. Each mask coefficient is broadcast and multiply-added against the
+ * input shifted by that coefficient's offset, so every lane is an
+ * independent output element and bands need no special handling.
+ *
+ * uchar, ushort and float images sum in float, double images in double. The
+ * C sums in double for everything, so float output can differ from it by a
+ * few float ULP.
+ *
+ * 1D masks, ie. the two passes of vips_convsep(), skip the offset table:
+ * taps are a fixed stride apart (bands for a row, the line skip for a
+ * column). If the mask is symmetric, as all gaussians are, we add each pair
+ * of pixels first and halve the number of multiplies.
+ *
+ * They return the number of elements done and the caller finishes the line.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif /*HAVE_CONFIG_H*/
+#include <glib/gi18n-lib.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <vips/vips.h>
+#include <vips/vector.h>
+#include <vips/debug.h>
+#include <vips/internal.h>
+
+#include "pconvolution.h"
+
+#ifdef HAVE_HWY
+
+#undef HWY_TARGET_INCLUDE
+#define HWY_TARGET_INCLUDE "libvips/convolution/convf_hwy.cpp"
+#include <hwy/foreach_target.h>
+#include <hwy/highway.h>
+
+namespace HWY_NAMESPACE {
+
+using namespace hwy::HWY_NAMESPACE;
+
+using DF32 = ScalableTag<float>;
+using DI32 = ScalableTag<int32_t>;
+constexpr DF32 df32;
+constexpr DI32 di32;
+constexpr Rebind<uint8_t, DI32> du8x32;
+constexpr Rebind<uint16_t, DI32> du16x32;
+
+#if HWY_HAVE_FLOAT64
+using DF64 = ScalableTag<double>;
+constexpr DF64 df64;
+#endif /*HWY_HAVE_FLOAT64*/
+
+/* Load a vector of input elements in the sum type.
+ */
+HWY_ATTR HWY_INLINE Vec<DF32>
+vips_convf_load_hwy(DF32 d, const uint8_t *HWY_RESTRICT p)
+{
+	return ConvertTo(d, PromoteTo(di32, LoadU(du8x32, p)));
+}
+
+HWY_ATTR HWY_INLINE Vec<DF32>
+vips_convf_load_hwy(DF32 d, const uint16_t *HWY_RESTRICT p)
+{
+	return ConvertTo(d, PromoteTo(di32, LoadU(du16x32, p)));
+}
+
+HWY_ATTR HWY_INLINE Vec<DF32>
+vips_convf_load_hwy(DF32 d, const float *HWY_RESTRICT p)
+{
+	return LoadU(d, p);
+}
+
+#if HWY_HAVE_FLOAT64
+HWY_ATTR HWY_INLINE Vec<DF64>
+vips_convf_load_hwy(DF64 d, const double *HWY_RESTRICT p)
+{
+	return LoadU(d, p);
+}
+#endif /*HWY_HAVE_FLOAT64*/
+
+/* Any mask, as a list of non-zero coefficients and their offsets. Four
+ * vectors at a time, so each broadcast is used four times and there are
+ * four independent chains of multiply-adds.
+ */
+template <class D, typename TI>
+HWY_ATTR int
+vips_convf_line_hwy(D d, TFromD<D> *HWY_RESTRICT q,
+	const TI *HWY_RESTRICT p, int sz,
+	const int *HWY_RESTRICT offsets, const double *HWY_RESTRICT coeff,
+	int nnz, double offset)
+{
+	using T = TFromD<D>;
+	const int N = Lanes(d);
+	const auto voffset = Set(d, (T) offset);
+
+	int x, i;
+
+	for (x = 0; x + 4 * N <= sz; x += 4 * N) {
+		auto sum0 = voffset;
+		auto sum1 = voffset;
+		auto sum2 = voffset;
+		auto sum3 = voffset;
+
+		for (i = 0; i < nnz; i++) {
+			const auto c = Set(d, (T) coeff[i]);
+			const TI *HWY_RESTRICT pi = p + x + offsets[i];
+
+			sum0 = MulAdd(c, vips_convf_load_hwy(d, pi), sum0);
+			sum1 = MulAdd(c, vips_convf_load_hwy(d, pi + N), sum1);
+			sum2 = MulAdd(c, vips_convf_load_hwy(d, pi + 2 * N), sum2);
+			sum3 = MulAdd(c, vips_convf_load_hwy(d, pi + 3 * N), sum3);
+		}
+
+		StoreU(sum0, d, q + x);
+		StoreU(sum1, d, q + x + N);
+		StoreU(sum2, d, q + x + 2 * N);
+		StoreU(sum3, d, q + x + 3 * N);
+	}
+
+	for (; x + N <= sz; x += N) {
+		auto sum = voffset;
+
+		for (i = 0; i < nnz; i++)
+			sum = MulAdd(Set(d, (T) coeff[i]),
+				vips_convf_load_hwy(d, p + x + offsets[i]), sum);
+
+		StoreU(sum, d, q + x);
+	}
+
+	return x;
+}
+
+/* A 1D mask of @n coefficients with taps @stride elements apart.
+ */
+template <class D, typename TI>
+HWY_ATTR int
+vips_convf_1d_line_hwy(D d, TFromD<D> *HWY_RESTRICT q,
+	const TI *HWY_RESTRICT p, int sz, int stride,
+	const double *HWY_RESTRICT coeff, int n, int symmetric, double offset)
+{
+	using T = TFromD<D>;
+	const int N = Lanes(d);
+	const auto voffset = Set(d, (T) offset);
+
+	/* Fold this many pairs from the ends, then do the middle tap (if any)
+	 * on its own.
+	 */
+	const int half = symmetric ? n / 2 : 0;
+
+	int x, i;
+
+	for (x = 0; x + 4 * N <= sz; x += 4 * N) {
+		auto sum0 = voffset;
+		auto sum1 = voffset;
+		auto sum2 = voffset;
+		auto sum3 = voffset;
+
+		for (i = 0; i < half; i++) {
+			const auto c = Set(d, (T) coeff[i]);
+			const TI *HWY_RESTRICT a = p + x + i * stride;
+			const TI *HWY_RESTRICT b = p + x + (n - 1 - i) * stride;
+
+			const auto v0 = Add(vips_convf_load_hwy(d, a),
+				vips_convf_load_hwy(d, b));
+			const auto v1 = Add(vips_convf_load_hwy(d, a + N),
+				vips_convf_load_hwy(d, b + N));
+			const auto v2 = Add(vips_convf_load_hwy(d, a + 2 * N),
+				vips_convf_load_hwy(d, b + 2 * N));
+			const auto v3 = Add(vips_convf_load_hwy(d, a + 3 * N),
+				vips_convf_load_hwy(d, b + 3 * N));
+
+			sum0 = MulAdd(c, v0, sum0);
+			sum1 = MulAdd(c, v1, sum1);
+			sum2 = MulAdd(c, v2, sum2);
+			sum3 = MulAdd(c, v3, sum3);
+		}
+
+		for (; i < n - half; i++) {
+			const auto c = Set(d, (T) coeff[i]);
+			const TI *HWY_RESTRICT a = p + x + i * stride;
+
+			sum0 = MulAdd(c, vips_convf_load_hwy(d, a), sum0);
+			sum1 = MulAdd(c, vips_convf_load_hwy(d, a + N), sum1);
+			sum2 = MulAdd(c, vips_convf_load_hwy(d, a + 2 * N), sum2);
+			sum3 = MulAdd(c, vips_convf_load_hwy(d, a + 3 * N), sum3);
+		}
+
+		StoreU(sum0, d, q + x);
+		StoreU(sum1, d, q + x + N);
+		StoreU(sum2, d, q + x + 2 * N);
+		StoreU(sum3, d, q + x + 3 * N);
+	}
+
+	for (; x + N <= sz; x += N) {
+		auto sum = voffset;
+
+		for (i = 0; i < half; i++) {
+			const TI *HWY_RESTRICT a = p + x + i * stride;
+			const TI *HWY_RESTRICT b = p + x + (n - 1 - i) * stride;
+			const auto v = Add(vips_convf_load_hwy(d, a),
+				vips_convf_load_hwy(d, b));
+
+			sum = MulAdd(Set(d, (T) coeff[i]), v, sum);
+		}
+
+		for (; i < n - half; i++)
+			sum = MulAdd(Set(d, (T) coeff[i]),
+				vips_convf_load_hwy(d, p + x + i * stride), sum);
+
+		StoreU(sum, d, q + x);
+	}
+
+	return x;
+}
+
+HWY_ATTR int
+vips_convf_hwy(VipsPel *HWY_RESTRICT q, const VipsPel *HWY_RESTRICT p,
+	VipsBandFormat format, int sz,
+	const int *HWY_RESTRICT offsets, const double *HWY_RESTRICT coeff,
+	int nnz, double offset)
+{
+	switch (format) {
+	case VIPS_FORMAT_UCHAR:
+		return vips_convf_line_hwy(df32, (float *) q, (const uint8_t *) p,
+			sz, offsets, coeff, nnz, offset);
+
+	case VIPS_FORMAT_USHORT:
+		return vips_convf_line_hwy(df32, (float *) q, (const uint16_t *) p,
+			sz, offsets, coeff, nnz, offset);
+
+	case VIPS_FORMAT_FLOAT:
+		return vips_convf_line_hwy(df32, (float *) q, (const float *) p,
+			sz, offsets, coeff, nnz, offset);
+
+#if HWY_HAVE_FLOAT64
+	case VIPS_FORMAT_DOUBLE:
+		return vips_convf_line_hwy(df64, (double *) q, (const double *) p,
+			sz, offsets, coeff, nnz, offset);
+#endif /*HWY_HAVE_FLOAT64*/
+
+	default:
+		return 0;
+	}
+}
+
+HWY_ATTR int
+vips_convf_1d_hwy(VipsPel *HWY_RESTRICT q, const VipsPel *HWY_RESTRICT p,
+	VipsBandFormat format, int sz, int stride,
+	const double *HWY_RESTRICT coeff, int n, int symmetric, double offset)
+{
+	switch (format) {
+	case VIPS_FORMAT_UCHAR:
+		return vips_convf_1d_line_hwy(df32, (float *) q, (const uint8_t *) p,
+			sz, stride, coeff, n, symmetric, offset);
+
+	case VIPS_FORMAT_USHORT:
+		return vips_convf_1d_line_hwy(df32, (float *) q, (const uint16_t *) p,
+			sz, stride, coeff, n, symmetric, offset);
+
+	case VIPS_FORMAT_FLOAT:
+		return vips_convf_1d_line_hwy(df32, (float *) q, (const float *) p,
+			sz, stride, coeff, n, symmetric, offset);
+
+#if HWY_HAVE_FLOAT64
+	case VIPS_FORMAT_DOUBLE:
+		return vips_convf_1d_line_hwy(df64, (double *) q, (const double *) p,
+			sz, stride, coeff, n, symmetric, offset);
+#endif /*HWY_HAVE_FLOAT64*/
+
+	default:
+		return 0;
+	}
+}
+
+} /*namespace HWY_NAMESPACE*/
+
+#if HWY_ONCE
+HWY_EXPORT(vips_convf_hwy);
+HWY_EXPORT(vips_convf_1d_hwy);
+
+int
+vips_convf_hwy(VipsPel *q, const VipsPel *p, VipsBandFormat format, int sz,
+	const int *offsets, const double *coeff, int nnz, double offset)
+{
+	/* clang-format off */
+	return HWY_DYNAMIC_DISPATCH(vips_convf_hwy)(q, p, format, sz,
+		offsets, coeff, nnz, offset);
+	/* clang-format on */
+}
+
+int
+vips_convf_1d_hwy(VipsPel *q, const VipsPel *p, VipsBandFormat format,
+	int sz, int stride, const double *coeff, int n, int symmetric,
+	double offset)
+{
+	/* clang-format off */
+	return HWY_DYNAMIC_DISPATCH(vips_convf_1d_hwy)(q, p, format, sz,
+		stride, coeff, n, symmetric, offset);
+	/* clang-format on */
+}
+#endif /*HWY_ONCE*/
+
+#endif /*HAVE_HWY*/
@@ -0,0 +1,581 @@
+/* Overlap-save FFT convolution.
+ *
+ * 19/10/26
+ * 	- from convf.c
+ */
+
+/*
+
+	This file is part of VIPS.
+
+	VIPS is free software; you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+	02110-1301  USA
+
+ */
+
+/*
+
+	These files are distributed with VIPS - http://www.vips.ecs.soton.ac.uk
+
+ */
+
+/* vips_conv() uses this for large masks.
+ *
+ * Each output tile is cut into blocks. A block of w x h output pixels needs
+ * (w + mw - 1) x (h + mh - 1) input pixels, which we copy into a
+ * size x size buffer, transform, multiply by the transform of the mask, and
+ * transform back. The mask is stored reversed, so the circular convolution
+ * of the buffer is the correlation vips_conv() computes, and the first w x h
+ * results are exactly the output block: the results that wrap around are
+ * discarded. This is overlap-save.
+ *
+ * Blocks are independent, so this works tile by tile from a normal
+ * edge-extended input, with memory bounded by the FFT size. Overlap-add
+ * would have to sum partial results across neighbouring tiles.
+ *
+ * Output follows vips_convf() for VIPS_PRECISION_FLOAT and vips_convi() for
+ * VIPS_PRECISION_INTEGER. For INTEGER the mask is rounded to int, so the
+ * sums are integers and after rint() we can do the same integer arithmetic
+ * as the C path.
+ */
+
+/*
+#define DEBUG
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif /*HAVE_CONFIG_H*/
+#include <glib/gi18n-lib.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <math.h>
+
+#include <vips/vips.h>
+#include <vips/internal.h>
+
+#include "pconvolution.h"
+
+#ifdef HAVE_FFTW
+
+#include <fftw3.h>
+
+/* FFTW is a little slower per flop than our vector loops, and we must copy
+ * in and out of the buffers, so only use it when the model says it's this
+ * many times cheaper. This puts the changeover at about 31 x 31 for a
+ * dense mask.
+ */
+#define VIPS_CONVFFT_MARGIN (6.0)
+
+typedef struct _VipsConvfft {
+	int mw;
+	int mh;
+
+	/* FFT size, and the output block each FFT makes.
+	 */
+	int size;
+	int block_width;
+	int block_height;
+
+	/* The transform of the reversed mask, size x (size / 2 + 1), with the
+	 * 1 / (size * size) of the inverse transform baked in.
+	 */
+	fftw_complex *mask;
+
+	/* Shared plans, see vips__fft_plan_get().
+	 */
+	fftw_plan forward;
+	fftw_plan inverse;
+
+	/* Reproduce vips_convi().
+	 */
+	gboolean intize;
+	double scale;
+	double offset;
+} VipsConvfft;
+
+typedef struct {
+	VipsRegion *ir;
+
+	double *buf;
+	fftw_complex *spectrum;
+} VipsConvfftSequence;
+
+/* Cost of one output pixel with an FFT of this size, in multiply-adds.
+ */
+static double
+vips_convfft_cost(int size, int mw, int mh)
+{
+	int block_width = size - mw + 1;
+	int block_height = size - mh + 1;
+	int blocks = VIPS_ROUND_UP(vips__tile_width, block_width) /
+		block_width *
+		VIPS_ROUND_UP(vips__tile_height, block_height) / block_height;
+	double n = (double) size * size;
+
+	/* A real transform is about 2.5 n log2(n) flops each way, and the
+	 * complex multiply 6 flops for each of n / 2 elements.
+	 */
+	double flops = 2 * 2.5 * n * log2(n) + 3 * n;
+
+	return blocks * flops / 2 / (vips__tile_width * vips__tile_height);
+}
+
+/* Pick an FFT size for this mask, or zero if we should convolve directly.
+ */
+static int
+vips_convfft_size(VipsImage *M, VipsPrecision precision)
+{
+	double *coeff = VIPS_MATRIX(M, 0, 0);
+	int ne = M->Xsize * M->Ysize;
+
+	int nnz;
+	int best_size;
+	double best_cost;
+	int size;
+	int i;
+
+	nnz = 0;
+	for (i = 0; i < ne; i++) {
+		double v = precision == VIPS_PRECISION_INTEGER
+			? VIPS_RINT(coeff[i])
+			: coeff[i];
+
+		if (v != 0)
+			nnz += 1;
+	}
+
+	best_size = 0;
+	best_cost = nnz / VIPS_CONVFFT_MARGIN;
+	for (size = 32; size <= 2048; size *= 2) {
+		double cost;
+
+		if (size - M->Xsize + 1 < 8 ||
+			size - M->Ysize + 1 < 8)
+			continue;
+
+		cost = vips_convfft_cost(size, M->Xsize, M->Ysize);
+		if (cost < best_cost) {
+			best_size = size;
+			best_cost = cost;
+		}
+	}
+
+#ifdef DEBUG
+	printf("vips_convfft_size: nnz = %d, size = %d\n", nnz, best_size);
+#endif /*DEBUG*/
+
+	return best_size;
+}
+
+gboolean
+vips__convfft_use(VipsImage *in, VipsImage *M, VipsPrecision precision)
+{
+	if (vips_band_format_iscomplex(in->BandFmt))
+		return FALSE;
+	if (precision != VIPS_PRECISION_FLOAT &&
+		precision != VIPS_PRECISION_INTEGER)
+		return FALSE;
+
+	return vips_convfft_size(M, precision) > 0;
+}
+
+static void
+vips_convfft_free(VipsImage *image, VipsConvfft *convfft)
+{
+	VIPS_FREEF(vips__fft_plan_release, convfft->forward);
+	VIPS_FREEF(vips__fft_plan_release, convfft->inverse);
+	VIPS_FREEF(fftw_free, convfft->mask);
+	g_free(convfft);
+}
+
+static int
+vips_convfft_stop(void *vseq, void *a, void *b)
+{
+	VipsConvfftSequence *seq = (VipsConvfftSequence *) vseq;
+
+	VIPS_UNREF(seq->ir);
+	VIPS_FREEF(fftw_free, seq->buf);
+	VIPS_FREEF(fftw_free, seq->spectrum);
+	g_free(seq);
+
+	return 0;
+}
+
+static void *
+vips_convfft_start(VipsImage *out, void *a, void *b)
+{
+	VipsImage *in = (VipsImage *) a;
+	VipsConvfft *convfft = (VipsConvfft *) b;
+	int size = convfft->size;
+
+	VipsConvfftSequence *seq;
+
+	seq = g_new0(VipsConvfftSequence, 1);
+	seq->ir = vips_region_new(in);
+
+	/* fftw_alloc gives the same alignment as the planner buffers, so we
+	 * can run the shared plans on these.
+	 */
+	if (!(seq->buf = fftw_alloc_real((size_t) size * size)) ||
+		!(seq->spectrum =
+				fftw_alloc_complex((size_t) size * (size / 2 + 1)))) {
+		vips_convfft_stop(seq, in, convfft);
+		vips_error("convfft", "%s", _("out of memory"));
+		return NULL;
+	}
+
+	/* Buffer elements outside the block never reach the result we keep,
+	 * but they must be finite.
+	 */
+	memset(seq->buf, 0, (size_t) size * size * sizeof(double));
+
+	return (void *) seq;
+}
+
+#define LOAD(TYPE) \
+	{ \
+		for (y = 0; y < s.height; y++) { \
+			TYPE *restrict p = (TYPE *) \
+				VIPS_REGION_ADDR(ir, s.left, s.top + y); \
+			double *restrict q = seq->buf + y * size; \
+\
+			for (x = 0; x < s.width; x++) \
+				q[x] = p[x * bands + b]; \
+		} \
+	}
+
+#define WRITE_FLOAT(TYPE) \
+	{ \
+		for (y = 0; y < block->height; y++) { \
+			double *restrict p = seq->buf + y * size; \
+			TYPE *restrict q = (TYPE *) VIPS_REGION_ADDR(out_region, \
+				block->left, block->top + y); \
+\
+			for (x = 0; x < block->width; x++) \
+				q[x * bands + b] = p[x] / scale + offset; \
+		} \
+	}
+
+/* The sums are exact integers, so after rint() this is the same as the
+ * CONV_INT loop in convi.c.
+ */
+#define WRITE_INT(TYPE, MIN, MAX) \
+	{ \
+		for (y = 0; y < block->height; y++) { \
+			double *restrict p = seq->buf + y * size; \
+			TYPE *restrict q = (TYPE *) VIPS_REGION_ADDR(out_region, \
+				block->left, block->top + y); \
+\
+			for (x = 0; x < block->width; x++) { \
+				gint64 sum = rint(p[x]); \
+\
+				sum = (sum + rounding) / iscale + ioffset; \
+				q[x * bands + b] = VIPS_CLIP(MIN, sum, MAX); \
+			} \
+		} \
+	}
+
+/* Convolve one band of one block of output.
+ */
+static void
+vips_convfft_block(VipsConvfft *convfft, VipsConvfftSequence *seq,
+	VipsRegion *out_region, VipsRect *block, int b)
+{
+	VipsRegion *ir = seq->ir;
+	VipsImage *in = ir->im;
+	int bands = in->Bands;
+	int size = convfft->size;
+	int n = size * (size / 2 + 1);
+	double scale = convfft->scale;
+	double offset = convfft->offset;
+	gint64 iscale = scale;
+	gint64 ioffset = offset;
+	gint64 rounding = iscale / 2;
+
+	VipsRect s;
+	int x, y, i;
+
+	s = *block;
+	s.width += convfft->mw - 1;
+	s.height += convfft->mh - 1;
+
+	switch (in->BandFmt) {
+	case VIPS_FORMAT_UCHAR:
+		LOAD(unsigned char);
+		break;
+
+	case VIPS_FORMAT_CHAR:
+		LOAD(signed char);
+		break;
+
+	case VIPS_FORMAT_USHORT:
+		LOAD(unsigned short);
+		break;
+
+	case VIPS_FORMAT_SHORT:
+		LOAD(signed short);
+		break;
+
+	case VIPS_FORMAT_UINT:
+		LOAD(unsigned int);
+		break;
+
+	case VIPS_FORMAT_INT:
+		LOAD(signed int);
+		break;
+
+	case VIPS_FORMAT_FLOAT:
+		LOAD(float);
+		break;
+
+	case VIPS_FORMAT_DOUBLE:
+		LOAD(double);
+		break;
+
+	default:
+		g_assert_not_reached();
+	}
+
+	fftw_execute_dft_r2c(convfft->forward, seq->buf, seq->spectrum);
+
+	for (i = 0; i < n; i++) {
+		double re = seq->spectrum[i][0];
+		double im = seq->spectrum[i][1];
+		double mre = convfft->mask[i][0];
+		double mim = convfft->mask[i][1];
+
+		seq->spectrum[i][0] = re * mre - im * mim;
+		seq->spectrum[i][1] = re * mim + im * mre;
+	}
+
+	fftw_execute_dft_c2r(convfft->inverse, seq->spectrum, seq->buf);
+
+	switch (out_region->im->BandFmt) {
+	case VIPS_FORMAT_UCHAR:
+		WRITE_INT(unsigned char, 0, UCHAR_MAX);
+		break;
+
+	case VIPS_FORMAT_CHAR:
+		WRITE_INT(signed char, SCHAR_MIN, SCHAR_MAX);
+		break;
+
+	case VIPS_FORMAT_USHORT:
+		WRITE_INT(unsigned short, 0, USHRT_MAX);
+		break;
+
+	case VIPS_FORMAT_SHORT:
+		WRITE_INT(signed short, SHRT_MIN, SHRT_MAX);
+		break;
+
+	case VIPS_FORMAT_UINT:
+		WRITE_INT(unsigned int, 0, UINT_MAX);
+		break;
+
+	case VIPS_FORMAT_INT:
+		WRITE_INT(signed int, INT_MIN, INT_MAX);
+		break;
+
+	case VIPS_FORMAT_FLOAT:
+		WRITE_FLOAT(float);
+		break;
+
+	case VIPS_FORMAT_DOUBLE:
+		WRITE_FLOAT(double);
+		break;
+
+	default:
+		g_assert_not_reached();
+	}
+}
+
+static int
+vips_convfft_gen(VipsRegion *out_region,
+	void *vseq, void *a, void *b, gboolean *stop)
+{
+	VipsConvfftSequence *seq = (VipsConvfftSequence *) vseq;
+	VipsConvfft *convfft = (VipsConvfft *) b;
+	VipsImage *in = (VipsImage *) a;
+	VipsRect *r = &out_region->valid;
+
+	VipsRect s;
+	int x, y, i;
+
+	s = *r;
+	s.width += convfft->mw - 1;
+	s.height += convfft->mh - 1;
+	if (vips_region_prepare(seq->ir, &s))
+		return -1;
+
+	VIPS_GATE_START("vips_convfft_gen: work");
+
+	for (y = 0; y < r->height; y += convfft->block_height)
+		for (x = 0; x < r->width; x += convfft->block_width) {
+			VipsRect block;
+
+			block.left = r->left + x;
+			block.top = r->top + y;
+			block.width = VIPS_MIN(convfft->block_width, r->width - x);
+			block.height =
+				VIPS_MIN(convfft->block_height, r->height - y);
+
+			for (i = 0; i < in->Bands; i++)
+				vips_convfft_block(convfft, seq,
+					out_region, &block, i);
+		}
+
+	VIPS_GATE_STOP("vips_convfft_gen: work");
+
+	VIPS_COUNT_PIXELS(out_region, "vips_convfft_gen");
+
+	return 0;
+}
+
+/* Make the plans and the transform of the mask.
+ */
+static int
+vips_convfft_plan(VipsConvfft *convfft, VipsImage *M)
+{
+	int size = convfft->size;
+	int n = size * (size / 2 + 1);
+	double *coeff = VIPS_MATRIX(M, 0, 0);
+
+	double *buf;
+	fftw_complex *spectrum;
+	int x, y, i;
+
+	buf = fftw_alloc_real((size_t) size * size);
+	spectrum = fftw_alloc_complex(n);
+	convfft->mask = fftw_alloc_complex(n);
+	if (!buf ||
+		!spectrum ||
+		!convfft->mask) {
+		VIPS_FREEF(fftw_free, buf);
+		VIPS_FREEF(fftw_free, spectrum);
+		vips_error("convfft", "%s", _("out of memory"));
+		return -1;
+	}
+
+	/* Sequences already run in parallel, so no threaded plans.
+	 */
+	if (!(convfft->forward = vips__fft_plan_get(VIPS_FFT_R2C,
+			  size, size, FFTW_ESTIMATE, FALSE, buf, spectrum)) ||
+		!(convfft->inverse = vips__fft_plan_get(VIPS_FFT_C2R,
+			  size, size, FFTW_ESTIMATE, FALSE, spectrum, buf))) {
+		fftw_free(buf);
+		fftw_free(spectrum);
+		return -1;
+	}
+
+	/* Store the mask reversed, with the origin at element 0, so the
+	 * circular convolution is a correlation.
+	 */
+	memset(buf, 0, (size_t) size * size * sizeof(double));
+	for (y = 0; y < convfft->mh; y++)
+		for (x = 0; x < convfft->mw; x++) {
+			double v = coeff[x + y * convfft->mw];
+
+			buf[((size - y) % size) * size + (size - x) % size] = v;
+		}
+
+	fftw_execute_dft_r2c(convfft->forward, buf, convfft->mask);
+
+	for (i = 0; i < n; i++) {
+		convfft->mask[i][0] /= (double) size * size;
+		convfft->mask[i][1] /= (double) size * size;
+	}
+
+	fftw_free(buf);
+	fftw_free(spectrum);
+
+	return 0;
+}
+
+/* Convolve @in with @M, a double matrix, by FFT. Call
+ * vips__convfft_use() first. On error, @out may still need unreffing.
+ */
+int
+vips__convfft(VipsImage *in, VipsImage **out, VipsImage *M,
+	VipsPrecision precision)
+{
+	VipsImage *t;
+	VipsImage *imask;
+	VipsConvfft *convfft;
+
+	vips__fft_init();
+
+	if (vips_embed(in, &t,
+			M->Xsize / 2, M->Ysize / 2,
+			in->Xsize + M->Xsize - 1, in->Ysize + M->Ysize - 1,
+			"extend", VIPS_EXTEND_COPY,
+			NULL))
+		return -1;
+
+	/* The generate function reads from @t, so @out owns it.
+	 */
+	*out = vips_image_new();
+	vips_object_local(*out, t);
+	if (vips_image_pipelinev(*out, VIPS_DEMAND_STYLE_SMALLTILE, t, NULL))
+		return -1;
+
+	convfft = g_new0(VipsConvfft, 1);
+	g_signal_connect(*out, "close",
+		G_CALLBACK(vips_convfft_free), convfft);
+
+	/* Use the same int mask, scale and offset as vips_convi().
+	 */
+	convfft->intize = precision == VIPS_PRECISION_INTEGER;
+	if (convfft->intize) {
+		if (vips__image_intize(M, &imask))
+			return -1;
+		vips_object_local(*out, imask);
+		M = imask;
+	}
+
+	convfft->mw = M->Xsize;
+	convfft->mh = M->Ysize;
+	convfft->size = vips_convfft_size(M, precision);
+	convfft->block_width = convfft->size - convfft->mw + 1;
+	convfft->block_height = convfft->size - convfft->mh + 1;
+	convfft->scale = vips_image_get_scale(M);
+	convfft->offset = vips_image_get_offset(M);
+
+	g_info("convfft: %d x %d mask, FFT size %d",
+		convfft->mw, convfft->mh, convfft->size);
+
+	if (vips_convfft_plan(convfft, M))
+		return -1;
+
+	(*out)->Xsize -= M->Xsize - 1;
+	(*out)->Ysize -= M->Ysize - 1;
+	if (precision == VIPS_PRECISION_FLOAT &&
+		vips_band_format_isint(in->BandFmt))
+		(*out)->BandFmt = VIPS_FORMAT_FLOAT;
+
+	if (vips_image_generate(*out,
+			vips_convfft_start, vips_convfft_gen, vips_convfft_stop,
+			t, convfft))
+		return -1;
+
+	(*out)->Xoffset = -M->Xsize / 2;
+	(*out)->Yoffset = -M->Ysize / 2;
+
+	return 0;
+}
+
+#endif /*HAVE_FFTW*/
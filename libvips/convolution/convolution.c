@@ -79,6 +79,15 @@
  * How to combine values. See vips_compass(), for example.
  */
 
+/**
+ * VipsGaussblurMethod:
+ * @VIPS_GAUSSBLUR_METHOD_AUTO: let libvips pick, currently always the mask
+ * @VIPS_GAUSSBLUR_METHOD_CONV: convolve with a truncated mask
+ * @VIPS_GAUSSBLUR_METHOD_IIR: use a recursive filter, in memory
+ *
+ * How vips_gaussblur() should blur. See vips_gaussblur().
+ */
+
 G_DEFINE_ABSTRACT_TYPE(VipsConvolution, vips_convolution,
 	VIPS_TYPE_OPERATION);
 
@@ -7,6 +7,8 @@
  * 21/9/20
  * 	- allow sigma zero, meaning no blur
  * 	- sigma < 0.2 is just copy
+ * 19/10/26
+ * 	- add "method", and a recursive filter for large sigma
  */
 
 /*
@@ -51,6 +53,8 @@
 
 #include <vips/vips.h>
 
+#include "pconvolution.h"
+
 typedef struct _VipsGaussblur {
 	VipsOperation parent_instance;
 
@@ -60,6 +64,7 @@ typedef struct _VipsGaussblur {
 	gdouble sigma;
 	gdouble min_ampl;
 	VipsPrecision precision;
+	VipsGaussblurMethod method;
 
 } VipsGaussblur;
 
@@ -70,12 +75,26 @@ G_DEFINE_TYPE(VipsGaussblur, vips_gaussblur, VIPS_TYPE_OPERATION);
 static int
 vips_gaussblur_build(VipsObject *object)
 {
+	VipsObjectClass *class = VIPS_OBJECT_GET_CLASS(object);
 	VipsGaussblur *gaussblur = (VipsGaussblur *) object;
 	VipsImage **t = (VipsImage **) vips_object_local_array(object, 2);
 
+	gboolean iir;
+
 	if (VIPS_OBJECT_CLASS(vips_gaussblur_parent_class)->build(object))
 		return -1;
 
+	/* The recursive filter is only valid for sigma 0.5 and up. It holds
+	 * the whole image in memory, so AUTO never picks it, you have to ask.
+	 */
+	if (gaussblur->method == VIPS_GAUSSBLUR_METHOD_IIR) {
+		if (vips_check_noncomplex(class->nickname, gaussblur->in))
+			return -1;
+		iir = gaussblur->sigma >= 0.5;
+	}
+	else
+		iir = FALSE;
+
 	/* vips_gaussmat() will make a 1x1 pixel mask for anything smaller than
 	 * this.
 	 */
@@ -83,6 +102,13 @@ vips_gaussblur_build(VipsObject *object)
 		if (vips_copy(gaussblur->in, &t[1], NULL))
 			return -1;
 	}
+	else if (iir) {
+		g_info("gaussblur recursive, sigma %g", gaussblur->sigma);
+
+		if (vips__gaussblur_iir(gaussblur->in, &t[1],
+				gaussblur->sigma, gaussblur->precision))
+			return -1;
+	}
 	else {
 		if (vips_gaussmat(&t[0],
 				gaussblur->sigma, gaussblur->min_ampl,
@@ -160,6 +186,13 @@ vips_gaussblur_class_init(VipsGaussblurClass *class)
 		VIPS_ARGUMENT_OPTIONAL_INPUT,
 		G_STRUCT_OFFSET(VipsGaussblur, precision),
 		VIPS_TYPE_PRECISION, VIPS_PRECISION_INTEGER);
+
+	VIPS_ARG_ENUM(class, "method", 5,
+		_("Method"),
+		_("Blur with this method"),
+		VIPS_ARGUMENT_OPTIONAL_INPUT,
+		G_STRUCT_OFFSET(VipsGaussblur, method),
+		VIPS_TYPE_GAUSSBLUR_METHOD, VIPS_GAUSSBLUR_METHOD_AUTO);
 }
 
 static void
@@ -168,6 +201,7 @@ vips_gaussblur_init(VipsGaussblur *gaussblur)
 	gaussblur->sigma = 1.5;
 	gaussblur->min_ampl = 0.2;
 	gaussblur->precision = VIPS_PRECISION_INTEGER;
+	gaussblur->method = VIPS_GAUSSBLUR_METHOD_AUTO;
 }
 
 /**
@@ -181,11 +215,20 @@ vips_gaussblur_init(VipsGaussblur *gaussblur)
  *
  * * @precision: #VipsPrecision, precision for blur, default int
  * * @min_ampl: minimum amplitude, default 0.2
+ * * @method: #VipsGaussblurMethod, how to blur, default auto
  *
  * This operator runs vips_gaussmat() and vips_convsep() for you on an image.
  * Set @min_ampl smaller to generate a larger, more accurate mask. Set @sigma
  * larger to make the blur more blurry.
  *
+ * The cost of a mask grows with @sigma. For large @sigma, @method
+ * #VIPS_GAUSSBLUR_METHOD_IIR uses a third-order recursive filter instead,
+ * whose cost per pixel does not depend on @sigma. It approximates the whole
+ * Gaussian rather than one truncated at @min_ampl (which it ignores), so
+ * results differ slightly from the mask. It needs complete lines, so it
+ * holds the image in memory while it works, so
+ * #VIPS_GAUSSBLUR_METHOD_AUTO, the default, always uses the mask.
+ *
  * See also: vips_gaussmat(), vips_convsep().
  *
  * Returns: 0 on success, -1 on error.
@@ -75,6 +75,26 @@ void vips_convi_uchar_hwy(VipsRegion *out_region, VipsRegion *ir, VipsRect *r,
 	int ne, int nnz, int offset, const int *restrict offsets,
 	const short *restrict mant, int exp);
 
+/* Highway kernels for vips_convf(), see convf_hwy.cpp.
+ */
+int vips_convf_hwy(VipsPel *q, const VipsPel *p, VipsBandFormat format,
+	int sz, const int *offsets, const double *coeff, int nnz, double offset);
+int vips_convf_1d_hwy(VipsPel *q, const VipsPel *p, VipsBandFormat format,
+	int sz, int stride, const double *coeff, int n, int symmetric,
+	double offset);
+
+/* The FFT engine for vips_conv().
+ */
+gboolean vips__convfft_use(VipsImage *in, VipsImage *M,
+	VipsPrecision precision);
+int vips__convfft(VipsImage *in, VipsImage **out, VipsImage *M,
+	VipsPrecision precision);
+
+/* The recursive engine for vips_gaussblur().
+ */
+int vips__gaussblur_iir(VipsImage *in, VipsImage **out,
+	double sigma, VipsPrecision precision);
+
 #ifdef __cplusplus
 }
 #endif /*__cplusplus*/
@@ -0,0 +1,383 @@
+/* Shared fftw plans
+ *
+ * 19/10/26
+ * 	- from fwfft.c
+ * 	- add a plan cache, wisdom and threaded plans
+ */
+
+/*
+
+	This file is part of VIPS.
+
+	VIPS is free software; you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+	02110-1301  USA
+
+ */
+
+/*
+
+	These files are distributed with VIPS - http://www.vips.ecs.soton.ac.uk
+
+ */
+
+/* Making an fftw plan can take much longer than running it, so we keep a
+ * process-wide table of plans keyed by kind, size, planner flags and number
+ * of threads. Operations run the shared plans on their own arrays with the
+ * new-array execute functions.
+ *
+ * Plans are made on fftw_malloc() arrays. fftw needs the arrays you execute
+ * on to have the same alignment and placement as the ones you planned with,
+ * so vips__fft_plan_get() takes the arrays you will use and plans for those.
+ *
+ * If VIPS_FFTW_WISDOM is set, it names a file of fftw wisdom. We load it on
+ * first use and write it back in vips_shutdown(), so measured plans are only
+ * measured once per machine.
+ *
+ * With libfftw3_threads, large plans can use vips_concurrency_get() threads.
+ */
+
+/*
+#define DEBUG
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif /*HAVE_CONFIG_H*/
+#include <glib/gi18n-lib.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <vips/vips.h>
+#include <vips/internal.h>
+
+#ifdef HAVE_FFTW
+
+#include <fftw3.h>
+
+/* Keep at most this many plans.
+ */
+#define VIPS_FFT_CACHE_MAX (50)
+
+/* Smaller transforms than this are quicker on one thread.
+ */
+#define VIPS_FFT_THREADS_MIN (256 * 256)
+
+/* Everything in fftw3 except execute has to be behind a mutex. This also
+ * locks the plan cache.
+ */
+GMutex *vips__fft_lock = NULL;
+
+typedef struct _VipsFftPlanEntry {
+	char *key;
+	fftw_plan plan;
+
+	/* One ref for the cache, plus one for each user.
+	 */
+	int ref_count;
+} VipsFftPlanEntry;
+
+/* Key to entry, and plan to entry for release.
+ */
+static GHashTable *vips_fft_plan_table = NULL;
+static GHashTable *vips_fft_plan_users = NULL;
+
+/* Most recently used entry at the head.
+ */
+static GQueue vips_fft_plan_lru = G_QUEUE_INIT;
+
+/* The wisdom file, if any.
+ */
+static char *vips_fft_wisdom = NULL;
+
+/* Set if we can make threaded plans.
+ */
+static gboolean vips_fft_threads = FALSE;
+
+static void *
+vips__fft_thread_init(void *data)
+{
+	const char *wisdom;
+
+	vips__fft_lock = vips_g_mutex_new();
+	vips_fft_plan_table = g_hash_table_new(g_str_hash, g_str_equal);
+	vips_fft_plan_users = g_hash_table_new(g_direct_hash, g_direct_equal);
+
+#ifdef HAVE_FFTW_THREADS
+	vips_fft_threads = fftw_init_threads() != 0;
+#endif /*HAVE_FFTW_THREADS*/
+
+	if ((wisdom = g_getenv("VIPS_FFTW_WISDOM"))) {
+		vips_fft_wisdom = g_strdup(wisdom);
+
+		if (fftw_import_wisdom_from_filename(vips_fft_wisdom))
+			g_info("fft: loaded wisdom from %s", vips_fft_wisdom);
+		else
+			g_info("fft: no wisdom loaded from %s", vips_fft_wisdom);
+	}
+
+	return NULL;
+}
+
+void
+vips__fft_init(void)
+{
+	static GOnce once = G_ONCE_INIT;
+
+	VIPS_ONCE(&once, vips__fft_thread_init, NULL);
+}
+
+static void
+vips_fft_plan_entry_unref_nolock(VipsFftPlanEntry *entry)
+{
+	g_assert(entry->ref_count > 0);
+
+	entry->ref_count -= 1;
+
+	if (entry->ref_count == 0) {
+		g_hash_table_remove(vips_fft_plan_users, entry->plan);
+		fftw_destroy_plan(entry->plan);
+		VIPS_FREE(entry->key);
+		g_free(entry);
+	}
+}
+
+/* Make a plan on scratch arrays with the same alignment and placement as
+ * @in and @out.
+ */
+static fftw_plan
+vips_fft_plan_new(VipsFftKind kind, int width, int height,
+	unsigned int flags, void *in, void *out)
+{
+	size_t n_real = (size_t) width * height;
+	size_t n_half = (size_t) height * (width / 2 + 1);
+
+	void *a;
+	void *b;
+	fftw_plan plan;
+
+	if (fftw_alignment_of(in) ||
+		fftw_alignment_of(out))
+		flags |= FFTW_UNALIGNED;
+
+	/* Yes, they really do use nx for height and ny for width.
+	 */
+	plan = NULL;
+	switch (kind) {
+	case VIPS_FFT_R2C:
+		a = fftw_alloc_real(n_real);
+		b = fftw_alloc_complex(n_half);
+		if (a && b)
+			plan = fftw_plan_dft_r2c_2d(height, width,
+				(double *) a, (fftw_complex *) b, flags);
+		break;
+
+	case VIPS_FFT_C2R:
+		a = fftw_alloc_complex(n_half);
+		b = fftw_alloc_real(n_real);
+		if (a && b)
+			plan = fftw_plan_dft_c2r_2d(height, width,
+				(fftw_complex *) a, (double *) b, flags);
+		break;
+
+	case VIPS_FFT_FORWARD:
+	case VIPS_FFT_BACKWARD:
+		a = fftw_alloc_complex(n_real);
+		b = in == out ? a : fftw_alloc_complex(n_real);
+		if (a && b)
+			plan = fftw_plan_dft_2d(height, width,
+				(fftw_complex *) a, (fftw_complex *) b,
+				kind == VIPS_FFT_FORWARD ? FFTW_FORWARD : FFTW_BACKWARD,
+				flags);
+		if (b == a)
+			b = NULL;
+		break;
+
+	default:
+		g_assert_not_reached();
+		a = NULL;
+		b = NULL;
+	}
+
+	VIPS_FREEF(fftw_free, a);
+	VIPS_FREEF(fftw_free, b);
+
+	return plan;
+}
+
+/**
+ * vips__fft_plan_get: (skip)
+ * @kind: transform to make
+ * @width: transform width
+ * @height: transform height
+ * @flags: fftw planner flags, eg. FFTW_MEASURE
+ * @threaded: allow a threaded plan
+ * @in: the input array you will execute on
+ * @out: the output array you will execute on
+ *
+ * Get a shared plan for this transform. Run it on @in and @out, or on
+ * any arrays with the same alignment and placement, with the fftw new-array
+ * execute functions. C2R plans overwrite their input.
+ *
+ * Call vips__fft_init() first. Release the plan with vips__fft_plan_release().
+ *
+ * Returns: the plan, or %NULL on error.
+ */
+fftw_plan
+vips__fft_plan_get(VipsFftKind kind, int width, int height,
+	unsigned int flags, gboolean threaded, void *in, void *out)
+{
+	VipsFftPlanEntry *entry;
+	fftw_plan plan;
+	int n_threads;
+	char *key;
+
+	n_threads = 1;
+	if (threaded &&
+		vips_fft_threads &&
+		(guint64) width * height >= VIPS_FFT_THREADS_MIN)
+		n_threads = vips_concurrency_get();
+
+	key = g_strdup_printf("%d %d %d %u %d %d %d",
+		kind, width, height, flags, n_threads,
+		fftw_alignment_of(in) != 0 || fftw_alignment_of(out) != 0,
+		in == out);
+
+	g_mutex_lock(vips__fft_lock);
+
+	if ((entry = (VipsFftPlanEntry *)
+				g_hash_table_lookup(vips_fft_plan_table, key))) {
+		g_free(key);
+
+		entry->ref_count += 1;
+		g_queue_remove(&vips_fft_plan_lru, entry);
+		g_queue_push_head(&vips_fft_plan_lru, entry);
+
+		g_mutex_unlock(vips__fft_lock);
+
+#ifdef DEBUG
+		printf("vips__fft_plan_get: hit for %s\n", entry->key);
+#endif /*DEBUG*/
+
+		return entry->plan;
+	}
+
+#ifdef HAVE_FFTW_THREADS
+	if (vips_fft_threads)
+		fftw_plan_with_nthreads(n_threads);
+#endif /*HAVE_FFTW_THREADS*/
+
+	plan = vips_fft_plan_new(kind, width, height, flags, in, out);
+
+#ifdef HAVE_FFTW_THREADS
+	if (vips_fft_threads)
+		fftw_plan_with_nthreads(1);
+#endif /*HAVE_FFTW_THREADS*/
+
+	if (!plan) {
+		g_mutex_unlock(vips__fft_lock);
+		g_free(key);
+		vips_error("fft", "%s", _("unable to create transform plan"));
+		return NULL;
+	}
+
+#ifdef DEBUG
+	printf("vips__fft_plan_get: new plan for %s\n", key);
+#endif /*DEBUG*/
+
+	/* One ref for the cache, one for the caller.
+	 */
+	entry = g_new0(VipsFftPlanEntry, 1);
+	entry->key = key;
+	entry->plan = plan;
+	entry->ref_count = 2;
+	g_hash_table_insert(vips_fft_plan_table, entry->key, entry);
+	g_hash_table_insert(vips_fft_plan_users, entry->plan, entry);
+	g_queue_push_head(&vips_fft_plan_lru, entry);
+
+	/* Trim from the tail. Plans still in use stay alive until they are
+	 * released.
+	 */
+	while (g_queue_get_length(&vips_fft_plan_lru) > VIPS_FFT_CACHE_MAX) {
+		VipsFftPlanEntry *last = (VipsFftPlanEntry *)
+			g_queue_pop_tail(&vips_fft_plan_lru);
+
+		g_hash_table_remove(vips_fft_plan_table, last->key);
+		vips_fft_plan_entry_unref_nolock(last);
+	}
+
+	g_mutex_unlock(vips__fft_lock);
+
+	return plan;
+}
+
+/**
+ * vips__fft_plan_release: (skip)
+ * @plan: plan from vips__fft_plan_get()
+ *
+ * Drop a ref to a shared plan.
+ */
+void
+vips__fft_plan_release(fftw_plan plan)
+{
+	VipsFftPlanEntry *entry;
+
+	g_mutex_lock(vips__fft_lock);
+
+	entry = (VipsFftPlanEntry *)
+		g_hash_table_lookup(vips_fft_plan_users, plan);
+	g_assert(entry);
+	vips_fft_plan_entry_unref_nolock(entry);
+
+	g_mutex_unlock(vips__fft_lock);
+}
+
+/* Save wisdom and drop all cached plans. Called from vips_shutdown().
+ */
+void
+vips__fft_shutdown(void)
+{
+	VipsFftPlanEntry *entry;
+
+	if (!vips__fft_lock)
+		return;
+
+	g_mutex_lock(vips__fft_lock);
+
+	if (vips_fft_wisdom) {
+		if (fftw_export_wisdom_to_filename(vips_fft_wisdom))
+			g_info("fft: saved wisdom to %s", vips_fft_wisdom);
+		else
+			g_warning("unable to save fftw wisdom to %s",
+				vips_fft_wisdom);
+	}
+
+	while ((entry = (VipsFftPlanEntry *)
+				g_queue_pop_tail(&vips_fft_plan_lru))) {
+		g_hash_table_remove(vips_fft_plan_table, entry->key);
+		vips_fft_plan_entry_unref_nolock(entry);
+	}
+
+	g_mutex_unlock(vips__fft_lock);
+}
+
+#else /*!HAVE_FFTW*/
+
+void
+vips__fft_shutdown(void)
+{
+}
+
+#endif /*HAVE_FFTW*/
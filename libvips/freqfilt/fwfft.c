@@ -39,6 +39,8 @@
  * 	- redone as a class
  * 15/12/23 [akash-akya]
  *	- add locks
+ * 19/10/26
+ * 	- use shared, cached plans
  */
 
 /*
@@ -93,26 +95,6 @@ typedef VipsFreqfiltClass VipsFwfftClass;
 
 G_DEFINE_TYPE(VipsFwfft, vips_fwfft, VIPS_TYPE_FREQFILT);
 
-/* Everything in fftw3 except execute has to be behind a mutex.
- */
-GMutex *vips__fft_lock = NULL;
-
-static void *
-vips__fft_thread_init(void *data)
-{
-	vips__fft_lock = vips_g_mutex_new();
-
-    return NULL;
-}
-
-void
-vips__fft_init(void)
-{
-	static GOnce once = G_ONCE_INIT;
-
-	VIPS_ONCE(&once, vips__fft_thread_init, NULL);
-}
-
 /* Real to complex forward transform.
  */
 static int
@@ -125,7 +107,6 @@ rfwfft1(VipsObject *object, VipsImage *in, VipsImage **out)
 	const int half_width = in->Xsize / 2 + 1;
 
 	double *half_complex;
-	double *planner_scratch;
 
 	fftw_plan plan;
 	double *buf, *q, *p;
@@ -142,33 +123,21 @@ rfwfft1(VipsObject *object, VipsImage *in, VipsImage **out)
 		vips_image_write(t[0], t[1]))
 		return -1;
 
-	/* Make the plan for the transform. Yes, they really do use nx for
-	 * height and ny for width. Use a separate scratch buffer for the
-	 * planner, we can't overwrite real->data
-	 */
-	if (!(planner_scratch = VIPS_ARRAY(fwfft,
-			  VIPS_IMAGE_N_PELS(in), double)))
-		return -1;
 	if (!(half_complex = VIPS_ARRAY(fwfft,
 			  in->Ysize * half_width * 2, double)))
 		return -1;
-	g_mutex_lock(vips__fft_lock);
-	if (!(plan = fftw_plan_dft_r2c_2d(in->Ysize, in->Xsize,
-			  planner_scratch, (fftw_complex *) half_complex,
-			  0))) {
-		g_mutex_unlock(vips__fft_lock);
-		vips_error(class->nickname,
-			"%s", _("unable to create transform plan"));
+
+	/* Plans are shared, and made on scratch arrays, so real->data is
+	 * safe.
+	 */
+	if (!(plan = vips__fft_plan_get(VIPS_FFT_R2C, in->Xsize, in->Ysize,
+			  FFTW_MEASURE, TRUE, t[1]->data, half_complex)))
 		return -1;
-	}
-	g_mutex_unlock(vips__fft_lock);
 
 	fftw_execute_dft_r2c(plan,
 		(double *) t[1]->data, (fftw_complex *) half_complex);
 
-	g_mutex_lock(vips__fft_lock);
-	fftw_destroy_plan(plan);
-	g_mutex_unlock(vips__fft_lock);
+	vips__fft_plan_release(plan);
 
 	/* Write to out as another memory buffer.
 	 */
@@ -248,7 +217,6 @@ cfwfft1(VipsObject *object, VipsImage *in, VipsImage **out)
 	VipsObjectClass *class = VIPS_OBJECT_GET_CLASS(fwfft);
 
 	fftw_plan plan;
-	double *planner_scratch;
 	double *buf, *q, *p;
 	int x, y;
 
@@ -263,33 +231,16 @@ cfwfft1(VipsObject *object, VipsImage *in, VipsImage **out)
 		vips_image_write(t[0], t[1]))
 		return -1;
 
-	/* We have to have a separate buffer for the planner to work on.
+	/* In-place transform.
 	 */
-	if (!(planner_scratch = VIPS_ARRAY(fwfft,
-			  VIPS_IMAGE_N_PELS(in) * 2, double)))
+	if (!(plan = vips__fft_plan_get(VIPS_FFT_FORWARD, in->Xsize, in->Ysize,
+			  FFTW_MEASURE, TRUE, t[1]->data, t[1]->data)))
 		return -1;
 
-	/* Make the plan for the transform.
-	 */
-	g_mutex_lock(vips__fft_lock);
-	if (!(plan = fftw_plan_dft_2d(in->Ysize, in->Xsize,
-			  (fftw_complex *) planner_scratch,
-			  (fftw_complex *) planner_scratch,
-			  FFTW_FORWARD,
-			  0))) {
-		g_mutex_unlock(vips__fft_lock);
-		vips_error(class->nickname,
-			"%s", _("unable to create transform plan"));
-		return -1;
-	}
-	g_mutex_unlock(vips__fft_lock);
-
 	fftw_execute_dft(plan,
 		(fftw_complex *) t[1]->data, (fftw_complex *) t[1]->data);
 
-	g_mutex_lock(vips__fft_lock);
-	fftw_destroy_plan(plan);
-	g_mutex_unlock(vips__fft_lock);
+	vips__fft_plan_release(plan);
 
 	/* Write to out as another memory buffer.
 	 */
@@ -388,6 +339,12 @@ vips_fwfft_init(VipsFwfft *fwfft)
  * VIPS uses the fftw Fourier Transform library. If this library was not
  * available when VIPS was configured, these functions will fail.
  *
+ * fftw plans are cached and shared, so repeated transforms of the same size
+ * only pay for planning once. Set the environment variable
+ * `VIPS_FFTW_WISDOM` to the name of a file and vips will load fftw wisdom
+ * from it on first use and save it again in vips_shutdown(). If fftw was
+ * built with threads, large transforms use vips_concurrency_get() threads.
+ *
  * See also: vips_invfft().
  *
  * Returns: 0 on success, -1 on error.
@@ -28,6 +28,8 @@
  * 	- redone as a class
  * 15/12/23 [akash-akya]
  *	- add locks
+ * 19/10/26
+ * 	- use shared, cached plans
  */
 
 /*
@@ -94,7 +96,6 @@ cinvfft1(VipsObject *object, VipsImage *in, VipsImage **out)
 	VipsObjectClass *class = VIPS_OBJECT_GET_CLASS(invfft);
 
 	fftw_plan plan;
-	double *planner_scratch;
 
 	if (vips_check_mono(class->nickname, in) ||
 		vips_check_uncoded(class->nickname, in))
@@ -107,31 +108,16 @@ cinvfft1(VipsObject *object, VipsImage *in, VipsImage **out)
 		vips_image_write(t[0], *out))
 		return -1;
 
-	/* Make the plan for the transform. Yes, they really do use nx for
-	 * height and ny for width.
+	/* In-place transform.
 	 */
-	if (!(planner_scratch = VIPS_ARRAY(invfft,
-			  VIPS_IMAGE_N_PELS(in) * 2, double)))
+	if (!(plan = vips__fft_plan_get(VIPS_FFT_BACKWARD, in->Xsize, in->Ysize,
+			  FFTW_MEASURE, TRUE, (*out)->data, (*out)->data)))
 		return -1;
-	g_mutex_lock(vips__fft_lock);
-	if (!(plan = fftw_plan_dft_2d(in->Ysize, in->Xsize,
-			  (fftw_complex *) planner_scratch,
-			  (fftw_complex *) planner_scratch,
-			  FFTW_BACKWARD,
-			  0))) {
-		g_mutex_unlock(vips__fft_lock);
-		vips_error(class->nickname,
-			"%s", _("unable to create transform plan"));
-		return -1;
-	}
-	g_mutex_unlock(vips__fft_lock);
 
 	fftw_execute_dft(plan,
 		(fftw_complex *) (*out)->data, (fftw_complex *) (*out)->data);
 
-	g_mutex_lock(vips__fft_lock);
-	fftw_destroy_plan(plan);
-	g_mutex_unlock(vips__fft_lock);
+	vips__fft_plan_release(plan);
 
 	(*out)->Type = VIPS_INTERPRETATION_B_W;
 
@@ -145,11 +131,9 @@ rinvfft1(VipsObject *object, VipsImage *in, VipsImage **out)
 {
 	VipsImage **t = (VipsImage **) vips_object_local_array(object, 4);
 	VipsInvfft *invfft = (VipsInvfft *) object;
-	VipsObjectClass *class = VIPS_OBJECT_GET_CLASS(invfft);
 	const int half_width = in->Xsize / 2 + 1;
 
 	double *half_complex;
-	double *planner_scratch;
 	fftw_plan plan;
 	int x, y;
 	double *q, *p;
@@ -188,29 +172,16 @@ rinvfft1(VipsObject *object, VipsImage *in, VipsImage **out)
 	if (vips_image_write_prepare(*out))
 		return -1;
 
-	/* Make the plan for the transform. Yes, they really do use nx for
-	 * height and ny for width.
+	/* This overwrites half_complex, but we don't need it again.
 	 */
-	if (!(planner_scratch = VIPS_ARRAY(invfft,
-			  t[1]->Ysize * half_width * 2, double)))
+	if (!(plan = vips__fft_plan_get(VIPS_FFT_C2R, t[1]->Xsize, t[1]->Ysize,
+			  FFTW_MEASURE, TRUE, half_complex, (*out)->data)))
 		return -1;
-	g_mutex_lock(vips__fft_lock);
-	if (!(plan = fftw_plan_dft_c2r_2d(t[1]->Ysize, t[1]->Xsize,
-			  (fftw_complex *) planner_scratch, (double *) (*out)->data,
-			  0))) {
-		g_mutex_unlock(vips__fft_lock);
-		vips_error(class->nickname,
-			"%s", _("unable to create transform plan"));
-		return -1;
-	}
-	g_mutex_unlock(vips__fft_lock);
 
 	fftw_execute_dft_c2r(plan,
 		(fftw_complex *) half_complex, (double *) (*out)->data);
 
-	g_mutex_lock(vips__fft_lock);
-	fftw_destroy_plan(plan);
-	g_mutex_unlock(vips__fft_lock);
+	vips__fft_plan_release(plan);
 
 	return 0;
 }
@@ -296,6 +267,8 @@ vips_invfft_init(VipsInvfft *invfft)
  * VIPS uses the fftw Fourier Transform library. If this library was not
  * available when VIPS was configured, these functions will fail.
  *
+ * See vips_fwfft() for notes on plan caching, wisdom and threads.
+ *
  * See also: vips_fwfft().
  *
  * Returns: 0 on success, -1 on error.
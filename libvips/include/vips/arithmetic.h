@@ -532,6 +532,9 @@ VIPS_API
 int vips_stats(VipsImage *in, VipsImage **out, ...)
 	G_GNUC_NULL_TERMINATED;
 VIPS_API
+int vips_multistats(VipsImage *in, VipsImage **out, ...)
+	G_GNUC_NULL_TERMINATED;
+VIPS_API
 int vips_measure(VipsImage *in, VipsImage **out, int h, int v, ...)
 	G_GNUC_NULL_TERMINATED;
 VIPS_API
@@ -542,6 +545,10 @@ VIPS_API
 int vips_getpoint(VipsImage *in, double **vector, int *n, int x, int y, ...)
 	G_GNUC_NULL_TERMINATED;
 VIPS_API
+int vips_getpoints(VipsImage *in, double **vector, int *n,
+	const double *coords, int n_coords, ...)
+	G_GNUC_NULL_TERMINATED;
+VIPS_API
 int vips_hist_find(VipsImage *in, VipsImage **out, ...)
 	G_GNUC_NULL_TERMINATED;
 VIPS_API
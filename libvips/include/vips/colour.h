@@ -107,6 +107,13 @@ typedef enum {
 	VIPS_PCS_LAST
 } VipsPCS;
 
+typedef enum {
+	VIPS_DE_TYPE_DE76,
+	VIPS_DE_TYPE_DE00,
+	VIPS_DE_TYPE_DECMC,
+	VIPS_DE_TYPE_LAST
+} VipsDEType;
+
 VIPS_API
 gboolean vips_colourspace_issupported(const VipsImage *image);
 VIPS_API
@@ -233,6 +240,9 @@ int vips_dE00(VipsImage *left, VipsImage *right, VipsImage **out, ...)
 VIPS_API
 int vips_dECMC(VipsImage *left, VipsImage *right, VipsImage **out, ...)
 	G_GNUC_NULL_TERMINATED;
+VIPS_API
+int vips_dEstats(VipsImage *left, VipsImage *right, double *mean, ...)
+	G_GNUC_NULL_TERMINATED;
 
 VIPS_API
 void vips_col_Lab2XYZ(float L, float a, float b,
@@ -102,6 +102,7 @@ typedef enum {
 	VIPS_INTERESTING_LOW,
 	VIPS_INTERESTING_HIGH,
 	VIPS_INTERESTING_ALL,
+	VIPS_INTERESTING_ATTENTION_WINDOW,
 	VIPS_INTERESTING_LAST
 } VipsInteresting;
 
@@ -134,6 +135,8 @@ typedef enum {
 	VIPS_BLEND_MODE_LAST
 } VipsBlendMode;
 
+typedef VipsImage *(*VipsArrayjoinOpenFn)(int i, void *client);
+
 VIPS_API
 int vips_copy(VipsImage *in, VipsImage **out, ...)
 	G_GNUC_NULL_TERMINATED;
@@ -176,6 +179,9 @@ VIPS_API
 int vips_arrayjoin(VipsImage **in, VipsImage **out, int n, ...)
 	G_GNUC_NULL_TERMINATED;
 VIPS_API
+int vips_arrayjoin_lazy(VipsImage **out, int n, ...)
+	G_GNUC_NULL_TERMINATED;
+VIPS_API
 int vips_extract_area(VipsImage *in, VipsImage **out,
 	int left, int top, int width, int height, ...)
 	G_GNUC_NULL_TERMINATED;
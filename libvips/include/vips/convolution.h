@@ -45,6 +45,13 @@ typedef enum {
 	VIPS_COMBINE_LAST
 } VipsCombine;
 
+typedef enum {
+	VIPS_GAUSSBLUR_METHOD_AUTO,
+	VIPS_GAUSSBLUR_METHOD_CONV,
+	VIPS_GAUSSBLUR_METHOD_IIR,
+	VIPS_GAUSSBLUR_METHOD_LAST
+} VipsGaussblurMethod;
+
 VIPS_API
 int vips_conv(VipsImage *in, VipsImage **out, VipsImage *mask, ...)
 	G_GNUC_NULL_TERMINATED;
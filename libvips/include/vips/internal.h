@@ -124,6 +124,30 @@ extern int vips__thinstrip_height;
  */
 extern int vips__concurrency;
 
+/* All fftw3 calls except execute() need to be locked. The convolution
+ * code uses fftw too.
+ */
+extern GMutex *vips__fft_lock;
+
+void vips__fft_init(void);
+void vips__fft_shutdown(void);
+
+/* Shared, cached fftw plans. See freqfilt/fftplan.c.
+ */
+typedef enum {
+	VIPS_FFT_R2C,
+	VIPS_FFT_C2R,
+	VIPS_FFT_FORWARD,
+	VIPS_FFT_BACKWARD
+} VipsFftKind;
+
+struct fftw_plan_s;
+
+struct fftw_plan_s *vips__fft_plan_get(VipsFftKind kind,
+	int width, int height, unsigned int flags, gboolean threaded,
+	void *in, void *out);
+void vips__fft_plan_release(struct fftw_plan_s *plan);
+
 /* abort() on any error.
  */
 extern int vips__fatal;
@@ -156,6 +180,7 @@ VIPS_API void vips__worker_lock(GMutex *mutex);
 VIPS_API void vips__worker_cond_wait(GCond *cond, GMutex *mutex);
 
 void vips__cache_init(void);
+void vips__icc_cache_drop_all(void);
 
 int vips__print_renders(void);
 int vips__type_leak(void);
@@ -259,6 +284,14 @@ int vips__bandup(const char *domain, VipsImage *in, VipsImage **out, int n);
 int vips__bandalike_vec(const char *domain,
 	VipsImage **in, VipsImage **out, int n, int base_bands);
 
+/* The Highway kernel for vips_relational_const(), shared with
+ * vips_ifthenelse(). It compares sz elements against a single constant and
+ * returns the number done, or 0 if the constant isn't exact in the pixel
+ * type.
+ */
+int vips__relational_const_hwy(VipsPel *q, const VipsPel *p,
+	VipsOperationRelational op, VipsBandFormat format, double c, int sz);
+
 int vips__formatalike(VipsImage *in1, VipsImage *in2,
 	VipsImage **out1, VipsImage **out2);
 int vips__sizealike(VipsImage *in1, VipsImage *in2,
@@ -740,6 +740,8 @@ vips_shutdown(void)
 #endif /*DEBUG*/
 
 	vips_cache_drop_all();
+	vips__icc_cache_drop_all();
+	vips__fft_shutdown();
 
 #if ENABLE_DEPRECATED
 	im_close_plugins();
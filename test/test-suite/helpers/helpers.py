@@ -236,3 +236,28 @@ def run_image2(message, left, right, fn):
              lambda x, y: run_fn2(fn, x, y))
     run_cmp2(message, left, right, 10, 10,
              lambda x, y: run_fn2(fn, x, y))
+
+
+# a one line image with a band for each (multiplier, offset) pair, each band
+# a different jumbled ramp, wrapped to 0 - modulus - 1 ... use None for no
+# wrap
+def ramp_image(width, coefficients, modulus=256):
+    x = pyvips.Image.xyz(width, 1)[0]
+    bands = [x * m + c for m, c in coefficients]
+    if modulus is not None:
+        bands = [band % modulus for band in bands]
+
+    return bands[0].bandjoin(bands[1:])
+
+
+# run fn on one line images, and on the same images as a single column, which
+# always takes the C path ... the results should match exactly, or to
+# within a relative threshold
+def assert_vector_matches_scalar(fn, *images, threshold=None):
+    wide = fn(*images)
+    column = fn(*[image.rot90() for image in images]).rot270()
+
+    if threshold is None:
+        assert (wide == column).min() == 255
+    else:
+        assert ((wide - column).abs() / (column.abs() + 1)).max() < threshold
@@ -228,6 +228,25 @@ class TestArithmetic:
         assert (x == 12).max() == 255
         assert (x == 12.5).max() == 0
 
+    def test_relational_vector(self):
+        left = ramp_image(300, [(37, 11), (101, 7), (5, 250)])
+        right = ramp_image(300, [(13, 3), (7, 100), (5, 250)])
+        ops = ["equal", "noteq", "less", "lesseq", "more", "moreeq"]
+
+        for fmt in noncomplex_formats:
+            a = (left - 100).cast(fmt)
+            b = (right - 100).cast(fmt)
+
+            for op in ops:
+                def check(fn):
+                    assert_vector_matches_scalar(fn, a, b)
+
+                check(lambda p, q: p.relational(q, op))
+                check(lambda p, q: p.relational_const(op, [27]))
+                check(lambda p, q: p.relational_const(op, [27, 12, 1000]))
+                check(lambda p, q: p.relational_const(op, [27.5]))
+                check(lambda p, q: p.relational_const(op, [-1]))
+
     def test_abs(self):
         def my_abs(x):
             return abs(x)
@@ -285,6 +304,30 @@ class TestArithmetic:
         self.run_unary(self.all_images, my_invert,
                        fmt=[pyvips.BandFormat.UCHAR])
 
+    def test_linear(self):
+        # 256 x 256, so the uchar and ushort lookup tables are used
+        x = pyvips.Image.xyz(256, 256)[0]
+        im = x.bandjoin([x * 2, x * 255])
+        points = [(0, 0), (10, 0), (100, 0), (255, 0)]
+
+        for fmt in [pyvips.BandFormat.UCHAR, pyvips.BandFormat.USHORT,
+                    pyvips.BandFormat.FLOAT]:
+            a = im.cast(fmt)
+            for mul, add in [([1.5], [10]), ([1.5, 0.5, -1], [10, 20, 300])]:
+                b = a.linear(mul, add, uchar=True)
+                c = a.linear(mul, add)
+                assert b.format == pyvips.BandFormat.UCHAR
+                for (px, py) in points:
+                    value = a(px, py)
+                    mul3 = mul * 3 if len(mul) == 1 else mul
+                    add3 = add * 3 if len(add) == 1 else add
+                    result = [m * v + o for m, v, o in
+                              zip(mul3, value, add3)]
+                    assert_almost_equal_objects(c(px, py), result)
+                    assert_almost_equal_objects(b(px, py),
+                                                [int(max(0, min(255, r)))
+                                                 for r in result])
+
     # test the rest of VipsArithmetic
 
     def test_avg(self):
@@ -351,6 +394,22 @@ class TestArithmetic:
             assert_almost_equal_objects(hist(20, 0), [5000])
             assert_almost_equal_objects(hist(5, 0), [0])
 
+        # a single band histogram is only as wide as the max value
+        hist = test.cast(pyvips.BandFormat.UCHAR).hist_find(band=0)
+        assert hist.width == 11
+
+        # ushort lines with and without runs take different paths ... a
+        # noisy ramp has every value once, the flat lines are one run
+        x = pyvips.Image.xyz(256, 256)
+        noisy = (x[0] * 251 + x[1] * 256 * 7) % 65536
+        flat = x[1] * 256
+        test = noisy.join(flat, "vertical").cast(pyvips.BandFormat.USHORT)
+        hist = test.hist_find()
+        assert hist.width == 65536
+        assert hist.min() >= 1
+        assert hist(256, 0) == [257]
+        assert hist.avg() * hist.width == 2 * 256 * 256
+
     def test_histfind_indexed(self):
         im = pyvips.Image.black(50, 100)
         test = im.insert(im + 10, 50, 0, expand=True)
@@ -365,6 +424,27 @@ class TestArithmetic:
                 assert_almost_equal_objects(hist(0, 0), [0])
                 assert_almost_equal_objects(hist(1, 0), [50000])
 
+    def test_histfind_indexed_dense(self):
+        # more than 4096 labels, so the sparse ushort accumulators must
+        # switch to dense bins part way through
+        x = pyvips.Image.xyz(200, 100)
+        index = (x[0] + x[1] * 200).cast(pyvips.BandFormat.USHORT)
+        im = (x[0] * 3 + x[1]).cast(pyvips.BandFormat.DOUBLE)
+        flat = pyvips.Image.new_from_memory(im.write_to_memory(),
+                                            20000, 1, 1, "double")
+
+        for combine in ["sum", "min", "max"]:
+            hist = im.hist_find_indexed(index, combine=combine)
+            assert hist.width == 20000
+            assert hist.height == 1
+            assert (hist - flat).abs().max() == 0
+
+        # 4 pixels in each of 5000 bins
+        hist = (im * 0 + 1).hist_find_indexed(index % 5000)
+        assert hist.width == 5000
+        assert hist.min() == 4
+        assert hist.max() == 4
+
     def test_histfind_ndim(self):
         im = pyvips.Image.black(100, 100) + [1, 2, 3]
 
@@ -381,6 +461,15 @@ class TestArithmetic:
             assert hist.height == 1
             assert hist.bands == 1
 
+            # large enough to use sparse accumulators
+            hist = im.cast(fmt).hist_find_ndim(bins=64)
+
+            assert_almost_equal_objects(hist(0, 0)[0], 10000)
+            assert hist.width == 64
+            assert hist.height == 64
+            assert hist.bands == 64
+            assert hist.avg() * 64 * 64 * 64 == 10000
+
     def test_hough_circle(self):
         test = pyvips.Image.black(100, 100).draw_circle(100, 50, 50, 40)
 
@@ -752,6 +841,57 @@ class TestArithmetic:
             assert_almost_equal_objects(matrix(4, 1), [a.avg()])
             assert_almost_equal_objects(matrix(5, 1), [a.deviate()])
 
+    def test_multistats(self):
+        im = pyvips.Image.black(50, 50)
+        test = im.insert(im + 10, 50, 0, expand=True)
+
+        for x in noncomplex_formats:
+            a = test.cast(x)
+            stats = a.stats()
+            matrix, opts = a.multistats(find_hist=True,
+                                        percent=[50, 90],
+                                        hist=True,
+                                        percentiles=True)
+            hist = opts['hist']
+            percentiles = opts['percentiles']
+
+            for col in range(10):
+                for row in range(2):
+                    assert_almost_equal_objects(matrix(col, row),
+                                                stats(col, row))
+
+            assert_almost_equal_objects(hist.avg(), a.hist_find().avg())
+            assert percentiles(0, 0)[0] == 0
+            assert percentiles(1, 0)[0] == 10
+
+        # NaN has no bin
+        a = pyvips.Image.new_from_array([[float("nan"), 1, 2, 2]])
+        for fmt in float_formats:
+            matrix, opts = a.cast(fmt).multistats(find_hist=True, hist=True)
+            hist = opts['hist']
+            assert hist(0, 0) == [0]
+            assert hist(1, 0) == [1]
+            assert hist(2, 0) == [2]
+            assert hist.avg() * hist.width == 3
+
+    def test_getpoints(self):
+        im = pyvips.Image.xyz(300, 300)
+        points = [(10, 10), (299, 0), (150, 290), (11, 12), (10, 10)]
+        coords = [c for p in points for c in p]
+
+        values = im.getpoints(coords)
+        assert len(values) == len(points) * im.bands
+        for i, (x, y) in enumerate(points):
+            assert_almost_equal_objects(values[i * 2:i * 2 + 2],
+                                        im.getpoint(x, y))
+
+        values = im.getpoints([10.5, 20.5],
+                              interpolate=pyvips.Interpolate.new('bilinear'))
+        assert_almost_equal_objects(values, [10.5, 20.5])
+
+        with pytest.raises(pyvips.error.Error):
+            im.getpoints([300, 0])
+
     def test_sum(self):
         for fmt in all_formats:
             im = pyvips.Image.black(50, 50)
@@ -85,6 +85,124 @@ class TestColour:
 
             assert_almost_equal_objects(before, after, threshold=10)
 
+    def test_colourspace_fused(self):
+        # the single-pass routes must match the step-by-step conversions
+        # exactly, whichever path they take
+        x = pyvips.Image.xyz(256, 256)
+        srgb = x.bandjoin(x[0] ^ x[1]).bandjoin_const([200])
+        srgb = srgb.cast(pyvips.BandFormat.UCHAR)
+        srgb = srgb.copy(interpretation=pyvips.Interpretation.SRGB)
+
+        lab = srgb.colourspace(pyvips.Interpretation.LAB)
+        lab2 = srgb.sRGB2scRGB().scRGB2XYZ().XYZ2Lab()
+        assert (lab - lab2).abs().max() == 0
+
+        bw = srgb.colourspace(pyvips.Interpretation.B_W)
+        bw2 = srgb.sRGB2scRGB().scRGB2BW()
+        assert (bw - bw2).abs().max() == 0
+
+        rgb16 = srgb.colourspace(pyvips.Interpretation.RGB16)
+        grey16 = rgb16.colourspace(pyvips.Interpretation.GREY16)
+        grey162 = rgb16.sRGB2scRGB().scRGB2BW(depth=16)
+        assert (grey16 - grey162).abs().max() == 0
+
+        back = lab.colourspace(pyvips.Interpretation.SRGB)
+        back2 = lab.Lab2XYZ().XYZ2scRGB().scRGB2sRGB()
+        assert (back - back2).abs().max() == 0
+        assert back.interpretation == pyvips.Interpretation.SRGB
+
+        back16 = lab.colourspace(pyvips.Interpretation.RGB16)
+        back162 = lab.Lab2XYZ().XYZ2scRGB().scRGB2sRGB(depth=16)
+        assert (back16 - back162).abs().max() == 0
+
+        lab_bw = lab.colourspace(pyvips.Interpretation.B_W)
+        lab_bw2 = lab.Lab2XYZ().XYZ2scRGB().scRGB2BW()
+        assert (lab_bw - lab_bw2).abs().max() == 0
+        assert lab_bw.bands == 2
+        assert lab_bw.interpretation == pyvips.Interpretation.B_W
+
+        lab_grey16 = lab.colourspace(pyvips.Interpretation.GREY16)
+        lab_grey162 = lab.Lab2XYZ().XYZ2scRGB().scRGB2BW(depth=16)
+        assert (lab_grey16 - lab_grey162).abs().max() == 0
+        assert lab_grey16.interpretation == pyvips.Interpretation.GREY16
+
+    def test_colourspace_float(self):
+        # Lab <-> LCh and Lab <-> XYZ should round-trip closely, whichever
+        # path the line functions take ... use an odd width so we test the
+        # scalar tail too, and keep within the white point
+        x = pyvips.Image.xyz(255, 256)
+        L = x[0] * (50.0 / 255) + 40
+        a = x[1] * (40.0 / 256) - 20
+        b = (x[0] ^ x[1]) * (40.0 / 256) - 20
+        lab = L.bandjoin([a, b])
+        lab = lab.copy(interpretation=pyvips.Interpretation.LAB)
+
+        assert lab.Lab2LCh().LCh2Lab().dE76(lab).max() < 0.01
+        assert lab.Lab2XYZ().XYZ2Lab().dE76(lab).max() < 0.01
+
+        xyz = lab.Lab2XYZ()
+        assert (xyz.XYZ2Lab().Lab2XYZ() - xyz).abs().max() < 0.01
+
+        # check against known values, at the start of the line and in the
+        # tail, and a pixel must give the same result wherever it is
+        lab = pyvips.Image.black(33, 1) + [50, 0, 0]
+        lab = lab.copy(interpretation=pyvips.Interpretation.LAB)
+        xyz = lab.Lab2XYZ()
+        for x in [0, 32]:
+            assert_almost_equal_objects(xyz(x, 0),
+                                        [17.5064, 18.4187, 20.0547],
+                                        threshold=0.001)
+        assert all(b.max() == b.min() for b in xyz.bandsplit())
+
+        lch = (pyvips.Image.black(33, 1) + [50, 30, 40]).Lab2LCh()
+        for x in [0, 32]:
+            assert_almost_equal_objects(lch(x, 0), [50, 50, 53.1301],
+                                        threshold=0.001)
+        assert all(b.max() == b.min() for b in lch.bandsplit())
+
+        for image in [lab.Lab2XYZ().XYZ2Lab(),
+                      lab.Lab2XYZ().XYZ2scRGB(),
+                      lab.Lab2XYZ().XYZ2scRGB().scRGB2XYZ(),
+                      lch.LCh2Lab()]:
+            assert all(b.max() == b.min() for b in image.bandsplit())
+
+    def test_coding(self):
+        # the pack and unpack operations should round-trip to within the
+        # quantisation step ... use an odd width for the loop tail
+        x = pyvips.Image.xyz(255, 256)
+        L = x[0] * (100.0 / 255)
+        a = x[1] - 128
+        b = (x[0] ^ x[1]) - 128
+        lab = L.bandjoin([a, b])
+        lab = lab.copy(interpretation=pyvips.Interpretation.LAB)
+
+        assert (lab.Lab2LabQ().LabQ2Lab() - lab).abs().max() < 0.07
+        assert (lab.Lab2LabS().LabS2Lab() - lab).abs().max() < 0.01
+
+        # every possible 10-bit L
+        l10 = x[0] * 4 + (x[1] & 3)
+        zero = x[0] * 0
+        labq = (l10 >> 2).bandjoin([zero, zero, (x[1] & 3) << 6])
+        labq = labq.cast("uchar")
+        labq = labq.copy(coding=pyvips.Coding.LABQ)
+        assert (labq.LabQ2Lab()[0] - l10 * (100.0 / 1023)).abs().max() < 0.0001
+
+        # check against known values
+        lab = pyvips.Image.black(33, 1) + [50, 10, -20]
+        lab = lab.copy(interpretation=pyvips.Interpretation.LAB)
+        labq = lab.Lab2LabQ()
+        assert_almost_equal_objects(labq.copy(coding=pyvips.Coding.NONE)(32, 0),
+                                    [128, 10, 236, 0])
+        assert_almost_equal_objects(labq.LabQ2Lab()(32, 0),
+                                    [50.0489, 10, -20], threshold=0.001)
+
+        rgb = (x / 64.0).bandjoin(x[0] / 1024.0).copy(
+            interpretation=pyvips.Interpretation.SCRGB)
+        back = rgb.float2rad().rad2float()
+        assert ((back - rgb).abs() / (rgb.max() + 1)).max() < 0.01
+        assert_almost_equal_objects(back(254, 255), rgb(254, 255),
+                                    threshold=0.05)
+
     # test results from Bruce Lindbloom's calculator:
     # http://www.brucelindbloom.com
     def test_dE00(self):
@@ -111,6 +229,42 @@ class TestColour:
         assert pytest.approx(result, 0.001) == 33.166
         assert pytest.approx(alpha, 0.001) == 42.0
 
+    def test_dE_vector(self):
+        # a hue ramp that goes round every quadrant a few times, with a
+        # neutral (zero chroma) pixel every few steps in each image, so we
+        # hit the atan2() octants and the zero chroma special cases ... use
+        # an odd width, so both the vector path and the scalar tail are used
+        x = pyvips.Image.xyz(255, 1)[0]
+
+        def lab_ramp(L, chroma, hue):
+            lab = L.bandjoin([chroma * hue.cos(), chroma * hue.sin()])
+            return lab.copy(interpretation=pyvips.Interpretation.LAB)
+
+        reference = lab_ramp(x % 61 + 20, x % 17 * 4, x * 5.7)
+        sample = lab_ramp(x % 37 + 30, x % 13 * 5, x * 3.1 + 45)
+
+        for fn, threshold in [(lambda a, b: a.dE00(b), 1e-3),
+                              (lambda a, b: a.dE76(b), 1e-5),
+                              (lambda a, b: a.dECMC(b), 1e-3)]:
+            assert_vector_matches_scalar(fn, reference, sample,
+                                         threshold=threshold)
+
+    def test_dEstats(self):
+        test = pyvips.Image.new_from_file(JPEG_FILE)
+        test = test.colourspace(pyvips.Interpretation.LAB)
+        test2 = test.linear([1.02, 1, 1], [1, 2, -1])
+        n = test.width * test.height
+
+        for metric, fn in [("de76", test.dE76),
+                           ("de00", test.dE00),
+                           ("decmc", test.dECMC)]:
+            d = fn(test2)
+            mean, opts = test.dEstats(test2, metric=metric, threshold=2,
+                                      max=True, count=True)
+            assert pytest.approx(mean, 0.0001) == d.avg()
+            assert pytest.approx(opts["max"], 0.0001) == d.max()
+            assert opts["count"] == round((d > 2).avg() * n / 255)
+
     # the vips CMC calculation is based on distance in a colorspace
     # derived from the CMC formula, so it won't match exactly ...
     # see vips_LCh2CMC() for details
@@ -165,6 +319,27 @@ class TestColour:
         im = test.icc_import()
         assert im.interpretation == pyvips.Interpretation.LAB
 
+        # transforms are cached and shared between operations, so a copy of
+        # the image must give the same result, and the depth must be
+        # respected
+        im = test.icc_transform(SRGB_FILE)
+        im2 = test.copy().icc_transform(SRGB_FILE)
+        assert (im - im2).abs().max() == 0
+        im3 = test.copy().icc_transform(SRGB_FILE, depth=16)
+        assert im3.format == pyvips.BandFormat.USHORT
+        assert (im3 / 256 - im).abs().max() < 2
+
+        # a baked LUT should be close to the full transform, for 3D and 4D
+        # input
+        for lut_size in [17, 33, 65]:
+            im2 = test.icc_transform(SRGB_FILE, lut_size=lut_size)
+            assert im2.format == pyvips.BandFormat.UCHAR
+            assert (im - im2).abs().max() < 4
+        cmyk = test.icc_transform("cmyk")
+        im = cmyk.icc_transform(SRGB_FILE)
+        im2 = cmyk.icc_transform(SRGB_FILE, lut_size=33)
+        assert (im - im2).abs().max() < 4
+
     # even without lcms, we should have a working approximation
     def test_cmyk(self):
         test = pyvips.Image.new_from_file(JPEG_FILE)
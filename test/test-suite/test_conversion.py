@@ -75,6 +75,22 @@ class TestConversion:
         im2 = im.cast("char")
         assert im2.avg() == max_value["char"]
 
+    def test_cast_vector(self):
+        # include values that clip
+        values = [-1e10, -2147483648, -40000, -32768, -129, -128, -2.7, -1,
+                  -0.5, 0, 0.5, 1, 2.7, 127, 128, 255, 255.5, 256, 32767,
+                  32768, 65535, 65536, 2147483520, 2147483647, 2147483648,
+                  3e9, 4294967295, 1e10]
+        values = values + [x * 0.37 for x in values] + [x * 1.5 for x in values]
+        source = pyvips.Image.new_from_array([values])
+
+        for in_fmt in noncomplex_formats:
+            wide = source.cast(in_fmt)
+            for out_fmt in noncomplex_formats:
+                for shift in [False, True]:
+                    assert_vector_matches_scalar(
+                        lambda im: im.cast(out_fmt, shift=shift), wide)
+
     def test_band_and(self):
         def band_and(x):
             if isinstance(x, pyvips.Image):
@@ -135,6 +151,36 @@ class TestConversion:
 
         self.run_unary(self.all_images, bandmean, fmt=noncomplex_formats)
 
+    def test_band_vector(self):
+        source = ramp_image(67, [(37, 11), (1019, 7), (5, 250), (131071, 3)],
+                            modulus=None)
+
+        for fmt in noncomplex_formats:
+            wide = source.cast(fmt)
+
+            def check(fn):
+                assert_vector_matches_scalar(fn, wide)
+
+            for layout in [[1, 1], [1, 1, 1], [1, 1, 1, 1], [2, 2], [3, 1],
+                           [1, 3], [2, 1], [1, 2], [2, 1, 1]]:
+                def join(im):
+                    parts = []
+                    start = 0
+                    for n in layout:
+                        parts.append(im.extract_band(start, n=n))
+                        start += n
+                    return parts[0].bandjoin(parts[1:])
+
+                check(join)
+
+            for bands in [2, 3, 4]:
+                for band in range(bands):
+                    for n in range(1, bands - band + 1):
+                        check(lambda im: im.extract_band(0, n=bands)
+                              .extract_band(band, n=n))
+
+                check(lambda im: im.extract_band(0, n=bands).bandmean())
+
     def test_bandrank(self):
         def median(x, y):
             joined = [[a, b] for a, b in zip(x, y)]
@@ -347,6 +393,27 @@ class TestConversion:
         assert opts["attention_x"] == 199
         assert opts["attention_y"] == 234
 
+    @pytest.mark.skipif(pyvips.type_find("VipsOperation", "smartcrop") == 0,
+                        reason="no smartcrop, skipping test")
+    def test_smartcrop_attention_window(self):
+        test, opts = self.image.smartcrop(
+            100, 100,
+            interesting="attention-window",
+            attention_x=True, attention_y=True)
+        assert test.width == 100
+        assert test.height == 100
+        assert opts["attention_x"] == -test.xoffset + 50
+        assert opts["attention_y"] == -test.yoffset + 50
+
+        # a detailed patch on a flat background should be found
+        patch = self.image.crop(100, 100, 60, 60)
+        test = pyvips.Image.black(300, 200, bands=3) \
+            .copy(interpretation="srgb") \
+            .insert(patch, 220, 120)
+        crop = test.smartcrop(60, 60, interesting="attention-window")
+        assert abs(-crop.xoffset - 220) <= 5
+        assert abs(-crop.yoffset - 120) <= 5
+
     def test_smartcrop_rgba(self):
         rgba = pyvips.Image.new_from_file(RGBA_FILE)
         test, opts = rgba.smartcrop(
@@ -457,6 +524,100 @@ class TestConversion:
         assert_almost_equal_objects(comp(0, 0), [51.8, 52.8, 53.8, 255],
                                     threshold=0.1)
 
+    @pytest.mark.skipif(pyvips.type_find("VipsConversion", "composite") == 0,
+                        reason="no composite support, skipping test")
+    def test_composite_modes(self):
+        x = pyvips.Image.xyz(37, 16)
+        base = (x[0] * 7).bandjoin([x[1] * 16,
+                                    (x[0] + x[1]) * 5,
+                                    255 - x[0] * 6])
+        base = base.cast("uchar").copy(interpretation="srgb")
+        overlay = (x[1] * 13).bandjoin([255 - x[0] * 5,
+                                        x[0] * x[1] / 3,
+                                        x[1] * 17])
+        overlay = overlay.cast("uchar").copy(interpretation="srgb")
+
+        # the vector paths should match the scalar path, which is
+        # always used for a one pixel wide image
+        modes = ["clear", "source", "over", "in", "out", "atop",
+                 "dest", "dest-over", "dest-in", "dest-out", "dest-atop",
+                 "xor", "add", "saturate", "multiply", "screen", "overlay",
+                 "darken", "lighten", "colour-dodge", "colour-burn",
+                 "hard-light", "soft-light", "difference", "exclusion"]
+        for premultiplied in [False, True]:
+            for mode in modes:
+                comp = base.composite(overlay, mode,
+                                      premultiplied=premultiplied)
+                for left in [0, 17, 36]:
+                    a = base.crop(left, 0, 1, 16)
+                    b = overlay.crop(left, 0, 1, 16)
+                    narrow = a.composite(b, mode,
+                                         premultiplied=premultiplied)
+                    diff = comp.crop(left, 0, 1, 16) - narrow
+                    assert diff.abs().max() <= 1
+
+        # premultiplied over on 8 and 16-bit images is done in fixed point
+        # and should be exact
+        for mx, interpretation in [(255, "srgb"), (65535, "rgb16")]:
+            fmt = "uchar" if mx == 255 else "ushort"
+            a = (base * (mx / 255)).premultiply(max_alpha=mx).cast(fmt)
+            a = a.copy(interpretation=interpretation)
+            b = (overlay * (mx / 255)).premultiply(max_alpha=mx).cast(fmt)
+            b = b.copy(interpretation=interpretation)
+
+            comp = a.composite(b, "over", premultiplied=True)
+            # double, since float can't hold 65535 * 65535 exactly
+            ad = a.cast("double")
+            bd = b.cast("double")
+            predict = (bd * mx + ad * (mx - bd[3])) / mx
+            assert (comp - predict.floor()).abs().max() == 0
+
+        # the fixed point path truncates, like the float path ... 200 *
+        # 127 / 255 is 99.6, so check both the vector and scalar paths
+        # give 99
+        for width in [37, 1]:
+            a = pyvips.Image.black(width, 1) + [200, 200, 200, 255]
+            a = a.cast("uchar").copy(interpretation="srgb")
+            b = pyvips.Image.black(width, 1) + [0, 0, 0, 128]
+            b = b.cast("uchar").copy(interpretation="srgb")
+            comp = a.composite(b, "over", premultiplied=True)
+            assert comp.extract_band(0).max() == 99
+            assert comp.extract_band(0).min() == 99
+
+    @pytest.mark.skipif(pyvips.type_find("VipsConversion", "composite") == 0,
+                        reason="no composite support, skipping test")
+    def test_composite_many(self):
+        # lots of small opaque layers, some off the edges, plus one which
+        # covers many grid cells ... "over" should then match insert
+        base = pyvips.Image.black(700, 500, bands=3).bandjoin(255)
+        base = base.cast("uchar").copy(interpretation="srgb")
+
+        layers = []
+        xs = []
+        ys = []
+        predict = base
+        for i in range(300):
+            width = 5 + (i * 7) % 40
+            height = 5 + (i * 11) % 30
+            x = (i * 97) % 760 - 30
+            y = (i * 61) % 560 - 30
+            if i == 150:
+                width = 600
+                height = 300
+            layer = (pyvips.Image.black(width, height, bands=3) +
+                     [i % 256, (i * 3) % 256, (i * 5) % 256]).bandjoin(255)
+            layer = layer.cast("uchar").copy(interpretation="srgb")
+            layers.append(layer)
+            xs.append(x)
+            ys.append(y)
+            predict = predict.insert(layer, x, y)
+
+        comp = base.composite(layers, "over", x=xs, y=ys)
+
+        assert comp.width == base.width
+        assert comp.height == base.height
+        assert (comp - predict).abs().max() == 0
+
     def test_unpremultiply(self):
         for fmt in unsigned_formats + [pyvips.BandFormat.SHORT,
                                        pyvips.BandFormat.INT] + float_formats:
@@ -476,6 +637,32 @@ class TestConversion:
                 # differs ... don't require huge accuracy
                 assert abs(x - y) < 2
 
+    def test_alpha_vector(self):
+        colour = ramp_image(300, [(37, 11), (101, 7), (5, 250)])
+        # a little out of range, to test clipping
+        x = ramp_image(300, [(1, 0)], modulus=260)
+
+        for fmt, mx, alpha in [
+                [pyvips.BandFormat.UCHAR, 255, x],
+                [pyvips.BandFormat.USHORT, 65535, x * 257],
+                [pyvips.BandFormat.FLOAT, 1.0, x / 200.0 - 0.2]]:
+            scale = mx / 255.0
+            for bands in [2, 4]:
+                wide = (colour.extract_band(0, n=bands - 1) * scale) \
+                    .bandjoin(alpha).cast(fmt)
+
+                def check(fn):
+                    assert_vector_matches_scalar(fn, wide)
+
+                for max_alpha in [mx, mx * 0.75]:
+                    check(lambda im: im.premultiply(max_alpha=max_alpha))
+                    check(lambda im: im.unpremultiply(max_alpha=max_alpha))
+
+                check(lambda im: im.flatten(max_alpha=mx))
+                check(lambda im: im.flatten(max_alpha=mx,
+                                            background=[100 * scale] *
+                                            (bands - 1)))
+
     def test_flip(self):
         for fmt in all_formats:
             test = self.colour.cast(fmt)
@@ -624,6 +811,66 @@ class TestConversion:
         result = r(50, 50)
         assert_almost_equal_objects(result, [3.0, 4.9, 6.9], threshold=0.1)
 
+    def test_ifthenelse_vector(self):
+        cond = ramp_image(300, [(37, 11), (101, 7), (5, 250)])
+        # the middle band is only 0, 127 and 254, for blend
+        cond = cond[0].bandjoin([cond[1] % 3 * 127, cond[2]])
+        then = ramp_image(300, [(13, 3), (7, 100), (5, 250)])
+        other = ramp_image(300, [(11, 5), (3, 10), (17, 25)])
+        cond = cond.cast(pyvips.BandFormat.UCHAR)
+
+        for fmt, scale in [[pyvips.BandFormat.UCHAR, 1],
+                           [pyvips.BandFormat.CHAR, 0.5],
+                           [pyvips.BandFormat.USHORT, 257],
+                           [pyvips.BandFormat.SHORT, 100],
+                           [pyvips.BandFormat.INT, 1000],
+                           [pyvips.BandFormat.FLOAT, 1.0 / 255]]:
+            a = (then * scale).cast(fmt)
+            b = (other * scale).cast(fmt)
+
+            for blend in [False, True]:
+                assert_vector_matches_scalar(
+                    lambda c, p, q: c.ifthenelse(p, q, blend=blend),
+                    cond, a, b)
+
+    def test_ifthenelse_const(self):
+        # comparing against a constant should be the same as making the mask
+        # with relational_const
+        x = pyvips.Image.xyz(300, 20)[0]
+        cond = ((x * 37 + 11) % 256).bandjoin([(x * 101 + 7) % 256,
+                                               (x * 5 + 250) % 256])
+        ops = ["equal", "noteq", "less", "lesseq", "more", "moreeq"]
+
+        for fmt in noncomplex_formats:
+            c = cond.cast(fmt)
+
+            for op in ops:
+                for const in [[128], [12.5], [10, 128, 254]]:
+                    for blend in [False, True]:
+                        mask = c.relational_const(op, const)
+                        predict = mask.ifthenelse(self.colour, [1, 2, 3],
+                                                  blend=blend)
+                        result = c.ifthenelse(self.colour, [1, 2, 3],
+                                              blend=blend,
+                                              relational=op, c=const)
+                        assert (predict == result).min() == 255
+
+        # the default is != 0, without the cast to uchar
+        c = (x / 299.0).cast(pyvips.BandFormat.FLOAT)
+        result = c.ifthenelse(255, 0, c=[0])
+        assert result.min() == 0
+        assert result(1, 0) == [255]
+
+    def test_bandbool_vector(self):
+        im = ramp_image(300, [(37, 11), (101, 7), (5, 250), (13, 3)])
+
+        for fmt in int_formats:
+            for bands in [2, 3, 4]:
+                a = (im.extract_band(0, n=bands) * 123).cast(fmt)
+                for op in ["and", "or", "eor"]:
+                    assert_vector_matches_scalar(
+                        lambda im: im.bandbool(op), a)
+
     def test_switch(self):
         x = pyvips.Image.grey(256, 256, uchar=True)
 
@@ -703,6 +950,40 @@ class TestConversion:
         assert im.height == max_height
         assert im.bands == max_bands
 
+    def test_arrayjoin_lazy(self):
+        # 12 tiles, all a little different
+        tiles = [(self.colour.crop(i * 3, i * 2, 40, 30) + i).cast("uchar")
+                 for i in range(12)]
+        template = os.path.join(self.tempdir, "tile-%d.v")
+        for i, tile in enumerate(tiles):
+            tile.write_to_file(template % i)
+
+        for max_open in [1, 3, 100]:
+            for shim in [0, 5]:
+                a = pyvips.Image.arrayjoin(tiles, across=5, shim=shim,
+                                           background=[10, 20, 30])
+                b = pyvips.Image.arrayjoin_lazy(12, filename=template,
+                                                across=5, shim=shim,
+                                                background=[10, 20, 30],
+                                                max_open=max_open)
+                assert a.width == b.width
+                assert a.height == b.height
+                assert a.bands == b.bands
+                assert (a == b).min() == 255
+
+        # the %d can have flags and a width
+        template = os.path.join(self.tempdir, "tile-%03d.v")
+        for i, tile in enumerate(tiles):
+            tile.write_to_file(template % i)
+        a = pyvips.Image.arrayjoin(tiles, across=5)
+        b = pyvips.Image.arrayjoin_lazy(12, filename=template, across=5)
+        assert (a == b).min() == 255
+
+        with pytest.raises(pyvips.error.Error):
+            pyvips.Image.arrayjoin_lazy(12, filename="tile-%s.v")
+        with pytest.raises(pyvips.error.Error):
+            pyvips.Image.arrayjoin_lazy(12, filename="tile-%d-%d.v")
+
     def test_msb(self):
         for fmt in unsigned_formats:
             mx = max_value[fmt]
@@ -766,6 +1047,28 @@ class TestConversion:
 
         self.run_unary([self.colour], recomb, fmt=noncomplex_formats)
 
+    def test_recomb_vector(self):
+        colour = ramp_image(300, [(37, 11), (101, 7), (5, 250), (13, 3)])
+        matrices = {
+            3: [[0.2, 0.5, 0.3], [-0.1, 1.2, 0.4], [0.7, 0.0, -0.25]],
+            4: [[0.2, 0.5, 0.3, 0.1], [-0.1, 1.2, 0.4, 0.0],
+                [0.7, 0.0, -0.25, 2.0], [0.0, 0.0, 0.0, 1.0]]
+        }
+
+        for fmt, scale in [[pyvips.BandFormat.UCHAR, 1],
+                           [pyvips.BandFormat.USHORT, 257],
+                           [pyvips.BandFormat.FLOAT, 1.0 / 255]]:
+            for in_bands in [3, 4]:
+                for out_bands in [3, 4]:
+                    m = [row[:in_bands] for row in matrices[4][:out_bands]] \
+                        if in_bands != out_bands else matrices[in_bands]
+                    wide = (colour.extract_band(0, n=in_bands) * scale) \
+                        .cast(fmt)
+                    assert wide.recomb(m).bands == out_bands
+                    # the scalar path sums in double
+                    assert_vector_matches_scalar(lambda im: im.recomb(m),
+                                                 wide, threshold=1e-5)
+
     def test_replicate(self):
         for fmt in all_formats:
             im = self.colour.cast(fmt)
@@ -816,6 +1119,40 @@ class TestConversion:
                 diff = (after - im).abs().max()
                 assert diff == 0
 
+    def test_rot_pixels(self):
+        # check every pixel lands in the right place for 1, 2, 3, 4, 8 and
+        # 16 byte pixels, with sizes which aren't a multiple of the block
+        # size and which span several tiles
+        width = 300
+        height = 170
+
+        def make(x, y):
+            v = x + y * 1000
+            return [(v % 251).cast("uchar"),
+                    (v % 251).cast("uchar").bandjoin((v % 241).cast("uchar")),
+                    (v % 251).cast("uchar").bandjoin([(v % 241).cast("uchar"),
+                                                     (v % 239).cast("uchar")]),
+                    v.cast("uint"),
+                    v.cast("double"),
+                    v.cast("double").bandjoin((v * 3).cast("double"))]
+
+        xy = pyvips.Image.xyz(width, height)
+        tests = make(xy[0], xy[1])
+
+        xy = pyvips.Image.xyz(height, width)
+        d90 = make(xy[1], (height - 1) - xy[0])
+        d270 = make((width - 1) - xy[1], xy[0])
+
+        xy = pyvips.Image.xyz(width, height)
+        d180 = make((width - 1) - xy[0], (height - 1) - xy[1])
+        flip = make((width - 1) - xy[0], xy[1])
+
+        for i, im in enumerate(tests):
+            assert (im.rot90() - d90[i]).abs().max() == 0
+            assert (im.rot180() - d180[i]).abs().max() == 0
+            assert (im.rot270() - d270[i]).abs().max() == 0
+            assert (im.fliphor() - flip[i]).abs().max() == 0
+
     def test_autorot(self):
         rotation_images = os.path.join(IMAGES, 'rotation')
         files = os.listdir(rotation_images)
@@ -79,6 +79,77 @@ class TestConvolution:
                     true = conv(im, msk, 49, 49)
                     assert_almost_equal_objects(result, true)
 
+    def test_convf_vector(self):
+        x = pyvips.Image.xyz(301, 40)
+        im = ((x[0] * 37 + x[1] * 11) % 256).bandjoin([(x[0] * x[1]) % 256,
+                                                       (x[0] * 5 + 250) % 256])
+        masks = [pyvips.Image.gaussmat(3, 0.1, separable=True,
+                                       precision="float"),
+                 pyvips.Image.new_from_array([[1, -2, 3, 4, 5.5]], scale=3,
+                                             offset=10)]
+
+        for fmt in ["uchar", "ushort", "float", "double"]:
+            src = im.cast(fmt)
+
+            for msk in masks:
+                for m in [msk, msk.rot90()]:
+                    # padding with zeros makes it 2D, so this checks the 1D
+                    # path against the general one
+                    padded = m.embed(1, 1, m.width + 2, m.height + 2)
+                    padded = padded.copy(scale=m.scale, offset=m.offset)
+
+                    a = src.conv(m, precision="float")
+                    b = src.conv(padded, precision="float")
+                    assert (a - b).abs().max() < 0.01
+
+                    for x, y in [(25, 20), (150, 10), (290, 30)]:
+                        true = conv(src, m, x - m.width // 2,
+                                    y - m.height // 2)
+                        true = [v + m.offset for v in true]
+                        assert_almost_equal_objects(a(x, y), true,
+                                                    threshold=0.01)
+
+            a = src.convsep(masks[0], precision="float")
+            b = src.conv(masks[0], precision="float") \
+                .conv(masks[0].rot90(), precision="float")
+            assert (a - b).abs().max() < 0.01
+
+    @pytest.mark.skipif(pyvips.type_find("VipsOperation", "fwfft") == 0,
+                        reason="no FFTW, skipping test")
+    def test_conv_fft(self):
+        x = pyvips.Image.xyz(300, 200)
+        im = ((x[0] * 37 + x[1] * 11) % 256).bandjoin((x[0] * x[1]) % 256)
+
+        # big and dense enough for the FFT path, and not symmetric ... the
+        # mask sums to 1515, so with scale 40 the sum / scale has a
+        # fractional part above .5 and integer precision must adjust the
+        # scale, as convi does
+        mask = [[(i * 7 + j * 3) % 11 - 4 for i in range(41)]
+                for j in range(37)]
+        masks = [pyvips.Image.new_from_array(mask, scale=50, offset=3),
+                 pyvips.Image.new_from_array(mask, scale=40, offset=3)]
+
+        for m in masks:
+            for fmt in ["uchar", "short", "float", "double"]:
+                src = im.cast(fmt)
+
+                a = src.conv(m, precision="float")
+                b = src.convf(m)
+                assert a.width == src.width
+                assert a.height == src.height
+                assert a.format == b.format
+                assert (a - b).abs().max() < 0.01
+
+                # the uchar convi vector path is approximate, so compare
+                # uchar against the C path via ushort
+                a = src.conv(m, precision="integer")
+                if fmt == "uchar":
+                    b = src.cast("ushort").convi(m).cast("uchar")
+                else:
+                    b = src.convi(m)
+                assert a.format == src.format
+                assert (a - b).abs().max() < 0.01
+
     # don't test conva, it's still not done
     def dont_est_conva(self):
         for im in self.all_images:
@@ -189,6 +260,37 @@ class TestConvolution:
                     assert_almost_equal_objects(a_point, b_point,
                                                 threshold=0.1)
 
+    def test_gaussblur_iir(self):
+        im = pyvips.Image.black(200, 150).draw_rect(255, 60, 40, 80, 70,
+                                                    fill=True)
+        im = im.bandjoin([im.flip("horizontal"), im.flip("vertical")])
+
+        for sigma in [20, 30, 100]:
+            a = im.gaussblur(sigma, min_ampl=0.001,
+                             precision="float", method="conv")
+            b = im.gaussblur(sigma, precision="float", method="iir")
+
+            assert b.width == im.width
+            assert b.height == im.height
+            assert b.bands == im.bands
+            assert b.format == "float"
+            assert (a - b).abs().max() < 5
+
+        b = im.gaussblur(30, method="iir")
+        assert b.format == "uchar"
+
+        # the recursive filter works in memory, so auto never picks it
+        a = im.gaussblur(30)
+        b = im.gaussblur(30, method="conv")
+        assert (a - b).abs().max() == 0
+
+        # short lines, and constant images must stay constant
+        for w, h in [(1, 1), (1, 3), (2, 5), (50, 2)]:
+            im = pyvips.Image.black(w, h) + 100
+            b = im.gaussblur(30, method="iir", precision="float")
+            assert abs(b.min() - 100) < 0.001
+            assert abs(b.max() - 100) < 0.001
+
     def test_sharpen(self):
         for im in self.all_images:
             for fmt in noncomplex_formats:
@@ -0,0 +1,35 @@
+# vim: set fileencoding=utf-8 :
+import pytest
+
+import pyvips
+from helpers import *
+
+
+@pytest.mark.skipif(pyvips.type_find("VipsOperation", "fwfft") == 0,
+                    reason="no FFTW, skipping test")
+class TestFreqfilt:
+    def test_fft_round_trip(self):
+        # run each size twice, so the second time uses cached plans
+        for width, height in [(64, 64), (101, 67), (64, 64), (101, 67)]:
+            x = pyvips.Image.xyz(width, height)
+            im = (x[0] * 13 + x[1] * 7) % 251
+
+            fft = im.fwfft()
+            assert fft.width == width
+            assert fft.height == height
+            assert fft.format == pyvips.BandFormat.DPCOMPLEX
+
+            # DC is the mean
+            assert abs(fft.real().getpoint(0, 0)[0] - im.avg()) < 0.001
+
+            real = fft.invfft(real=True)
+            assert real.format == pyvips.BandFormat.DOUBLE
+            assert (real - im).abs().max() < 0.001
+
+            cplx = fft.invfft()
+            assert (cplx.real() - im).abs().max() < 0.001
+            assert cplx.imag().abs().max() < 0.001
+
+            # complex input takes the complex to complex path
+            fft2 = cplx.fwfft()
+            assert (fft2 - fft).abs().max() < 0.001
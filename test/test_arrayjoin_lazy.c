@@ -0,0 +1,110 @@
+/* Join tiles made by an open_fn with vips_arrayjoin_lazy(), and check that
+ * tiles are closed as a sequential read moves past them.
+ */
+
+#include <vips/vips.h>
+
+#define N_TILES (12)
+#define TILE_WIDTH (100)
+#define TILE_HEIGHT (300)
+
+static VipsImage *tiles[N_TILES];
+static int n_opened = 0;
+static int n_closed = 0;
+
+static void
+tile_close(VipsImage *image, void *user)
+{
+	g_atomic_int_inc(&n_closed);
+}
+
+/* This can be called from several threads at once.
+ */
+static VipsImage *
+open_tile(int i, void *client)
+{
+	VipsImage *tile;
+
+	if (vips_copy(tiles[i], &tile, NULL))
+		return NULL;
+
+	/* As if we'd opened the tile with access=sequential, so the join
+	 * will minimise tiles once it's past them.
+	 */
+	vips_image_set_int(tile, VIPS_META_SEQUENTIAL, 1);
+
+	g_signal_connect(tile, "close", G_CALLBACK(tile_close), NULL);
+	g_atomic_int_inc(&n_opened);
+
+	return tile;
+}
+
+int
+main(int argc, char **argv)
+{
+	VipsImage *t;
+	VipsImage *a;
+	VipsImage *b;
+	VipsImage *diff;
+	double max;
+	int i;
+
+	if (VIPS_INIT(argv[0]))
+		vips_error_exit(NULL);
+
+	/* The operation cache would keep closed tiles alive.
+	 */
+	vips_cache_set_max(0);
+
+	for (i = 0; i < N_TILES; i++) {
+		if (vips_black(&t, TILE_WIDTH, TILE_HEIGHT, "bands", 3, NULL) ||
+			vips_linear1(t, &tiles[i], 1.0, i * 10.0,
+				"uchar", TRUE,
+				NULL))
+			vips_error_exit(NULL);
+		g_object_unref(t);
+	}
+
+	/* One tile across, so a sequential read goes through them in order.
+	 * max_open is larger than the number of tiles, so only sequential
+	 * minimise can close them.
+	 */
+	if (vips_arrayjoin(tiles, &a, N_TILES, "across", 1, NULL) ||
+		vips_arrayjoin_lazy(&b, N_TILES,
+			"open_fn", (void *) open_tile,
+			"across", 1,
+			"max_open", 100,
+			NULL))
+		vips_error_exit(NULL);
+
+	if (vips_subtract(a, b, &t, NULL) ||
+		vips_abs(t, &diff, NULL) ||
+		vips_max(diff, &max, NULL))
+		vips_error_exit(NULL);
+	g_object_unref(t);
+	g_object_unref(diff);
+
+	if (max != 0) {
+		printf("open_fn tiles differ from vips_arrayjoin()\n");
+		return 1;
+	}
+
+	if (n_opened < N_TILES) {
+		printf("only %d of %d tiles opened\n", n_opened, N_TILES);
+		return 1;
+	}
+
+	/* b is still alive, so any closes must be from minimise.
+	 */
+	if (n_closed == 0) {
+		printf("no tiles closed by a sequential read\n");
+		return 1;
+	}
+
+	g_object_unref(a);
+	g_object_unref(b);
+	for (i = 0; i < N_TILES; i++)
+		g_object_unref(tiles[i]);
+
+	return 0;
+}